@@ -19,6 +19,7 @@ varying vec4	position_eye;
 	attribute	vec4	color_current;
 	attribute	vec4	color_compliment;
 	attribute	float	texture_mix;
+	attribute	float	selected;
 	
 	void main (void)
 	{
@@ -59,6 +60,13 @@ varying vec4	position_eye;
 					dot(eye_plane_t, position));
 					
 		tex_mix = texture_mix;
+		
+		// Faces flagged selected are dropped by moving them outside the clip 
+		// volume; their lines stay.  The display list code draws the faces 
+		// of selected copies again as a wire frame.  The DL builder writes 
+		// a zero normal for every line vertex, so that is how we know a line.
+		if(selected > 0.5 && normal != vec3(0))
+			gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
 	}
 
 #endif
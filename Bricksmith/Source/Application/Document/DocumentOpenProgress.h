@@ -0,0 +1,70 @@
+//==============================================================================
+//
+// File:		DocumentOpenProgress.h
+//
+// Purpose:		Shows and times the stages of opening a document.
+//
+//				Reading is one stage rather than several because its parts run
+//				together: submodels are parsed in parallel, and every library
+//				part a submodel mentions is loaded, flattened and has its mesh
+//				smoothed as soon as its name is seen, while the rest of the file
+//				is still being parsed. Everything after that is done in order
+//				on the main thread.
+//
+//				The open is not over until the model has been drawn once, since
+//				the first draw is what uploads the meshes; the report gives the
+//				time to that first complete frame as well.
+//
+//==============================================================================
+#import <Foundation/Foundation.h>
+
+@class AMSProgressPanel;
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Types
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef enum
+{
+	DocumentOpenStageRead		= 0,	// parse, load library parts, prepare their meshes
+	DocumentOpenStageCheck		= 1,	// missing, moved and misnamed parts
+	DocumentOpenStageOptimize	= 2,	// -optimizeOpenGL
+	DocumentOpenStageFirstFrame	= 3,	// until a view has drawn the model
+	DocumentOpenStageCount		= 4
+
+} DocumentOpenStageT;
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// class DocumentOpenProgress
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface DocumentOpenProgress : NSObject
+{
+	AMSProgressPanel	*progressPanel;
+	CFAbsoluteTime		openStartTime;
+	CFAbsoluteTime		stageStartTimes[DocumentOpenStageCount];
+	CFAbsoluteTime		stageEndTimes[DocumentOpenStageCount];
+	NSInteger			currentStage;			// -1 before the first stage begins
+	BOOL				isFinished;
+}
+
+// Initialization
+- (id) initWithMessage:(NSString *)message;
+
+// Stages
+- (void) beginStage:(DocumentOpenStageT)stage;
+- (void) closeProgressPanel;
+- (void) firstFrameDrawn;
+- (BOOL) isFinished;
+
+// Results
+- (CFTimeInterval) durationOfStage:(DocumentOpenStageT)stage;
+- (CFTimeInterval) timeToFirstFrame;
+- (NSString *) report;
+
+@end
@@ -0,0 +1,197 @@
+//==============================================================================
+//
+// File:		DocumentOpenProgress.m
+//
+// Purpose:		Shows and times the stages of opening a document. See
+//				DocumentOpenProgress.h.
+//
+// Notes:		Only reading shows the progress panel; the checks which follow
+//				may put up alerts of their own.
+//
+//==============================================================================
+#import "DocumentOpenProgress.h"
+
+#import <AMSProgressBar/AMSProgressBar.h>
+
+static NSString *StageNames[DocumentOpenStageCount] = {	@"read",
+														@"check parts",
+														@"optimize",
+														@"first frame" };
+
+
+@implementation DocumentOpenProgress
+
+#pragma mark -
+#pragma mark INITIALIZATION
+#pragma mark -
+
+//========== initWithMessage: ==================================================
+//
+// Purpose:		Starts the clock and puts up the progress panel with the given
+//				message.
+//
+//==============================================================================
+- (id) initWithMessage:(NSString *)message
+{
+	self = [super init];
+	if(self)
+	{
+		openStartTime   = CFAbsoluteTimeGetCurrent();
+		currentStage    = -1;
+
+		progressPanel   = [[AMSProgressPanel progressPanel] retain];
+		[progressPanel setMessage:message];
+		[progressPanel setIndeterminate:YES];
+		[progressPanel showProgressPanel];
+	}
+	return self;
+
+}//end initWithMessage:
+
+
+#pragma mark -
+#pragma mark STAGES
+#pragma mark -
+
+//========== beginStage: =======================================================
+//
+// Purpose:		Ends whatever stage is running and starts the given one.
+//
+//==============================================================================
+- (void) beginStage:(DocumentOpenStageT)stage
+{
+	CFAbsoluteTime  now = CFAbsoluteTimeGetCurrent();
+
+	if(self->currentStage >= 0)
+		self->stageEndTimes[self->currentStage] = now;
+
+	self->stageStartTimes[stage]    = now;
+	self->stageEndTimes[stage]      = 0;
+	self->currentStage              = stage;
+
+}//end beginStage:
+
+
+//========== closeProgressPanel ================================================
+//
+// Purpose:		Takes down the progress panel. The clock keeps running.
+//
+//==============================================================================
+- (void) closeProgressPanel
+{
+	[self->progressPanel close];
+	[self->progressPanel release];
+	self->progressPanel = nil;
+
+}//end closeProgressPanel
+
+
+//========== firstFrameDrawn ===================================================
+//
+// Purpose:		A view has drawn the whole model, which is the end of the open.
+//				Later frames are ignored.
+//
+//==============================================================================
+- (void) firstFrameDrawn
+{
+	if(self->isFinished == NO && self->currentStage == DocumentOpenStageFirstFrame)
+	{
+		self->stageEndTimes[DocumentOpenStageFirstFrame] = CFAbsoluteTimeGetCurrent();
+		self->isFinished = YES;
+	}
+
+}//end firstFrameDrawn
+
+
+//========== isFinished ========================================================
+//
+// Purpose:		Returns YES once the first frame has been drawn.
+//
+//==============================================================================
+- (BOOL) isFinished
+{
+	return self->isFinished;
+
+}//end isFinished
+
+
+#pragma mark -
+#pragma mark RESULTS
+#pragma mark -
+
+//========== durationOfStage: ==================================================
+//
+// Purpose:		Returns the time spent in the given stage, or 0 if it hasn't
+//				finished (or never ran).
+//
+//==============================================================================
+- (CFTimeInterval) durationOfStage:(DocumentOpenStageT)stage
+{
+	CFTimeInterval  duration    = 0;
+
+	if(self->stageEndTimes[stage] > 0)
+		duration = self->stageEndTimes[stage] - self->stageStartTimes[stage];
+
+	return duration;
+
+}//end durationOfStage:
+
+
+//========== timeToFirstFrame ==================================================
+//
+// Purpose:		Returns the time from the start of the open until the model was
+//				first drawn, or 0 if it hasn't been yet.
+//
+//==============================================================================
+- (CFTimeInterval) timeToFirstFrame
+{
+	CFTimeInterval  duration    = 0;
+
+	if(self->isFinished == YES)
+		duration = self->stageEndTimes[DocumentOpenStageFirstFrame] - self->openStartTime;
+
+	return duration;
+
+}//end timeToFirstFrame
+
+
+//========== report ============================================================
+//
+// Purpose:		Returns a one-line summary of the stage times, for the log.
+//
+//==============================================================================
+- (NSString *) report
+{
+	NSMutableString *report     = [NSMutableString string];
+	NSInteger       counter     = 0;
+
+	for(counter = 0; counter < DocumentOpenStageCount; counter++)
+	{
+		[report appendFormat:@"%@ = %.3f s, ", StageNames[counter], [self durationOfStage:counter]];
+	}
+	[report appendFormat:@"time to first frame = %.3f s", [self timeToFirstFrame]];
+
+	return report;
+
+}//end report
+
+
+#pragma mark -
+#pragma mark DESTRUCTOR
+#pragma mark -
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Done timing.
+//
+//==============================================================================
+- (void) dealloc
+{
+	[self closeProgressPanel];
+
+	[super dealloc];
+
+}//end dealloc
+
+
+@end
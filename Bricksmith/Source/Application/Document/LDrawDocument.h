@@ -24,6 +24,7 @@
 #import "RotationPanelController.h"
 #import "ViewportArranger.h"
 
+@class DocumentOpenProgress;
 @class DocumentToolbarController;
 @class ExtendedScrollView;
 @class ExtendedSplitView;
@@ -38,6 +39,8 @@
 @class LDrawStep;
 @class LDrawPart;
 @class PartBrowserDataSource;
+@class PartConnectionIndex;
+@class PartInterferenceReport;
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -85,6 +88,11 @@
 		LDrawGLView		*mostRecentLDrawView; //file graphic view which most recently had focus. Weak link.
 		BOOL			lockViewingAngle;		// hack to fix unexpected view changes during inserts
 		NSArray		*	markedSelection;		// if we are mid-marquee selection, this is an array of the previously selected directives before drag started
+		PartInterferenceReport	*interferenceReport;	// kept so repeated checks only re-examine what changed
+		PartConnectionIndex		*connectionIndex;		// studs of the active model, for snapping dragged parts
+		BOOL					connectionIndexIsCurrent;	// updated since the current part drag began
+		DocumentOpenProgress	*openProgress;			// timing of the open, until the first frame is drawn
+		NSMutableDictionary		*saveSnapshots;			// URL and save operation -> snapshots taken on the main thread, oldest first, awaiting their writes
 }
 
 // Accessors
@@ -131,6 +139,7 @@
 
 // - File menu
 - (IBAction) exportSteps:(id)sender;
+- (IBAction) exportMesh:(id)sender;
 - (IBAction) revealInFinder:(id)sender;
 
 // - Edit menu
@@ -149,6 +158,8 @@
 - (IBAction) gridGranularityMenuChanged:(id)sender;
 - (IBAction) showDimensions:(id)sender;
 - (IBAction) showPieceCount:(id)sender;
+- (IBAction) selectDuplicateParts:(id)sender;
+- (IBAction) selectInterferingParts:(id)sender;
 
 // - View menu
 - (IBAction) zoomActual:(id)sender;
@@ -222,7 +233,11 @@
 - (LDrawStep *) selectedStep;
 - (LDrawDirective *) selectedStepComponent;
 - (LDrawPart *) selectedPart;
+- (NSString *) saveSnapshotKeyForURL:(NSURL *)url forSaveOperation:(NSSaveOperationType)saveOperation;
+- (void) selectPartsFromReport:(NSArray *)parts emptyMessage:(NSString *)message emptyInformative:(NSString *)informative;
 - (void) updateInspector;
+- (void) updateConnectionIndex;
+- (void) updateInterferenceReport;
 - (void) updateViewingAngleToMatchStep;
 - (void) writeDirectives:(NSArray *)directives toPasteboard:(NSPasteboard *)pasteboard;
 - (NSArray *) pasteFromPasteboard:(NSPasteboard *) pasteboard preventNameCollisions:(BOOL)renameModels parent:(LDrawContainer*)parent index:(NSInteger)insertAtIndex;
@@ -18,9 +18,12 @@
 //==============================================================================
 #import "LDrawDocument.h"
 
-#import <AMSProgressBar/AMSProgressBar.h>
+#if USE_BLOCKS
+#import <dispatch/dispatch.h>
+#endif
 
 #import "DimensionsPanel.h"
+#import "DocumentOpenProgress.h"
 #import "DocumentToolbarController.h"
 #import "ExtendedScrollView.h"
 #import "ExtendedSplitView.h"
@@ -39,14 +42,17 @@
 #import "LDrawFile.h"
 #import "LDrawFileOutlineView.h"
 #import "LDrawGLView.h"
+#import "LDrawKeywords.h"
 #import "LDrawLine.h"
 #import "LDrawLSynth.h"
 #import "LDrawLSynthDirective.h"
+#import "LDrawMeshExporter.h"
 #import "LDrawModel.h"
 #import "LDrawMPDModel.h"
 #import "LDrawPart.h"
 #import "LDrawQuadrilateral.h"
 #import "LDrawStep.h"
+#import "LDrawTrace.h"
 #import "LDrawTriangle.h"
 #import "LDrawUtilities.h"
 #import "LSynthConfiguration.h"
@@ -56,6 +62,9 @@
 #import "MovePanel.h"
 #import "PartBrowserDataSource.h"
 #import "PartBrowserPanelController.h"
+#import "PartConnectionIndex.h"
+#import "PartInterferenceReport.h"
+#import "PartLibrary.h"
 #import "PartReport.h"
 #import "PieceCountPanel.h"
 #import "RotationPanelController.h"
@@ -69,6 +78,10 @@
 #import "RelatedParts.h"
 #endif
 
+// Key in the writing thread's dictionary for the snapshot of the save it is 
+// doing. See -writeSafelyToURL:ofType:forSaveOperation:error:.
+#define LDrawDocumentSaveSnapshotKey	@"LDrawDocumentSaveSnapshot"
+
 
 #if WANT_RELATED_PARTS
 // Modes to build a submenu for related parts:
@@ -338,7 +351,6 @@ void AppendChoicesToNewItem(
 			  ofType:(NSString *)typeName
 			   error:(NSError **)outError
 {
-	AMSProgressPanel    *progressPanel  = [AMSProgressPanel progressPanel];
 	NSString            *openMessage    = nil;
 	BOOL                success         = NO;
 	
@@ -346,14 +358,14 @@ void AppendChoicesToNewItem(
 		[self displayName] ];
 	
 	//This might take a while. Show that we're doing something!
-	[progressPanel setMessage:openMessage];
-	[progressPanel setIndeterminate:YES];
-	[progressPanel showProgressPanel];
+	[self->openProgress release];
+	self->openProgress = [[DocumentOpenProgress alloc] initWithMessage:openMessage];
+	[self->openProgress beginStage:DocumentOpenStageRead];
 
 	//do the actual loading.
 	success = [super readFromURL:absoluteURL ofType:typeName error:outError];
 	
-	[progressPanel close];
+	[self->openProgress closeProgressPanel];
 	
 	if(success == YES)
 	{
@@ -368,22 +380,27 @@ void AppendChoicesToNewItem(
 			[[self documentContents] setPath:nil];
 
 		//Postflight: find missing and moved parts.
+		[self->openProgress beginStage:DocumentOpenStageCheck];
 		[self doMissingPiecesCheck:self];
 		[self doMovedPiecesCheck:self];
 		[self doMissingModelnameExtensionCheck:self];
 		
 		// Now that all the parts are at their final name, we can optimize.
+		[self->openProgress beginStage:DocumentOpenStageOptimize];
 		[[LDrawApplication sharedOpenGLContext] makeCurrentContext];
 		
-		CFAbsoluteTime  startTime       = CFAbsoluteTimeGetCurrent();
-		CFTimeInterval  optimizeTime    = 0;
-		
+		TRACE_BEGIN("optimize document");
 		[[self documentContents] optimizeOpenGL];
+		TRACE_END("optimize document");
 		
-		optimizeTime = CFAbsoluteTimeGetCurrent() - startTime;
-#if DEBUG
-		NSLog(@"optimize time = %f", optimizeTime);
-#endif
+		// The meshes are uploaded as the model is first drawn; see 
+		// -LDrawGLViewDidDraw:. 
+		[self->openProgress beginStage:DocumentOpenStageFirstFrame];
+	}
+	else
+	{
+		[self->openProgress release];
+		self->openProgress = nil;
 	}
 	
 	return success;
@@ -456,15 +473,11 @@ void AppendChoicesToNewItem(
 		
 		@try
 		{
-			CFAbsoluteTime  startTime   = CFAbsoluteTimeGetCurrent();
-			CFTimeInterval  parseTime   = 0;
-			
+			// Library parts are loaded and readied as the submodels 
+			// mentioning them are parsed; this returns when all of it is done.
+			TRACE_BEGIN("parse document");
 			newFile     = [LDrawFile parseFromFileContents:fileContents];
-			parseTime   = CFAbsoluteTimeGetCurrent() - startTime;
-			
-#if DEBUG
-			NSLog(@"parse time = %f", parseTime);
-#endif
+			TRACE_END("parse document");
 			
 			if(newFile != nil)
 			{
@@ -521,22 +534,200 @@ void AppendChoicesToNewItem(
 }//end saveToURL:ofType:forSaveOperation:delegate:didSaveSelector:contextInfo:
 
 
+//========== saveToURL:ofType:forSaveOperation:completionHandler: ==============
+//
+// Purpose:		Every save on 10.7 and later comes through here on the main 
+//				thread, before NSDocument hands the writing to a background 
+//				thread. So this is where we snapshot the file: serializing 
+//				edited submodels touches their caches, which belong to the main 
+//				thread. 
+//
+// Notes:		The snapshot waits under this save's URL and operation until 
+//				-writeSafelyToURL:ofType:forSaveOperation:error: claims it. 
+//				NSDocument runs overlapping saves one after another, so a queue 
+//				per key pairs each write with the snapshot of its own save. If 
+//				the save ends without writing (cancelled or failed), its 
+//				snapshot is thrown away so no later write picks it up. 
+//
+//==============================================================================
+#if USE_BLOCKS
+- (void) saveToURL:(NSURL *)url
+			ofType:(NSString *)typeName
+  forSaveOperation:(NSSaveOperationType)saveOperation
+ completionHandler:(void (^)(NSError *errorOrNil))completionHandler
+{
+	NSArray         *snapshot   = [[self documentContents] snapshotForWriting];
+	NSString        *key        = [self saveSnapshotKeyForURL:url forSaveOperation:saveOperation];
+	NSMutableArray  *queue      = nil;
+	
+	@synchronized(self)
+	{
+		if(self->saveSnapshots == nil)
+			self->saveSnapshots = [[NSMutableDictionary alloc] init];
+		
+		queue = [self->saveSnapshots objectForKey:key];
+		if(queue == nil)
+		{
+			queue = [NSMutableArray array];
+			[self->saveSnapshots setObject:queue forKey:key];
+		}
+		[queue addObject:snapshot];
+	}
+	
+	[super saveToURL:url ofType:typeName forSaveOperation:saveOperation completionHandler:
+	^(NSError *errorOrNil)
+	{
+		@synchronized(self)
+		{
+			NSMutableArray *waiting = [self->saveSnapshots objectForKey:key];
+			
+			[waiting removeObjectIdenticalTo:snapshot];
+			if(waiting != nil && [waiting count] == 0)
+				[self->saveSnapshots removeObjectForKey:key];
+		}
+		if(completionHandler)
+			completionHandler(errorOrNil);
+	}];
+	
+}//end saveToURL:ofType:forSaveOperation:completionHandler:
+#endif
+
+
+//========== writeSafelyToURL:ofType:forSaveOperation:error: ===================
+//
+// Purpose:		Runs on whichever thread NSDocument writes from. Claims the 
+//				snapshot taken for this save and makes it available to 
+//				-dataOfType:error:, which runs inside this call on the same 
+//				thread. 
+//
+//==============================================================================
+- (BOOL) writeSafelyToURL:(NSURL *)url
+				   ofType:(NSString *)typeName
+		 forSaveOperation:(NSSaveOperationType)saveOperation
+					error:(NSError **)outError
+{
+	NSMutableDictionary *threadDictionary   = [[NSThread currentThread] threadDictionary];
+	NSString            *key                = [self saveSnapshotKeyForURL:url forSaveOperation:saveOperation];
+	NSMutableArray      *queue              = nil;
+	NSArray             *snapshot           = nil;
+	BOOL                success             = NO;
+	
+	@synchronized(self)
+	{
+		queue = [self->saveSnapshots objectForKey:key];
+		if([queue count] > 0)
+		{
+			snapshot = [[[queue objectAtIndex:0] retain] autorelease];
+			[queue removeObjectAtIndex:0];
+			if([queue count] == 0)
+				[self->saveSnapshots removeObjectForKey:key];
+		}
+	}
+	
+	if(snapshot != nil)
+		[threadDictionary setObject:snapshot forKey:LDrawDocumentSaveSnapshotKey];
+	
+	success = [super writeSafelyToURL:url ofType:typeName forSaveOperation:saveOperation error:outError];
+	
+	[threadDictionary removeObjectForKey:LDrawDocumentSaveSnapshotKey];
+	
+	return success;
+	
+}//end writeSafelyToURL:ofType:forSaveOperation:error:
+
+
+//========== canAsynchronouslyWriteToURL:ofType:forSaveOperation: =============
+//
+// Purpose:		Lets NSDocument save us on a background thread. The snapshot 
+//				that thread writes from is taken on the main thread beforehand; 
+//				see -saveToURL:ofType:forSaveOperation:completionHandler:.
+//
+//==============================================================================
+- (BOOL) canAsynchronouslyWriteToURL:(NSURL *)url
+							  ofType:(NSString *)typeName
+					forSaveOperation:(NSSaveOperationType)saveOperation
+{
+	return YES;
+	
+}//end canAsynchronouslyWriteToURL:ofType:forSaveOperation:
+
+
 //========== dataOfType:error: =================================================
 //
 // Purpose:		Converts this document into a data object that can be written 
 //				to disk. This is where a document gets saved.
 //
+// Notes:		When saving asynchronously, this runs on a background thread 
+//				while NSDocument holds off user interaction. The snapshot was 
+//				already taken on the main thread, so we let editing resume 
+//				straight away; the text is joined, encoded and written after. 
+//
+//				A snapshot can only be taken on the main thread. Without one 
+//				for this save anywhere else, we fail the save rather than read 
+//				a file that is being edited. 
+//
+//				NSDocument writes the data out safely (to a temporary file 
+//				which then replaces the original), so a failed save never 
+//				leaves a half-written file behind. 
+//
 //==============================================================================
 - (NSData *)dataOfType:(NSString *)typeName
 				 error:(NSError **)outError
 {
-    NSString *modelOutput = [[self documentContents] write];
+#if DEBUG
+	CFAbsoluteTime  startTime   = CFAbsoluteTimeGetCurrent();
+#endif
+	NSArray         *snapshot   = [[[NSThread currentThread] threadDictionary] objectForKey:LDrawDocumentSaveSnapshotKey];
+	NSString        *modelOutput = nil;
+	NSData          *data        = nil;
+	
+	// Before 10.7, saves don't come through 
+	// -saveToURL:ofType:forSaveOperation:completionHandler:, but they don't 
+	// write in the background either, so the snapshot can be taken now. 
+	if(snapshot == nil)
+	{
+		if([NSThread isMainThread] == NO)
+		{
+			if(outError != NULL)
+				*outError = [NSError errorWithDomain:NSCocoaErrorDomain
+												code:NSFileWriteUnknownError
+											userInfo:nil];
+			return nil;
+		}
+		snapshot = [[self documentContents] snapshotForWriting];
+	}
+	
+	// Editing may continue now. (Not available before 10.7, but neither is 
+	// asynchronous saving.) 
+	if([self respondsToSelector:@selector(unblockUserInteraction)])
+		[self unblockUserInteraction];
+	
+	TRACE_BEGIN("save");
+	modelOutput = [LDrawFile writeSnapshot:snapshot];
+	data        = [modelOutput dataUsingEncoding:NSUTF8StringEncoding];
+	TRACE_END("save");
+	
+#if DEBUG
+	NSLog(@"write time = %f", CFAbsoluteTimeGetCurrent() - startTime);
+#endif
 	
-	return [modelOutput dataUsingEncoding:NSUTF8StringEncoding];
+	return data;
 	
 }//end dataOfType:error:
 
 
+//========== saveSnapshotKeyForURL:forSaveOperation: ===========================
+//
+// Purpose:		Names the queue a save's snapshot waits in until its write.
+//
+//==============================================================================
+- (NSString *) saveSnapshotKeyForURL:(NSURL *)url forSaveOperation:(NSSaveOperationType)saveOperation
+{
+	return [NSString stringWithFormat:@"%ld %@", (long)saveOperation, [[url URLByStandardizingPath] absoluteString]];
+	
+}//end saveSnapshotKeyForURL:forSaveOperation:
+
+
 #pragma mark -
 #pragma mark ACCESSORS
 #pragma mark -
@@ -1376,10 +1567,21 @@ void AppendChoicesToNewItem(
 //==============================================================================
 - (void) doMovedPiecesCheck:(id)sender
 {
-	PartReport	*partReport     = [PartReport partReportForContainer:[self documentContents]];
-	NSArray     *movedParts     = [partReport movedParts];
-	NSInteger   buttonReturned  = 0;
-	NSInteger   counter         = 0;
+	LDrawFile       *file           = [self documentContents];
+	PartLibrary     *partLibrary    = [PartLibrary sharedPartLibrary];
+	NSMutableArray  *movedParts     = [NSMutableArray array];
+	NSString        *category       = nil;
+	NSInteger       buttonReturned  = 0;
+	NSInteger       counter         = 0;
+	
+	// Ask the library about each distinct name once, then pull the parts 
+	// using moved names straight out of the file's reference index.
+	for(NSString *referenceName in [file referencedNames])
+	{
+		category = [partLibrary categoryForPartName:referenceName];
+		if([category isEqualToString:LDRAW_MOVED_CATEGORY])
+			[movedParts addObjectsFromArray:[file partsReferencingName:referenceName]];
+	}
 	
 	if([movedParts count] > 0)
 	{
@@ -1584,6 +1786,61 @@ void AppendChoicesToNewItem(
 }//end exportSteps:
 
 
+//========== exportMesh: =======================================================
+//
+// Purpose:		Presents a save dialog allowing the user to export the model on 
+//				display as a triangle mesh, for renderers and 3D printers. The 
+//				format follows the extension chosen: glTF, OBJ or STL. 
+//
+//==============================================================================
+- (IBAction) exportMesh:(id)sender
+{
+	NSSavePanel *exportPanel	= [NSSavePanel savePanel];
+	NSString	*activeName		= [[[self documentContents] activeModel] modelName];
+	
+	[exportPanel setDirectoryURL:nil];
+	[exportPanel setNameFieldStringValue:[[activeName stringByDeletingPathExtension] stringByAppendingPathExtension:@"gltf"]];
+	[exportPanel setAllowedFileTypes:[NSArray arrayWithObjects:@"gltf", @"obj", @"stl", nil]];
+	[exportPanel setAllowsOtherFileTypes:NO];
+	[exportPanel setMessage:NSLocalizedString(@"ExportMeshDialogMessage", nil)];
+	
+	[exportPanel beginSheetModalForWindow:[self windowForSheet]
+						completionHandler:
+	 ^(NSInteger returnCode)
+	 {
+		 LDrawMeshExporter	*exporter	= nil;
+		 LDrawMeshFormatT	format		= LDrawMeshFormatGLTF;
+		 NSString			*savePath	= nil;
+		 NSAlert			*alert		= nil;
+		 BOOL				success		= NO;
+		 
+		 if(returnCode == NSOKButton)
+		 {
+			 savePath = [[exportPanel URL] path];
+			 [LDrawMeshExporter getFormat:&format forPathExtension:[savePath pathExtension]];
+			 
+			 exporter	= [[LDrawMeshExporter alloc] initWithPath:savePath format:format];
+			 success	= [exporter writeContainer:[self documentContents]];
+			 [exporter release];
+			 
+			 if(success == NO)
+			 {
+				 alert = [[NSAlert alloc] init];
+				 
+				 [alert setMessageText:NSLocalizedString(@"ExportMeshFailedMessage", nil)];
+				 [alert setInformativeText:NSLocalizedString(@"ExportMeshFailedInformative", nil)];
+				 [alert addButtonWithTitle:NSLocalizedString(@"OKButtonName", nil)];
+				 
+				 [alert runModal];
+				 
+				 [alert release];
+			 }
+		 }
+	 }];
+	
+}//end exportMesh:
+
+
 //========== revealInFinder: ===================================================
 //
 // Purpose:             Open a Finder window with the current file selected.
@@ -2013,6 +2270,49 @@ void AppendChoicesToNewItem(
 }//end showPieceCount:
 
 
+//========== selectDuplicateParts: =============================================
+//
+// Purpose:		Selects every part in the active model which sits in exactly the 
+//				same place as an identical part. 
+//
+// Notes:		The first of each set of duplicates is left unselected, so that 
+//				pressing Delete afterwards leaves one copy behind. 
+//
+//==============================================================================
+- (IBAction) selectDuplicateParts:(id)sender
+{
+	NSArray *duplicates = nil;
+	
+	[self updateInterferenceReport];
+	duplicates = [self->interferenceReport duplicateParts];
+	
+	[self selectPartsFromReport:duplicates
+				 emptyMessage:NSLocalizedString(@"NoDuplicatePartsMessage", nil)
+			 emptyInformative:NSLocalizedString(@"NoDuplicatePartsInformative", nil) ];
+	
+}//end selectDuplicateParts:
+
+
+//========== selectInterferingParts: ===========================================
+//
+// Purpose:		Selects every part in the active model which passes through 
+//				another part. 
+//
+//==============================================================================
+- (IBAction) selectInterferingParts:(id)sender
+{
+	NSArray *interferingParts = nil;
+	
+	[self updateInterferenceReport];
+	interferingParts = [self->interferenceReport interferingParts];
+	
+	[self selectPartsFromReport:interferingParts
+				 emptyMessage:NSLocalizedString(@"NoInterferingPartsMessage", nil)
+			 emptyInformative:NSLocalizedString(@"NoInterferingPartsInformative", nil) ];
+	
+}//end selectInterferingParts:
+
+
 #pragma mark -
 #pragma mark View Menu
 
@@ -3777,6 +4077,31 @@ void AppendChoicesToNewItem(
 }//end LDrawGLViewBecameFirstResponder:
 
 
+//========== LDrawGLViewDidDraw: ===============================================
+//
+// Purpose:		One of our views finished drawing. The first time, that ends the 
+//				open. 
+//
+//==============================================================================
+- (void) LDrawGLViewDidDraw:(LDrawGLView *)glView
+{
+	if(self->openProgress != nil && [glView LDrawDirective] == [self documentContents])
+	{
+		[self->openProgress firstFrameDrawn];
+		
+		if([self->openProgress isFinished] == YES)
+		{
+#if DEBUG
+			NSLog(@"open %@: %@", [self displayName], [self->openProgress report]);
+#endif
+			[self->openProgress release];
+			self->openProgress = nil;
+		}
+	}
+
+}//end LDrawGLViewDidDraw:
+
+
 //========== LDrawGLView:dragHandleDidMove: ====================================
 //
 // Purpose:		A primitive's geometry is being directly manipulated.
@@ -3798,6 +4123,8 @@ void AppendChoicesToNewItem(
 {
 	[self->selectedDirectivesBeforeCopyDrag release];
 	self->selectedDirectivesBeforeCopyDrag = nil;
+	
+	self->connectionIndexIsCurrent = NO;
 }
 
 
@@ -3858,6 +4185,37 @@ void AppendChoicesToNewItem(
 }//end LDrawGLViewPreferredPartTransform:
 
 
+//========== LDrawGLView:snapDisplacement:ofDirectives: ========================
+//
+// Purpose:		Parts are being dragged by displacement. If that brings one of 
+//				their studs or anti-studs close to a mating one in the model, 
+//				adjust it so they land right on top of each other. 
+//
+// Notes:		Nothing in the model moves while a drag is in progress, so the 
+//				connection index is only brought up to date at the start of 
+//				each one. 
+//
+//==============================================================================
+- (Vector3) LDrawGLView:(LDrawGLView *)glView
+	   snapDisplacement:(Vector3)displacement
+		   ofDirectives:(NSArray *)directives
+{
+	if([[NSUserDefaults standardUserDefaults] boolForKey:SNAP_TO_CONNECTIONS_KEY] == YES)
+	{
+		if(self->connectionIndexIsCurrent == NO)
+		{
+			[self updateConnectionIndex];
+			self->connectionIndexIsCurrent = YES;
+		}
+		
+		displacement = [self->connectionIndex snapDisplacement:displacement ofDirectives:directives];
+	}
+	
+	return displacement;
+	
+}//end LDrawGLView:snapDisplacement:ofDirectives:
+
+
 //**** LDrawGLView ****
 
 //============ markPreviousSelection ============================================
@@ -5679,6 +6037,40 @@ void AppendChoicesToNewItem(
 }//end 
 
 
+//========== selectPartsFromReport:emptyMessage:emptyInformative: =============
+//
+// Purpose:		Selects the parts found by an interference check, or explains 
+//				that there weren't any.
+//
+//==============================================================================
+- (void) selectPartsFromReport:(NSArray *)parts
+				  emptyMessage:(NSString *)message
+			  emptyInformative:(NSString *)informative
+{
+	NSAlert *alert  = nil;
+	
+	if([parts count] > 0)
+	{
+		[self selectDirective:nil byExtendingSelection:NO];
+		[self selectDirectives:parts];
+	}
+	else
+	{
+		alert = [[NSAlert alloc] init];
+		
+		[alert setMessageText:message];
+		[alert setInformativeText:informative];
+		
+		[alert beginSheetModalForWindow:[self windowForSheet]
+						  modalDelegate:nil
+						 didEndSelector:NULL
+							contextInfo:NULL ];
+		[alert release];
+	}
+	
+}//end selectPartsFromReport:emptyMessage:emptyInformative:
+
+
 //========== updateInspector ===================================================
 //
 // Purpose:		Updates the Inspector to display the currently-selected objects.
@@ -5696,6 +6088,50 @@ void AppendChoicesToNewItem(
 }//end updateInspector
 
 
+//========== updateConnectionIndex =============================================
+//
+// Purpose:		Brings the index of studs and anti-studs in the active model up 
+//				to date. 
+//
+// Notes:		Like the interference report, the index is kept around and only 
+//				re-files the parts which moved. 
+//
+//==============================================================================
+- (void) updateConnectionIndex
+{
+	LDrawMPDModel   *activeModel    = [[self documentContents] activeModel];
+	
+	if(self->connectionIndex == nil)
+		self->connectionIndex = [[PartConnectionIndex alloc] init];
+	
+	[self->connectionIndex setLDrawContainer:activeModel];
+	[self->connectionIndex update];
+	
+}//end updateConnectionIndex
+
+
+//========== updateInterferenceReport ==========================================
+//
+// Purpose:		Brings the duplicate and interference report for the active 
+//				model up to date. 
+//
+// Notes:		The report is kept between checks; only parts which moved since 
+//				the last one need to be examined again. 
+//
+//==============================================================================
+- (void) updateInterferenceReport
+{
+	LDrawMPDModel   *activeModel    = [[self documentContents] activeModel];
+	
+	if(self->interferenceReport == nil)
+		self->interferenceReport = [[PartInterferenceReport alloc] init];
+	
+	[self->interferenceReport setLDrawContainer:activeModel];
+	[self->interferenceReport update];
+	
+}//end updateInterferenceReport
+
+
 //========== updateViewingAngleToMatchStep =====================================
 //
 // Purpose:		Sets the viewing angle of the main viewport to the angle 
@@ -5911,6 +6347,10 @@ void AppendChoicesToNewItem(
 	[documentContents	release];
 	[lastSelectedPart	release];
 	[selectedDirectives	release];
+	[interferenceReport	release];
+	[connectionIndex	release];
+	[openProgress		release];
+	[saveSnapshots		release];
 
 	[super dealloc];
 	
@@ -0,0 +1,77 @@
+//==============================================================================
+//
+// File:		BatchAnalyzer.h
+//
+// Purpose:		Analyzes a pile of LDraw files without any user interface, for
+//				running Bricksmith from the command line:
+//
+//					Bricksmith --analyze [options] file-or-folder ...
+//
+//				Options:
+//					--ldraw <path>		LDraw folder (default: the one in
+//										Bricksmith's preferences)
+//					--format json|csv	output format (default: json)
+//					--output <path>		write results here (default: stdout)
+//					--jobs <n>			files parsed at once (default: one
+//										per processor)
+//					--thumbnails		also benchmark part thumbnails for
+//										every part the files use
+//
+//				Folders are searched for .ldr, .mpd and .dat files. For each
+//				file we report the piece count, missing and moved parts, steps,
+//				submodels and the size of the model. A summary with the
+//				throughput in files per second goes to stderr.
+//
+//				Files are parsed concurrently; they all share the one part
+//				library, which loads each part only once no matter how many
+//				files want it. Parsing was built to run on many threads.
+//				Analysis was not--resolving parts and measuring the model fill
+//				in caches shared among files--so it runs one file at a time,
+//				in the order the files finish parsing. It is cheap next to
+//				parsing.
+//
+//				The thumbnail benchmark runs afterwards, on the main thread. It
+//				fetches each part's thumbnail twice through the part browser's
+//				disk cache: the first pass draws any that aren't cached yet,
+//				the second reads them all back. Rates for both go to stderr.
+//
+//==============================================================================
+#import <Foundation/Foundation.h>
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// class BatchAnalyzer
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface BatchAnalyzer : NSObject
+{
+	NSArray             *paths;
+	NSUInteger          maximumConcurrentFiles;
+	NSMutableArray      *results;				// one NSDictionary per path, in order
+	NSMutableSet        *partNames;				// every part referenced by any file
+	dispatch_queue_t    analysisQueue;			// serializes everything after parsing
+	CFTimeInterval      elapsedTime;
+}
+
+// Command Line
++ (BOOL) wantsToRunWithArguments:(NSArray *)arguments;
++ (int) runWithArguments:(NSArray *)arguments;
+
+// Initialization
+- (id) initWithPaths:(NSArray *)pathsIn;
+
+// Accessors
+- (CFTimeInterval) elapsedTime;
+- (NSArray *) results;
+- (NSSet *) partNames;
+- (void) setMaximumConcurrentFiles:(NSUInteger)count;
+
+// Analysis
+- (void) analyze;
+
+// Output
+- (NSString *) CSVRepresentation;
+- (NSString *) JSONRepresentation;
+
+@end
@@ -0,0 +1,656 @@
+//==============================================================================
+//
+// File:		BatchAnalyzer.m
+//
+// Purpose:		Analyzes LDraw files from the command line. See BatchAnalyzer.h.
+//
+//==============================================================================
+#import "BatchAnalyzer.h"
+
+#import "ColorLibrary.h"
+#import "LDrawFile.h"
+#import "LDrawMPDModel.h"
+#import "LDrawPaths.h"
+#import "MacLDraw.h"
+#import "MatrixMath.h"
+#import "PartLibrary.h"
+#import "PartReport.h"
+#import "PartThumbnailCache.h"
+
+// Result keys, in output order.
+static NSString	*BatchPathKey			= @"path";
+static NSString	*BatchErrorKey			= @"error";
+static NSString	*BatchPartsKey			= @"parts";
+static NSString	*BatchMissingKey		= @"missing";
+static NSString	*BatchMovedKey			= @"moved";
+static NSString	*BatchStepsKey			= @"steps";
+static NSString	*BatchSubmodelsKey		= @"submodels";
+static NSString	*BatchWidthKey			= @"width";
+static NSString	*BatchHeightKey			= @"height";
+static NSString	*BatchDepthKey			= @"depth";
+static NSString	*BatchParseTimeKey		= @"parseSeconds";
+
+static NSArray	*ResultKeys(void);
+static NSString	*JSONString(NSString *string);
+static NSString	*CSVString(NSString *string);
+static void		WriteToStandardError(NSString *message);
+static void		BenchmarkThumbnails(NSSet *partNames);
+
+
+@interface BatchAnalyzer (Private)
+
+- (NSDictionary *) resultForFile:(LDrawFile *)file atPath:(NSString *)path parseTime:(CFTimeInterval)parseTime;
+
+@end
+
+
+@implementation BatchAnalyzer
+
+#pragma mark -
+#pragma mark COMMAND LINE
+#pragma mark -
+
+//---------- wantsToRunWithArguments: --------------------------------[static]--
+//
+// Purpose:		Returns YES if Bricksmith was started to analyze files rather
+//				than to edit them.
+//
+//------------------------------------------------------------------------------
++ (BOOL) wantsToRunWithArguments:(NSArray *)arguments
+{
+	return [arguments containsObject:@"--analyze"];
+
+}//end wantsToRunWithArguments:
+
+
+//---------- runWithArguments: ---------------------------------------[static]--
+//
+// Purpose:		Does a whole command-line run: finds the part library, analyzes
+//				every file named in arguments and writes out the results.
+//				Returns the exit status.
+//
+//------------------------------------------------------------------------------
++ (int) runWithArguments:(NSArray *)arguments
+{
+	NSAutoreleasePool   *pool           = [[NSAutoreleasePool alloc] init];
+	NSFileManager       *fileManager    = [[[NSFileManager alloc] init] autorelease];
+	NSMutableArray      *filePaths      = [NSMutableArray array];
+	NSString            *ldrawPath      = [[NSUserDefaults standardUserDefaults] stringForKey:LDRAW_PATH_KEY];
+	NSString            *format         = @"json";
+	NSString            *outputPath     = nil;
+	NSUInteger          jobs            = [[NSProcessInfo processInfo] activeProcessorCount];
+	NSString            *argument       = nil;
+	NSString            *filePath       = nil;
+	NSString            *output         = nil;
+	BatchAnalyzer       *analyzer       = nil;
+	BOOL                isDirectory     = NO;
+	BOOL                wantsThumbnails = NO;
+	NSUInteger          counter         = 0;
+	int                 status          = 0;
+
+	//---------- Options -------------------------------------------------------
+
+	// The first argument is the program itself.
+	for(counter = 1; counter < [arguments count]; counter++)
+	{
+		argument = [arguments objectAtIndex:counter];
+
+		if([argument isEqualToString:@"--analyze"])
+			continue;
+		else if(counter + 1 < [arguments count] && [argument isEqualToString:@"--ldraw"])
+			ldrawPath = [arguments objectAtIndex:++counter];
+		else if(counter + 1 < [arguments count] && [argument isEqualToString:@"--format"])
+			format = [arguments objectAtIndex:++counter];
+		else if(counter + 1 < [arguments count] && [argument isEqualToString:@"--output"])
+			outputPath = [arguments objectAtIndex:++counter];
+		else if(counter + 1 < [arguments count] && [argument isEqualToString:@"--jobs"])
+			jobs = MAX(1, [[arguments objectAtIndex:++counter] integerValue]);
+		else if([argument isEqualToString:@"--thumbnails"])
+			wantsThumbnails = YES;
+		else if([argument hasPrefix:@"-"])
+		{
+			// Cocoa hands every program a few -NSSomething arguments of its
+			// own; skip them along with their values.
+			if(counter + 1 < [arguments count] && [[arguments objectAtIndex:counter + 1] hasPrefix:@"-"] == NO)
+				counter++;
+		}
+		else
+		{
+			argument = [argument stringByStandardizingPath];
+
+			if([fileManager fileExistsAtPath:argument isDirectory:&isDirectory] && isDirectory)
+			{
+				for(filePath in [fileManager enumeratorAtPath:argument])
+				{
+					NSString *extension = [[filePath pathExtension] lowercaseString];
+
+					if(		[extension isEqualToString:@"ldr"]
+						||	[extension isEqualToString:@"mpd"]
+						||	[extension isEqualToString:@"dat"] )
+					{
+						[filePaths addObject:[argument stringByAppendingPathComponent:filePath]];
+					}
+				}
+			}
+			else
+				[filePaths addObject:argument];
+		}
+	}
+
+	if([format isEqualToString:@"json"] == NO && [format isEqualToString:@"csv"] == NO)
+	{
+		WriteToStandardError([NSString stringWithFormat:@"Unknown format \"%@\"; use json or csv.\n", format]);
+		status = 1;
+	}
+	else if([filePaths count] == 0)
+	{
+		WriteToStandardError(@"usage: Bricksmith --analyze [--ldraw path] [--format json|csv] [--output path] [--jobs n] [--thumbnails] file-or-folder ...\n");
+		status = 1;
+	}
+
+	//---------- Part Library --------------------------------------------------
+
+	if(status == 0)
+	{
+		[[LDrawPaths sharedPaths] setPreferredLDrawPath:ldrawPath];
+		ldrawPath = [[LDrawPaths sharedPaths] findLDrawPath];
+
+		if(ldrawPath == nil)
+		{
+			WriteToStandardError(@"Can't find an LDraw folder; name one with --ldraw.\n");
+			status = 1;
+		}
+		else
+		{
+			[[LDrawPaths sharedPaths] setPreferredLDrawPath:ldrawPath];
+
+			if([[PartLibrary sharedPartLibrary] load] == NO)
+				[[PartLibrary sharedPartLibrary] reloadParts];
+
+			// Lazily created, and not safely; make it before the threads start.
+			[ColorLibrary sharedColorLibrary];
+		}
+	}
+
+	//---------- Analysis ------------------------------------------------------
+
+	if(status == 0)
+	{
+		analyzer = [[BatchAnalyzer alloc] initWithPaths:filePaths];
+		[analyzer setMaximumConcurrentFiles:jobs];
+		[analyzer analyze];
+
+		if([format isEqualToString:@"csv"])
+			output = [analyzer CSVRepresentation];
+		else
+			output = [analyzer JSONRepresentation];
+
+		if(outputPath != nil)
+		{
+			if([output writeToFile:outputPath atomically:YES encoding:NSUTF8StringEncoding error:NULL] == NO)
+			{
+				WriteToStandardError([NSString stringWithFormat:@"Can't write %@.\n", outputPath]);
+				status = 1;
+			}
+		}
+		else
+			[[NSFileHandle fileHandleWithStandardOutput] writeData:[output dataUsingEncoding:NSUTF8StringEncoding]];
+
+		WriteToStandardError([NSString stringWithFormat:@"Analyzed %lu files in %.2f s (%.1f files/s, %lu at once).\n",
+														(unsigned long)[filePaths count],
+														[analyzer elapsedTime],
+														[filePaths count] / MAX([analyzer elapsedTime], 0.001),
+														(unsigned long)jobs ]);
+
+		if(wantsThumbnails)
+			BenchmarkThumbnails([analyzer partNames]);
+
+		[analyzer release];
+	}
+
+	[pool drain];
+
+	return status;
+
+}//end runWithArguments:
+
+
+#pragma mark -
+#pragma mark INITIALIZATION
+#pragma mark -
+
+//========== initWithPaths: ====================================================
+//
+// Purpose:		Prepares to analyze the files at the given paths.
+//
+//==============================================================================
+- (id) initWithPaths:(NSArray *)pathsIn
+{
+	self = [super init];
+	if(self)
+	{
+		paths                   = [pathsIn copy];
+		maximumConcurrentFiles  = [[NSProcessInfo processInfo] activeProcessorCount];
+		results                 = [[NSMutableArray alloc] init];
+		partNames               = [[NSMutableSet alloc] init];
+		analysisQueue           = dispatch_queue_create("com.AllenSmith.Bricksmith.BatchAnalysis", NULL);
+	}
+	return self;
+
+}//end initWithPaths:
+
+
+#pragma mark -
+#pragma mark ACCESSORS
+#pragma mark -
+
+//========== elapsedTime =======================================================
+//
+// Purpose:		Returns the wall-clock time the last -analyze took.
+//
+//==============================================================================
+- (CFTimeInterval) elapsedTime
+{
+	return self->elapsedTime;
+
+}//end elapsedTime
+
+
+//========== results ===========================================================
+//
+// Purpose:		Returns one dictionary per path, in the order the paths were
+//				given. See the Batch...Key constants for what is in them.
+//
+//==============================================================================
+- (NSArray *) results
+{
+	return self->results;
+
+}//end results
+
+
+//========== partNames =========================================================
+//
+// Purpose:		Returns the names of all the parts referenced by the files
+//				analyzed, including missing parts and submodels.
+//
+//==============================================================================
+- (NSSet *) partNames
+{
+	return self->partNames;
+
+}//end partNames
+
+
+//========== setMaximumConcurrentFiles: ========================================
+//
+// Purpose:		Sets how many files may be parsed or waiting for analysis at
+//				once. This bounds the memory used as well as the threads.
+//
+//==============================================================================
+- (void) setMaximumConcurrentFiles:(NSUInteger)count
+{
+	self->maximumConcurrentFiles = MAX(1, count);
+
+}//end setMaximumConcurrentFiles:
+
+
+#pragma mark -
+#pragma mark ANALYSIS
+#pragma mark -
+
+//========== analyze ===========================================================
+//
+// Purpose:		Parses and analyzes every file, returning when all are done.
+//
+// Notes:		A file holds its slot from when it starts parsing until its
+//				analysis is done, so parsed models can't pile up behind the
+//				analysis queue.
+//
+//==============================================================================
+- (void) analyze
+{
+	dispatch_group_t        group       = dispatch_group_create();
+	dispatch_semaphore_t    slots       = dispatch_semaphore_create(self->maximumConcurrentFiles);
+	dispatch_queue_t        parseQueue  = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	CFAbsoluteTime          startTime   = CFAbsoluteTimeGetCurrent();
+	NSUInteger              counter     = 0;
+
+	[self->results removeAllObjects];
+	[self->partNames removeAllObjects];
+	for(counter = 0; counter < [self->paths count]; counter++)
+	{
+		[self->results addObject:[NSNull null]];
+	}
+
+	for(counter = 0; counter < [self->paths count]; counter++)
+	{
+		NSString    *path   = [self->paths objectAtIndex:counter];
+		NSUInteger  index   = counter;
+
+		dispatch_semaphore_wait(slots, DISPATCH_TIME_FOREVER);
+
+		dispatch_group_async(group, parseQueue,
+		^{
+			NSAutoreleasePool   *pool           = [[NSAutoreleasePool alloc] init];
+			CFAbsoluteTime      parseStartTime  = CFAbsoluteTimeGetCurrent();
+			LDrawFile           *file           = [[LDrawFile fileFromContentsAtPath:path] retain];
+			CFTimeInterval      parseTime       = CFAbsoluteTimeGetCurrent() - parseStartTime;
+
+			dispatch_group_async(group, self->analysisQueue,
+			^{
+				NSAutoreleasePool   *pool   = [[NSAutoreleasePool alloc] init];
+				NSDictionary        *result = [self resultForFile:file atPath:path parseTime:parseTime];
+
+				[self->results replaceObjectAtIndex:index withObject:result];
+				[file release];
+
+				[pool drain];
+				dispatch_semaphore_signal(slots);
+			});
+
+			[pool drain];
+		});
+	}
+
+	dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+	dispatch_release(group);
+	dispatch_release(slots);
+
+	self->elapsedTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+}//end analyze
+
+
+//========== resultForFile:atPath:parseTime: ===================================
+//
+// Purpose:		Measures one parsed file. file is nil if it couldn't be read.
+//
+// Notes:		Runs on the analysis queue only. Resolving the parts here is
+//				what finds the missing ones.
+//
+//==============================================================================
+- (NSDictionary *) resultForFile:(LDrawFile *)file
+						  atPath:(NSString *)path
+					   parseTime:(CFTimeInterval)parseTime
+{
+	NSMutableDictionary *result     = [NSMutableDictionary dictionary];
+	PartReport          *report     = nil;
+	LDrawMPDModel       *model      = nil;
+	Box3                bounds      = InvalidBox;
+
+	[result setObject:path forKey:BatchPathKey];
+	[result setObject:[NSNumber numberWithDouble:parseTime] forKey:BatchParseTimeKey];
+
+	if(file == nil || [[file submodels] count] == 0)
+	{
+		[result setObject:@"could not read file" forKey:BatchErrorKey];
+	}
+	else
+	{
+		model   = [file firstModel];
+		report  = [PartReport partReportForContainer:file];
+		[report getPieceCountReport];
+
+		bounds  = [model boundingBox3];
+		if(V3EqualBoxes(bounds, InvalidBox))
+			bounds.min = bounds.max = ZeroPoint3;
+
+		[result setObject:[NSNumber numberWithUnsignedInteger:[report numberOfParts]]			forKey:BatchPartsKey];
+		[result setObject:[NSNumber numberWithUnsignedInteger:[[report missingParts] count]]	forKey:BatchMissingKey];
+		[result setObject:[NSNumber numberWithUnsignedInteger:[[report movedParts] count]]		forKey:BatchMovedKey];
+		[result setObject:[NSNumber numberWithUnsignedInteger:[[model steps] count]]			forKey:BatchStepsKey];
+		[result setObject:[NSNumber numberWithUnsignedInteger:[[file submodels] count]]		forKey:BatchSubmodelsKey];
+		[result setObject:[NSNumber numberWithFloat:bounds.max.x - bounds.min.x]				forKey:BatchWidthKey];
+		[result setObject:[NSNumber numberWithFloat:bounds.max.y - bounds.min.y]				forKey:BatchHeightKey];
+		[result setObject:[NSNumber numberWithFloat:bounds.max.z - bounds.min.z]				forKey:BatchDepthKey];
+
+		[self->partNames addObjectsFromArray:[[report allParts] valueForKey:@"referenceName"]];
+	}
+
+	return result;
+
+}//end resultForFile:atPath:parseTime:
+
+
+#pragma mark -
+#pragma mark OUTPUT
+#pragma mark -
+
+//========== CSVRepresentation =================================================
+//
+// Purpose:		Returns the results as CSV, one row per file after a header row.
+//				Sizes are in LDraw units.
+//
+//==============================================================================
+- (NSString *) CSVRepresentation
+{
+	NSMutableString *csv    = [NSMutableString string];
+	NSArray         *keys   = ResultKeys();
+	NSDictionary    *result = nil;
+	id              value   = nil;
+	NSUInteger      counter = 0;
+
+	[csv appendString:[keys componentsJoinedByString:@","]];
+	[csv appendString:@"\n"];
+
+	for(result in self->results)
+	{
+		for(counter = 0; counter < [keys count]; counter++)
+		{
+			value = [result objectForKey:[keys objectAtIndex:counter]];
+
+			if(counter > 0)
+				[csv appendString:@","];
+			if([value isKindOfClass:[NSString class]])
+				[csv appendString:CSVString(value)];
+			else if(value != nil)
+				[csv appendString:[value stringValue]];
+		}
+		[csv appendString:@"\n"];
+	}
+
+	return csv;
+
+}//end CSVRepresentation
+
+
+//========== JSONRepresentation ================================================
+//
+// Purpose:		Returns the results as a JSON array of objects, one per file.
+//				Sizes are in LDraw units.
+//
+// Notes:		NSJSONSerialization is too new for us.
+//
+//==============================================================================
+- (NSString *) JSONRepresentation
+{
+	NSMutableString *json       = [NSMutableString string];
+	NSArray         *keys       = ResultKeys();
+	NSDictionary    *result     = nil;
+	NSString        *key        = nil;
+	id              value       = nil;
+	BOOL            firstResult = YES;
+	BOOL            firstValue  = YES;
+
+	[json appendString:@"["];
+
+	for(result in self->results)
+	{
+		[json appendString:(firstResult ? @"\n\t{" : @",\n\t{")];
+		firstResult = NO;
+		firstValue  = YES;
+
+		for(key in keys)
+		{
+			value = [result objectForKey:key];
+			if(value == nil)
+				continue;
+
+			[json appendFormat:@"%@%@: ", (firstValue ? @"" : @", "), JSONString(key)];
+			firstValue = NO;
+
+			if([value isKindOfClass:[NSString class]])
+				[json appendString:JSONString(value)];
+			else
+				[json appendString:[value stringValue]];
+		}
+		[json appendString:@"}"];
+	}
+
+	[json appendString:@"\n]\n"];
+
+	return json;
+
+}//end JSONRepresentation
+
+
+#pragma mark -
+#pragma mark DESTRUCTOR
+#pragma mark -
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Bye.
+//
+//==============================================================================
+- (void) dealloc
+{
+	[paths		release];
+	[results	release];
+	[partNames	release];
+	dispatch_release(analysisQueue);
+
+	[super dealloc];
+
+}//end dealloc
+
+
+@end
+
+
+#pragma mark -
+
+//---------- ResultKeys ----------------------------------------------[static]--
+//
+// Purpose:		Returns the result keys in the order they are written.
+//
+//------------------------------------------------------------------------------
+static NSArray *ResultKeys(void)
+{
+	return [NSArray arrayWithObjects:	BatchPathKey,
+										BatchErrorKey,
+										BatchPartsKey,
+										BatchMissingKey,
+										BatchMovedKey,
+										BatchStepsKey,
+										BatchSubmodelsKey,
+										BatchWidthKey,
+										BatchHeightKey,
+										BatchDepthKey,
+										BatchParseTimeKey,
+										nil ];
+
+}//end ResultKeys
+
+
+//---------- JSONString ----------------------------------------------[static]--
+//
+// Purpose:		Returns string as a quoted JSON string.
+//
+//------------------------------------------------------------------------------
+static NSString *JSONString(NSString *string)
+{
+	NSMutableString *quoted     = [NSMutableString stringWithString:@"\""];
+	unichar         character   = 0;
+	NSUInteger      counter     = 0;
+
+	for(counter = 0; counter < [string length]; counter++)
+	{
+		character = [string characterAtIndex:counter];
+
+		if(character == '"' || character == '\\')
+			[quoted appendFormat:@"\\%C", character];
+		else if(character < 0x20)
+			[quoted appendFormat:@"\\u%04x", character];
+		else
+			[quoted appendFormat:@"%C", character];
+	}
+	[quoted appendString:@"\""];
+
+	return quoted;
+
+}//end JSONString
+
+
+//---------- CSVString -----------------------------------------------[static]--
+//
+// Purpose:		Returns string as a CSV field, quoted if it needs to be.
+//
+//------------------------------------------------------------------------------
+static NSString *CSVString(NSString *string)
+{
+	NSCharacterSet  *special    = [NSCharacterSet characterSetWithCharactersInString:@",\"\r\n"];
+	NSString        *field      = string;
+
+	if([string rangeOfCharacterFromSet:special].location != NSNotFound)
+	{
+		field = [string stringByReplacingOccurrencesOfString:@"\"" withString:@"\"\""];
+		field = [NSString stringWithFormat:@"\"%@\"", field];
+	}
+
+	return field;
+
+}//end CSVString
+
+
+//---------- WriteToStandardError ------------------------------------[static]--
+//
+// Purpose:		Writes a message to stderr, which NSLog would clutter up with a
+//				timestamp and process name.
+//
+//------------------------------------------------------------------------------
+static void WriteToStandardError(NSString *message)
+{
+	[[NSFileHandle fileHandleWithStandardError] writeData:[message dataUsingEncoding:NSUTF8StringEncoding]];
+
+}//end WriteToStandardError
+
+
+//---------- BenchmarkThumbnails -------------------------------------[static]--
+//
+// Purpose:		Fetches the thumbnail of every named part twice through the
+//				shared thumbnail cache and reports how fast they were drawn and
+//				read back.
+//
+// Notes:		Thumbnails left over from an earlier run count as cache hits,
+//				so the first pass only draws what is new.
+//
+//------------------------------------------------------------------------------
+static void BenchmarkThumbnails(NSSet *partNames)
+{
+	PartThumbnailCache  *cache      = [PartThumbnailCache sharedThumbnailCache];
+	NSAutoreleasePool   *pool       = nil;
+	NSString            *partName   = nil;
+	CGImageRef          image       = NULL;
+	NSUInteger          pass        = 0;
+
+	for(pass = 0; pass < 2; pass++)
+	{
+		for(partName in partNames)
+		{
+			pool    = [[NSAutoreleasePool alloc] init];
+			image   = [cache copyThumbnailForPartName:partName];
+			CGImageRelease(image);
+			[pool drain];
+		}
+	}
+
+	WriteToStandardError([NSString stringWithFormat:@"Thumbnails: %lu drawn in %.2f s (%.1f/s); %lu read from cache, %.2f ms each.\n",
+													(unsigned long)[cache generatedCount],
+													[cache generationTime],
+													[cache generatedCount] / MAX([cache generationTime], 0.001),
+													(unsigned long)[cache cacheHitCount],
+													[cache cacheHitTime] * 1000 / MAX([cache cacheHitCount], 1) ]);
+
+}//end BenchmarkThumbnails
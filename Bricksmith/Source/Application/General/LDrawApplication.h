@@ -46,6 +46,9 @@
 - (IBAction) doPartBrowser:(id)sender;
 - (IBAction) showMouseTools:(id)sender;
 - (IBAction) hideMouseTools:(id)sender;
+- (IBAction) toggleTraceRecording:(id)sender;
+- (IBAction) saveTrace:(id)sender;
+- (IBAction) showMemoryReport:(id)sender;
 
 //Accessors
 + (NSOpenGLPixelFormat *) openGLPixelFormat;
@@ -61,6 +64,7 @@
 - (void) findLDrawPath;
 - (void) openHelpAnchor:(NSString *)helpAnchor;
 - (NSString *) userName;
+- (NSString *) memoryReport;
 - (void) populateLSynthModelMenus;
 
 void connexionMessageHandler(io_connect_t connection, natural_t messageType, void *messageArgument);
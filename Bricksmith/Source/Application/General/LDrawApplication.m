@@ -22,7 +22,10 @@
 #import "Inspector.h"
 #import "LDrawColorPanelController.h"
 #import "LDrawDocument.h"
+#import "LDrawFile.h"
+#import "LDrawMemory.h"
 #import "LDrawPaths.h"
+#import "LDrawTrace.h"
 #import "MacLDraw.h"
 #import "PartBrowserPanelController.h"
 #import "PartLibrary.h"
@@ -326,6 +329,64 @@ extern OSErr InstallConnexionHandlers() __attribute__((weak_import));
 }//end hideMouseTools:
 
 
+//========== toggleTraceRecording: =============================================
+//
+// Purpose:		Starts or stops recording a performance trace. Starting over 
+//				throws out the previous recording. 
+//
+//==============================================================================
+- (IBAction) toggleTraceRecording:(id)sender
+{
+	LDrawTraceSetRecording(LDrawTraceIsRecording == NO);
+	
+}//end toggleTraceRecording:
+
+
+//========== saveTrace: ========================================================
+//
+// Purpose:		Writes out the performance trace recorded so far, for viewing in 
+//				chrome://tracing. 
+//
+//==============================================================================
+- (IBAction) saveTrace:(id)sender
+{
+	NSSavePanel *savePanel  = [NSSavePanel savePanel];
+	NSInteger   result      = 0;
+	
+	[savePanel setAllowedFileTypes:[NSArray arrayWithObject:@"json"]];
+	[savePanel setNameFieldStringValue:@"Bricksmith Trace"];
+	
+	result = [savePanel runModal];
+	if(result == NSFileHandlingPanelOKButton)
+	{
+		if(LDrawTraceWriteChromeJSON([[[savePanel URL] path] fileSystemRepresentation]) == 0)
+			NSBeep();
+	}
+	
+}//end saveTrace:
+
+
+//========== showMemoryReport: =================================================
+//
+// Purpose:		Shows where the model and renderer memory is going. 
+//
+//==============================================================================
+- (IBAction) showMemoryReport:(id)sender
+{
+	NSAlert     *alert  = [[NSAlert alloc] init];
+	NSString    *report = [self memoryReport];
+	
+	[alert setMessageText:NSLocalizedString(@"MemoryReportTitle", nil)];
+	[alert setInformativeText:report];
+	[alert addButtonWithTitle:NSLocalizedString(@"OKButtonName", nil)];
+	
+	[alert runModal];
+	
+	[alert release];
+	
+}//end showMemoryReport:
+
+
 #pragma mark -
 #pragma mark Part Menu
 
@@ -427,6 +488,7 @@ extern OSErr InstallConnexionHandlers() __attribute__((weak_import));
 	
 	[sharedGLContext makeCurrentContext];
 	
+	
 	//Try to define an LDraw path before the application even finishes starting.
 	[self findLDrawPath];
 
@@ -572,6 +634,12 @@ extern OSErr InstallConnexionHandlers() __attribute__((weak_import));
 			enable = YES;
 			break;
 			
+		case recordTraceMenuTag:
+			[menuItem setState:(LDrawTraceIsRecording ? NSOnState : NSOffState)];
+			[menuItem setHidden:(WANT_TRACING == 0)];
+			enable = YES;
+			break;
+			
 		default:
 			enable = YES;
 			break;
@@ -653,6 +721,69 @@ extern OSErr InstallConnexionHandlers() __attribute__((weak_import));
 #pragma mark UTILITIES
 #pragma mark -
 
+//========== memoryReport ======================================================
+//
+// Purpose:		Returns a summary of the memory counted in LDrawMemory.h, then 
+//				the display list bytes of each open document and of the library 
+//				parts which hold the most. 
+//
+// Notes:		Undo history is not counted. 
+//
+//==============================================================================
+- (NSString *) memoryReport
+{
+	NSMutableString *report         = [NSMutableString string];
+	NSDictionary    *partSizes      = [[PartLibrary sharedPartLibrary] displayListByteSizesByPart];
+	NSArray         *partNames      = nil;
+	NSString        *partName       = nil;
+	LDrawDocument   *document       = nil;
+	NSUInteger      partBytes       = 0;
+	NSInteger       counter         = 0;
+	
+	[report appendString:@"Totals:\n"];
+	for(counter = 0; counter < LDrawMemoryTagCount; counter++)
+	{
+		[report appendFormat:@"    %s: %.1f KB in %lld blocks\n",
+							 LDrawMemoryGetTagName(counter),
+							 LDrawMemoryGetBytes(counter) / 1024.0,
+							 (long long)LDrawMemoryGetBlocks(counter) ];
+	}
+	
+	[report appendString:@"\nDocument display lists:\n"];
+	for(document in [[NSDocumentController sharedDocumentController] documents])
+	{
+		if([document isKindOfClass:[LDrawDocument class]])
+		{
+			[report appendFormat:@"    %@: %.1f KB\n",
+								 [document displayName],
+								 [[document documentContents] displayListByteSize] / 1024.0 ];
+		}
+	}
+	
+	// Biggest parts first
+	partNames = [partSizes keysSortedByValueUsingSelector:@selector(compare:)];
+	partNames = [[partNames reverseObjectEnumerator] allObjects];
+	for(partName in partNames)
+	{
+		partBytes += [[partSizes objectForKey:partName] unsignedIntegerValue];
+	}
+	
+	[report appendFormat:@"\nLibrary part display lists: %.1f KB in %ld parts\n",
+						 partBytes / 1024.0,
+						 (long)[partNames count] ];
+	for(counter = 0; counter < [partNames count] && counter < 10; counter++)
+	{
+		partName = [partNames objectAtIndex:counter];
+		[report appendFormat:@"    %@: %.1f KB\n",
+							 partName,
+							 [[partSizes objectForKey:partName] unsignedIntegerValue] / 1024.0 ];
+	}
+	
+	return report;
+	
+}//end memoryReport
+
+
 //========== openHelpAnchor: ===================================================
 //
 // Purpose:		Provides much-needed API layering to open the specified help 
@@ -62,6 +62,7 @@
 
 //Notifications
 - (void) sharedPartCatalogDidChange:(NSNotification *)notification;
+- (void) partThumbnailDidLoad:(NSNotification *)notification;
 
 //Utilities
 - (NSMutableArray *) filterPartRecords:(NSArray *)partRecords bySearchString:(NSString *)searchString excludeParts:(NSSet *)excludedParts;
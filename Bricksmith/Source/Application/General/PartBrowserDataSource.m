@@ -31,9 +31,17 @@
 #import "LDrawPart.h"
 #import "MacLDraw.h"
 #import "PartLibrary.h"
+#import "PartThumbnailCache.h"
 #import "StringCategory.h"
 #import "TableViewCategory.h"
 
+// Identifier of the parts table column showing part thumbnails
+static NSString	*PartThumbnailColumnIdentifier	= @"PartThumbnail";
+
+// Height of a parts table row, in points, when thumbnails are shown. Part
+// thumbnails are made at twice this many pixels for high-resolution displays.
+#define PART_THUMBNAIL_ROW_HEIGHT	(PART_THUMBNAIL_PIXEL_SIZE / 2)
+
 
 @implementation PartBrowserDataSource
 
@@ -52,6 +60,8 @@
 	NSMenu          *searchMenuTemplate = nil;
 	NSMenuItem      *recentsItem        = nil;
 	NSMenuItem      *noRecentsItem      = nil;
+	NSTableColumn   *thumbnailColumn    = nil;
+	NSImageCell     *thumbnailCell      = nil;
 	
 	// Loading main nib (the one in which this helper controller was allocated)
 	// By the time this is called, our accessory nib has already been loaded in 
@@ -82,6 +92,22 @@
 		[self->partsTable setDoubleAction:@selector(doubleClickedInPartTable:)];
 		[self->partsTable setFocusRingType:NSFocusRingTypeNone];
 		
+		// - Thumbnails
+		
+		// Pictures come from the thumbnail cache, which draws them in the 
+		// background; the column is left out of the nibs so that every part 
+		// browser gets the same one. 
+		thumbnailColumn = [[NSTableColumn alloc] initWithIdentifier:PartThumbnailColumnIdentifier];
+		thumbnailCell	= [[NSImageCell alloc] init];
+		[thumbnailCell setImageScaling:NSImageScaleProportionallyDown];
+		[thumbnailColumn setDataCell:thumbnailCell];
+		[thumbnailColumn setEditable:NO];
+		[thumbnailColumn setResizingMask:NSTableColumnNoResizing];
+		[thumbnailColumn setWidth:PART_THUMBNAIL_ROW_HEIGHT];
+		[self->partsTable addTableColumn:thumbnailColumn];
+		[self->partsTable moveColumn:[self->partsTable numberOfColumns] - 1 toColumn:0];
+		[self->partsTable setRowHeight:PART_THUMBNAIL_ROW_HEIGHT];
+		
 		// - Part preview
 		
 		[self->partPreview setAcceptsFirstResponder:NO];
@@ -168,11 +194,18 @@
 													 name: LDrawPartLibraryDidChangeNotification
 												   object: nil ];
 		
+		[[NSNotificationCenter defaultCenter] addObserver: self
+												 selector: @selector(partThumbnailDidLoad:)
+													 name: LDrawPartThumbnailDidLoadNotification
+												   object: nil ];
+		
 		
 		//---------- Free Memory -----------------------------------------------
 		[searchMenuTemplate	release];
 		[recentsItem		release];
 		[noRecentsItem		release];
+		[thumbnailColumn	release];
+		[thumbnailCell		release];
 	}
 	// Loading "PartBrowserAccessories.nib"
 	else
@@ -586,13 +619,25 @@
 {
 	NSDictionary	*partRecord			= [self->tableDataSource objectAtIndex:rowIndex];
 	NSString		*columnIdentifier	= [tableColumn identifier];
+	CGImageRef		thumbnail			= NULL;
 	
-	NSString		*cellValue			= [partRecord objectForKey:columnIdentifier];
+	id				cellValue			= [partRecord objectForKey:columnIdentifier];
 	
 	//If it's a part, get rid of the file extension on its name.
 	if([columnIdentifier isEqualToString:PART_NUMBER_KEY])
 		cellValue = [cellValue stringByDeletingPathExtension];
 	
+	// The thumbnail appears when it's ready; see -partThumbnailDidLoad:.
+	else if([columnIdentifier isEqualToString:PartThumbnailColumnIdentifier])
+	{
+		thumbnail = [[PartThumbnailCache sharedThumbnailCache] thumbnailForPartName:[partRecord objectForKey:PART_NUMBER_KEY]];
+		if(thumbnail != NULL)
+		{
+			cellValue = [[[NSImage alloc] initWithCGImage:thumbnail
+													 size:NSMakeSize(PART_THUMBNAIL_ROW_HEIGHT, PART_THUMBNAIL_ROW_HEIGHT)] autorelease];
+		}
+	}
+	
 	return cellValue;
 	
 }//end tableView:objectValueForTableColumn:row:
@@ -794,6 +839,40 @@
 }//end sharedPartCatalogDidChange:
 
 
+//========== partThumbnailDidLoad: =============================================
+//
+// Purpose:		A part thumbnail we asked for is ready. Redraw it if its row is 
+//				still on screen. 
+//
+// Notes:		Without a part name, every thumbnail has changed. 
+//
+//==============================================================================
+- (void) partThumbnailDidLoad:(NSNotification *)notification
+{
+	NSString			*partName		= [[notification userInfo] objectForKey:PART_NUMBER_KEY];
+	NSInteger			columnIndex		= [self->partsTable columnWithIdentifier:PartThumbnailColumnIdentifier];
+	NSRange				visibleRows		= [self->partsTable rowsInRect:[self->partsTable visibleRect]];
+	NSMutableIndexSet	*rowIndexes		= [NSMutableIndexSet indexSet];
+	NSUInteger			row				= 0;
+	
+	if(columnIndex != -1)
+	{
+		for(row = visibleRows.location; row < NSMaxRange(visibleRows) && row < [self->tableDataSource count]; row++)
+		{
+			if(		partName == nil
+				||	[[[self->tableDataSource objectAtIndex:row] objectForKey:PART_NUMBER_KEY] isEqualToString:partName] )
+			{
+				[rowIndexes addIndex:row];
+			}
+		}
+		
+		[self->partsTable reloadDataForRowIndexes:rowIndexes
+									columnIndexes:[NSIndexSet indexSetWithIndex:columnIndex]];
+	}
+	
+}//end partThumbnailDidLoad:
+
+
 #pragma mark -
 #pragma mark UTILITIES
 #pragma mark -
@@ -996,6 +996,7 @@ PreferencesDialogController *preferencesDialog = nil;
 	[initialDefaults setObject:[NSNumber numberWithFloat: 1]	forKey:GRID_SPACING_FINE];
 	[initialDefaults setObject:[NSNumber numberWithFloat:10]	forKey:GRID_SPACING_MEDIUM];
 	[initialDefaults setObject:[NSNumber numberWithFloat:20]	forKey:GRID_SPACING_COARSE];
+	[initialDefaults setObject:(id)kCFBooleanTrue				forKey:SNAP_TO_CONNECTIONS_KEY];
 	
 	//
 	// Initial Window State
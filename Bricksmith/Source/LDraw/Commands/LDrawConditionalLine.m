@@ -24,6 +24,7 @@
 //==============================================================================
 #import "LDrawConditionalLine.h"
 
+#import "LDrawPrimitiveSink.h"
 #import "LDrawUtilities.h"
 
 @implementation LDrawConditionalLine
@@ -361,6 +362,7 @@
 -(void) setConditionalVertex1:(Point3)newVertex
 {
 	conditionalVertex1 = newVertex;
+	[self invalCache:CacheFlagText];
 	
 }//end setconditionalVertex1:
 
@@ -373,6 +375,7 @@
 -(void) setConditionalVertex2:(Point3)newVertex
 {
 	conditionalVertex2 = newVertex;
+	[self invalCache:CacheFlagText];
 	
 }//end setconditionalVertex2:
 
@@ -426,6 +429,21 @@
 }//end flattenIntoLines:triangles:quadrilaterals:other:currentColor:
 
 
+//========== flattenIntoSink:currentColor:currentTransform: ====================
+//
+// Purpose:		Conditional lines are left out of the stream, just as they are 
+//				left out of the array-based flatten.
+//
+//==============================================================================
+- (void) flattenIntoSink:(LDrawPrimitiveSink *)sink
+			currentColor:(LDrawColor *)parentColor
+		currentTransform:(Matrix4)transform
+{
+	// Do nothing. Prevent LDrawLine (the superclass) from streaming us.
+	
+}//end flattenIntoSink:currentColor:currentTransform:
+
+
 //========== registerUndoActions ===============================================
 //
 // Purpose:		Registers the undo actions that are unique to this subclass, 
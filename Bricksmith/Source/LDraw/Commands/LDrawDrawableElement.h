@@ -15,6 +15,8 @@
 #import "MatrixMath.h"
 #import "LDrawMovableDirective.h"
 
+struct LDrawPrimitive;
+
 typedef struct
 {
 	GLfloat position[3];
@@ -54,4 +56,8 @@ typedef struct
 //- (void) moveBy:(Vector3)moveVector;
 - (Point3) position:(Point3)position snappedToGrid:(float)gridSpacing;
 
+// Utilities
+- (LDrawColor *) colorForParentColor:(LDrawColor *)parentColor;
+- (void) getPrimitiveColor:(struct LDrawPrimitive *)primitive forParentColor:(LDrawColor *)parentColor;
+
 @end
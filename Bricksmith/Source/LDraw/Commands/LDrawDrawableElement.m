@@ -14,6 +14,7 @@
 #import "ColorLibrary.h"
 #import "LDrawColor.h"
 #import "LDrawContainer.h"
+#import "LDrawPrimitiveSink.h"
 #import "LDrawUtilities.h"
 
 
@@ -253,50 +254,53 @@
 								projection:(Matrix4)projection
 									  view:(Box2)viewport;
 {
-	Box3    bounds          = [self boundingBox3];
-	Point3  windowPoint     = ZeroPoint3;
-	Box3    projectedBounds = InvalidBox;
+	Box3    bounds              = [self boundingBox3];
+	Matrix4 modelViewProjection = IdentityMatrix4;
+	Point3  windowPoint         = ZeroPoint3;
+	Box3    projectedBounds     = InvalidBox;
 	
 	if(V3EqualBoxes(bounds, InvalidBox) == NO)
 	{		
+		modelViewProjection = Matrix4Multiply(modelView, projection);
+		
 		// front lower left
-		windowPoint     = V3Project(bounds.min,
-									modelView, projection, viewport);
+		windowPoint     = V3ProjectWithMatrix(bounds.min,
+									modelViewProjection, viewport);
 		projectedBounds = V3UnionBoxAndPoint(projectedBounds, windowPoint);
 		
 		// front lower right
-		windowPoint     = V3Project(V3Make(bounds.max.x, bounds.min.y, bounds.min.z),
-									modelView, projection, viewport);
+		windowPoint     = V3ProjectWithMatrix(V3Make(bounds.max.x, bounds.min.y, bounds.min.z),
+									modelViewProjection, viewport);
 		projectedBounds = V3UnionBoxAndPoint(projectedBounds, windowPoint);
 		
 		// front upper right
-		windowPoint     = V3Project(V3Make(bounds.max.x, bounds.max.y, bounds.min.z),
-									modelView, projection, viewport);
+		windowPoint     = V3ProjectWithMatrix(V3Make(bounds.max.x, bounds.max.y, bounds.min.z),
+									modelViewProjection, viewport);
 		projectedBounds = V3UnionBoxAndPoint(projectedBounds, windowPoint);
 		
 		// front upper left
-		windowPoint     = V3Project(V3Make(bounds.min.x, bounds.max.y, bounds.min.z),
-									modelView, projection, viewport);
+		windowPoint     = V3ProjectWithMatrix(V3Make(bounds.min.x, bounds.max.y, bounds.min.z),
+									modelViewProjection, viewport);
 		projectedBounds = V3UnionBoxAndPoint(projectedBounds, windowPoint);
 		
 		// back lower left
-		windowPoint     = V3Project(V3Make(bounds.min.x, bounds.min.y, bounds.max.z),
-									modelView, projection, viewport);
+		windowPoint     = V3ProjectWithMatrix(V3Make(bounds.min.x, bounds.min.y, bounds.max.z),
+									modelViewProjection, viewport);
 		projectedBounds = V3UnionBoxAndPoint(projectedBounds, windowPoint);
 		
 		// back lower right
-		windowPoint     = V3Project(V3Make(bounds.max.x, bounds.min.y, bounds.max.z),
-									modelView, projection, viewport);
+		windowPoint     = V3ProjectWithMatrix(V3Make(bounds.max.x, bounds.min.y, bounds.max.z),
+									modelViewProjection, viewport);
 		projectedBounds = V3UnionBoxAndPoint(projectedBounds, windowPoint);
 		
 		// back upper right
-		windowPoint     = V3Project(V3Make(bounds.max.x, bounds.max.y, bounds.max.z),
-									modelView, projection, viewport);
+		windowPoint     = V3ProjectWithMatrix(V3Make(bounds.max.x, bounds.max.y, bounds.max.z),
+									modelViewProjection, viewport);
 		projectedBounds = V3UnionBoxAndPoint(projectedBounds, windowPoint);
 		
 		// back upper left
-		windowPoint     = V3Project(V3Make(bounds.min.x, bounds.max.y, bounds.max.z),
-									modelView, projection, viewport);
+		windowPoint     = V3ProjectWithMatrix(V3Make(bounds.min.x, bounds.max.y, bounds.max.z),
+									modelViewProjection, viewport);
 		projectedBounds = V3UnionBoxAndPoint(projectedBounds, windowPoint);
 	}
 	
@@ -305,6 +309,18 @@
 }//end projectedBoundingBoxWithModelView:projection:view:
 
 
+//========== hasVisibleContent =================================================
+//
+// Purpose:		Hidden elements can be passed over by traversals entirely.
+//
+//==============================================================================
+- (BOOL) hasVisibleContent
+{
+	return (self->hidden == NO);
+	
+}//end hasVisibleContent
+
+
 //========== isHidden ==========================================================
 //
 // Purpose:		Returns whether this element will be drawn or not.
@@ -357,8 +373,9 @@
 	if(self->hidden != flag)
 	{
 		self->hidden = flag;
-		[[self enclosingDirective] setVertexesNeedRebuilding];
+		[[self enclosingDirective] setVertexesNeedUpdateForDirective:self];
 		[self invalCache:(CacheFlagBounds|DisplayList)];
+		[[self enclosingDirective] directiveDidChangeVisibility:self];
 	}
 	
 }//end setHidden:
@@ -374,7 +391,8 @@
 	[newColor retain];
 	[self->color release];
 	self->color = newColor;
-	[self invalCache:(DisplayList)];	// Needed to force anyone who is cached to recompute the new DL with possibly baked color!	
+	[self invalCache:(DisplayList|CacheFlagText)];	// Needed to force anyone who is cached to recompute the new DL with possibly baked color!	
+	[[self enclosingDirective] setVertexesNeedUpdateForDirective:self];
 	
 }//end setLDrawColor:
 
@@ -511,4 +529,57 @@
 }//end flattenIntoLines:triangles:quadrilaterals:other:currentColor:
 
 
+//========== colorForParentColor: ==============================================
+//
+// Purpose:		Returns the color this element actually appears in when drawn 
+//				inside something of parentColor. This is the same resolution 
+//				-flattenIntoLines:... performs, without changing the receiver.
+//
+//==============================================================================
+- (LDrawColor *) colorForParentColor:(LDrawColor *)parentColor
+{
+	LDrawColor  *resolvedColor  = self->color;
+	
+	if([parentColor colorCode] != LDrawCurrentColor)
+	{
+		if([self->color colorCode] == LDrawCurrentColor)
+			resolvedColor = parentColor;
+		
+		else if([self->color colorCode] == LDrawEdgeColor)
+			resolvedColor = [parentColor complimentColor];
+	}
+	
+	return resolvedColor;
+	
+}//end colorForParentColor:
+
+
+//========== getPrimitiveColor:forParentColor: =================================
+//
+// Purpose:		Fills in the color of a streamed primitive, and notes the 
+//				receiver as the element it came from.
+//
+// Notes:		An edge color which came from anywhere but the element itself 
+//				is a compliment Bricksmith derived; it has no real color code, 
+//				so it goes out as custom RGB. 
+//
+//==============================================================================
+- (void) getPrimitiveColor:(LDrawPrimitive *)primitive forParentColor:(LDrawColor *)parentColor
+{
+	LDrawColor  *resolvedColor  = [self colorForParentColor:parentColor];
+	
+	primitive->color        = resolvedColor;
+	primitive->element      = self;
+	primitive->colorCode    = [resolvedColor colorCode];
+	[resolvedColor getColorRGBA:primitive->rgba];
+	
+	if(		primitive->colorCode == LDrawEdgeColor
+		&&	resolvedColor != self->color )
+	{
+		primitive->colorCode = LDrawColorCustomRGB;
+	}
+	
+}//end getPrimitiveColor:forParentColor:
+
+
 @end
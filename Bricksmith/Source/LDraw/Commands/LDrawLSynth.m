@@ -10,7 +10,9 @@
 
 #import "LDrawLSynth.h"
 #import "LSynthConfiguration.h"
+#import "LDrawMeshExporter.h"
 #import "LDrawPart.h"
+#import "LDrawPrimitiveSink.h"
 #import "LDrawUtilities.h"
 #import "StringCategory.h"
 #import "LDrawKeywords.h"
@@ -159,9 +161,7 @@
                 NSString *direction = [[[currentLine brick_arrayOfCaptureComponentsMatchedByRegex:@"(INSIDE|OUTSIDE|CROSS)"] objectAtIndex:0] objectAtIndex:0];
                 LDrawLSynthDirective *directive = [[LDrawLSynthDirective alloc] init];
                 [directive setStringValue:direction];
-                [[self subdirectives] addObject:directive];
-                [directive setEnclosingDirective:self];
-                [directive addObserver:self];
+                [super insertDirective:directive atIndex:[[self subdirectives] count]];
                 [directive release];
             }
 
@@ -181,16 +181,16 @@
                                                                      maxIndex:NSMaxRange(range) - 1];
 
                 LDrawDirective *newDirective = [[CommandClass alloc] initWithLines:lines inRange:commandRange parentGroup:parentGroup];
-                [newDirective setEnclosingDirective:self];
-                [newDirective addObserver:self];
 
                 // Add our part in the correct place
                 if (parserState == PARSER_PARSING_CONSTRAINTS) {
                     [newDirective setIconName:[self determineIconName:newDirective]];
-                    [[self subdirectives] addObject:newDirective];
+                    [super insertDirective:newDirective atIndex:[[self subdirectives] count]];
                 }
 
                 else if (parserState == PARSER_PARSING_SYNTHESIZED) {
+                    [newDirective setEnclosingDirective:self];
+                    [newDirective addObserver:self];
                     [synthesizedParts addObject:newDirective];
                 }
 
@@ -441,6 +441,41 @@
 
 }//end drawSelf:
 
+//========== collectMeshExport: ================================================
+//
+// Purpose:		Export the synthesized pieces.  The constraints are only there
+//              to be edited.
+//
+//==============================================================================
+- (void) collectMeshExport:(LDrawMeshExporter *)exporter
+{
+    if(self->hidden == NO)
+    {
+        for (LDrawPart *part in synthesizedParts) {
+            [part collectMeshExport:exporter];
+        }
+    }
+}//end collectMeshExport:
+
+
+//========== flattenIntoSink:currentColor:currentTransform: ====================
+//
+// Purpose:		Streams the synthesized pieces. As with export, the constraints 
+//				are left out.
+//
+//==============================================================================
+- (void) flattenIntoSink:(LDrawPrimitiveSink *)sink
+			currentColor:(LDrawColor *)parentColor
+		currentTransform:(Matrix4)transform
+{
+    if(self->hidden == NO)
+    {
+        for (LDrawPart *part in synthesizedParts) {
+            [part flattenIntoSink:sink currentColor:parentColor currentTransform:transform];
+        }
+    }
+}//end flattenIntoSink:currentColor:currentTransform:
+
 //========== hitTest:transform:viewScale:boundsOnly:creditObject:hits: =======
 //
 // Purpose:		Hit-test the geometry.
@@ -451,7 +486,7 @@
        viewScale:(float)scaleFactor
       boundsOnly:(BOOL)boundsOnly
     creditObject:(id)creditObject
-            hits:(NSMutableDictionary *)hits
+            hits:(LDrawHitList *)hits
 {
     if(self->hidden == NO)
     {
@@ -695,6 +730,7 @@
 - (void) setLsynthClass:(int)class
 {
     self->lsynthClass = class;
+    [self invalCache:CacheFlagText];
 }//end setLsynthClass:
 
 //========== lsynthClass: ====================================================
@@ -718,6 +754,7 @@
     [type retain];
     [self->synthType release];
     self->synthType = type;
+    [self invalCache:CacheFlagText];
 
 }//end setLsynthType:
 
@@ -746,10 +783,23 @@
         self->hidden = flag;
         [[self enclosingDirective] setVertexesNeedRebuilding];
         [self invalCache:(CacheFlagBounds|DisplayList)];
+        [[self enclosingDirective] directiveDidChangeVisibility:self];
     }
 
 }//end setHidden:
 
+//========== hasVisibleContent =================================================
+//
+// Purpose:		The synthesized part is drawn as a whole or not at all; the 
+//				visibility of its constraints doesn't enter into it.
+//
+//==============================================================================
+- (BOOL) hasVisibleContent
+{
+    return (self->hidden == NO);
+
+}//end hasVisibleContent
+
 //========== isHidden ==========================================================
 //
 // Purpose:		Returns whether this element will be drawn or not.
@@ -819,6 +869,7 @@
     [newColor retain];
     [self->color release];
     self->color = newColor;
+    [self invalCache:CacheFlagText];
 
     [self colorSelectedSynthesizedParts:[self isSelected]];
 }//end setLDrawColor:
@@ -1048,7 +1099,7 @@
     int i;
     for (i = [[self subdirectives] count] - 1; i >= 0; i--) {
         if ([[[self subdirectives] objectAtIndex:i] isKindOfClass:[LDrawLSynthDirective class]]) {
-            [[self subdirectives] removeObjectAtIndex:i];
+            [self removeDirectiveAtIndex:i];
         }
     }
     //NSLog(@"Cleaned subdirs: %@", [self subdirectives]);
@@ -1125,9 +1176,15 @@
         //NSLog(@"New Constraints: %@", newConstraints);
     }
 
-    // Finally, update the constraints
-    [[self subdirectives] removeAllObjects];
-    [[self subdirectives] addObjectsFromArray:newConstraints];
+    // Finally, update the constraints. Go through the container so that it 
+    // keeps track of what's visible; newConstraints holds on to the parts 
+    // while they are out. 
+    while ([[self subdirectives] count] > 0) {
+        [self removeDirectiveAtIndex:[[self subdirectives] count] - 1];
+    }
+    for (LDrawDirective *constraint in newConstraints) {
+        [super insertDirective:constraint atIndex:[[self subdirectives] count]];
+    }
 }
 
 //========== prepareAutoHullData ===============================================
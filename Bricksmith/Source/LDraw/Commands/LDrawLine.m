@@ -21,6 +21,7 @@
 
 #import "LDrawColor.h"
 #import "LDrawDragHandle.h"
+#import "LDrawPrimitiveSink.h"
 #import "LDrawStep.h"
 #import "LDrawUtilities.h"
 
@@ -272,7 +273,7 @@
 	   viewScale:(float)scaleFactor
 	  boundsOnly:(BOOL)boundsOnly
 	creditObject:(id)creditObject
-			hits:(NSMutableDictionary *)hits
+			hits:(LDrawHitList *)hits
 {
 	if(self->hidden == NO)
 	{
@@ -578,14 +579,14 @@
 -(void) setVertex1:(Point3)newVertex
 {
 	vertex1 = newVertex;
-	[self invalCache:(CacheFlagBounds|DisplayList)];
+	[self invalCache:(CacheFlagBounds|DisplayList|CacheFlagText)];
 	
 	if(dragHandles)
 	{
 		[[self->dragHandles objectAtIndex:0] setPosition:newVertex updateTarget:NO];
 	}
 	
-	[[self enclosingDirective] setVertexesNeedRebuilding];
+	[[self enclosingDirective] setVertexesNeedUpdateForDirective:self];
 	
 }//end setVertex1:
 
@@ -598,14 +599,14 @@
 -(void) setVertex2:(Point3)newVertex
 {
 	vertex2 = newVertex;
-	[self invalCache:(CacheFlagBounds|DisplayList)];
+	[self invalCache:(CacheFlagBounds|DisplayList|CacheFlagText)];
 	
 	if(dragHandles)
 	{
 		[[self->dragHandles objectAtIndex:1] setPosition:newVertex updateTarget:NO];
 	}
 	
-	[[self enclosingDirective] setVertexesNeedRebuilding];
+	[[self enclosingDirective] setVertexesNeedUpdateForDirective:self];
 	
 }//end setVertex2:
 
@@ -684,6 +685,27 @@
 }//end flattenIntoLines:triangles:quadrilaterals:other:currentColor:
 
 
+//========== flattenIntoSink:currentColor:currentTransform: ====================
+//
+// Purpose:		Streams the transformed line into the sink.
+//
+//==============================================================================
+- (void) flattenIntoSink:(LDrawPrimitiveSink *)sink
+			currentColor:(LDrawColor *)parentColor
+		currentTransform:(Matrix4)transform
+{
+	LDrawPrimitive  primitive;
+	
+	primitive.type          = LDrawPrimitiveLine;
+	primitive.vertexes[0]  = V3MulPointByProjMatrix(self->vertex1, transform);
+	primitive.vertexes[1]  = V3MulPointByProjMatrix(self->vertex2, transform);
+	[self getPrimitiveColor:&primitive forParentColor:parentColor];
+	
+	LDrawPrimitiveSinkAccept(sink, &primitive);
+	
+}//end flattenIntoSink:currentColor:currentTransform:
+
+
 //========== registerUndoActions ===============================================
 //
 // Purpose:		Registers the undo actions that are unique to this subclass, 
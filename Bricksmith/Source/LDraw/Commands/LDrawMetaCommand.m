@@ -306,6 +306,19 @@
 #pragma mark ACCESSORS
 #pragma mark -
 
+//========== hasVisibleContent =================================================
+//
+// Purpose:		Meta-commands don't draw anything, so containers can pass over 
+//				them.
+//
+//==============================================================================
+- (BOOL) hasVisibleContent
+{
+	return NO;
+	
+}//end hasVisibleContent
+
+
 //========== setStringValue: ===================================================
 //
 // Purpose:		updates the basic command string.
@@ -317,6 +330,7 @@
 	[commandString release];
 	
 	commandString = newString;
+	[self invalCache:CacheFlagText];
 	
 }//end setStringValue:
 
@@ -19,6 +19,7 @@
 @class LDrawFile;
 @class LDrawModel;
 @class LDrawStep;
+@class LDrawMeshExporter;
 @class PartReport;
 
 typedef enum PartType {
@@ -60,6 +61,7 @@ typedef enum PartType {
 - (Point3) position;
 - (NSString *) referenceName;
 - (LDrawModel *) referencedMPDSubmodel;
+- (LDrawModel *) resolvedLibraryModel;
 - (TransformComponents) transformComponents;
 - (Matrix4) transformationMatrix;
 - (void) setDisplayName:(NSString *)newPartName;
@@ -68,6 +70,7 @@ typedef enum PartType {
 - (void) setTransformationMatrix:(Matrix4 *)newMatrix;
 
 //Actions
+- (void) collectMeshExport:(LDrawMeshExporter *)exporter;
 - (void) collectPartReport:(PartReport *)report;
 - (TransformComponents) componentsSnappedToGrid:(float) gridSpacing minimumAngle:(float)degrees;
 - (TransformComponents) components:(TransformComponents)components snappedToGrid:(float)gridSpacing minimumAngle:(float)degrees;
@@ -25,8 +25,11 @@
 #import <string.h>
 #import "LDrawColor.h"
 #import "LDrawFile.h"
+#import "LDrawMeshExporter.h"
 #import "LDrawModel.h"
+#import "LDrawPrimitiveSink.h"
 #import "LDrawStep.h"
+#import "LDrawTrace.h"
 #import "LDrawUtilities.h"
 #import "LDrawVertexes.h"
 #import "PartLibrary.h"
@@ -386,7 +389,7 @@
 			}
 			
 			if([self isSelected] == YES)
-				[renderer pushWireFrame];
+				[renderer pushSelected];
 			
 			#if SHRINK_SEAMS
 			
@@ -434,7 +437,7 @@
 				[renderer popColor];
 				
 			if([self isSelected] == YES)
-				[renderer popWireFrame];
+				[renderer popSelected];
 				
 		}	
 	}
@@ -504,7 +507,7 @@
 	   viewScale:(float)scaleFactor
 	  boundsOnly:(BOOL)boundsOnly
 	creditObject:(id)creditObject
-			hits:(NSMutableDictionary *)hits
+			hits:(LDrawHitList *)hits
 {
 	if(self->hidden == NO)
 	{
@@ -752,28 +755,9 @@
 		{
 			bounds = [modelToDraw boundingBox3];
 			
-			if(V3EqualBoxes(bounds, InvalidBox) == NO)
-			{
-				// Transform all the points of the bounding box to find the new 
-				// minimum and maximum. 
-				int     counter     = 0;
-				Point3  vertices[8] = {	
-										{bounds.min.x, bounds.min.y, bounds.min.z},
-										{bounds.min.x, bounds.min.y, bounds.max.z},
-										{bounds.min.x, bounds.max.y, bounds.max.z},
-										{bounds.min.x, bounds.max.y, bounds.min.z},
-										
-										{bounds.max.x, bounds.min.y, bounds.min.z},
-										{bounds.max.x, bounds.min.y, bounds.max.z},
-										{bounds.max.x, bounds.max.y, bounds.max.z},
-										{bounds.max.x, bounds.max.y, bounds.min.z},
-									  };
-				for(counter = 0; counter < 8; counter++)
-				{
-					vertices[counter] = V3MulPointByProjMatrix(vertices[counter], transformation);
-					cacheBounds = V3UnionBoxAndPoint(cacheBounds, vertices[counter]);
-				}
-			}
+			// Transform the model's box into our coordinates. This is as 
+			// tight as transforming all eight corners, but cheaper. 
+			cacheBounds = V3TransformBox(bounds, transformation);
 		}
 	}
 	
@@ -880,6 +864,27 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 }//end referencedMPDSubmodel
 
 
+//========== resolvedLibraryModel ==============================================
+//
+// Purpose:		Returns the library part this part draws, or nil if it refers to 
+//				a submodel or peer file, or can't be found at all. 
+//
+// Notes:		Library models are never edited once loaded, so what they draw 
+//				depends only on this part's transform and color. 
+//
+//==============================================================================
+- (LDrawModel *) resolvedLibraryModel
+{
+	[self resolvePart];
+	
+	if(self->cacheType == PartTypeLibrary)
+		return self->cacheModel;
+	else
+		return nil;
+	
+}//end resolvedLibraryModel
+
+
 //========== transformComponents ===============================================
 //
 // Purpose:		Returns the individual components of the transformation matrix 
@@ -982,6 +987,7 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 				inGroup:(dispatch_group_t)parentGroup
 {
 	NSString            *newReferenceName   = [newPartName lowercaseString];
+	NSString            *oldReferenceName   = referenceName;
 	dispatch_group_t    parseGroup          = NULL;
 
 	[newPartName retain];
@@ -990,8 +996,14 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 	displayName = newPartName;
 	
 	[newReferenceName retain];
-	[referenceName release];
 	referenceName = newReferenceName;
+	
+	[self invalCache:CacheFlagText];
+	
+	// Parts being parsed have no file yet; the index picks them up on insert.
+	if(self->enclosingDirective != nil)
+		[[self enclosingFile] part:self didChangeReferenceFrom:oldReferenceName];
+	[oldReferenceName release];
 
 	assert(parentGroup == NULL || cacheType == PartTypeUnresolved);
 	
@@ -1062,7 +1074,7 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 //==============================================================================
 - (void) setTransformationMatrix:(Matrix4 *)newMatrix
 {
-	[self invalCache:CacheFlagBounds];
+	[self invalCache:(CacheFlagBounds|CacheFlagText)];
 	Matrix4GetGLMatrix4(*newMatrix, self->glTransformation);
 	
 }//end setTransformationMatrix
@@ -1420,7 +1432,12 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 	if(msg == MessageNameChanged)
 		[self unresolvePart];
 	if(msg == MessageScopeChanged)
+	{
+		// The model we drew may have been swapped for a different one (e.g. a 
+		// peer file reloaded from disk), so our bounds are no longer known.
 		[self unresolvePart];
+		[self invalCache:CacheFlagBounds];
+	}
 }
 
 
@@ -1526,6 +1543,63 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 }//end flattenIntoLines:triangles:quadrilaterals:other:currentColor:
 
 
+//========== flattenIntoSink:currentColor:currentTransform: ====================
+//
+// Purpose:		Streams the primitives of the referenced model into the sink, 
+//				under this part's transform and color. 
+//
+// Notes:		Unlike the array-based flatten, the referenced model is not 
+//				copied; the transform is simply passed down. 
+//
+//==============================================================================
+- (void) flattenIntoSink:(LDrawPrimitiveSink *)sink
+			currentColor:(LDrawColor *)parentColor
+		currentTransform:(Matrix4)transform
+{
+	LDrawModel  *modelToDraw        = nil;
+	Matrix4     combinedTransform   = IdentityMatrix4;
+	
+	// A sink that doesn't follow references only wants the primitives 
+	// directly in the flattened directive. 
+	if(sink->followsReferences == NO)
+		return;
+	
+	// Same thread-safe lookup as -flattenIntoLines:...
+	modelToDraw = [self referencedMPDSubmodel];
+	
+	if(modelToDraw == nil)
+		modelToDraw = [[PartLibrary sharedPartLibrary] modelForName_threadSafe:referenceName];
+	
+	combinedTransform = Matrix4Multiply([self transformationMatrix], transform);
+	
+	[modelToDraw flattenIntoSink:sink
+					currentColor:[self colorForParentColor:parentColor]
+				currentTransform:combinedTransform];
+	
+}//end flattenIntoSink:currentColor:currentTransform:
+
+
+//========== collectMeshExport: ================================================
+//
+// Purpose:		Exports whatever this part draws, in its position and color. 
+//
+//==============================================================================
+- (void) collectMeshExport:(LDrawMeshExporter *)exporter
+{
+	if(self->hidden == NO)
+	{
+		[self resolvePart];
+		if(cacheModel != nil)
+		{
+			[exporter beginPart:self];
+			[cacheModel collectMeshExport:exporter];
+			[exporter endPart];
+		}
+	}
+	
+}//end collectMeshExport:
+
+
 //========== collectPartReport: ================================================
 //
 // Purpose:		Collects a report on this part. If this is really an MPD 
@@ -1625,20 +1699,6 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 }//end registerUndoActions:
 
 
-//========== addedMPDModel =====================================================
-//
-// Purpose:		This message is sent when a model is added to a MPD file; if we
-//				aren't fonud, we unresolve so that we can get a shot at
-//				re-resolving to the newly added part.
-//
-//==============================================================================
-- (void) addedMPDModel:(NSNotification *)notification
-{
-	if(cacheType == PartTypeNotFound)
-		[self unresolvePart];
-}//end addedMPDModel
-
-
 //========== resolvePart =======================================================
 //
 // Purpose:		Find the object this part references and record the way in which 
@@ -1649,6 +1709,7 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 {
 	if(cacheType == PartTypeUnresolved)
 	{
+		TRACE_BEGIN("resolve part");
 		LDrawModel * mdpModel = [self referencedMPDSubmodel];
 		if(mdpModel != nil)
 		{
@@ -1691,12 +1752,16 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 					cacheDrawable = nil;
 					cacheModel = nil;
 					[self invalCache:CacheFlagBounds];
-					// If we are not found, listen to the "sub-model-added" notification; ideally this would be on our enclosing LDrawFile but for
-					// now listen to all instances.
-					[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(addedMPDModel:) name:LDrawMPDSubModelAdded object:nil];					
+					// If we are not found, our enclosing LDrawFile will 
+					// unresolve us when a submodel by our name is added; it 
+					// finds us through its reference index. Submodels added 
+					// to other files might satisfy us too, so tell it to 
+					// watch for our name.
+					[[self enclosingFile] notePartIsMissing:self];
 				}			
 			}
 		}
+		TRACE_END("resolve part");
 	}
 }
 
@@ -1722,11 +1787,6 @@ To work, this needs to multiply the modelViewGLMatrix by the part transform.
 			[cacheModel removeObserver:self];
 		}
 		
-		if(cacheType == PartTypeNotFound)
-		{
-			[[NSNotificationCenter defaultCenter] removeObserver:self name:LDrawMPDSubModelAdded object:nil];	
-		}
-		
 		cacheType = PartTypeUnresolved;
 		cacheDrawable = nil;
 		cacheModel = nil;
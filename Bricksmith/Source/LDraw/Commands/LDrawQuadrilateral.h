@@ -42,6 +42,7 @@
 -(void) setVertex4:(Point3)newVertex;
 
 //Utilities
++ (NSUInteger) fixGeometryOfParsedDirectives:(id *)directives count:(NSUInteger)count;
 - (void) fixBowtie;
 - (void) recomputeNormal;
 
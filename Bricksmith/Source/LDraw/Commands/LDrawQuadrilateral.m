@@ -23,6 +23,8 @@
 
 #import "LDrawColor.h"
 #import "LDrawDragHandle.h"
+#import "LDrawPrimitiveBatch.h"
+#import "LDrawPrimitiveSink.h"
 #import "LDrawStep.h"
 #import "LDrawUtilities.h"
 #import "GLMatrixMath.h"
@@ -42,6 +44,10 @@
 //
 //				4 colour x1 y1 z1 x2 y2 z2 x3 y3 z3 x4 y4 z4 
 //
+// Notes:		The vertexes are stored just as read. The normal and any bow-tie 
+//				are fixed later for the whole step at once, by 
+//				+fixGeometryOfParsedDirectives:count:. 
+//
 //==============================================================================
 - (id) initWithLines:(NSArray *)lines
 			 inRange:(NSRange)range
@@ -82,7 +88,7 @@
 			parsedField = [LDrawUtilities readNextField:workingLine  remainder: &workingLine ];
 			workingVertex.z = [parsedField floatValue];
 			
-			[self setVertex1:workingVertex];
+			self->vertex1 = workingVertex;
 				
 			//Read Vertex 2.
 			// (x2)
@@ -95,7 +101,7 @@
 			parsedField = [LDrawUtilities readNextField:workingLine  remainder: &workingLine ];
 			workingVertex.z = [parsedField floatValue];
 			
-			[self setVertex2:workingVertex];
+			self->vertex2 = workingVertex;
 			
 			//Read Vertex 3.
 			// (x3)
@@ -108,7 +114,7 @@
 			parsedField = [LDrawUtilities readNextField:workingLine  remainder: &workingLine ];
 			workingVertex.z = [parsedField floatValue];
 			
-			[self setVertex3:workingVertex];
+			self->vertex3 = workingVertex;
 			
 			//Read Vertex 4.
 			// (x4)
@@ -121,9 +127,7 @@
 			parsedField = [LDrawUtilities readNextField:workingLine  remainder: &workingLine ];
 			workingVertex.z = [parsedField floatValue];
 			
-			[self setVertex4:workingVertex];
-			
-			[self fixBowtie];
+			self->vertex4 = workingVertex;
 		}
 		else
 			@throw [NSException exceptionWithName:@"BricksmithParseException" reason:@"Bad quad syntax" userInfo:nil];
@@ -312,7 +316,7 @@
 	   viewScale:(float)scaleFactor
 	  boundsOnly:(BOOL)boundsOnly
 	creditObject:(id)creditObject
-			hits:(NSMutableDictionary *)hits
+			hits:(LDrawHitList *)hits
 {
 	if(self->hidden == NO)
 	{
@@ -788,14 +792,14 @@
 {
 	self->vertex1 = newVertex;
 	[self recomputeNormal];
-	[self invalCache:(CacheFlagBounds|DisplayList)];
+	[self invalCache:(CacheFlagBounds|DisplayList|CacheFlagText)];
 	
 	if(dragHandles)
 	{
 		[[self->dragHandles objectAtIndex:0] setPosition:newVertex updateTarget:NO];
 	}
 	
-	[[self enclosingDirective] setVertexesNeedRebuilding];
+	[[self enclosingDirective] setVertexesNeedUpdateForDirective:self];
 	
 }//end setVertex1:
 
@@ -809,14 +813,14 @@
 {
 	self->vertex2 = newVertex;
 	[self recomputeNormal];
-	[self invalCache:(CacheFlagBounds|DisplayList)];
+	[self invalCache:(CacheFlagBounds|DisplayList|CacheFlagText)];
 	
 	if(dragHandles)
 	{
 		[[self->dragHandles objectAtIndex:1] setPosition:newVertex updateTarget:NO];
 	}
 	
-	[[self enclosingDirective] setVertexesNeedRebuilding];
+	[[self enclosingDirective] setVertexesNeedUpdateForDirective:self];
 	
 }//end setVertex2:
 
@@ -830,14 +834,14 @@
 {
 	self->vertex3 = newVertex;
 	[self recomputeNormal];
-	[self invalCache:(CacheFlagBounds|DisplayList)];
+	[self invalCache:(CacheFlagBounds|DisplayList|CacheFlagText)];
 	
 	if(dragHandles)
 	{
 		[[self->dragHandles objectAtIndex:2] setPosition:newVertex updateTarget:NO];
 	}
 	
-	[[self enclosingDirective] setVertexesNeedRebuilding];
+	[[self enclosingDirective] setVertexesNeedUpdateForDirective:self];
 	
 }//end setVertex3:
 
@@ -851,14 +855,14 @@
 {
 	self->vertex4 = newVertex;
 	[self recomputeNormal];
-	[self invalCache:(CacheFlagBounds|DisplayList)];
+	[self invalCache:(CacheFlagBounds|DisplayList|CacheFlagText)];
 	
 	if(dragHandles)
 	{
 		[[self->dragHandles objectAtIndex:3] setPosition:newVertex updateTarget:NO];
 	}
 	
-	[[self enclosingDirective] setVertexesNeedRebuilding];
+	[[self enclosingDirective] setVertexesNeedUpdateForDirective:self];
 	
 }//end setVertex4:
 
@@ -912,6 +916,90 @@
 #pragma mark UTILITIES
 #pragma mark -
 
+//========== fixGeometryOfParsedDirectives:count: ==============================
+//
+// Purpose:		Finishes parsing every quadrilateral among directives: computes 
+//				its normal and untangles a bow-tie, for all of them in one batch. 
+//				Other directives in the array are left alone. Returns the number 
+//				of degenerate quadrilaterals found.
+//
+// Notes:		-initWithLines:inRange:parentGroup: leaves this undone, because 
+//				a step can do all of its quadrilaterals much faster at once; 
+//				see LDrawPrimitiveBatch.h. 
+//
+//==============================================================================
++ (NSUInteger) fixGeometryOfParsedDirectives:(id *)directives count:(NSUInteger)count
+{
+	LDrawPrimitiveBatch *batch              = NULL;
+	LDrawQuadrilateral  *quadrilateral      = nil;
+	Point3              vertexes[4];
+	NSUInteger          primitiveCount      = 0;
+	NSUInteger          degenerateCount     = 0;
+	NSUInteger          counter             = 0;
+	size_t              batchIndex          = 0;
+	
+	for(counter = 0; counter < count; counter++)
+	{
+		if([directives[counter] isKindOfClass:self])
+			primitiveCount += 1;
+	}
+	if(primitiveCount == 0)
+		return 0;
+	
+	// Gather
+	batch = LDrawPrimitiveBatchCreate(4, primitiveCount);
+	for(counter = 0; counter < count; counter++)
+	{
+		if([directives[counter] isKindOfClass:self])
+		{
+			quadrilateral = directives[counter];
+			vertexes[0] = quadrilateral->vertex1;
+			vertexes[1] = quadrilateral->vertex2;
+			vertexes[2] = quadrilateral->vertex3;
+			vertexes[3] = quadrilateral->vertex4;
+			LDrawPrimitiveBatchAdd(batch, vertexes);
+		}
+	}
+	
+	degenerateCount = LDrawPrimitiveBatchFixQuadrilaterals(batch);
+	
+	// Scatter
+	for(counter = 0; counter < count; counter++)
+	{
+		if([directives[counter] isKindOfClass:self])
+		{
+			quadrilateral = directives[counter];
+			LDrawPrimitiveBatchGetVertexes(batch, batchIndex, vertexes);
+#if DEBUG
+			// The batch must agree with the one-at-a-time path.
+			LDrawQuadrilateral *check = [[LDrawQuadrilateral alloc] init];
+			[check setVertex1:quadrilateral->vertex1];
+			[check setVertex2:quadrilateral->vertex2];
+			[check setVertex3:quadrilateral->vertex3];
+			[check setVertex4:quadrilateral->vertex4];
+			[check fixBowtie];
+			assert(   V3EqualPoints(check->vertex1, vertexes[0])
+				   && V3EqualPoints(check->vertex2, vertexes[1])
+				   && V3EqualPoints(check->vertex3, vertexes[2])
+				   && V3EqualPoints(check->vertex4, vertexes[3])
+				   && V3PointsWithinTolerance(check->normal, LDrawPrimitiveBatchGetNormal(batch, batchIndex)) );
+			[check release];
+#endif
+			quadrilateral->vertex1 = vertexes[0];
+			quadrilateral->vertex2 = vertexes[1];
+			quadrilateral->vertex3 = vertexes[2];
+			quadrilateral->vertex4 = vertexes[3];
+			quadrilateral->normal = LDrawPrimitiveBatchGetNormal(batch, batchIndex);
+			batchIndex += 1;
+		}
+	}
+	LDrawPrimitiveBatchFree(batch);
+	
+	return degenerateCount;
+	
+}//end fixGeometryOfParsedDirectives:count:
+
+
 //========== fixBowtie =========================================================
 //
 // Purpose:		Four points in any order define a quadrilateral, but if you want 
@@ -1013,6 +1101,29 @@
 }//end flattenIntoLines:triangles:quadrilaterals:other:currentColor:
 
 
+//========== flattenIntoSink:currentColor:currentTransform: ====================
+//
+// Purpose:		Streams the transformed quadrilateral into the sink.
+//
+//==============================================================================
+- (void) flattenIntoSink:(LDrawPrimitiveSink *)sink
+			currentColor:(LDrawColor *)parentColor
+		currentTransform:(Matrix4)transform
+{
+	LDrawPrimitive  primitive;
+	
+	primitive.type          = LDrawPrimitiveQuadrilateral;
+	primitive.vertexes[0]  = V3MulPointByProjMatrix(self->vertex1, transform);
+	primitive.vertexes[1]  = V3MulPointByProjMatrix(self->vertex2, transform);
+	primitive.vertexes[2]  = V3MulPointByProjMatrix(self->vertex3, transform);
+	primitive.vertexes[3]  = V3MulPointByProjMatrix(self->vertex4, transform);
+	[self getPrimitiveColor:&primitive forParentColor:parentColor];
+	
+	LDrawPrimitiveSinkAccept(sink, &primitive);
+	
+}//end flattenIntoSink:currentColor:currentTransform:
+
+
 //========== recomputeNormal ===================================================
 //
 // Purpose:		Finds the normal vector for this surface.
@@ -11,6 +11,7 @@
 
 #import "LDrawDragHandle.h"
 #import "LDrawKeywords.h"
+#import "LDrawPrimitiveSink.h"
 #import "LDrawUtilities.h"
 #import "LDrawVertexes.h"
 #import "PartLibrary.h"
@@ -34,6 +35,9 @@
 	NSRange			fallbackRange		= NSMakeRange(NSNotFound, 0);
 	NSUInteger      lineIndex           = 0;
 	NSMutableArray	*strippedLines		= [NSMutableArray array];
+	id              *directives         = NULL;
+	NSUInteger      directiveCount      = 0;
+	NSUInteger      counter             = 0;
 
 	self = [super initWithLines:lines inRange:range parentGroup:parentGroup];
 	if(self)
@@ -97,7 +101,8 @@
 		}
 		
 		// Interpret geometry
-		lineIndex = 0;
+		directives  = calloc([strippedLines count], sizeof(LDrawDirective*));
+		lineIndex   = 0;
 		while(lineIndex < [strippedLines count])
 		{
 			currentLine = [strippedLines objectAtIndex:lineIndex];
@@ -106,12 +111,21 @@
 			commandRange = [CommandClass rangeOfDirectiveBeginningAtIndex:lineIndex
 																  inLines:strippedLines
 																 maxIndex:[strippedLines count] - 1];
-			LDrawDirective *newDirective = [[CommandClass alloc] initWithLines:strippedLines inRange:commandRange parentGroup:parentGroup];
-			[self addDirective:newDirective];
+			directives[directiveCount] = [[CommandClass alloc] initWithLines:strippedLines inRange:commandRange parentGroup:parentGroup];
 			
-			lineIndex     = NSMaxRange(commandRange);
+			directiveCount  += 1;
+			lineIndex       = NSMaxRange(commandRange);
 		}
 		
+		[LDrawUtilities fixGeometryOfParsedDirectives:directives count:directiveCount];
+		
+		for(counter = 0; counter < directiveCount; counter++)
+		{
+			[self addDirective:directives[counter]];
+			[directives[counter] release];
+		}
+		free(directives);
+		
 		//---------- Fallback geometry -----------------------------------------
 		
 		if(fallbackRange.location != NSNotFound)
@@ -483,7 +497,7 @@
 	   viewScale:(float)scaleFactor
 	  boundsOnly:(BOOL)boundsOnly
 	creditObject:(id)creditObject
-			hits:(NSMutableDictionary *)hits
+			hits:(LDrawHitList *)hits
 {
 	NSArray     *commands			= [self subdirectives];
 	NSUInteger  commandCount        = [commands count];
@@ -740,6 +754,7 @@
 	[newName retain];
 	[self->glossmapName release];
 	self->glossmapName = newName;
+	[self invalCache:CacheFlagText];
 }
 
 
@@ -780,6 +795,8 @@
 	[self->imageReferenceName release];
 	self->imageReferenceName = newReferenceName;
 	
+	[self invalCache:CacheFlagText];
+	
 	// Force the part library to parse the model this part will display. This 
 	// pushes all parsing into the same operation, which improves loading time 
 	// predictability and allows better potential threading optimization. 
@@ -814,6 +831,7 @@
 -(void) setPlanePoint1:(Point3)newPlanePoint
 {
 	self->planePoint1 = newPlanePoint;
+	[self invalCache:CacheFlagText];
 	
 	if(dragHandles)
 	{
@@ -833,6 +851,7 @@
 -(void) setPlanePoint2:(Point3)newPlanePoint
 {
 	self->planePoint2 = newPlanePoint;
+	[self invalCache:CacheFlagText];
 	
 	if(dragHandles)
 	{
@@ -852,6 +871,7 @@
 -(void) setPlanePoint3:(Point3)newPlanePoint
 {
 	self->planePoint3 = newPlanePoint;
+	[self invalCache:CacheFlagText];
 	
 	if(dragHandles)
 	{
@@ -909,6 +929,18 @@
 }
 
 
+//========== setVertexesNeedUpdateForDirective: ================================
+//
+// Purpose:		Marks just the vertexes of the given primitive as needing to be 
+//				rewritten. 
+//
+//==============================================================================
+- (void) setVertexesNeedUpdateForDirective:(LDrawDirective *)directive
+{
+	[self->vertexes updateDirective:directive];
+}
+
+
 #pragma mark -
 
 //========== insertDirective:atIndex: ==========================================
@@ -1127,8 +1159,8 @@
 	if([vertexes isOptimizedForColor:parentColor])
 	{
 		// The vertexs have already been optimized for any referencing colors. 
-		// Just rebuild the existing color optimizations. 
-		[self->vertexes rebuildAllOptimizations];
+		// Just bring the existing color optimizations up to date. 
+		[self->vertexes updateAllOptimizations];
 	}
 	else
 	{
@@ -1303,6 +1335,30 @@
 }//end flattenIntoLines:triangles:quadrilaterals:other:currentColor:
 
 
+//========== flattenIntoSink:currentColor:currentTransform: ====================
+//
+// Purpose:		Hands the texture to a sink which can keep it, or else streams 
+//				its geometry as plain primitives. 
+//
+// Notes:		Like the nonrecursive array flatten, a sink which doesn't follow 
+//				references gets nothing; textures draw their own geometry. 
+//
+//==============================================================================
+- (void) flattenIntoSink:(LDrawPrimitiveSink *)sink
+			currentColor:(LDrawColor *)parentColor
+		currentTransform:(Matrix4)transform
+{
+	if(sink->followsReferences == NO)
+		return;
+	
+	if(sink->acceptOther != NULL)
+		sink->acceptOther(self, parentColor, transform, sink->context);
+	else
+		[super flattenIntoSink:sink currentColor:parentColor currentTransform:transform];
+	
+}//end flattenIntoSink:currentColor:currentTransform:
+
+
 #pragma mark -
 #pragma mark DESTRUCTOR
 #pragma mark -
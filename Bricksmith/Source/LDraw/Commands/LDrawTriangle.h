@@ -36,6 +36,7 @@
 -(void) setVertex3:(Point3)newVertex;
 
 //Utilities
++ (NSUInteger) fixGeometryOfParsedDirectives:(id *)directives count:(NSUInteger)count;
 - (void) recomputeNormal;
 
 @end
@@ -25,6 +25,8 @@
 
 #import "LDrawColor.h"
 #import "LDrawDragHandle.h"
+#import "LDrawPrimitiveBatch.h"
+#import "LDrawPrimitiveSink.h"
 #import "LDrawStep.h"
 #import "LDrawUtilities.h"
 #include "GLMatrixMath.h"
@@ -45,6 +47,10 @@
 //
 //				3 colour x1 y1 z1 x2 y2 z2 x3 y3 z3 
 //
+// Notes:		The vertexes are stored just as read. The normal is computed 
+//				later for the whole step at once, by 
+//				+fixGeometryOfParsedDirectives:count:. 
+//
 //==============================================================================
 - (id) initWithLines:(NSArray *)lines
 			 inRange:(NSRange)range
@@ -85,7 +91,7 @@
 			parsedField = [LDrawUtilities readNextField:workingLine  remainder: &workingLine ];
 			workingVertex.z = [parsedField floatValue];
 			
-			[self setVertex1:workingVertex];
+			self->vertex1 = workingVertex;
 				
 			//Read Vertex 2.
 			// (x2)
@@ -98,7 +104,7 @@
 			parsedField = [LDrawUtilities readNextField:workingLine  remainder: &workingLine ];
 			workingVertex.z = [parsedField floatValue];
 			
-			[self setVertex2:workingVertex];
+			self->vertex2 = workingVertex;
 			
 			//Read Vertex 3.
 			// (x3)
@@ -111,7 +117,7 @@
 			parsedField = [LDrawUtilities readNextField:workingLine  remainder: &workingLine ];
 			workingVertex.z = [parsedField floatValue];
 			
-			[self setVertex3:workingVertex];
+			self->vertex3 = workingVertex;
 		}
 		else
 			@throw [NSException exceptionWithName:@"BricksmithParseException" reason:@"Bad triangle syntax" userInfo:nil];
@@ -299,7 +305,7 @@
 	   viewScale:(float)scaleFactor
 	  boundsOnly:(BOOL)boundsOnly
 	creditObject:(id)creditObject
-			hits:(NSMutableDictionary *)hits
+			hits:(LDrawHitList *)hits
 {
 	if(self->hidden == NO)
 	{
@@ -688,14 +694,14 @@
 {
 	self->vertex1 = newVertex;
 	[self recomputeNormal];
-	[self invalCache:(CacheFlagBounds|DisplayList)];
+	[self invalCache:(CacheFlagBounds|DisplayList|CacheFlagText)];
 
 	if(dragHandles)
 	{
 		[[self->dragHandles objectAtIndex:0] setPosition:newVertex updateTarget:NO];
 	}
 	
-	[[self enclosingDirective] setVertexesNeedRebuilding];
+	[[self enclosingDirective] setVertexesNeedUpdateForDirective:self];
 	
 }//end setVertex1:
 
@@ -709,14 +715,14 @@
 {
 	self->vertex2 = newVertex;
 	[self recomputeNormal];
-	[self invalCache:(CacheFlagBounds|DisplayList)];
+	[self invalCache:(CacheFlagBounds|DisplayList|CacheFlagText)];
 	
 	if(dragHandles)
 	{
 		[[self->dragHandles objectAtIndex:1] setPosition:newVertex updateTarget:NO];
 	}
 	
-	[[self enclosingDirective] setVertexesNeedRebuilding];
+	[[self enclosingDirective] setVertexesNeedUpdateForDirective:self];
 	
 }//end setVertex2:
 
@@ -730,14 +736,14 @@
 {
 	self->vertex3 = newVertex;
 	[self recomputeNormal];
-	[self invalCache:(CacheFlagBounds|DisplayList)];
+	[self invalCache:(CacheFlagBounds|DisplayList|CacheFlagText)];
 	
 	if(dragHandles)
 	{
 		[[self->dragHandles objectAtIndex:2] setPosition:newVertex updateTarget:NO];
 	}
 	
-	[[self enclosingDirective] setVertexesNeedRebuilding];
+	[[self enclosingDirective] setVertexesNeedUpdateForDirective:self];
 	
 }//end setVertex3:
 
@@ -788,6 +794,85 @@
 #pragma mark UTILITIES
 #pragma mark -
 
+//========== fixGeometryOfParsedDirectives:count: ==============================
+//
+// Purpose:		Finishes parsing every triangle among directives: computes its 
+//				normal, for all of them in one batch. 
+//				Other directives in the array are left alone. Returns the number 
+//				of degenerate triangles found.
+//
+// Notes:		-initWithLines:inRange:parentGroup: leaves this undone, because 
+//				a step can do all of its triangles much faster at once; 
+//				see LDrawPrimitiveBatch.h. 
+//
+//==============================================================================
++ (NSUInteger) fixGeometryOfParsedDirectives:(id *)directives count:(NSUInteger)count
+{
+	LDrawPrimitiveBatch *batch              = NULL;
+	LDrawTriangle       *triangle           = nil;
+	Point3              vertexes[3];
+	NSUInteger          primitiveCount      = 0;
+	NSUInteger          degenerateCount     = 0;
+	NSUInteger          counter             = 0;
+	size_t              batchIndex          = 0;
+	
+	for(counter = 0; counter < count; counter++)
+	{
+		if([directives[counter] isKindOfClass:self])
+			primitiveCount += 1;
+	}
+	if(primitiveCount == 0)
+		return 0;
+	
+	// Gather
+	batch = LDrawPrimitiveBatchCreate(3, primitiveCount);
+	for(counter = 0; counter < count; counter++)
+	{
+		if([directives[counter] isKindOfClass:self])
+		{
+			triangle = directives[counter];
+			vertexes[0] = triangle->vertex1;
+			vertexes[1] = triangle->vertex2;
+			vertexes[2] = triangle->vertex3;
+			LDrawPrimitiveBatchAdd(batch, vertexes);
+		}
+	}
+	
+	degenerateCount = LDrawPrimitiveBatchFixTriangles(batch);
+	
+	// Scatter
+	for(counter = 0; counter < count; counter++)
+	{
+		if([directives[counter] isKindOfClass:self])
+		{
+			triangle = directives[counter];
+			LDrawPrimitiveBatchGetVertexes(batch, batchIndex, vertexes);
+#if DEBUG
+			// The batch must agree with the one-at-a-time path.
+			LDrawTriangle *check = [[LDrawTriangle alloc] init];
+			[check setVertex1:triangle->vertex1];
+			[check setVertex2:triangle->vertex2];
+			[check setVertex3:triangle->vertex3];
+			assert(   V3EqualPoints(check->vertex1, vertexes[0])
+				   && V3EqualPoints(check->vertex2, vertexes[1])
+				   && V3EqualPoints(check->vertex3, vertexes[2])
+				   && V3PointsWithinTolerance(check->normal, LDrawPrimitiveBatchGetNormal(batch, batchIndex)) );
+			[check release];
+#endif
+			triangle->vertex1 = vertexes[0];
+			triangle->vertex2 = vertexes[1];
+			triangle->vertex3 = vertexes[2];
+			triangle->normal = LDrawPrimitiveBatchGetNormal(batch, batchIndex);
+			batchIndex += 1;
+		}
+	}
+	LDrawPrimitiveBatchFree(batch);
+	
+	return degenerateCount;
+	
+}//end fixGeometryOfParsedDirectives:count:
+
+
 //========== flattenIntoLines:triangles:quadrilaterals:other:currentColor: =====
 //
 // Purpose:		Appends the directive into the appropriate container. 
@@ -822,6 +907,28 @@
 }//end flattenIntoLines:triangles:quadrilaterals:other:currentColor:
 
 
+//========== flattenIntoSink:currentColor:currentTransform: ====================
+//
+// Purpose:		Streams the transformed triangle into the sink.
+//
+//==============================================================================
+- (void) flattenIntoSink:(LDrawPrimitiveSink *)sink
+			currentColor:(LDrawColor *)parentColor
+		currentTransform:(Matrix4)transform
+{
+	LDrawPrimitive  primitive;
+	
+	primitive.type          = LDrawPrimitiveTriangle;
+	primitive.vertexes[0]  = V3MulPointByProjMatrix(self->vertex1, transform);
+	primitive.vertexes[1]  = V3MulPointByProjMatrix(self->vertex2, transform);
+	primitive.vertexes[2]  = V3MulPointByProjMatrix(self->vertex3, transform);
+	[self getPrimitiveColor:&primitive forParentColor:parentColor];
+	
+	LDrawPrimitiveSinkAccept(sink, &primitive);
+	
+}//end flattenIntoSink:currentColor:currentTransform:
+
+
 //========== recomputeNormal ===================================================
 //
 // Purpose:		Finds the normal vector for this surface.
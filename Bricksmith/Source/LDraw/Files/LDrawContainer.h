@@ -13,8 +13,19 @@
 #import "LDrawDirective.h"
 #import "MatrixMath.h"
 
+@class LDrawMeshExporter;
 @class PartReport;
 
+// Children visited and passed over by traversals which skip invisible 
+// children, for tracing. Not locked; these are only statistics. 
+#if WANT_TRACING
+	extern NSUInteger	LDrawTraversalVisitedCount;
+	extern NSUInteger	LDrawTraversalSkippedCount;
+	#define COUNT_TRAVERSAL(visited, total)	do { LDrawTraversalVisitedCount += (visited); LDrawTraversalSkippedCount += (total) - (visited); } while(0)
+#else
+	#define COUNT_TRAVERSAL(visited, total)	do { } while(0)
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Class:		LDrawContainer
@@ -27,6 +38,7 @@
 	
 	@private
 	NSMutableArray		*containedObjects;
+	NSMutableIndexSet	*visibleIndexes;		// children with -hasVisibleContent
 }
 
 //Accessors
@@ -35,16 +47,21 @@
 								projection:(Matrix4)projection
 									  view:(Box2)viewport;
 - (NSInteger) indexOfDirective:(LDrawDirective *)directive;
-- (NSMutableArray *) subdirectives;
+- (NSArray *) subdirectives;
+- (NSIndexSet *) visibleSubdirectiveIndexes;
 
 - (void) setPostsNotifications:(BOOL)flag;
 - (void) setVertexesNeedRebuilding;
+- (void) setVertexesNeedUpdateForDirective:(LDrawDirective *)directive;
 - (void) setSubdirectiveSelected:(BOOL)flag;
 
 //Actions
 - (void) addDirective:(LDrawDirective *)directive;
+- (void) directiveDidChangeVisibility:(LDrawDirective *)directive;
+- (void) collectMeshExport:(LDrawMeshExporter *)exporter;
 - (void) collectPartReport:(PartReport *)report;
 - (void) insertDirective:(LDrawDirective *)directive atIndex:(NSInteger)index;
+- (void) moveDirectiveAtIndex:(NSInteger)fromIndex toIndex:(NSInteger)toIndex;
 - (void) removeDirective:(LDrawDirective *)doomedDirective;
 - (void) removeDirectiveAtIndex:(NSInteger)index;
 
@@ -12,9 +12,17 @@
 //==============================================================================
 #import "LDrawContainer.h"
 
+#import "LDrawFile.h"
+#import "LDrawMeshExporter.h"
+#import "LDrawPrimitiveSink.h"
 #import "LDrawUtilities.h"
 #import "PartReport.h"
 
+#if WANT_TRACING
+NSUInteger	LDrawTraversalVisitedCount	= 0;
+NSUInteger	LDrawTraversalSkippedCount	= 0;
+#endif
+
 @implementation LDrawContainer
 
 #pragma mark -
@@ -32,6 +40,7 @@
 	self = [super init];
 	
 	containedObjects    = [[NSMutableArray alloc] init];
+	visibleIndexes      = [[NSMutableIndexSet alloc] init];
 	postsNotifications  = NO;
 	
 	return self;
@@ -48,13 +57,22 @@
 //==============================================================================
 - (id)initWithCoder:(NSCoder *)decoder
 {
+	NSUInteger	counter	= 0;
+	
 	self = [super initWithCoder:decoder];
 	
 	containedObjects = [[decoder decodeObjectForKey:@"containedObjects"] retain];
+	visibleIndexes   = [[NSMutableIndexSet alloc] init];
 	
 	for(id<LDrawObservable> i in containedObjects)
 		[i addObserver:self];
 	
+	for(counter = 0; counter < [containedObjects count]; counter++)
+	{
+		if([[containedObjects objectAtIndex:counter] hasVisibleContent])
+			[visibleIndexes addIndex:counter];
+	}
+	
 	return self;
 	
 }//end initWithCoder:
@@ -94,7 +112,7 @@
 	for(currentObject in self->containedObjects)
 	{
 		copiedObject = [currentObject copy];
-		[copiedContainer insertDirective:copiedObject atIndex:counter];
+		[copiedContainer insertDirective:copiedObject atIndex:counter++];
 		[copiedObject release];
 	}
 	
@@ -202,14 +220,45 @@
 //
 // Purpose:		Returns the LDraw directives stored in this collection.
 //
+// Notes:		This is a read-only view. Change the collection only through 
+//				-insertDirective:atIndex: and -removeDirectiveAtIndex:, which 
+//				keep the visible-children summary, observers and reference 
+//				index in step with it. 
+//
 //==============================================================================
-- (NSMutableArray *) subdirectives
+- (NSArray *) subdirectives
 {
 	return containedObjects;
 	
 }//end subdirectives
 
 
+//========== visibleSubdirectiveIndexes ========================================
+//
+// Purpose:		Returns the indexes of the subdirectives which have anything to 
+//				draw. Traversals can visit just these; a container with none at 
+//				all can be passed over wholesale. 
+//
+//==============================================================================
+- (NSIndexSet *) visibleSubdirectiveIndexes
+{
+	return visibleIndexes;
+	
+}//end visibleSubdirectiveIndexes
+
+
+//========== hasVisibleContent =================================================
+//
+// Purpose:		A container draws something if any of its children do.
+//
+//==============================================================================
+- (BOOL) hasVisibleContent
+{
+	return ([visibleIndexes count] > 0);
+	
+}//end hasVisibleContent
+
+
 #pragma mark -
 
 //========== setPostsNotifications: ============================================
@@ -252,6 +301,19 @@
 }
 
 
+//========== setVertexesNeedUpdateForDirective: ================================
+//
+// Purpose:		Notes that the drawable contents of one child primitive have 
+//				changed, so only its vertexes need rewriting. 
+//
+//==============================================================================
+- (void) setVertexesNeedUpdateForDirective:(LDrawDirective *)directive
+{
+	// pass up to whoever owns the vertexes.
+	[[self enclosingDirective] setVertexesNeedUpdateForDirective:directive];
+}
+
+
 #pragma mark -
 #pragma mark ACTIONS
 #pragma mark -
@@ -269,6 +331,60 @@
 }//end addDirective:
 
 
+//========== directiveDidChangeVisibility: =====================================
+//
+// Purpose:		One of our children has started or stopped drawing anything. 
+//				Brings our summary of visible children up to date, and passes 
+//				the news up if it changes whether we draw anything ourselves. 
+//
+// Notes:		Traversals don't visit invisible children, so a change to one 
+//				may never have reached us. Everything we cache about it is 
+//				assumed to be out of date.
+//
+//==============================================================================
+- (void) directiveDidChangeVisibility:(LDrawDirective *)directive
+{
+	NSUInteger  index       = [containedObjects indexOfObjectIdenticalTo:directive];
+	BOOL        wasVisible  = [self hasVisibleContent];
+	
+	if(index != NSNotFound)
+	{
+		if([directive hasVisibleContent])
+			[visibleIndexes addIndex:index];
+		else
+			[visibleIndexes removeIndex:index];
+		
+		[self invalCache:(CacheFlagBounds|DisplayList)];
+		
+		if([self hasVisibleContent] != wasVisible)
+			[[self enclosingDirective] directiveDidChangeVisibility:self];
+	}
+	
+}//end directiveDidChangeVisibility:
+
+
+//========== collectMeshExport: ================================================
+//
+// Purpose:		Reports everything drawn in this container, no matter how deeply 
+//				it may be contained, to a mesh exporter. 
+//
+//==============================================================================
+- (void) collectMeshExport:(LDrawMeshExporter *)exporter
+{
+	id          currentDirective    = nil;
+	NSInteger   counter             = 0;
+	
+	for(counter = 0; counter < [containedObjects count]; counter++)
+	{
+		currentDirective = [containedObjects objectAtIndex:counter];
+		
+		if([currentDirective respondsToSelector:@selector(collectMeshExport:)])
+			[currentDirective collectMeshExport:exporter];
+	}
+	
+}//end collectMeshExport:
+
+
 //========== collectPartReport: ================================================
 //
 // Purpose:		Collects a report on all the parts in this container, no matter 
@@ -318,10 +434,16 @@
 //==============================================================================
 - (void) insertDirective:(LDrawDirective *)directive atIndex:(NSInteger)index
 {
+	BOOL    wasVisible  = [self hasVisibleContent];
+	
 	// Insert
 	[containedObjects insertObject:directive atIndex:index];
 	[directive setEnclosingDirective:self];
 	
+	[visibleIndexes shiftIndexesStartingAtIndex:index by:1];
+	if([directive hasVisibleContent])
+		[visibleIndexes addIndex:index];
+	
 	// Apply notification policy to new children
 	if([directive respondsToSelector:@selector(setPostsNotifications:)] == YES)
 	{
@@ -331,6 +453,11 @@
 		}
 	}
 	
+	// Keep the file's reference index in step with the tree. Containers 
+	// which aren't in a file yet get indexed whole when they are added.
+	[[self enclosingFile] addReferencesInDirective:directive];
+	[self invalCache:CacheFlagText];
+	
 	// We have to do this FIRST - otherwise, our cache gets rebuilt by the notification handlers before the view hierarchy is fully wired
 	// up and things go pretty sideways from there.
 	[directive addObserver:self];
@@ -339,11 +466,55 @@
 	{
 		[self noteNeedsDisplay];
 	}
-
+	
+	if([self hasVisibleContent] != wasVisible)
+		[[self enclosingDirective] directiveDidChangeVisibility:self];
 	
 }//end insertDirective:atIndex:
 
 
+//========== moveDirectiveAtIndex:toIndex: =====================================
+//
+// Purpose:		Moves a child to a new position in this collection. toIndex is 
+//				where it ends up once the move is done.
+//
+// Notes:		The directive never leaves the container, so none of the 
+//				removal bookkeeping (observers, reference index, parentage) 
+//				happens. Only the order changes.
+//
+//==============================================================================
+- (void) moveDirectiveAtIndex:(NSInteger)fromIndex toIndex:(NSInteger)toIndex
+{
+	LDrawDirective  *directive  = nil;
+	BOOL            wasVisible  = NO;
+	
+	if(fromIndex == toIndex)
+		return;
+	
+	directive	= [[self->containedObjects objectAtIndex:fromIndex] retain];
+	wasVisible	= [visibleIndexes containsIndex:fromIndex];
+	
+	[containedObjects removeObjectAtIndex:fromIndex];
+	[visibleIndexes removeIndex:fromIndex];
+	[visibleIndexes shiftIndexesStartingAtIndex:(fromIndex + 1) by:-1];
+	
+	[containedObjects insertObject:directive atIndex:toIndex];
+	[visibleIndexes shiftIndexesStartingAtIndex:toIndex by:1];
+	if(wasVisible)
+		[visibleIndexes addIndex:toIndex];
+	
+	[directive release];
+	
+	[self invalCache:CacheFlagText];
+	
+	if(self->postsNotifications == YES)
+	{
+		[self noteNeedsDisplay];
+	}
+	
+}//end moveDirectiveAtIndex:toIndex:
+
+
 //========== removeDirectiveAtIndex: ===========================================
 //
 // Purpose:		Removes the LDraw directive stored at index in this collection.
@@ -351,7 +522,11 @@
 //==============================================================================
 - (void) removeDirectiveAtIndex:(NSInteger)index
 {
-	LDrawDirective *doomedDirective = [self->containedObjects objectAtIndex:index];
+	LDrawDirective  *doomedDirective    = [self->containedObjects objectAtIndex:index];
+	BOOL            wasVisible          = [self hasVisibleContent];
+	
+	[[self enclosingFile] removeReferencesInDirective:doomedDirective];
+	[self invalCache:CacheFlagText];
 	
 	if([doomedDirective enclosingDirective] == self)
 		[doomedDirective setEnclosingDirective:nil]; //no parent anymore; it's an orphan now.
@@ -362,10 +537,16 @@
 	
 	[containedObjects removeObjectAtIndex:index]; //or disowned at least.
 	
+	[visibleIndexes removeIndex:index];
+	[visibleIndexes shiftIndexesStartingAtIndex:(index + 1) by:-1];
+	
 	if(self->postsNotifications == YES)
 	{
 		[self noteNeedsDisplay];
 	}
+	
+	if([self hasVisibleContent] != wasVisible)
+		[[self enclosingDirective] directiveDidChangeVisibility:self];
 						  
 }//end removeDirectiveAtIndex:
 
@@ -453,6 +634,25 @@
 }//end flattenIntoLines:triangles:quadrilaterals:other:currentColor:
 
 
+//========== flattenIntoSink:currentColor:currentTransform: ====================
+//
+// Purpose:		Streams the primitives of each subdirective into the sink.
+//
+//==============================================================================
+- (void) flattenIntoSink:(LDrawPrimitiveSink *)sink
+			currentColor:(LDrawColor *)parentColor
+		currentTransform:(Matrix4)transform
+{
+	for(LDrawDirective *currentDirective in self->containedObjects)
+	{
+		[currentDirective flattenIntoSink:sink
+							 currentColor:parentColor
+						 currentTransform:transform];
+	}
+	
+}//end flattenIntoSink:currentColor:currentTransform:
+
+
 //========== optimizeOpenGL ====================================================
 //
 // Purpose:		Makes this part run faster by compiling its contents into a 
@@ -503,6 +703,7 @@
 
 	//release instance variables
 	[containedObjects release];
+	[visibleIndexes release];
 	
 	[super dealloc];
 	
@@ -548,6 +749,21 @@
 }
 
 
+//========== revalCacheRecursively: ============================================
+//
+// Purpose:		Revalidates the flags on ourselves and all our subdirectives, 
+//				re-arming inval notifications throughout the subtree.
+//
+//==============================================================================
+- (void) revalCacheRecursively:(CacheFlagsT) flags
+{
+	[self revalCache:flags];
+	
+	for(LDrawDirective *currentDirective in self->containedObjects)
+		[currentDirective revalCacheRecursively:flags];
+}
+
+
 //========== receiveMessage ====================================================
 //
 // Purpose:		The things we observe call this when something one-time and 
@@ -14,6 +14,7 @@
 
 // forward declarations
 @class LDrawMPDModel;
+@class LDrawPart;
 
 
 //Active model changed.
@@ -31,6 +32,9 @@
 	NSDictionary	*nameModelDict;
 	LDrawMPDModel	*activeModel;
 	NSString		*filePath;			//where this file came from on disk.
+	NSMutableDictionary	*referenceIndex;	//lowercase reference name -> NSMutableSet of LDrawParts in this file
+	NSMutableDictionary	*missingParts;		//lowercase reference name -> NSMutableSet of those parts which came up missing
+	BOOL			watchesOtherFiles;	//observing LDrawMPDSubModelAdded for missing parts
 //	NSUInteger		drawCount;			//number of threads currently drawing us
 //	NSConditionLock *editLock;
 }
@@ -49,18 +53,33 @@
 - (LDrawMPDModel *) firstModel;							// For using another file, we always refer to the FIRST model even if the doc is open and another model is actively edited!
 - (void) addSubmodel:(LDrawMPDModel *)newSubmodel;
 - (NSArray *) draggingDirectives;
+- (NSUInteger) displayListByteSize;
 - (NSArray *) modelNames;
 - (LDrawMPDModel *) modelWithName:(NSString *)soughtName;
+- (NSArray *) partsReferencingName:(NSString *)referenceName;
 - (NSString *)path;
+- (NSArray *) referencedNames;
 - (NSArray *) submodels;
 
 - (void) setActiveModel:(LDrawMPDModel *)newModel;
 - (void) setDraggingDirectives:(NSArray *)directives;
 - (void) setPath:(NSString *)newPath;
 
+// Reference index
+- (void) addReferencesInDirective:(LDrawDirective *)directive;
+- (void) removeReferencesInDirective:(LDrawDirective *)directive;
+- (void) part:(LDrawPart *)part didChangeReferenceFrom:(NSString *)oldReferenceName;
+- (void) notePartIsMissing:(LDrawPart *)part;
+- (void) forgetMissingPart:(LDrawPart *)part name:(NSString *)referenceName;
+
+// Writing
++ (NSString *) writeSnapshot:(NSArray *)snapshot;
+- (NSArray *) snapshotForWriting;
+
 // Utilities
 - (void) optimizeStructure;
 - (void) optimizeVertexes;
+- (void) updateChangedVertexes;
 - (void) renameModel:(LDrawMPDModel *)submodel toName:(NSString *)newName;
 
 @end
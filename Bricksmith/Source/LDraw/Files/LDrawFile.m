@@ -25,10 +25,11 @@
 #endif
 
 #import "MacLDraw.h"
+#import "LDrawMeshExporter.h"
 #import "LDrawMPDModel.h"
 #import "LDrawPart.h"
+#import "LDrawTrace.h"
 #import "LDrawUtilities.h"
-#import "PartReport.h"
 #import "StringCategory.h"
 #import "LDrawLSynthDirective.h"
 
@@ -183,7 +184,9 @@
 			dispatch_group_async(dispatchGroup, queue,
 			^{
 #endif			
+				TRACE_BEGIN("parse submodel");
 				LDrawMPDModel *newModel    = [[LDrawMPDModel alloc] initWithLines:lines inRange:modelRange parentGroup:dispatchGroup];
+				TRACE_END("parse submodel");
 				
 				// Store non-retaining, but *thread-safe* container 
 				// (NSMutableArray is NOT). Since it doesn't retain, we mustn't 
@@ -251,6 +254,7 @@
 	[self setActiveModel:firstModel];
 	
 	[self updateModelLookupTable];
+	[self rebuildReferenceIndex];
 	
 	return self;
 	
@@ -349,6 +353,19 @@
 }//end collectSelf:
 
 
+//========== collectMeshExport: ================================================
+//
+// Purpose:		Exports the model on display; the rest only matter as far as it 
+//				uses them. 
+//
+//==============================================================================
+- (void) collectMeshExport:(LDrawMeshExporter *)exporter
+{
+	[activeModel collectMeshExport:exporter];
+	
+}//end collectMeshExport:
+
+
 //========== debugDrawboundingBox ==============================================
 //
 // Purpose:		Draw a translucent visualization of our bounding box to test
@@ -371,7 +388,7 @@
 	   viewScale:(float)scaleFactor
 	  boundsOnly:(BOOL)boundsOnly
 	creditObject:(id)creditObject
-			hits:(NSMutableDictionary *)hits
+			hits:(LDrawHitList *)hits
 {
 	[activeModel hitTest:pickRay transform:transform viewScale:scaleFactor boundsOnly:boundsOnly creditObject:creditObject hits:hits];
 }
@@ -448,6 +465,78 @@
 }//end write
 
 
+#pragma mark -
+
+//---------- writeSnapshot: -----------------------------------------[static]--
+//
+// Purpose:		Writes out a snapshot made by -snapshotForWriting. The result is 
+//				exactly what -write would have returned for the file at the 
+//				moment the snapshot was taken. 
+//
+// Notes:		Safe to call on any thread; the snapshot is nothing but strings. 
+//
+//------------------------------------------------------------------------------
++ (NSString *) writeSnapshot:(NSArray *)snapshot
+{
+	NSMutableString *written        = [NSMutableString string];
+	NSString        *CRLF           = [NSString CRLF];
+	NSArray         *entry          = nil;
+	NSUInteger      numberModels    = [snapshot count];
+	NSUInteger      counter         = 0;
+	
+	for(counter = 0; counter < numberModels; counter++)
+	{
+		entry = [snapshot objectAtIndex:counter];
+		
+		//A single model is written without the MPD FILE/NOFILE wrapper.
+		if(numberModels == 1)
+			[written appendString:[entry objectAtIndex:1]];
+		else
+		{
+			[written appendString:[LDrawMPDModel writeModelNamed:[entry objectAtIndex:0] body:[entry objectAtIndex:1]]];
+			[written appendString:CRLF];
+		}
+	}
+	
+	//Trim off any final newline characters.
+	return [written stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+	
+}//end writeSnapshot:
+
+
+//========== snapshotForWriting ================================================
+//
+// Purpose:		Captures the file's contents so they can be written out on a 
+//				background thread while editing carries on. 
+//
+//				The snapshot has one entry per submodel: its name and its text. 
+//				Submodels cache their text, so only those edited since the last 
+//				save are serialized here; the rest are free. 
+//
+// Notes:		Main thread only: serializing reads the directives and fills 
+//				their caches, which belong to the main thread. Nothing is 
+//				copied, so every directive writes itself exactly as -write 
+//				would. 
+//
+//==============================================================================
+- (NSArray *) snapshotForWriting
+{
+	NSArray         *submodels      = [self submodels];
+	NSMutableArray  *snapshot       = [NSMutableArray arrayWithCapacity:[submodels count]];
+	
+	for(LDrawMPDModel *model in submodels)
+	{
+		[snapshot addObject:[NSArray arrayWithObjects:
+										[model modelName],
+										[model writeModel],
+										nil ]];
+	}
+	
+	return snapshot;
+	
+}//end snapshotForWriting
+
+
 #pragma mark -
 
 //========== lockForEditing ====================================================
@@ -550,6 +639,27 @@
 }//end draggingDirectives
 
 
+//========== displayListByteSize ===============================================
+//
+// Purpose:		Returns the bytes held by the cached meshes of all the 
+//				submodels. See -[LDrawModel displayListByteSize]. 
+//
+//==============================================================================
+- (NSUInteger) displayListByteSize
+{
+	NSUInteger		byteSize	= 0;
+	LDrawMPDModel	*submodel	= nil;
+	
+	for(submodel in [self submodels])
+	{
+		byteSize += [submodel displayListByteSize];
+	}
+	
+	return byteSize;
+	
+}//end displayListByteSize
+
+
 //========== modelNames ========================================================
 //
 // Purpose:		Returns the the names of all the submodels in the file.
@@ -590,6 +700,26 @@
 }//end modelWithName:
 
 
+//========== partsReferencingName: =============================================
+//
+// Purpose:		Returns every LDrawPart in this file whose reference name 
+//				matches the given name, ignoring case. This answers "where is 
+//				this part used?" straight from the reference index, without 
+//				walking the directive tree.
+//
+//==============================================================================
+- (NSArray *) partsReferencingName:(NSString *)referenceName
+{
+	NSSet	*parts	= [self->referenceIndex objectForKey:[referenceName lowercaseString]];
+	
+	if(parts == nil)
+		return [NSArray array];
+	else
+		return [parts allObjects];
+	
+}//end partsReferencingName:
+
+
 //========== path ==============================================================
 //
 // Purpose:		Returns the filesystem path at which this file was resides, or 
@@ -605,6 +735,19 @@
 }//end path
 
 
+//========== referencedNames ===================================================
+//
+// Purpose:		Returns the (lowercase) reference names of all the parts used 
+//				anywhere in this file, each listed once.
+//
+//==============================================================================
+- (NSArray *) referencedNames
+{
+	return [self->referenceIndex allKeys];
+	
+}//end referencedNames
+
+
 //========== submodels =========================================================
 //
 // Purpose:		Returns an array of the LDrawModels (or more likely, the 
@@ -758,13 +901,32 @@
 //==============================================================================
 - (void) insertDirective:(LDrawDirective *)directive atIndex:(NSInteger)index
 {
+	NSString    *modelName  = nil;
+	LDrawPart   *currentPart = nil;
+
 	[super insertDirective:directive atIndex:index];
 	[self updateModelLookupTable];
 	
-	// Post a notification on ourself that a model was added - missing parts need
-	// to know this to re-check whether they match this model.
+	// Any part which couldn't find this model before gets another chance. We 
+	// know exactly who they are from the reference index. 
+	if([directive isKindOfClass:[LDrawMPDModel class]])
+	{
+		modelName = [(LDrawMPDModel *)directive modelName];
+		
+		for(currentPart in [self partsReferencingName:modelName])
+		{
+			if([currentPart partIsMissing] == YES)
+				[currentPart unresolvePart];
+		}
+		[self->missingParts removeObjectForKey:[modelName lowercaseString]];
+	}
+	
+	// Post a notification on ourself that a model was added, for anyone else 
+	// interested in the file's list of models.
 	[[NSNotificationCenter defaultCenter]
-			postNotificationName:LDrawMPDSubModelAdded object:self ];
+			postNotificationName:LDrawMPDSubModelAdded
+						  object:self
+						userInfo:[NSDictionary dictionaryWithObject:directive forKey:LDrawMPDSubModelKey] ];
 	
 }//end insertDirective:atIndex:
 
@@ -776,12 +938,219 @@
 //==============================================================================
 - (void) removeDirectiveAtIndex:(NSInteger)index
 {
+	LDrawDirective  *doomedDirective    = [[[self subdirectives] objectAtIndex:index] retain];
+	NSString        *modelName          = nil;
+	LDrawPart       *currentPart        = nil;
+	
 	[super removeDirectiveAtIndex:index];
 	[self updateModelLookupTable];
 	
+	// Parts still referring to the deleted submodel must let go of it; they 
+	// will come up missing the next time they resolve. 
+	if([doomedDirective isKindOfClass:[LDrawMPDModel class]])
+	{
+		modelName = [(LDrawMPDModel *)doomedDirective modelName];
+		
+		for(currentPart in [self partsReferencingName:modelName])
+		{
+			[currentPart unresolvePart];
+			[currentPart invalCache:CacheFlagBounds];
+		}
+	}
+	[doomedDirective release];
+	
 }//end removeDirectiveAtIndex:
 
 
+#pragma mark -
+#pragma mark REFERENCE INDEX
+#pragma mark -
+
+//========== addReferencesInDirective: =========================================
+//
+// Purpose:		Enters every LDrawPart found in directive (or, if it is a 
+//				container, anywhere beneath it) into the file's reference index. 
+//
+// Notes:		Containers call this whenever they gain a child while they are 
+//				inside a file, so the index always mirrors the directive tree.
+//
+//==============================================================================
+- (void) addReferencesInDirective:(LDrawDirective *)directive
+{
+	NSString        *referenceName  = nil;
+	NSMutableSet    *parts          = nil;
+	
+	if([directive isKindOfClass:[LDrawPart class]])
+	{
+		referenceName = [(LDrawPart *)directive referenceName];
+		
+		if(referenceName != nil)
+		{
+			if(self->referenceIndex == nil)
+				self->referenceIndex = [[NSMutableDictionary alloc] init];
+			
+			parts = [self->referenceIndex objectForKey:referenceName];
+			if(parts == nil)
+			{
+				parts = [NSMutableSet set];
+				[self->referenceIndex setObject:parts forKey:referenceName];
+			}
+			[parts addObject:directive];
+		}
+	}
+	else if([directive isKindOfClass:[LDrawContainer class]])
+	{
+		for(LDrawDirective *child in [(LDrawContainer *)directive subdirectives])
+			[self addReferencesInDirective:child];
+	}
+	
+}//end addReferencesInDirective:
+
+
+//========== removeReferencesInDirective: ======================================
+//
+// Purpose:		Drops every LDrawPart found in or beneath directive from the 
+//				reference index. Called as the directive leaves the file.
+//
+//==============================================================================
+- (void) removeReferencesInDirective:(LDrawDirective *)directive
+{
+	NSString        *referenceName  = nil;
+	NSMutableSet    *parts          = nil;
+	
+	if([directive isKindOfClass:[LDrawPart class]])
+	{
+		referenceName	= [(LDrawPart *)directive referenceName];
+		parts			= [self->referenceIndex objectForKey:referenceName];
+		
+		if(parts != nil)
+		{
+			[parts removeObject:directive];
+			if([parts count] == 0)
+				[self->referenceIndex removeObjectForKey:referenceName];
+		}
+		
+		[self forgetMissingPart:(LDrawPart *)directive name:referenceName];
+	}
+	else if([directive isKindOfClass:[LDrawContainer class]])
+	{
+		for(LDrawDirective *child in [(LDrawContainer *)directive subdirectives])
+			[self removeReferencesInDirective:child];
+	}
+	
+}//end removeReferencesInDirective:
+
+
+//========== part:didChangeReferenceFrom: ======================================
+//
+// Purpose:		A part in this file has been pointed at a new name. Move it 
+//				from its old bucket in the reference index to its new one.
+//
+//==============================================================================
+- (void) part:(LDrawPart *)part didChangeReferenceFrom:(NSString *)oldReferenceName
+{
+	NSMutableSet    *parts  = nil;
+	
+	if(oldReferenceName != nil)
+	{
+		parts = [self->referenceIndex objectForKey:oldReferenceName];
+		[parts removeObject:part];
+		if(parts != nil && [parts count] == 0)
+			[self->referenceIndex removeObjectForKey:oldReferenceName];
+		
+		[self forgetMissingPart:part name:oldReferenceName];
+	}
+	
+	[self addReferencesInDirective:part];
+	
+}//end part:didChangeReferenceFrom:
+
+
+//========== notePartIsMissing: ================================================
+//
+// Purpose:		Called by a part of ours which couldn't be found anywhere. A 
+//				submodel added to some other open file might be what it is 
+//				looking for, so from now on we listen for that, and remember 
+//				the part under the name it wants.
+//
+// Notes:		Submodels added to this file are handled by 
+//				-insertDirective:atIndex:, which knows exactly who wants them. 
+//				Only files which have had a missing part pay for the 
+//				notification, just as only missing parts used to observe it 
+//				themselves.
+//
+//==============================================================================
+- (void) notePartIsMissing:(LDrawPart *)part
+{
+	NSString        *referenceName  = [[part referenceName] lowercaseString];
+	NSMutableSet    *parts          = nil;
+	
+	if(referenceName == nil)
+		return;
+	
+	if(self->missingParts == nil)
+		self->missingParts = [[NSMutableDictionary alloc] init];
+	
+	parts = [self->missingParts objectForKey:referenceName];
+	if(parts == nil)
+	{
+		parts = [NSMutableSet set];
+		[self->missingParts setObject:parts forKey:referenceName];
+	}
+	[parts addObject:part];
+	
+	if(self->watchesOtherFiles == NO)
+	{
+		self->watchesOtherFiles = YES;
+		[[NSNotificationCenter defaultCenter] addObserver:self
+												 selector:@selector(submodelAddedElsewhere:)
+													 name:LDrawMPDSubModelAdded
+												   object:nil ];
+	}
+	
+}//end notePartIsMissing:
+
+
+//========== forgetMissingPart:name: ===========================================
+//
+// Purpose:		The part is leaving the file or changing its name, so it no 
+//				longer waits on referenceName.
+//
+//==============================================================================
+- (void) forgetMissingPart:(LDrawPart *)part name:(NSString *)referenceName
+{
+	NSMutableSet    *parts  = nil;
+	
+	referenceName	= [referenceName lowercaseString];
+	parts			= [self->missingParts objectForKey:referenceName];
+	
+	if(parts != nil)
+	{
+		[parts removeObject:part];
+		if([parts count] == 0)
+			[self->missingParts removeObjectForKey:referenceName];
+	}
+	
+}//end forgetMissingPart:name:
+
+
+//========== rebuildReferenceIndex =============================================
+//
+// Purpose:		Builds the reference index from scratch. Only needed when the 
+//				directive tree was assembled without going through 
+//				-insertDirective:atIndex:, as happens when unarchiving.
+//
+//==============================================================================
+- (void) rebuildReferenceIndex
+{
+	[self->referenceIndex release];
+	self->referenceIndex = nil;
+	
+	[self addReferencesInDirective:self];
+	
+}//end rebuildReferenceIndex
+
+
 #pragma mark -
 #pragma mark UTILITIES
 #pragma mark -
@@ -900,6 +1269,18 @@
 }//end optimizeVertexes
 
 
+//========== updateChangedVertexes =============================================
+//
+// Purpose:		Rewrites the changed vertexes of the active model only. 
+//
+//==============================================================================
+- (void) updateChangedVertexes
+{
+	[[self activeModel] updateChangedVertexes];
+
+}//end updateChangedVertexes
+
+
 //========== renameModel:toName: ===============================================
 //
 // Purpose:		Sets the name of the given member submodel to the new name, and 
@@ -913,10 +1294,8 @@
 	NSArray     *submodels          = [self submodels];
 	BOOL        containsSubmodel    = ([submodels indexOfObjectIdenticalTo:submodel] != NSNotFound);
 	NSString    *oldName            = [submodel modelName];
-	PartReport  *partReport         = nil;
-	NSArray     *allParts           = nil;
+	NSArray     *referencingParts   = nil;
 	LDrawPart   *currentPart        = nil;
-	NSInteger   counter             = 0;
 
 	if(		containsSubmodel == YES
 	   &&	[oldName isEqualToString:newName] == NO )
@@ -924,21 +1303,15 @@
 		// Update the model name itself
 		[submodel setModelName:newName];
 		
-		// Update all references to the old name
-		partReport	= [PartReport partReportForContainer:self];
-		allParts	= [partReport allParts];
+		// Update all references to the old name. The reference index is keyed 
+		// by lowercase name, which takes care of Bricksmith's 
+		// case-insensitivity. Renaming the parts rewrites the index, so work 
+		// from a snapshot. 
+		referencingParts = [self partsReferencingName:oldName];
 		
-		for(counter = 0; counter < [allParts count]; counter++)
+		for(currentPart in referencingParts)
 		{
-			currentPart = [allParts objectAtIndex:counter];
-			
-			// If the part points to the old name, change it to the new one.
-			// Since the user can enter these values and Bricksmith is 
-			// case-insensitive, make sure to ignore case. 
-			if([[currentPart referenceName] caseInsensitiveCompare:oldName] == NSOrderedSame)
-			{
-				[currentPart setDisplayName:newName];
-			}
+			[currentPart setDisplayName:newName];
 		}
 	}
 	
@@ -970,6 +1343,42 @@
 }
 
 
+#pragma mark -
+#pragma mark NOTIFICATIONS
+#pragma mark -
+
+//========== submodelAddedElsewhere: ===========================================
+//
+// Purpose:		Some file got a new submodel. If it wasn't us, give the parts of 
+//				ours which went missing looking for that name another chance 
+//				to resolve. Only that one name is looked up.
+//
+// Notes:		A part which still can't be found notes itself missing again 
+//				when it next resolves.
+//
+//==============================================================================
+- (void) submodelAddedElsewhere:(NSNotification *)notification
+{
+	LDrawMPDModel   *newModel       = [[notification userInfo] objectForKey:LDrawMPDSubModelKey];
+	NSString        *modelName      = [[newModel modelName] lowercaseString];
+	NSSet           *parts          = nil;
+	LDrawPart       *currentPart    = nil;
+	
+	if([notification object] == self || modelName == nil)
+		return;
+	
+	// Take the set out of the table first; resolving may add parts back.
+	parts = [[[self->missingParts objectForKey:modelName] retain] autorelease];
+	[self->missingParts removeObjectForKey:modelName];
+	
+	for(currentPart in parts)
+	{
+		[currentPart unresolvePart];
+	}
+	
+}//end submodelAddedElsewhere:
+
+
 #pragma mark -
 #pragma mark DESTRUCTOR
 #pragma mark -
@@ -982,7 +1391,12 @@
 - (void) dealloc
 {
 	//NSLog(@"File %s going away.\n", [filePath UTF8String]);
+	if(watchesOtherFiles)
+		[[NSNotificationCenter defaultCenter] removeObserver:self name:LDrawMPDSubModelAdded object:nil];
+	
 	[nameModelDict	release];
+	[referenceIndex	release];
+	[missingParts	release];
 	[activeModel	release];
 	[filePath		release];
 //	[editLock		release];
@@ -24,6 +24,7 @@
 + (id) model;
 
 // Directives
++ (NSString *) writeModelNamed:(NSString *)name body:(NSString *)body;
 - (NSString *) writeModel;
 
 // Accessors
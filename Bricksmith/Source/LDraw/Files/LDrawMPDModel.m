@@ -259,6 +259,18 @@
 //
 //==============================================================================
 - (NSString *) write
+{
+	return [LDrawMPDModel writeModelNamed:[self modelName] body:[super write]];
+	
+}//end write
+
+
+//---------- writeModelNamed:body: -----------------------------------[static]--
+//
+// Purpose:		Wraps the text of a model in the MPD file commands. 
+//
+//------------------------------------------------------------------------------
++ (NSString *) writeModelNamed:(NSString *)name body:(NSString *)body
 {
 	NSString *CRLF = [NSString CRLF]; //we need a DOS line-end marker, because 
 									  //LDraw is predominantly DOS-based.
@@ -271,13 +283,13 @@
 	//		   model text
 	//			....
 	//		0 NOFILE
-	[written appendFormat:@"0 %@ %@%@", LDRAW_MPD_SUBMODEL_START, [self modelName], CRLF];
-	[written appendFormat:@"%@%@", [super write], CRLF];
+	[written appendFormat:@"0 %@ %@%@", LDRAW_MPD_SUBMODEL_START, name, CRLF];
+	[written appendFormat:@"%@%@", body, CRLF];
 	[written appendFormat:@"0 %@", LDRAW_MPD_SUBMODEL_END];
 	
 	return written;
 	
-}//end write
+}//end writeModelNamed:body:
 
 
 //========== writeModel =============================================================
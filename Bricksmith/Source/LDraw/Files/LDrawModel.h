@@ -11,9 +11,11 @@
 
 #import "LDrawContainer.h"
 @class ColorLibrary;
+@class LDrawChunkBatcher;
 @class LDrawFile;
 @class LDrawStep;
 @class LDrawVertexes;
+struct LDrawDLPrepared;
 
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -33,6 +35,7 @@
 	NSUInteger				 currentStepDisplayed;	// display up to and including this step index
 	
 	Box3					cachedBounds;			// bounds of the model - only covers steps that are showing
+	NSString				*cachedText;			// output of -write; valid while CacheFlagText is clean
 	
 	//steps are stored in the superclass.
 	
@@ -43,6 +46,11 @@
 													// some drawing on library parts.
 	LDrawDLHandle			dl;						// Cached DL if we have one.
 	LDrawDLCleanup_f		dl_dtor;
+	struct LDrawDLPrepared	*prepared_dl;			// mesh built ahead of the first draw; uploaded then
+	NSData					*connectionPoints;		// packed LDrawConnection structs; collected by -optimizeStructure
+#if WANT_CHUNK_BATCHING
+	LDrawChunkBatcher		*chunkBatcher;			// merged meshes of small parts, created on first draw
+#endif
 }
 
 //Initialization
@@ -51,7 +59,9 @@
 //Accessors
 - (NSString *) category;
 - (ColorLibrary *) colorLibrary;
+- (NSData *) connectionPoints;
 - (NSArray *) draggingDirectives;
+- (NSUInteger) displayListByteSize;
 - (LDrawFile *)enclosingFile;
 - (NSString *)modelDescription;
 - (NSString *)fileName;
@@ -84,9 +94,12 @@
 //Utilities
 - (NSUInteger) maxStepIndexToOutput;
 - (NSUInteger) numberElements;
+- (void) collectConnectionPoints;
 - (void) optimizePrimitiveStructure;
+- (void) prepareDisplayList;
 - (void) optimizeStructure;
 - (void) optimizeVertexes;
+- (void) updateChangedVertexes;
 - (NSUInteger) parseHeaderFromLines:(NSArray *)lines beginningAtIndex:(NSUInteger)index;
 - (BOOL) line:(NSString *)line isValidForHeader:(NSString *)headerKey info:(NSString**)infoPtr;
 
@@ -19,14 +19,21 @@
 #import <string.h>
 
 #import "ColorLibrary.h"
+#import "LDrawChunkBatcher.h"
 #import "LDrawColor.h"
 #import "LDrawConditionalLine.h"
+#import "LDrawConnections.h"
+#import "LDrawDLCollector.h"
+#import "LDrawDisplayList.h"
 #import "LDrawFile.h"
 #import "LDrawKeywords.h"
 #import "LDrawLine.h"
+#import "LDrawMeshExporter.h"
+#import "LDrawPrimitiveSink.h"
 #import "LDrawQuadrilateral.h"
 #import "LDrawStep.h"
 #import "LDrawPart.h"
+#import "LDrawTrace.h"
 #import "LDrawTriangle.h"
 #import "LDrawUtilities.h"
 #import "LDrawVertexes.h"
@@ -43,6 +50,21 @@
 
 #define NO_CULL_SMALL_BRICKS 0
 
+// The steps -optimizeStructure sorts the flattened model into.
+struct LDrawSortedSteps
+{
+	LDrawStep   *lines;
+	LDrawStep   *triangles;
+	LDrawStep   *quadrilaterals;
+	LDrawStep   *everythingElse;
+};
+
+static void AddPrimitiveToVertexes(const LDrawPrimitive *primitive, void *context);
+static void RemovePrimitiveFromVertexes(const LDrawPrimitive *primitive, void *context);
+static void AddPrimitiveToSortedSteps(const LDrawPrimitive *primitive, void *context);
+static void AddTextureToSortedSteps(LDrawDirective *directive, LDrawColor *parentColor, Matrix4 transform, void *context);
+
+
 @implementation LDrawModel
 
 
@@ -275,12 +297,15 @@
 
 {
 	NSArray     *steps              = [self subdirectives];
+	NSIndexSet  *visibleIndexes     = [self visibleSubdirectiveIndexes];
 	NSUInteger  maxIndex            = [self maxStepIndexToOutput];
 	LDrawStep   *currentDirective   = nil;
 	NSUInteger  counter             = 0;
 	
+	COUNT_TRAVERSAL([visibleIndexes countOfIndexesInRange:NSMakeRange(0, maxIndex + 1)], maxIndex + 1);
+	
 	// Draw all the steps in the model
-	for(counter = 0; counter <= maxIndex; counter++)
+	for(counter = [visibleIndexes firstIndex]; counter != NSNotFound && counter <= maxIndex; counter = [visibleIndexes indexGreaterThanIndex:counter])
 	{
 		currentDirective = [steps objectAtIndex:counter];
 		[currentDirective draw:optionsMask viewScale:scaleFactor parentColor:parentColor];
@@ -314,6 +339,11 @@
 //================================================================================
 - (void) drawSelf:(id<LDrawRenderer>)renderer
 {
+	// A model whose every step is hidden (or empty) has nothing to draw, 
+	// however many parts use it.
+	if([self hasVisibleContent] == NO && self->draggingDirectives == nil)
+		return;
+	
 	// First: cull check!  In my last perf look, draw time was bottlenecked
 	// on the GPU not eating data fast enough, _not_ on CPU.  So burning a
 	// tiny bit of CPU time per part to cull draw calls is a win!
@@ -354,6 +384,14 @@
 	// Now: if we do not have a DL (no DL or we threw it out because it
 	// was invalid) build one now: get a collector and call "collect" on
 	// ourselves, which will walk our tree picking up primitives.
+	//
+	// A mesh prepared when we were loaded only needs uploading.
+	if(!dl && prepared_dl)
+	{
+		dl = (LDrawDLHandle) LDrawDLPreparedFinish(prepared_dl);
+		dl_dtor = (LDrawDLCleanup_f) LDrawDLDestroy;
+		prepared_dl = NULL;
+	}
 	if(!dl)
 	{
 		id<LDrawCollector> collector = [renderer beginDL];
@@ -376,15 +414,33 @@
 		// so there is no need for this.
 		
 		NSArray     *steps              = [self subdirectives];
+		NSIndexSet  *visibleIndexes     = [self visibleSubdirectiveIndexes];
 		NSUInteger  maxIndex            = [self maxStepIndexToOutput];
 		LDrawStep   *currentDirective   = nil;
 		NSUInteger  counter             = 0;
 		
-		for(counter = 0; counter <= maxIndex; counter++)
+		COUNT_TRAVERSAL([visibleIndexes countOfIndexesInRange:NSMakeRange(0, maxIndex + 1)], maxIndex + 1);
+		
+	#if WANT_CHUNK_BATCHING
+		// Small parts which haven't changed lately are drawn from merged 
+		// meshes instead; the batcher draws everything else in the steps.
+		if(self->chunkBatcher == nil)
+			self->chunkBatcher = [[LDrawChunkBatcher alloc] init];
+		
+		[self->chunkBatcher beginPass];
+		for(counter = [visibleIndexes firstIndex]; counter != NSNotFound && counter <= maxIndex; counter = [visibleIndexes indexGreaterThanIndex:counter])
+		{
+			currentDirective = [steps objectAtIndex:counter];
+			[self->chunkBatcher drawStep:currentDirective renderer:renderer];
+		}
+		[self->chunkBatcher endPassWithRenderer:renderer];
+	#else
+		for(counter = [visibleIndexes firstIndex]; counter != NSNotFound && counter <= maxIndex; counter = [visibleIndexes indexGreaterThanIndex:counter])
 		{
 			currentDirective = [steps objectAtIndex:counter];
 			[currentDirective drawSelf:renderer];
 		}
+	#endif
 		
 		// And: if we are currently dragging directives, those 
 		// directives were skipped in the cases above.  So we
@@ -436,12 +492,15 @@
 - (void) collectSelf:(id<LDrawCollector>)renderer
 {
 	NSArray     *steps              = [self subdirectives];
+	NSIndexSet  *visibleIndexes     = [self visibleSubdirectiveIndexes];
 	NSUInteger  maxIndex            = [self maxStepIndexToOutput];
 	LDrawStep   *currentDirective   = nil;
 	NSUInteger  counter             = 0;
 	
+	COUNT_TRAVERSAL([visibleIndexes countOfIndexesInRange:NSMakeRange(0, maxIndex + 1)], maxIndex + 1);
+	
 	// Draw all the steps in the model
-	for(counter = 0; counter <= maxIndex; counter++)
+	for(counter = [visibleIndexes firstIndex]; counter != NSNotFound && counter <= maxIndex; counter = [visibleIndexes indexGreaterThanIndex:counter])
 	{
 		currentDirective = [steps objectAtIndex:counter];
 		[currentDirective collectSelf:renderer];
@@ -458,12 +517,15 @@
 - (void) debugDrawboundingBox
 {
 	NSArray     *steps              = [self subdirectives];
+	NSIndexSet  *visibleIndexes     = [self visibleSubdirectiveIndexes];
 	NSUInteger  maxIndex            = [self maxStepIndexToOutput];
 	LDrawStep   *currentDirective   = nil;
 	NSUInteger  counter             = 0;
 	
+	COUNT_TRAVERSAL([visibleIndexes countOfIndexesInRange:NSMakeRange(0, maxIndex + 1)], maxIndex + 1);
+	
 	// Draw all the steps in the model
-	for(counter = 0; counter <= maxIndex; counter++)
+	for(counter = [visibleIndexes firstIndex]; counter != NSNotFound && counter <= maxIndex; counter = [visibleIndexes indexGreaterThanIndex:counter])
 	{
 		currentDirective = [steps objectAtIndex:counter];
 		[currentDirective debugDrawboundingBox];
@@ -483,15 +545,18 @@
 	   viewScale:(float)scaleFactor
 	  boundsOnly:(BOOL)boundsOnly
 	creditObject:(id)creditObject
-			hits:(NSMutableDictionary *)hits
+			hits:(LDrawHitList *)hits
 {
 	NSArray     *steps              = [self subdirectives];
+	NSIndexSet  *visibleIndexes     = [self visibleSubdirectiveIndexes];
 	NSUInteger  maxIndex            = [self maxStepIndexToOutput];
 	LDrawStep   *currentDirective   = nil;
 	NSUInteger  counter             = 0;
 	
+	COUNT_TRAVERSAL([visibleIndexes countOfIndexesInRange:NSMakeRange(0, maxIndex + 1)], maxIndex + 1);
+	
 	// Draw all the steps in the model
-	for(counter = 0; counter <= maxIndex; counter++)
+	for(counter = [visibleIndexes firstIndex]; counter != NSNotFound && counter <= maxIndex; counter = [visibleIndexes indexGreaterThanIndex:counter])
 	{
 		currentDirective = [steps objectAtIndex:counter];
 		[currentDirective hitTest:pickRay transform:transform viewScale:scaleFactor boundsOnly:boundsOnly creditObject:creditObject hits:hits];
@@ -519,12 +584,15 @@
 	}
 
 	NSArray     *steps              = [self subdirectives];
+	NSIndexSet  *visibleIndexes     = [self visibleSubdirectiveIndexes];
 	NSUInteger  maxIndex            = [self maxStepIndexToOutput];
 	LDrawStep   *currentDirective   = nil;
 	NSUInteger  counter             = 0;
 
+	COUNT_TRAVERSAL([visibleIndexes countOfIndexesInRange:NSMakeRange(0, maxIndex + 1)], maxIndex + 1);
+	
 	// Draw all the steps in the model
-	for(counter = 0; counter <= maxIndex; counter++)
+	for(counter = [visibleIndexes firstIndex]; counter != NSNotFound && counter <= maxIndex; counter = [visibleIndexes indexGreaterThanIndex:counter])
 	{
 		currentDirective = [steps objectAtIndex:counter];
 		if([currentDirective boxTest:bounds transform:transform boundsOnly:boundsOnly creditObject:creditObject hits:hits])
@@ -554,12 +622,15 @@
     }
 
 	NSArray     *steps              = [self subdirectives];
+	NSIndexSet  *visibleIndexes     = [self visibleSubdirectiveIndexes];
 	NSUInteger  maxIndex            = [self maxStepIndexToOutput];
 	LDrawStep   *currentDirective   = nil;
 	NSUInteger  counter             = 0;
 
+	COUNT_TRAVERSAL([visibleIndexes countOfIndexesInRange:NSMakeRange(0, maxIndex + 1)], maxIndex + 1);
+	
 	// Draw all the steps in the model
-	for(counter = 0; counter <= maxIndex; counter++)
+	for(counter = [visibleIndexes firstIndex]; counter != NSNotFound && counter <= maxIndex; counter = [visibleIndexes indexGreaterThanIndex:counter])
 	{
 		currentDirective = [steps objectAtIndex:counter];
 		[currentDirective depthTest:pt inBox:bounds transform:transform creditObject:creditObject bestObject:bestObject bestDepth:bestDepth];
@@ -571,8 +642,35 @@
 //
 // Purpose:		Writes out the MPD submodel, wrapped in the MPD file commands.
 //
+// Notes:		The text is cached, so saving a file with many submodels only 
+//				re-serializes those which changed since the last save. Anything 
+//				inside which changes its output invalidates CacheFlagText, which 
+//				cascades up to us through the steps.
+//
 //==============================================================================
 - (NSString *) write
+{
+	if(		[self revalCache:CacheFlagText] == CacheFlagText
+		||	self->cachedText == nil )
+	{
+		[self->cachedText release];
+		self->cachedText = [[self writeUncached] copy];
+		
+		// Re-arm notifications from everything we just wrote.
+		[self revalCacheRecursively:CacheFlagText];
+	}
+	
+	return self->cachedText;
+
+}//end write
+
+
+//========== writeUncached =====================================================
+//
+// Purpose:		Serializes the model's header and all its steps from scratch.
+//
+//==============================================================================
+- (NSString *) writeUncached
 {
 	NSString        *CRLF           = [NSString CRLF]; //we need a DOS line-end marker, because 
 														//LDraw is predominantly DOS-based.
@@ -608,7 +706,7 @@
 	
 	return written;
 
-}//end write
+}//end writeUncached
 
 
 #pragma mark -
@@ -664,11 +762,12 @@
 		cachedBounds = InvalidBox;
 		
 		NSArray     *steps              = [self subdirectives];
+		NSIndexSet  *visibleIndexes     = [self visibleSubdirectiveIndexes];
 		NSUInteger  maxIndex            = [self maxStepIndexToOutput];
 		LDrawStep   *currentDirective   = nil;
 		NSUInteger  counter             = 0;
-		// Draw all the steps in the model
-		for(counter = 0; counter <= maxIndex; counter++)
+		// Measure all the steps in the model which have anything in them
+		for(counter = [visibleIndexes firstIndex]; counter != NSNotFound && counter <= maxIndex; counter = [visibleIndexes indexGreaterThanIndex:counter])
 		{
 			currentDirective = [steps objectAtIndex:counter];
 			cachedBounds = V3UnionBox(cachedBounds, [currentDirective boundingBox3]);
@@ -742,6 +841,21 @@
 }//end colorLibrary
 
 
+//========== connectionPoints ==================================================
+//
+// Purpose:		Returns the studs and anti-studs of a library part, in the 
+//				part's coordinates: packed LDrawConnection structs in an 
+//				NSData, [data length] / sizeof(LDrawConnection) of them. nil 
+//				for models which were never structure-optimized.
+//
+//==============================================================================
+- (NSData *) connectionPoints
+{
+	return self->connectionPoints;
+	
+}//end connectionPoints
+
+
 //========== draggingDirectives ================================================
 //
 // Purpose:		Returns the objects that are currently being displayed as part 
@@ -755,6 +869,30 @@
 }//end draggingDirectives
 
 
+//========== displayListByteSize ===============================================
+//
+// Purpose:		Returns the bytes held by this model's cached mesh: on the card 
+//				once it has been drawn, or in memory if it was prepared and is 
+//				still waiting for its first draw. 
+//
+// Notes:		Meshes of the parts the model uses belong to the library parts, 
+//				not to us. 
+//
+//==============================================================================
+- (NSUInteger) displayListByteSize
+{
+	NSUInteger	byteSize	= 0;
+	
+	if(self->dl != NULL && self->dl_dtor == (LDrawDLCleanup_f) LDrawDLDestroy)
+		byteSize += LDrawDLGetByteSize(self->dl);
+	if(self->prepared_dl != NULL)
+		byteSize += LDrawDLPreparedGetByteSize(self->prepared_dl);
+	
+	return byteSize;
+	
+}//end displayListByteSize
+
+
 //========== enclosingFile =====================================================
 //
 // Purpose:		Returns the file in which this model is stored.
@@ -1005,35 +1143,21 @@
 //==============================================================================
 - (void) setDraggingDirectives:(NSArray *)directives
 {
-	LDrawStep       *dragStep           = nil;
-	LDrawDirective  *currentDirective   = nil;
-	NSUInteger      counter             = 0;
+	LDrawStep           *dragStep           = nil;
+	LDrawDirective      *currentDirective   = nil;
+	LDrawPrimitiveSink  sink;
+	NSUInteger          counter             = 0;
 	
 	// Remove primitives from the previous dragging directives from the 
 	// optimized vertexes 
 	if(self->draggingDirectives)
 	{
-		NSMutableArray  *lines              = [NSMutableArray array];
-		NSMutableArray  *triangles          = [NSMutableArray array];
-		NSMutableArray  *quadrilaterals     = [NSMutableArray array];
+		sink                    = LDrawPrimitiveSinkMake(RemovePrimitiveFromVertexes, self->vertexes);
+		sink.followsReferences  = NO;
 		
-		[self->draggingDirectives flattenIntoLines:lines
-										 triangles:triangles
-									quadrilaterals:quadrilaterals
-											 other:nil
-									  currentColor:[[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor]
-								  currentTransform:IdentityMatrix4
-								   normalTransform:IdentityMatrix3
-										 recursive:NO];
-
-		for(LDrawLine *directive in lines)
-			[self->vertexes removeLine:directive];
-
-		for(LDrawTriangle *directive in triangles)
-			[self->vertexes removeTriangle:directive];
-
-		for(LDrawQuadrilateral *directive in quadrilaterals)
-			[self->vertexes removeQuadrilateral:directive];
+		[self->draggingDirectives flattenIntoSink:&sink
+									 currentColor:[[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor]
+								 currentTransform:IdentityMatrix4];
 	}
 	
 	// When we get sent nil directives, nil out the drag step.
@@ -1058,27 +1182,12 @@
 		
 		//---------- Optimize primitives ---------------------------------------
 		
-		NSMutableArray  *lines              = [NSMutableArray array];
-		NSMutableArray  *triangles          = [NSMutableArray array];
-		NSMutableArray  *quadrilaterals     = [NSMutableArray array];
+		sink                    = LDrawPrimitiveSinkMake(AddPrimitiveToVertexes, self->vertexes);
+		sink.followsReferences  = NO;
 		
-		[dragStep flattenIntoLines:lines
-						 triangles:triangles
-					quadrilaterals:quadrilaterals
-							 other:nil
-					  currentColor:[[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor]
-				  currentTransform:IdentityMatrix4
-				   normalTransform:IdentityMatrix3
-						 recursive:NO];
-		
-		for(LDrawLine *directive in lines)
-			[self->vertexes addLine:directive];
-		
-		for(LDrawTriangle *directive in triangles)
-			[self->vertexes addTriangle:directive];
-		
-		for(LDrawQuadrilateral *directive in quadrilaterals)
-			[self->vertexes addQuadrilateral:directive];
+		[dragStep flattenIntoSink:&sink
+					 currentColor:[[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor]
+				 currentTransform:IdentityMatrix4];
 	}
 	
 	[dragStep retain];
@@ -1102,6 +1211,7 @@
 	[modelDescription release];
 	
 	modelDescription = newDescription;
+	[self invalCache:CacheFlagText];
 	
 }//end setModelDescription:
 
@@ -1120,6 +1230,7 @@
 	[fileName release];
 	
 	fileName = newName;
+	[self invalCache:CacheFlagText];
 	
 }//end setFileName:
 
@@ -1139,6 +1250,7 @@
 	[author release];
 	
 	author = newAuthor;
+	[self invalCache:CacheFlagText];
 	
 }//end setAuthor:
 
@@ -1209,6 +1321,18 @@
 }
 
 
+//========== setVertexesNeedUpdateForDirective: ================================
+//
+// Purpose:		Marks just the vertexes of the given primitive as needing to be 
+//				rewritten. 
+//
+//==============================================================================
+- (void) setVertexesNeedUpdateForDirective:(LDrawDirective *)directive
+{
+	[self->vertexes updateDirective:directive];
+}
+
+
 #pragma mark -
 #pragma mark ACTIONS
 #pragma mark -
@@ -1242,6 +1366,34 @@
 }//end addStep:
 
 
+//========== collectMeshExport: ================================================
+//
+// Purpose:		Reports the model's own primitives as one mesh, then whatever 
+//				parts draw in the steps on display. 
+//
+// Notes:		Library parts are flattened to primitives, so there is nothing 
+//				more to find in them. 
+//
+//==============================================================================
+- (void) collectMeshExport:(LDrawMeshExporter *)exporter
+{
+	NSArray     *steps              = [self subdirectives];
+	NSUInteger  maxIndex            = [self maxStepIndexToOutput];
+	NSUInteger  counter             = 0;
+	
+	[exporter addMeshOfModel:self];
+	
+	if(self->isOptimized == NO)
+	{
+		for(counter = 0; counter <= maxIndex && counter < [steps count]; counter++)
+		{
+			[[steps objectAtIndex:counter] collectMeshExport:exporter];
+		}
+	}
+	
+}//end collectMeshExport:
+
+
 //========== makeStepVisible: ==================================================
 //
 // Purpose:		Guarantees that the given step is visible in this model.
@@ -1438,20 +1590,16 @@
 		self->vertexes = [[LDrawVertexes alloc] init];
 		[vertexes setAcceptsNonPrimitives:NO]; // we are responsible for drawing non-primitive objects
 		
-		NSMutableArray  *lines              = [NSMutableArray array];
-		NSMutableArray  *triangles          = [NSMutableArray array];
-		NSMutableArray  *quadrilaterals     = [NSMutableArray array];
+		// ONLY collect primitives; all other elements will be drawn in the 
+		// normal draw recursion 
+		LDrawPrimitiveSink  sink    = LDrawPrimitiveSinkMake(AddPrimitiveToVertexes, self->vertexes);
+		sink.followsReferences      = NO;
 		
-		[self flattenIntoLines:lines
-					 triangles:triangles
-				quadrilaterals:quadrilaterals
-						 other:nil // ONLY collect primitives; all other elements will be drawn in the normal draw recursion
-				  currentColor:[[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor]
-			  currentTransform:IdentityMatrix4
-			   normalTransform:IdentityMatrix3
-					 recursive:NO];
+		[self flattenIntoSink:&sink
+				 currentColor:[[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor]
+			 currentTransform:IdentityMatrix4];
 		
-		[vertexes setLines:lines triangles:triangles quadrilaterals:quadrilaterals other:nil];
+		[vertexes setVertexesNeedRebuilding];
 	}
 }//end optimizePrimitiveStructure
 
@@ -1474,37 +1622,42 @@
 //
 //				1000%. That is not a typo.
 //
+//				The stud primitives vanish in the flattening, so the part's
+//				connection points are collected from them first.
+//
+// Notes:		The flattening is streamed, so referenced models are never 
+//				copied; only the primitives which end up in the sorted steps 
+//				are allocated. Textures are the exception: they are copied and 
+//				flattened whole, because they draw their own geometry. 
+//
 //==============================================================================
 - (void) optimizeStructure
 {
-	NSArray         *steps              = [self subdirectives];
-	
-	NSMutableArray  *lines              = [NSMutableArray array];
-	NSMutableArray  *triangles          = [NSMutableArray array];
-	NSMutableArray  *quadrilaterals     = [NSMutableArray array];
-	NSMutableArray  *everythingElse     = [NSMutableArray array];
-	
-	LDrawStep       *linesStep          = [LDrawStep emptyStepWithFlavor:LDrawStepLines];
-	LDrawStep       *trianglesStep      = [LDrawStep emptyStepWithFlavor:LDrawStepTriangles];
-	LDrawStep       *quadrilateralsStep = [LDrawStep emptyStepWithFlavor:LDrawStepQuadrilaterals];
-	LDrawStep       *everythingElseStep = [LDrawStep emptyStepWithFlavor:LDrawStepAnyDirectives];
+	NSArray                 *steps          = [self subdirectives];
+	struct LDrawSortedSteps sorted;
+	LDrawPrimitiveSink      sink;
 	
 	NSUInteger      directiveCount      = 0;
 	NSInteger       counter             = 0;
 	
+	sorted.lines            = [LDrawStep emptyStepWithFlavor:LDrawStepLines];
+	sorted.triangles        = [LDrawStep emptyStepWithFlavor:LDrawStepTriangles];
+	sorted.quadrilaterals   = [LDrawStep emptyStepWithFlavor:LDrawStepQuadrilaterals];
+	sorted.everythingElse   = [LDrawStep emptyStepWithFlavor:LDrawStepAnyDirectives];
+	
+	[self collectConnectionPoints];
+	
 	// Traverse the entire hiearchy of part references and sort out each 
 	// primitive type into a flat list. This allows staggering speed increases. 
 	//
 	// If we were to only sort without flattening, we would get a 100% speed 
 	// increase. But flattening and sorting yields over 1000%. 
-	[self flattenIntoLines:lines
-				 triangles:triangles
-			quadrilaterals:quadrilaterals
-					 other:everythingElse
-			  currentColor:[[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor]
-		  currentTransform:IdentityMatrix4
-		   normalTransform:IdentityMatrix3
-				 recursive:YES];
+	sink                = LDrawPrimitiveSinkMake(AddPrimitiveToSortedSteps, &sorted);
+	sink.acceptOther    = AddTextureToSortedSteps;
+	
+	[self flattenIntoSink:&sink
+			 currentColor:[[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor]
+		 currentTransform:IdentityMatrix4];
 		  
 	// Now that we have everything separated, remove the main step (it's the one 
 	// that has the entire model in it) and . 
@@ -1515,43 +1668,96 @@
 	}
 	
 	// Replace the original directives with the categorized steps we've created 
-	if([lines count] > 0)
-	{
-		for(id directive in lines)
-		{
-			[linesStep addDirective:directive];
-		}
-		[self addDirective:linesStep];
-	}
+	if([[sorted.lines subdirectives] count] > 0)
+		[self addDirective:sorted.lines];
 
-	if([triangles count] > 0)
-	{
-		for(id directive in triangles)
-		{
-			[trianglesStep addDirective:directive];
-		}
-		[self addDirective:trianglesStep];
+	if([[sorted.triangles subdirectives] count] > 0)
+		[self addDirective:sorted.triangles];
+	
+	if([[sorted.quadrilaterals subdirectives] count] > 0)
+		[self addDirective:sorted.quadrilaterals];
+	
+	if([[sorted.everythingElse subdirectives] count] > 0 || [[self subdirectives] count] == 0)
+	{								// Make sure there is at least one step in the model!
+		[self addDirective:sorted.everythingElse];
 	}
-	if([quadrilaterals count] > 0)
+
+	isOptimized = TRUE;
+		
+}//end optimizeStructure
+
+
+//========== collectConnectionPoints ===========================================
+//
+// Purpose:		Records where this model's studs and anti-studs are, gathered
+//				from its references to the stud primitives and from the
+//				library parts it is built out of.
+//
+// Notes:		Library models are optimized as they are loaded, so the parts
+//				referenced here have already collected their own.
+//
+//==============================================================================
+- (void) collectConnectionPoints
+{
+	NSMutableData   *collected      = [NSMutableData data];
+	LDrawConnection primitiveConnections[LDRAW_CONNECTIONS_PER_PRIMITIVE_MAX];
+	NSUInteger      primitiveCount  = 0;
+	NSData          *childPoints    = nil;
+	LDrawPart       *part           = nil;
+	id              currentElement  = nil;
+	
+	for(currentElement in [self allEnclosedElements])
 	{
-		for(id directive in quadrilaterals)
+		if([currentElement isKindOfClass:[LDrawPart class]] == NO)
+			continue;
+		
+		part            = currentElement;
+		primitiveCount  = LDrawConnectionsForPrimitive([part referenceName], primitiveConnections);
+		
+		if(primitiveCount > 0)
 		{
-			[quadrilateralsStep addDirective:directive];
+			LDrawConnectionsAppendTransformed(collected, primitiveConnections, primitiveCount, [part transformationMatrix]);
 		}
-		[self addDirective:quadrilateralsStep];
-	}
-	if([everythingElse count] > 0 || [[self subdirectives] count] == 0)
-	{								// Make sure there is at least one step in the model!
-		for(id directive in everythingElse)
+		else
 		{
-			[everythingElseStep addDirective:directive];
+			childPoints = [[part resolvedLibraryModel] connectionPoints];
+			LDrawConnectionsAppendTransformed(collected, [childPoints bytes], [childPoints length] / sizeof(LDrawConnection), [part transformationMatrix]);
 		}
-		[self addDirective:everythingElseStep];
 	}
+	LDrawConnectionsRemoveDuplicates(collected);
+	
+	[self->connectionPoints release];
+	self->connectionPoints = [collected copy];
+	
+}//end collectConnectionPoints
 
-	isOptimized = TRUE;
+
+//========== prepareDisplayList ================================================
+//
+// Purpose:		Collects and smooths this model's mesh now, so that its first 
+//				draw only has to upload it. 
+//
+// Notes:		This may be called on any thread, but only while no one else 
+//				can see the model -- the part library calls it on freshly parsed 
+//				library parts before registering them. Textured models are left 
+//				to be collected when drawn; see LDrawDLCollector. 
+//
+//==============================================================================
+- (void) prepareDisplayList
+{
+	LDrawDLCollector    *collector  = nil;
+	
+	if(self->dl == NULL && self->prepared_dl == NULL)
+	{
+		collector = [[LDrawDLCollector alloc] init];
 		
-}//end optimizeStructure
+		[self collectSelf:collector];
+		self->prepared_dl = [collector prepare];
+		
+		[collector release];
+	}
+
+}//end prepareDisplayList
 
 
 //========== optimizeVertexes ==================================================
@@ -1559,11 +1765,13 @@
 // Purpose:		Makes sure the vertexes (collected in 
 //				-optimizePrimitiveStructure) are displayable. This is called in 
 //				response to changing the vertexes, so all existing optimizations 
-//				must be destroyed. 
+//				must be brought up to date. 
 //
 //==============================================================================
 - (void) optimizeVertexes
 {
+	TRACE_BEGIN("optimize model vertexes");
+	
 	[super optimizeVertexes];
 
 	// Allow primitives to be visible when displaying the model itself.
@@ -1572,17 +1780,37 @@
 	if([vertexes isOptimizedForColor:parentColor])
 	{
 		// The vertexes have already been optimized for any referencing colors. 
-		// Just rebuild the existing color optimizations. 
-		[self->vertexes rebuildAllOptimizations];
+		// Just bring the existing color optimizations up to date. 
+		[self->vertexes updateAllOptimizations];
 	}
 	else
 	{
 		// Newly-created, empty vertexes. Make a list to display the model itself. 
 		[self->vertexes optimizeOpenGLWithParentColor:parentColor];
 	}
+	
+	TRACE_END("optimize model vertexes");
+	
 }//end optimizeVertexes
 
 
+//========== updateChangedVertexes =============================================
+//
+// Purpose:		Rewrites only the vertex slots of primitives which have changed 
+//				since the last optimization. 
+//
+// Notes:		Unlike -optimizeVertexes, this does not recurse into the model's 
+//				contents. It is meant for drags, which move a few primitives on 
+//				every mouse event. 
+//
+//==============================================================================
+- (void) updateChangedVertexes
+{
+	[self->vertexes updateAllOptimizations];
+	
+}//end updateChangedVertexes
+
+
 //========== parseHeaderFromLines:beginningAtIndex: ============================
 //
 // Purpose:		Given lines from an LDraw document, fill in the model header 
@@ -1749,10 +1977,18 @@
 	[modelDescription	release];
 	[fileName			release];
 	[author				release];
+	[cachedText			release];
+	[connectionPoints	release];
 	
 	[vertexes			release];
 	[colorLibrary		release];
 	
+	if(prepared_dl)
+		LDrawDLPreparedDestroy(prepared_dl);
+#if WANT_CHUNK_BATCHING
+	[chunkBatcher		release];
+#endif
+	
 	[super dealloc];
 	
 }//end dealloc
@@ -1766,3 +2002,121 @@
 
 
 @end
+
+
+#pragma mark -
+
+//---------- AddPrimitiveToVertexes ----------------------------------[static]--
+//
+// Purpose:		Primitive sink function which registers the element a primitive 
+//				came from with an LDrawVertexes. 
+//
+// Notes:		Only meaningful for a sink which doesn't follow references; 
+//				anything else would register the insides of referenced parts. 
+//
+//------------------------------------------------------------------------------
+static void AddPrimitiveToVertexes(const LDrawPrimitive *primitive, void *context)
+{
+	LDrawVertexes   *vertexes   = context;
+	
+	[vertexes addDirective:primitive->element];
+	
+}//end AddPrimitiveToVertexes
+
+
+//---------- RemovePrimitiveFromVertexes -----------------------------[static]--
+//
+// Purpose:		Primitive sink function which undoes AddPrimitiveToVertexes.
+//
+//------------------------------------------------------------------------------
+static void RemovePrimitiveFromVertexes(const LDrawPrimitive *primitive, void *context)
+{
+	LDrawVertexes   *vertexes   = context;
+	
+	[vertexes removeDirective:primitive->element];
+	
+}//end RemovePrimitiveFromVertexes
+
+
+//---------- AddPrimitiveToSortedSteps -------------------------------[static]--
+//
+// Purpose:		Primitive sink function which makes a flattened directive out of 
+//				the primitive and adds it to the step for its type. 
+//
+//------------------------------------------------------------------------------
+static void AddPrimitiveToSortedSteps(const LDrawPrimitive *primitive, void *context)
+{
+	struct LDrawSortedSteps *sorted         = context;
+	LDrawDrawableElement    *flattened      = nil;
+	LDrawStep               *step           = nil;
+	
+	switch(primitive->type)
+	{
+		case LDrawPrimitiveLine:
+		{
+			LDrawLine *line = [[LDrawLine alloc] init];
+			[line setVertex1:primitive->vertexes[0]];
+			[line setVertex2:primitive->vertexes[1]];
+			flattened   = line;
+			step        = sorted->lines;
+			break;
+		}
+		case LDrawPrimitiveTriangle:
+		{
+			LDrawTriangle *triangle = [[LDrawTriangle alloc] init];
+			[triangle setVertex1:primitive->vertexes[0]];
+			[triangle setVertex2:primitive->vertexes[1]];
+			[triangle setVertex3:primitive->vertexes[2]];
+			flattened   = triangle;
+			step        = sorted->triangles;
+			break;
+		}
+		case LDrawPrimitiveQuadrilateral:
+		{
+			LDrawQuadrilateral *quadrilateral = [[LDrawQuadrilateral alloc] init];
+			[quadrilateral setVertex1:primitive->vertexes[0]];
+			[quadrilateral setVertex2:primitive->vertexes[1]];
+			[quadrilateral setVertex3:primitive->vertexes[2]];
+			[quadrilateral setVertex4:primitive->vertexes[3]];
+			flattened   = quadrilateral;
+			step        = sorted->quadrilaterals;
+			break;
+		}
+	}
+	
+	[flattened setLDrawColor:primitive->color];
+	[step addDirective:flattened];
+	[flattened release];
+	
+}//end AddPrimitiveToSortedSteps
+
+
+//---------- AddTextureToSortedSteps ---------------------------------[static]--
+//
+// Purpose:		Sink function for textures met in the flattening. The texture 
+//				keeps its own geometry, so a flattened copy of it goes among 
+//				everything else, just as the array-based flatten leaves it. 
+//
+//------------------------------------------------------------------------------
+static void AddTextureToSortedSteps(LDrawDirective *directive, LDrawColor *parentColor, Matrix4 transform, void *context)
+{
+	struct LDrawSortedSteps *sorted         = context;
+	LDrawDirective          *flatCopy       = [directive copy];
+	NSMutableArray          *everythingElse = [NSMutableArray array];
+	
+	[flatCopy flattenIntoLines:nil
+					 triangles:nil
+				quadrilaterals:nil
+						 other:everythingElse
+				  currentColor:parentColor
+			  currentTransform:transform
+			   normalTransform:Matrix3MakeNormalTransformFromProjMatrix(transform)
+					 recursive:YES];
+	[flatCopy release];
+	
+	for(LDrawDirective *flattened in everythingElse)
+	{
+		[sorted->everythingElse addDirective:flattened];
+	}
+	
+}//end AddTextureToSortedSteps
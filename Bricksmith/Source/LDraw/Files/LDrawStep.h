@@ -54,6 +54,9 @@ typedef enum
 	LDrawStepRotationT	stepRotationType;
 	Tuple3				rotationAngle;		// in degrees
 	Box3				cachedBounds;		// cached bounds of the step
+	Box3				*childBounds;		// bounds of each subdirective that went into cachedBounds
+	BOOL				childBoundsValid;	// NO means cachedBounds is rebuilt from scratch
+	NSMutableSet		*boundsChangedChildren;
 	//Optimization variables
 	LDrawStepFlavorT	stepFlavor; //defaults to LDrawStepAnyDirectives
 	LDrawColorT			colorOfAllDirectives;
@@ -39,6 +39,8 @@
 #import "StringCategory.h"
 #import "LDrawLSynthDirective.h"
 
+static BOOL BoundsMayHaveShrunk(Box3 oldChildBounds, Box3 newChildBounds, Box3 bounds);
+
 
 @implementation LDrawStep
 
@@ -203,6 +205,10 @@
 		NSUInteger      counter             = 0;
 		LDrawDirective  *currentDirective   = nil;
 
+		// Finish the geometry of the primitives in one batch, now that they 
+		// are all parsed. 
+		[LDrawUtilities fixGeometryOfParsedDirectives:directives count:insertIndex];
+		
 		// Add the accumulated directives *in order*
 		for(counter = 0; counter < insertIndex; counter++)
 		{
@@ -346,16 +352,24 @@
 //				drawing. Such steps consist entirely of one kind of directive, 
 //				so we need call glBegin only once for the entire step.
 //
+// Notes:		Like all the traversals here, this visits only the directives 
+//				which have something to draw; hidden ones are never touched.
+//
 //==============================================================================
 - (void) draw:(NSUInteger)optionsMask viewScale:(float)scaleFactor parentColor:(LDrawColor *)parentColor
 
 {
 	NSArray         *commandsInStep     = [self subdirectives];
+	NSIndexSet      *visibleIndexes     = [self visibleSubdirectiveIndexes];
 	LDrawDirective  *currentDirective   = nil;
+	NSUInteger      index               = 0;
+	
+	COUNT_TRAVERSAL([visibleIndexes count], [commandsInStep count]);
 	
 	//Draw each element in the step.
-	for(currentDirective in commandsInStep)
+	for(index = [visibleIndexes firstIndex]; index != NSNotFound; index = [visibleIndexes indexGreaterThanIndex:index])
 	{
+		currentDirective = [commandsInStep objectAtIndex:index];
 		[currentDirective draw:optionsMask viewScale:scaleFactor parentColor:parentColor];
 	}
 
@@ -375,11 +389,16 @@
 - (void) drawSelf:(id<LDrawRenderer>)renderer
 {
 	NSArray         *commandsInStep     = [self subdirectives];
+	NSIndexSet      *visibleIndexes     = [self visibleSubdirectiveIndexes];
 	LDrawDirective  *currentDirective   = nil;
+	NSUInteger      index               = 0;
+	
+	COUNT_TRAVERSAL([visibleIndexes count], [commandsInStep count]);
 	
 	//Draw each element in the step.
-	for(currentDirective in commandsInStep)
+	for(index = [visibleIndexes firstIndex]; index != NSNotFound; index = [visibleIndexes indexGreaterThanIndex:index])
 	{
+		currentDirective = [commandsInStep objectAtIndex:index];
 		[currentDirective drawSelf:renderer];
 	}
 }//end drawSelf:
@@ -398,11 +417,16 @@
 - (void) collectSelf:(id<LDrawCollector>)renderer
 {
 	NSArray         *commandsInStep     = [self subdirectives];
+	NSIndexSet      *visibleIndexes     = [self visibleSubdirectiveIndexes];
 	LDrawDirective  *currentDirective   = nil;
+	NSUInteger      index               = 0;
+	
+	COUNT_TRAVERSAL([visibleIndexes count], [commandsInStep count]);
 	
 	//Draw each element in the step.
-	for(currentDirective in commandsInStep)
+	for(index = [visibleIndexes firstIndex]; index != NSNotFound; index = [visibleIndexes indexGreaterThanIndex:index])
 	{
+		currentDirective = [commandsInStep objectAtIndex:index];
 		[currentDirective collectSelf:renderer];
 	}
 	[self revalCache:DisplayList];
@@ -439,17 +463,19 @@
 	   viewScale:(float)scaleFactor
 	  boundsOnly:(BOOL)boundsOnly
 	creditObject:(id)creditObject
-			hits:(NSMutableDictionary *)hits
+			hits:(LDrawHitList *)hits
 {
 	NSArray     *commandsInStep     = [self subdirectives];
-	NSUInteger  commandCount        = [commandsInStep count];
+	NSIndexSet  *visibleIndexes     = [self visibleSubdirectiveIndexes];
 	LDrawStep   *currentDirective   = nil;
-	NSUInteger  counter             = 0;
+	NSUInteger  index               = 0;
 	
-	// Draw all the steps in the model
-	for(counter = 0; counter < commandCount; counter++)
+	COUNT_TRAVERSAL([visibleIndexes count], [commandsInStep count]);
+	
+	// Test everything which is drawn
+	for(index = [visibleIndexes firstIndex]; index != NSNotFound; index = [visibleIndexes indexGreaterThanIndex:index])
 	{
-		currentDirective = [commandsInStep objectAtIndex:counter];
+		currentDirective = [commandsInStep objectAtIndex:index];
 		[currentDirective hitTest:pickRay transform:transform viewScale:scaleFactor boundsOnly:boundsOnly creditObject:creditObject hits:hits];
 	}
 }
@@ -475,14 +501,16 @@
 	}
 	
 	NSArray     *commandsInStep     = [self subdirectives];
-	NSUInteger  commandCount        = [commandsInStep count];
+	NSIndexSet  *visibleIndexes     = [self visibleSubdirectiveIndexes];
 	LDrawStep   *currentDirective   = nil;
-	NSUInteger  counter             = 0;
+	NSUInteger  index               = 0;
 
-	// Draw all the steps in the model
-	for(counter = 0; counter < commandCount; counter++)
+	COUNT_TRAVERSAL([visibleIndexes count], [commandsInStep count]);
+	
+	// Test everything which is drawn
+	for(index = [visibleIndexes firstIndex]; index != NSNotFound; index = [visibleIndexes indexGreaterThanIndex:index])
 	{
-		currentDirective = [commandsInStep objectAtIndex:counter];
+		currentDirective = [commandsInStep objectAtIndex:index];
 		if([currentDirective boxTest:bounds transform:transform boundsOnly:boundsOnly creditObject:creditObject hits:hits])
 			if(creditObject != nil)
 				return TRUE;
@@ -509,14 +537,16 @@
 		return;
 
 	NSArray     *commandsInStep     = [self subdirectives];
-	NSUInteger  commandCount        = [commandsInStep count];
+	NSIndexSet  *visibleIndexes     = [self visibleSubdirectiveIndexes];
 	LDrawStep   *currentDirective   = nil;
-	NSUInteger  counter             = 0;
+	NSUInteger  index               = 0;
 
-	// Draw all the steps in the model
-	for(counter = 0; counter < commandCount; counter++)
+	COUNT_TRAVERSAL([visibleIndexes count], [commandsInStep count]);
+	
+	// Test everything which is drawn
+	for(index = [visibleIndexes firstIndex]; index != NSNotFound; index = [visibleIndexes indexGreaterThanIndex:index])
 	{
-		currentDirective = [commandsInStep objectAtIndex:counter];
+		currentDirective = [commandsInStep objectAtIndex:index];
 		[currentDirective depthTest:pt inBox:bounds transform:transform creditObject:creditObject bestObject:bestObject bestDepth:bestDepth];
 	}
 }//end depthTest:inBox:transform:creditObject:bestObject:bestDepth:
@@ -699,12 +729,76 @@
 #pragma mark -
 
 //========== boundingBox3 ======================================================
+//
+// Purpose:		Returns the box enclosing everything in the step.
+//
+// Notes:		The bounds are kept incrementally. Children which were added or 
+//				whose bounds changed are unioned into the existing box; only a 
+//				child which pulled back from an edge of the box (or was removed 
+//				from one) forces every child to be measured again. 
+//
+//				Invisible children have no bounds, and aren't asked for them.
+//
 //==============================================================================
 - (Box3) boundingBox3
 {
 	if ([self revalCache:CacheFlagBounds] == CacheFlagBounds)
 	{
-		cachedBounds = [LDrawUtilities boundingBox3ForDirectives:[self subdirectives]];
+		NSArray         *subdirectives  = [self subdirectives];
+		NSIndexSet      *visibleIndexes = [self visibleSubdirectiveIndexes];
+		NSUInteger      index           = 0;
+		Box3            oldBounds       = InvalidBox;
+		Box3            newBounds       = InvalidBox;
+		
+		if(self->childBoundsValid)
+		{
+			for(LDrawDirective *child in self->boundsChangedChildren)
+			{
+				index = [subdirectives indexOfObjectIdenticalTo:child];
+				if(index != NSNotFound)
+				{
+					oldBounds   = self->childBounds[index];
+					newBounds   = [child boundingBox3];
+					
+					if(BoundsMayHaveShrunk(oldBounds, newBounds, self->cachedBounds))
+					{
+						self->childBoundsValid = NO;
+						break;
+					}
+					
+					self->childBounds[index]    = newBounds;
+					self->cachedBounds          = V3UnionBox(self->cachedBounds, newBounds);
+				}
+			}
+		}
+		
+		if(self->childBoundsValid == NO)
+		{
+			self->childBounds   = realloc(self->childBounds, MAX(1, [subdirectives count]) * sizeof(Box3));
+			self->cachedBounds  = InvalidBox;
+			
+			for(index = 0; index < [subdirectives count]; index++)
+			{
+				self->childBounds[index] = InvalidBox;
+			}
+			COUNT_TRAVERSAL([visibleIndexes count], [subdirectives count]);
+			for(index = [visibleIndexes firstIndex]; index != NSNotFound; index = [visibleIndexes indexGreaterThanIndex:index])
+			{
+				self->childBounds[index]    = [[subdirectives objectAtIndex:index] boundingBox3];
+				self->cachedBounds          = V3UnionBox(self->cachedBounds, self->childBounds[index]);
+			}
+			
+			if(self->boundsChangedChildren == nil)
+				self->boundsChangedChildren = [[NSMutableSet alloc] init];
+			
+			self->childBoundsValid = YES;
+		}
+		
+		[self->boundsChangedChildren removeAllObjects];
+		
+	#if DEBUG_INCREMENTAL_BOUNDS
+		assert(V3EqualBoxes(self->cachedBounds, [LDrawUtilities boundingBox3ForDirectives:subdirectives]));
+	#endif
 	}
 	return cachedBounds;
 	
@@ -842,6 +936,7 @@
 - (void) setRotationAngle:(Tuple3)newAngle
 {
 	self->rotationAngle = newAngle;
+	[self invalCache:CacheFlagText];
 	
 }//end setRotationAngle:
 
@@ -916,6 +1011,7 @@
 - (void) setStepRotationType:(LDrawStepRotationT)newValue
 {
 	self->stepRotationType = newValue;
+	[self invalCache:CacheFlagText];
 	
 }//end setStepRotationType:
 
@@ -929,6 +1025,19 @@
 //==============================================================================
 - (void) insertDirective:(LDrawDirective *)directive atIndex:(NSInteger)index
 {
+	// The new directive can only grow the bounds; fold it in next time they 
+	// are asked for. 
+	if(self->childBoundsValid)
+	{
+		NSUInteger  count   = [[self subdirectives] count];
+		
+		self->childBounds = realloc(self->childBounds, (count + 1) * sizeof(Box3));
+		memmove(self->childBounds + index + 1, self->childBounds + index, (count - index) * sizeof(Box3));
+		self->childBounds[index] = InvalidBox;
+		
+		[self->boundsChangedChildren addObject:directive];
+	}
+	
 	[self invalCache:CacheFlagBounds|DisplayList];
 	[super insertDirective:directive atIndex:index];
 	
@@ -946,6 +1055,23 @@
 {
 	[self invalCache:CacheFlagBounds|DisplayList];
 	LDrawDirective *directive = [[[self subdirectives] objectAtIndex:index] retain];
+	
+	// Removing something on the edge of the bounds can shrink them, and only a 
+	// full recompute can say by how much. 
+	if(self->childBoundsValid)
+	{
+		NSUInteger  count   = [[self subdirectives] count];
+		
+		if(BoundsMayHaveShrunk(self->childBounds[index], InvalidBox, self->cachedBounds))
+		{
+			self->childBoundsValid = NO;
+		}
+		else
+		{
+			memmove(self->childBounds + index, self->childBounds + index + 1, (count - index - 1) * sizeof(Box3));
+		}
+		[self->boundsChangedChildren removeObject:directive];
+	}
 
 	[super removeDirectiveAtIndex:index];
 	
@@ -1134,6 +1260,64 @@
 }//end registerUndoActions:
 
 
+#pragma mark -
+#pragma mark OBSERVER
+#pragma mark -
+
+//========== directiveDidChangeVisibility: =====================================
+//
+// Purpose:		A child which was passed over while measuring bounds must be 
+//				measured now, and one which is now hidden must come out. 
+//
+//==============================================================================
+- (void) directiveDidChangeVisibility:(LDrawDirective *)directive
+{
+	if(self->childBoundsValid)
+	{
+		[self->boundsChangedChildren addObject:directive];
+	}
+	[super directiveDidChangeVisibility:directive];
+	
+}//end directiveDidChangeVisibility:
+
+
+//========== statusInvalidated:who: ============================================
+//
+// Purpose:		Remembers which children changed bounds, so only they need be 
+//				measured again. 
+//
+//==============================================================================
+- (void) statusInvalidated:(CacheFlagsT)flags who:(id<LDrawObservable>)observable
+{
+	if((flags & CacheFlagBounds) && self->childBoundsValid)
+	{
+		[self->boundsChangedChildren addObject:observable];
+	}
+	[super statusInvalidated:flags who:observable];
+	
+}//end statusInvalidated:who:
+
+
+//---------- BoundsMayHaveShrunk -------------------------------------[static]--
+//
+// Purpose:		Returns YES if a child going from oldChildBounds to 
+//				newChildBounds could leave bounds (the union of all the 
+//				children) too big: that is, if the child used to reach one of 
+//				its faces and no longer does. 
+//
+//------------------------------------------------------------------------------
+static BOOL BoundsMayHaveShrunk(Box3 oldChildBounds, Box3 newChildBounds, Box3 bounds)
+{
+	return (	(oldChildBounds.min.x <= bounds.min.x && newChildBounds.min.x > bounds.min.x)
+			||	(oldChildBounds.min.y <= bounds.min.y && newChildBounds.min.y > bounds.min.y)
+			||	(oldChildBounds.min.z <= bounds.min.z && newChildBounds.min.z > bounds.min.z)
+			||	(oldChildBounds.max.x >= bounds.max.x && newChildBounds.max.x < bounds.max.x)
+			||	(oldChildBounds.max.y >= bounds.max.y && newChildBounds.max.y < bounds.max.y)
+			||	(oldChildBounds.max.z >= bounds.max.z && newChildBounds.max.z < bounds.max.z) );
+	
+}//end BoundsMayHaveShrunk
+
+
 #pragma mark -
 #pragma mark DESTRUCTOR
 #pragma mark -
@@ -1145,6 +1329,9 @@
 //==============================================================================
 - (void) dealloc
 {
+	free(childBounds);
+	[boundsChangedChildren release];
+	
 	[super dealloc];
 	
 }//end dealloc
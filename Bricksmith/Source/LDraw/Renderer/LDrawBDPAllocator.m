@@ -7,6 +7,7 @@
 //
 
 #import "LDrawBDPAllocator.h"
+#import "LDrawMemory.h"
 
 /* 
 	BDP implementation: the pool consists of one or more large "pages" of memory, consisting of
@@ -61,6 +62,7 @@ struct	LDrawBDP {
 static struct	BDPPage *	get_new_page()
 {	
 	struct	BDPPage * ptr = (struct	BDPPage *) malloc(sizeof(struct	BDPPage));
+	MEMORY_ALLOC(LDrawMemoryBDP, sizeof(struct BDPPage));
 	ptr->header.cur = ptr->data;
 	ptr->header.end = ptr->data + BDP_PAYLOAD_SIZE;
 	return ptr;
@@ -96,6 +98,8 @@ void					LDrawBDPDestroy(struct LDrawBDP * pool)
 	{
 		struct BDPPage * k = pool->first;
 		pool->first = pool->first->header.next;
+		// Oversized pages end where their one allocation does; standard pages are all the same size.
+		MEMORY_FREE(LDrawMemoryBDP, k->header.end - (char *) k);
 		free(k);
 	}
 	free(pool);
@@ -127,6 +131,7 @@ void *					LDrawBDPAllocate(struct LDrawBDP * pool, size_t sz)
 		// and pop it on the head of the list - the tail stays open - maybe
 		// it still has space.
 		char * raw_buf = (char *) malloc(sizeof(struct BDPPageHeader) + sz);
+		MEMORY_ALLOC(LDrawMemoryBDP, sizeof(struct BDPPageHeader) + sz);
 		struct BDPPageHeader * h = (struct BDPPageHeader *) raw_buf;
 		h->next = pool->first;
 		h->cur = h->end = raw_buf + sizeof(struct BDPPageHeader) + sz;
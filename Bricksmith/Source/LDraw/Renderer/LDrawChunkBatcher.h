@@ -0,0 +1,54 @@
+//==============================================================================
+//
+// File:		LDrawChunkBatcher.h
+//
+// Purpose:		Spatial batching of small, static parts into merged meshes.
+//
+//				Instancing only pays off for parts repeated many times, so a
+//				model built from many different small parts still costs one
+//				draw per part. The chunk batcher divides the model into a grid
+//				of cells and bakes every small library part in a cell into a
+//				single display list, in model coordinates, which is then drawn
+//				in one go.
+//
+//				Only parts which aren't changing are baked. Any change to a
+//				part in a cell (moving, recoloring, selecting, deleting) throws
+//				out that cell's mesh; its parts are drawn one by one again
+//				until things have been quiet for a moment, at which point the
+//				cell is rebaked on a background thread.
+//
+//				A model owns one batcher and brackets the drawing of its steps
+//				with -beginPass and -endPassWithRenderer:.
+//
+//==============================================================================
+#import <Foundation/Foundation.h>
+
+#import "LDrawRenderer.h"
+
+@class LDrawStep;
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// class LDrawChunkBatcher
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface LDrawChunkBatcher : NSObject
+{
+	NSMapTable			*partEntries;			// LDrawPart -> LDrawChunkEntry
+	NSMutableDictionary	*chunks;				// cell key -> LDrawChunk
+	NSMutableArray		*passChunks;			// chunks holding parts deferred during this pass
+	NSMapTable			*texturedModels;		// library LDrawModel -> NSNumber (BOOL)
+	NSUInteger			passNumber;
+
+	NSUInteger			partsDrawnIndividually;	// statistics for the current pass
+	NSUInteger			partsDrawnInChunks;
+	NSUInteger			chunksDrawn;
+}
+
+// Drawing
+- (void) beginPass;
+- (void) drawStep:(LDrawStep *)step renderer:(id<LDrawRenderer>)renderer;
+- (void) endPassWithRenderer:(id<LDrawRenderer>)renderer;
+
+@end
@@ -0,0 +1,767 @@
+//==============================================================================
+//
+// File:		LDrawChunkBatcher.m
+//
+// Purpose:		Spatial batching of small, static parts into merged meshes. See
+//				LDrawChunkBatcher.h.
+//
+// Notes:		Each pass, every part the model draws is checked against the
+//				state recorded for it: transform, color and the library model it
+//				draws. Anything different (or any part which has disappeared)
+//				marks its cell changed, which invalidates the cell's mesh at
+//				once.
+//
+//				Because a change to one part can be discovered after other parts
+//				of the same cell were already skipped, skipped parts are only
+//				deferred. At the end of the pass each cell either draws its mesh
+//				or, if it was invalidated along the way, draws its deferred
+//				parts individually.
+//
+//				Baking flattens each part's library model into world-space
+//				primitives with the streaming flatten, then smooths the merged
+//				mesh, all off the main thread. Only the final upload happens
+//				while drawing, at the start of a pass. A bake is thrown away if
+//				the cell changed again while it was in progress.
+//
+//				Parts drawing in the current color keep meta-colors in the
+//				merged mesh, so chunks still follow the color of whatever draws
+//				the model.
+//
+//==============================================================================
+#import "LDrawChunkBatcher.h"
+
+#import "ColorLibrary.h"
+#import "LDrawColor.h"
+#import "LDrawDisplayList.h"
+#import "LDrawModel.h"
+#import "LDrawPart.h"
+#import "LDrawPrimitiveSink.h"
+#import "LDrawStep.h"
+#import "LDrawTexture.h"
+#import "MatrixMath.h"
+
+// Edge length of a grid cell, in LDraw units. Parts larger than this are never
+// baked; they are worth a draw call of their own.
+#define CHUNK_CELL_SIZE			160.0
+
+// A cell with fewer parts than this isn't worth a mesh of its own.
+#define CHUNK_MINIMUM_PARTS		4
+
+// Seconds a cell must go unchanged before it is rebaked. Keeps cells from being
+// rebuilt over and over while the user is working in them.
+#define CHUNK_SETTLE_TIME		0.5
+
+// Print draw counts at the end of every pass.
+#define CHUNK_STATS				0
+
+
+// What a baked part looked like. Compared byte-for-byte, so always zero it
+// before filling it in.
+typedef struct LDrawChunkPartState
+{
+	Matrix4		transformation;
+	LDrawColor	*color;
+	LDrawColorT	colorCode;
+	LDrawModel	*model;
+
+} LDrawChunkPartState;
+
+
+//------------------------------------------------------------------------------
+//
+// LDrawChunk
+//
+// One cell of the grid.
+//
+//------------------------------------------------------------------------------
+@interface LDrawChunk : NSObject
+{
+@public
+	NSHashTable				*members;				// LDrawParts in this cell (not retained)
+	NSMutableArray			*deferredParts;			// members skipped during this pass
+	Box3					bounds;					// of the parts baked into the mesh
+	LDrawDLHandle			dl;
+	NSUInteger				changeCount;			// bumped whenever a member changes
+	NSUInteger				bakedChangeCount;		// changeCount that dl reflects
+	NSTimeInterval			lastChange;
+	BOOL					isBaking;
+	struct LDrawDLPrepared	*pendingMesh;			// finished bake, waiting for upload
+	NSUInteger				pendingChangeCount;
+}
+- (BOOL) hasValidMesh;
+- (void) noteChange;
+@end
+
+
+//------------------------------------------------------------------------------
+//
+// LDrawChunkEntry
+//
+// What the batcher knows about one part.
+//
+//------------------------------------------------------------------------------
+@interface LDrawChunkEntry : NSObject
+{
+@public
+	LDrawChunkPartState		state;
+	LDrawChunk				*chunk;					// not retained; the batcher owns chunks
+	NSUInteger				lastPass;				// last pass in which the part was drawn
+}
+@end
+
+
+@interface LDrawChunkBatcher (Private)
+
+- (BOOL) deferPart:(LDrawPart *)part;
+- (BOOL) getState:(LDrawChunkPartState *)state ofPart:(LDrawPart *)part;
+- (LDrawChunk *) chunkForBounds:(Box3)bounds;
+- (void) removePart:(LDrawPart *)part;
+- (void) bakeChunk:(LDrawChunk *)chunk;
+- (BOOL) modelIsTextured:(LDrawModel *)model;
+
+@end
+
+static BOOL ContainerHasTexture(LDrawContainer *container);
+static void AddPrimitiveToBuilder(const LDrawPrimitive *primitive, void *context);
+
+
+@implementation LDrawChunkBatcher
+
+//========== init ==============================================================
+//
+// Purpose:		Start out with an empty grid.
+//
+//==============================================================================
+- (id) init
+{
+	self = [super init];
+	if(self)
+	{
+		partEntries     = [[NSMapTable alloc] initWithKeyOptions:(NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality)
+												valueOptions:NSPointerFunctionsStrongMemory
+													capacity:0];
+		texturedModels  = [[NSMapTable alloc] initWithKeyOptions:(NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality)
+												valueOptions:NSPointerFunctionsStrongMemory
+													capacity:0];
+		chunks          = [[NSMutableDictionary alloc] init];
+		passChunks      = [[NSMutableArray alloc] init];
+	}
+	return self;
+
+}//end init
+
+
+#pragma mark -
+#pragma mark DRAWING
+#pragma mark -
+
+//========== beginPass =========================================================
+//
+// Purpose:		Called before the model draws its steps. Uploads any meshes
+//				finished in the background since the last pass.
+//
+// Notes:		Uploads can only happen here: a mesh installed partway through a
+//				pass would be drawn on top of parts already drawn individually.
+//
+//==============================================================================
+- (void) beginPass
+{
+	LDrawChunk  *chunk  = nil;
+
+	self->passNumber++;
+	self->partsDrawnIndividually    = 0;
+	self->partsDrawnInChunks        = 0;
+	self->chunksDrawn               = 0;
+
+	for(chunk in [self->chunks objectEnumerator])
+	{
+		if(chunk->pendingMesh != NULL)
+		{
+			if(chunk->pendingChangeCount == chunk->changeCount)
+			{
+				if(chunk->dl)
+					LDrawDLDestroy(chunk->dl);
+				chunk->dl               = LDrawDLPreparedFinish(chunk->pendingMesh);
+				chunk->bakedChangeCount = chunk->pendingChangeCount;
+			}
+			else
+				LDrawDLPreparedDestroy(chunk->pendingMesh);
+
+			chunk->pendingMesh = NULL;
+		}
+	}
+
+}//end beginPass
+
+
+//========== drawStep:renderer: ================================================
+//
+// Purpose:		Draws the step, leaving out parts which are baked into a valid
+//				chunk.
+//
+// Notes:		This takes the place of -[LDrawStep drawSelf:] while batching.
+//
+//==============================================================================
+- (void) drawStep:(LDrawStep *)step renderer:(id<LDrawRenderer>)renderer
+{
+	NSArray         *commandsInStep     = [step subdirectives];
+	NSIndexSet      *visibleIndexes     = [step visibleSubdirectiveIndexes];
+	LDrawDirective  *currentDirective   = nil;
+	NSUInteger      index               = 0;
+
+	COUNT_TRAVERSAL([visibleIndexes count], [commandsInStep count]);
+	
+	// Hidden parts are left out of the pass, which takes them out of their 
+	// chunks just as deleting them would.
+	for(index = [visibleIndexes firstIndex]; index != NSNotFound; index = [visibleIndexes indexGreaterThanIndex:index])
+	{
+		currentDirective = [commandsInStep objectAtIndex:index];
+		if(		[currentDirective isKindOfClass:[LDrawPart class]] == NO
+		   ||	[self deferPart:(LDrawPart *)currentDirective] == NO )
+		{
+			[currentDirective drawSelf:renderer];
+			self->partsDrawnIndividually++;
+		}
+	}
+
+}//end drawStep:renderer:
+
+
+//========== endPassWithRenderer: ==============================================
+//
+// Purpose:		Called after the model has drawn its steps. Draws the chunk
+//				meshes, and starts rebaking cells which have settled down.
+//
+//==============================================================================
+- (void) endPassWithRenderer:(id<LDrawRenderer>)renderer
+{
+	NSMutableArray  *removedParts   = [NSMutableArray array];
+	NSMutableArray  *emptyKeys      = [NSMutableArray array];
+	NSTimeInterval  now             = [NSDate timeIntervalSinceReferenceDate];
+	LDrawChunkEntry *entry          = nil;
+	LDrawChunk      *chunk          = nil;
+	LDrawPart       *part           = nil;
+	id              key             = nil;
+	GLfloat         minXYZ[3]       = {};
+	GLfloat         maxXYZ[3]       = {};
+
+	// Parts not drawn this pass were deleted or hidden by step display. Their
+	// cells no longer match their meshes.
+	for(part in self->partEntries)
+	{
+		entry = NSMapGet(self->partEntries, part);
+		if(entry->lastPass != self->passNumber)
+			[removedParts addObject:part];
+	}
+	for(part in removedParts)
+	{
+		[self removePart:part];
+	}
+
+	// Draw each chunk, or what it was supposed to cover if it fell out of date
+	// during the pass.
+	for(chunk in self->passChunks)
+	{
+		if([chunk hasValidMesh])
+		{
+			minXYZ[0] = chunk->bounds.min.x; minXYZ[1] = chunk->bounds.min.y; minXYZ[2] = chunk->bounds.min.z;
+			maxXYZ[0] = chunk->bounds.max.x; maxXYZ[1] = chunk->bounds.max.y; maxXYZ[2] = chunk->bounds.max.z;
+
+			if([renderer checkCull:minXYZ to:maxXYZ] != cull_skip)
+			{
+				[renderer drawDL:chunk->dl];
+				self->chunksDrawn++;
+			}
+			self->partsDrawnInChunks += [chunk->deferredParts count];
+		}
+		else
+		{
+			for(part in chunk->deferredParts)
+			{
+				[part drawSelf:renderer];
+			}
+			self->partsDrawnIndividually += [chunk->deferredParts count];
+		}
+		[chunk->deferredParts removeAllObjects];
+	}
+	[self->passChunks removeAllObjects];
+
+	// Rebake what has settled; drop what is empty.
+	for(key in self->chunks)
+	{
+		chunk = [self->chunks objectForKey:key];
+
+		if([chunk->members count] == 0)
+		{
+			if(chunk->isBaking == NO)
+				[emptyKeys addObject:key];
+		}
+		else if(	[chunk hasValidMesh] == NO
+				&&	chunk->isBaking == NO
+				&&	chunk->pendingMesh == NULL
+				&&	[chunk->members count] >= CHUNK_MINIMUM_PARTS
+				&&	now - chunk->lastChange >= CHUNK_SETTLE_TIME )
+		{
+			[self bakeChunk:chunk];
+		}
+	}
+	[self->chunks removeObjectsForKeys:emptyKeys];
+
+#if CHUNK_STATS
+	printf("Chunk batching: %lu parts in %lu chunk draws; %lu draws for everything else.\n",
+		   (unsigned long)self->partsDrawnInChunks,
+		   (unsigned long)self->chunksDrawn,
+		   (unsigned long)self->partsDrawnIndividually);
+#endif
+
+}//end endPassWithRenderer:
+
+
+#pragma mark -
+#pragma mark UTILITIES
+#pragma mark -
+
+//========== deferPart: ========================================================
+//
+// Purpose:		Brings the records for part up to date. Returns YES if the part
+//				is covered by a chunk mesh and must not be drawn on its own.
+//
+//==============================================================================
+- (BOOL) deferPart:(LDrawPart *)part
+{
+	LDrawChunkEntry     *entry      = NSMapGet(self->partEntries, part);
+	LDrawChunkPartState state;
+	LDrawChunk          *newChunk   = nil;
+	BOOL                deferred    = NO;
+
+	if([self getState:&state ofPart:part] == NO)
+	{
+		// Can't be batched (anymore).
+		if(entry != nil)
+			[self removePart:part];
+		return NO;
+	}
+
+	if(entry == nil)
+	{
+		entry = [[LDrawChunkEntry alloc] init];
+		entry->state    = state;
+		entry->chunk    = [self chunkForBounds:[part boundingBox3]];
+
+		NSHashInsert(entry->chunk->members, part);
+		[entry->chunk noteChange];
+
+		NSMapInsert(self->partEntries, part, entry);
+		[entry release];
+	}
+	else if(memcmp(&entry->state, &state, sizeof(LDrawChunkPartState)) != 0)
+	{
+		newChunk = [self chunkForBounds:[part boundingBox3]];
+
+		[entry->chunk noteChange];
+		if(newChunk != entry->chunk)
+		{
+			NSHashRemove(entry->chunk->members, part);
+			NSHashInsert(newChunk->members, part);
+			[newChunk noteChange];
+
+			entry->chunk = newChunk;
+		}
+		entry->state = state;
+	}
+
+	entry->lastPass = self->passNumber;
+
+	if([entry->chunk hasValidMesh])
+	{
+		if([entry->chunk->deferredParts count] == 0)
+			[self->passChunks addObject:entry->chunk];
+		[entry->chunk->deferredParts addObject:part];
+
+		deferred = YES;
+	}
+
+	return deferred;
+
+}//end deferPart:
+
+
+//========== getState:ofPart: ==================================================
+//
+// Purpose:		Fills in the state of part which its baked mesh depends on.
+//				Returns NO if the part can't be batched.
+//
+// Notes:		Batchable parts are visible, unselected, opaque, untextured
+//				library parts no bigger than a cell. Submodel references are
+//				left alone; they can change out from under us.
+//
+//==============================================================================
+- (BOOL) getState:(LDrawChunkPartState *)state ofPart:(LDrawPart *)part
+{
+	LDrawModel  *model      = nil;
+	LDrawColor  *color      = nil;
+	Box3        bounds      = InvalidBox;
+	GLfloat     rgba[4]     = {};
+
+	if([part isHidden] || [part isSelected])
+		return NO;
+
+	model = [part resolvedLibraryModel];
+	if(model == nil || [self modelIsTextured:model])
+		return NO;
+
+	color = [part LDrawColor];
+	[color getColorRGBA:rgba];
+	if(rgba[3] < 1.0 && [color colorCode] != LDrawCurrentColor && [color colorCode] != LDrawEdgeColor)
+		return NO;
+
+	bounds = [part boundingBox3];
+	if(		V3EqualBoxes(bounds, InvalidBox)
+	   ||	bounds.max.x - bounds.min.x > CHUNK_CELL_SIZE
+	   ||	bounds.max.y - bounds.min.y > CHUNK_CELL_SIZE
+	   ||	bounds.max.z - bounds.min.z > CHUNK_CELL_SIZE )
+	{
+		return NO;
+	}
+
+	memset(state, 0, sizeof(LDrawChunkPartState));
+	state->transformation   = [part transformationMatrix];
+	state->color            = color;
+	state->colorCode        = [color colorCode];
+	state->model            = model;
+
+	return YES;
+
+}//end getState:ofPart:
+
+
+//========== chunkForBounds: ===================================================
+//
+// Purpose:		Returns the chunk for the cell containing the center of bounds,
+//				creating it if need be.
+//
+//==============================================================================
+- (LDrawChunk *) chunkForBounds:(Box3)bounds
+{
+	Point3              center      = V3CenterOfBox(bounds);
+	unsigned long long  cellX       = (unsigned long long)(long long)floor(center.x / CHUNK_CELL_SIZE) & 0x1FFFFF;
+	unsigned long long  cellY       = (unsigned long long)(long long)floor(center.y / CHUNK_CELL_SIZE) & 0x1FFFFF;
+	unsigned long long  cellZ       = (unsigned long long)(long long)floor(center.z / CHUNK_CELL_SIZE) & 0x1FFFFF;
+	NSNumber            *key        = [NSNumber numberWithUnsignedLongLong:((cellX << 42) | (cellY << 21) | cellZ)];
+	LDrawChunk          *chunk      = [self->chunks objectForKey:key];
+
+	if(chunk == nil)
+	{
+		chunk = [[LDrawChunk alloc] init];
+		[self->chunks setObject:chunk forKey:key];
+		[chunk release];
+	}
+
+	return chunk;
+
+}//end chunkForBounds:
+
+
+//========== removePart: =======================================================
+//
+// Purpose:		Forgets part, invalidating the cell it was in.
+//
+//==============================================================================
+- (void) removePart:(LDrawPart *)part
+{
+	LDrawChunkEntry *entry  = NSMapGet(self->partEntries, part);
+
+	if(entry != nil)
+	{
+		NSHashRemove(entry->chunk->members, part);
+		[entry->chunk noteChange];
+
+		NSMapRemove(self->partEntries, part);
+	}
+
+}//end removePart:
+
+
+//========== bakeChunk: ========================================================
+//
+// Purpose:		Builds the merged mesh for chunk in the background.
+//
+// Notes:		Everything the bake needs is copied out of the parts here, so
+//				the background thread never looks at a part which might be
+//				edited meanwhile. It only reads library models, which don't
+//				change once loaded.
+//
+//==============================================================================
+- (void) bakeChunk:(LDrawChunk *)chunk
+{
+	NSMutableArray  *models         = [NSMutableArray array];
+	NSMutableArray  *colors         = [NSMutableArray array];
+	NSUInteger      partCount       = [chunk->members count];
+	Matrix4         *transforms     = malloc(sizeof(Matrix4) * partCount);
+	NSUInteger      bakeChangeCount = chunk->changeCount;
+	LDrawChunkEntry *entry          = nil;
+	LDrawPart       *part           = nil;
+	Box3            bounds          = InvalidBox;
+	NSUInteger      counter         = 0;
+
+	for(part in chunk->members)
+	{
+		entry = NSMapGet(self->partEntries, part);
+
+		[models addObject:entry->state.model];
+		[colors addObject:entry->state.color];
+		transforms[counter] = entry->state.transformation;
+		bounds              = V3UnionBox(bounds, [part boundingBox3]);
+
+		// Compliments are created on first use; don't let that happen on
+		// another thread.
+		[entry->state.color complimentColor];
+
+		counter++;
+	}
+
+	chunk->bounds   = bounds;
+	chunk->isBaking = YES;
+
+	dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0),
+	^{
+		struct LDrawDLBuilder   *builder    = LDrawDLBuilderCreate();
+		struct LDrawDLPrepared  *mesh       = NULL;
+		LDrawPrimitiveSink      sink        = LDrawPrimitiveSinkMake(AddPrimitiveToBuilder, builder);
+		NSUInteger              index       = 0;
+
+		for(index = 0; index < partCount; index++)
+		{
+			[[models objectAtIndex:index] flattenIntoSink:&sink
+											  currentColor:[colors objectAtIndex:index]
+										  currentTransform:transforms[index]];
+		}
+		free(transforms);
+
+		mesh = LDrawDLBuilderPrepare(builder);
+
+		dispatch_async(dispatch_get_main_queue(),
+		^{
+			chunk->isBaking = NO;
+
+			if(mesh != NULL && bakeChangeCount == chunk->changeCount)
+			{
+				chunk->pendingMesh          = mesh;
+				chunk->pendingChangeCount   = bakeChangeCount;
+			}
+			else if(mesh != NULL)
+				LDrawDLPreparedDestroy(mesh);
+		});
+	});
+
+}//end bakeChunk:
+
+
+//========== modelIsTextured: ==================================================
+//
+// Purpose:		Returns YES if the library model contains texture directives,
+//				which the streaming flatten can't carry.
+//
+//==============================================================================
+- (BOOL) modelIsTextured:(LDrawModel *)model
+{
+	NSNumber    *isTextured = NSMapGet(self->texturedModels, model);
+
+	if(isTextured == nil)
+	{
+		isTextured = [NSNumber numberWithBool:ContainerHasTexture(model)];
+		NSMapInsert(self->texturedModels, model, isTextured);
+	}
+
+	return [isTextured boolValue];
+
+}//end modelIsTextured:
+
+
+#pragma mark -
+#pragma mark DESTRUCTOR
+#pragma mark -
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Grid demolished.
+//
+//==============================================================================
+- (void) dealloc
+{
+	[partEntries	release];
+	[chunks			release];
+	[passChunks		release];
+	[texturedModels	release];
+
+	[super dealloc];
+
+}//end dealloc
+
+
+@end
+
+
+#pragma mark -
+
+@implementation LDrawChunk
+
+//========== init ==============================================================
+//
+// Purpose:		An empty cell.
+//
+//==============================================================================
+- (id) init
+{
+	self = [super init];
+	if(self)
+	{
+		members         = [[NSHashTable alloc] initWithOptions:(NSPointerFunctionsOpaqueMemory | NSPointerFunctionsObjectPointerPersonality)
+												  capacity:0];
+		deferredParts   = [[NSMutableArray alloc] init];
+		bounds          = InvalidBox;
+	}
+	return self;
+
+}//end init
+
+
+//========== hasValidMesh ======================================================
+//
+// Purpose:		Returns YES if the mesh matches the parts in the cell.
+//
+//==============================================================================
+- (BOOL) hasValidMesh
+{
+	return (self->dl != NULL && self->bakedChangeCount == self->changeCount);
+
+}//end hasValidMesh
+
+
+//========== noteChange ========================================================
+//
+// Purpose:		Invalidates the mesh and restarts the settling clock.
+//
+//==============================================================================
+- (void) noteChange
+{
+	self->changeCount   += 1;
+	self->lastChange    = [NSDate timeIntervalSinceReferenceDate];
+
+}//end noteChange
+
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Cell emptied.
+//
+//==============================================================================
+- (void) dealloc
+{
+	if(dl)
+		LDrawDLDestroy(dl);
+	if(pendingMesh)
+		LDrawDLPreparedDestroy(pendingMesh);
+
+	[members		release];
+	[deferredParts	release];
+
+	[super dealloc];
+
+}//end dealloc
+
+@end
+
+
+@implementation LDrawChunkEntry
+@end
+
+
+#pragma mark -
+
+//---------- ContainerHasTexture -------------------------------------[static]--
+//
+// Purpose:		Searches container and everything in it for texture directives.
+//
+//------------------------------------------------------------------------------
+static BOOL ContainerHasTexture(LDrawContainer *container)
+{
+	id  currentDirective    = nil;
+
+	for(currentDirective in [container subdirectives])
+	{
+		if([currentDirective isKindOfClass:[LDrawTexture class]])
+			return YES;
+
+		if(		[currentDirective isKindOfClass:[LDrawContainer class]]
+		   &&	ContainerHasTexture(currentDirective) )
+		{
+			return YES;
+		}
+	}
+
+	return NO;
+
+}//end ContainerHasTexture
+
+
+//---------- AddPrimitiveToBuilder -----------------------------------[static]--
+//
+// Purpose:		Primitive sink function which adds flattened primitives to a
+//				display list builder.
+//
+// Notes:		The primitives are already in model coordinates, so the normal
+//				is worked out from them directly, the same way the primitives
+//				themselves do it. Current and edge colors become the renderer's
+//				meta-colors.
+//
+//------------------------------------------------------------------------------
+static void AddPrimitiveToBuilder(const LDrawPrimitive *primitive, void *context)
+{
+	struct LDrawDLBuilder   *builder    = context;
+	const Point3            *vertexes   = primitive->vertexes;
+	GLfloat                 v[12]       = {};
+	GLfloat                 n[3]        = { 0, -1, 0 };
+	GLfloat                 c[4]        = {};
+	Vector3                 normal      = ZeroPoint3;
+	int                     counter     = 0;
+
+	for(counter = 0; counter < primitive->type; counter++)
+	{
+		v[counter * 3 + 0] = vertexes[counter].x;
+		v[counter * 3 + 1] = vertexes[counter].y;
+		v[counter * 3 + 2] = vertexes[counter].z;
+	}
+
+	// Meta-colors: alpha 0, with red choosing current (0) or compliment (1).
+	if(primitive->colorCode == LDrawCurrentColor)
+	{
+		c[0] = 0; c[1] = 0; c[2] = 0; c[3] = 0;
+	}
+	else if(primitive->colorCode == LDrawEdgeColor)
+	{
+		c[0] = 1; c[1] = 1; c[2] = 1; c[3] = 0;
+	}
+	else
+		memcpy(c, primitive->rgba, sizeof(c));
+
+	switch(primitive->type)
+	{
+		case LDrawPrimitiveLine:
+			LDrawDLBuilderAddLine(builder, v, n, c);
+			break;
+
+		case LDrawPrimitiveTriangle:
+			normal  = V3Cross(V3Sub(vertexes[1], vertexes[0]), V3Sub(vertexes[2], vertexes[0]));
+			n[0]    = normal.x; n[1] = normal.y; n[2] = normal.z;
+			LDrawDLBuilderAddTri(builder, v, n, c);
+			break;
+
+		case LDrawPrimitiveQuadrilateral:
+			normal  = V3Cross(V3Sub(vertexes[1], vertexes[0]), V3Sub(vertexes[3], vertexes[0]));
+			n[0]    = normal.x; n[1] = normal.y; n[2] = normal.z;
+			LDrawDLBuilderAddQuad(builder, v, n, c);
+			break;
+	}
+
+}//end AddPrimitiveToBuilder
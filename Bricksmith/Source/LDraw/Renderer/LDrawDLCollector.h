@@ -0,0 +1,39 @@
+//==============================================================================
+//
+// File:		LDrawDLCollector.h
+//
+// Purpose:		A collector which builds a display list mesh without a renderer.
+//
+//				The renderer's own collector can only be used while drawing,
+//				with the GL context current. This one just accumulates into a
+//				builder, so a model's mesh can be collected and smoothed on any
+//				thread ahead of time; -prepare hands back the result for
+//				LDrawDLPreparedFinish to upload when the model is first drawn.
+//
+//				Texture tags are GL objects which may not exist yet, so a mesh
+//				which pushes a texture is not prepared at all. Such models are
+//				collected the usual way when they are drawn.
+//
+//==============================================================================
+#import <Foundation/Foundation.h>
+
+#import "LDrawRenderer.h"
+
+struct LDrawDLBuilder;
+struct LDrawDLPrepared;
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// class LDrawDLCollector
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface LDrawDLCollector : NSObject <LDrawCollector>
+{
+	struct LDrawDLBuilder	*builder;			// NULL once prepared
+	BOOL					sawTexture;
+}
+
+- (struct LDrawDLPrepared *) prepare;
+
+@end
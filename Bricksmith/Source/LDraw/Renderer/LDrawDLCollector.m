@@ -0,0 +1,187 @@
+//==============================================================================
+//
+// File:		LDrawDLCollector.m
+//
+// Purpose:		A collector which builds a display list mesh without a renderer.
+//				See LDrawDLCollector.h.
+//
+//==============================================================================
+#import "LDrawDLCollector.h"
+
+#import "LDrawDisplayList.h"
+
+static void SetColor4fv(GLfloat *color, GLfloat storage[4]);
+
+
+@implementation LDrawDLCollector
+
+//========== init ==============================================================
+//
+// Purpose:		Starts an empty mesh.
+//
+//==============================================================================
+- (id) init
+{
+	self = [super init];
+	if(self)
+	{
+		builder = LDrawDLBuilderCreate();
+	}
+	return self;
+
+}//end init
+
+
+#pragma mark -
+#pragma mark COLLECTING
+#pragma mark -
+
+//========== pushTexture: ======================================================
+//
+// Purpose:		The mesh is textured, so we won't prepare it. See the header.
+//
+//==============================================================================
+- (void) pushTexture:(struct LDrawTextureSpec *)tex_spec
+{
+	self->sawTexture = YES;
+
+}//end pushTexture:
+
+
+//========== popTexture ========================================================
+//
+// Purpose:		Ends a textured run; nothing to do.
+//
+//==============================================================================
+- (void) popTexture
+{
+}//end popTexture
+
+
+//========== drawQuad:normal:color: ============================================
+//
+// Purpose:		Adds one quad to the mesh.
+//
+//==============================================================================
+- (void) drawQuad:(GLfloat *)vertices normal:(GLfloat *)normal color:(GLfloat *)color
+{
+	GLfloat c[4];
+
+	SetColor4fv(color, c);
+	LDrawDLBuilderAddQuad(self->builder, vertices, normal, c);
+
+}//end drawQuad:normal:color:
+
+
+//========== drawTri:normal:color: =============================================
+//
+// Purpose:		Adds one triangle to the mesh.
+//
+//==============================================================================
+- (void) drawTri:(GLfloat *)vertices normal:(GLfloat *)normal color:(GLfloat *)color
+{
+	GLfloat c[4];
+
+	SetColor4fv(color, c);
+	LDrawDLBuilderAddTri(self->builder, vertices, normal, c);
+
+}//end drawTri:normal:color:
+
+
+//========== drawLine:normal:color: ============================================
+//
+// Purpose:		Adds one line to the mesh.
+//
+//==============================================================================
+- (void) drawLine:(GLfloat *)vertices normal:(GLfloat *)normal color:(GLfloat *)color
+{
+	GLfloat c[4];
+
+	SetColor4fv(color, c);
+	LDrawDLBuilderAddLine(self->builder, vertices, normal, c);
+
+}//end drawLine:normal:color:
+
+
+#pragma mark -
+#pragma mark PREPARING
+#pragma mark -
+
+//========== prepare ===========================================================
+//
+// Purpose:		Smooths and packs the collected mesh. Returns NULL if the mesh
+//				was empty or textured.
+//
+// Notes:		The collector is spent afterwards; collecting into it again is
+//				an error.
+//
+//==============================================================================
+- (struct LDrawDLPrepared *) prepare
+{
+	struct LDrawDLPrepared  *prepared   = NULL;
+
+	assert(self->builder != NULL);
+
+	if(self->sawTexture == YES)
+		LDrawDLBuilderDestroy(self->builder);
+	else
+		prepared = LDrawDLBuilderPrepare(self->builder);
+
+	self->builder = NULL;
+
+	return prepared;
+
+}//end prepare
+
+
+#pragma mark -
+#pragma mark DESTRUCTOR
+#pragma mark -
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Throws out a mesh nobody asked for.
+//
+//==============================================================================
+- (void) dealloc
+{
+	if(self->builder != NULL)
+		LDrawDLBuilderDestroy(self->builder);
+
+	[super dealloc];
+
+}//end dealloc
+
+
+@end
+
+
+//---------- SetColor4fv ---------------------------------------------[static]--
+//
+// Purpose:		Copies an RGBA color, turning the current and compliment color
+//				pointers into the meta-colors the shader expects, exactly as
+//				the renderer does.
+//
+//------------------------------------------------------------------------------
+static void SetColor4fv(GLfloat *color, GLfloat storage[4])
+{
+	if(color == LDrawRenderCurrentColor)
+	{
+		storage[0] = 0;
+		storage[1] = 0;
+		storage[2] = 0;
+		storage[3] = 0;
+	}
+	else if(color == LDrawRenderComplimentColor)
+	{
+		storage[0] = 1;
+		storage[1] = 1;
+		storage[2] = 1;
+		storage[3] = 0;
+	}
+	else
+	{
+		memcpy(storage, color, sizeof(GLfloat) * 4);
+	}
+
+}//end SetColor4fv
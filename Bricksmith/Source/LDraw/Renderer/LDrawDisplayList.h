@@ -8,6 +8,8 @@
 
 #import <Cocoa/Cocoa.h>
 
+#import "LDrawRenderer.h"
+
 /*
 
 	LDrawDisplayList - THEORY OF OPERATION
@@ -31,6 +33,14 @@
 	Besides attempting to use hw instancing, the session will also draw translucent DLs last in 
 	back-to-front order to improve transparency performance.
 
+	SCENES
+	
+	A scene records the draws one traversal of the model makes - DL, colors, texture and transform -
+	without drawing them.  None of that depends on the camera, so several viewports onto the same
+	model can share one scene; each replays it into its own session, doing only its own culling,
+	sorting and submission.  A scene refers to DLs but does not own them, so it must be thrown out
+	before the DLs it mentions change.
+
 	FEATURES
 	
 	The DL API will draw translucent geomtry back-to-front ordered (the DLs are reordered, not the
@@ -41,20 +51,62 @@
 	attribute-instancing for small count or hardware instancing with attrib-array-divisor for large
 	numbers of bricks.	
 
- */
+	Selection is instance data too: a selected draw carries a flag, so selecting bricks doesn't
+	take them out of their instancing batches.  The shader drops the faces of selected copies and
+	a second, wire-frame pass draws them again as lines - one more draw per instanced brick
+	that has any copy selected.  Copies drawn one at a time are simply drawn as a wire frame.
 
-// Forwrd declared from basic renderer API.
-struct LDrawTextureSpec;
+ */
 
 // Opaque structures we use as "handles".
 struct	LDrawDL;
 struct	LDrawDLBuilder;
+struct	LDrawDLPrepared;
+struct	LDrawDLScene;
 struct	LDrawDLSession;
 
 // Display list creation API.
 struct LDrawDLBuilder *		LDrawDLBuilderCreate();
 struct LDrawDL *			LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx);
+void						LDrawDLBuilderDestroy(struct LDrawDLBuilder * ctx);
+
+#if DEBUG_DL_MEMORY_BALANCE
+// Round-trips a small DL through every create/destroy path and returns true if 
+// the tagged memory counts (see LDrawMemory.h) come back to where they were.
+int							LDrawDLCheckMemoryBalance(void);
+#endif
 void						LDrawDLDestroy(struct LDrawDL * dl);
+void						LDrawDLGetBounds(struct LDrawDL * dl, GLfloat minXYZ[3], GLfloat maxXYZ[3]);
+size_t						LDrawDLGetByteSize(struct LDrawDL * dl);
+
+// Two-stage DL creation.  Prepare does all of the CPU work (including smoothing)
+// and may be called on any thread; Finish uploads the result and must be called
+// where the GL context is current.  LDrawDLBuilderFinish is simply both at once.
+struct LDrawDLPrepared *	LDrawDLBuilderPrepare(struct LDrawDLBuilder * ctx);
+struct LDrawDL *			LDrawDLPreparedFinish(struct LDrawDLPrepared * prep);
+void						LDrawDLPreparedDestroy(struct LDrawDLPrepared * prep);
+size_t						LDrawDLPreparedGetByteSize(struct LDrawDLPrepared * prep);
+
+// Reading back a prepared DL, for exporting the smoothed mesh.  Each vertex is LDrawDLVertexStride
+// floats: XYZ, normal, RGBA, where alpha = 0 marks a meta color as in the shader.  For each
+// texture the DL has runs of triangle and quad corners; the runs index into the index table, whose
+// entries index the vertexes.  If the index table comes back NULL, the runs index the vertexes
+// directly.
+#define LDrawDLVertexStride			10
+void						LDrawDLPreparedGetMesh(
+									struct LDrawDLPrepared *		prep,
+									int *							out_vertex_count,
+									const GLfloat **				out_vertexes,
+									int *							out_index_count,
+									const GLuint **					out_indexes);
+int							LDrawDLPreparedGetTexCount(struct LDrawDLPrepared * prep);
+void						LDrawDLPreparedGetTexFaces(
+									struct LDrawDLPrepared *		prep,
+									int								tex_index,
+									int *							out_tri_start,
+									int *							out_tri_count,
+									int *							out_quad_start,
+									int *							out_quad_count);
 
 // Display list mesh accumulation APIs.
 void						LDrawDLBuilderSetTex(struct LDrawDLBuilder * ctx, struct LDrawTextureSpec * spec);
@@ -72,5 +124,44 @@ void						LDrawDLDraw(
 									const GLfloat 					cur_color[4],
 									const GLfloat 					cmp_color[4],
 									const GLfloat					transform[16],
+									int								selected,
+									int								draw_now);
+
+#if DEBUG_DL_SELECTION_BATCHING
+// Draws one DL into a throw-away session with none, some and all copies selected,
+// and returns true if the batch count comes out the same every time.
+int							LDrawDLCheckSelectionBatching(void);
+#endif
+
+// Scene recording APIs.  A recorded draw holds exactly what LDrawDLDraw was asked for.
+struct LDrawDLSceneDraw {
+	struct LDrawDL *				dl;
+	struct LDrawTextureSpec			spec;
+	GLfloat							color[4];
+	GLfloat							comp[4];
+	GLfloat							transform[16];
+	int								selected;
+	int								draw_now;
+};
+
+struct LDrawDLSceneHandle {
+	GLfloat							xyz[3];			// In model coordinates.
+	GLfloat							size;
+};
+
+struct LDrawDLScene *		LDrawDLSceneCreate();
+void						LDrawDLSceneDestroy(struct LDrawDLScene * scene);
+void						LDrawDLSceneAddDraw(
+									struct LDrawDLScene *			scene,
+									struct LDrawDL *				dl,
+									struct LDrawTextureSpec *		spec,
+									const GLfloat					cur_color[4],
+									const GLfloat					cmp_color[4],
+									const GLfloat					transform[16],
+									int								selected,
 									int								draw_now);
-									
+void						LDrawDLSceneAddDragHandle(struct LDrawDLScene * scene, const GLfloat xyz[3], GLfloat size);
+int							LDrawDLSceneGetDraws(struct LDrawDLScene * scene, const struct LDrawDLSceneDraw ** out_draws);
+int							LDrawDLSceneGetDragHandles(struct LDrawDLScene * scene, const struct LDrawDLSceneHandle ** out_handles);
+int							LDrawDLSceneIsCurrent(struct LDrawDLScene * scene);
+int							LDrawDLSceneIsEqual(struct LDrawDLScene * a, struct LDrawDLScene * b);
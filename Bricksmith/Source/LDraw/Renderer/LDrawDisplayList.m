@@ -9,9 +9,12 @@
 #import "LDrawDisplayList.h"
 #import "LDrawRenderer.h"
 #import "LDrawBDPAllocator.h"
+#import "LDrawMemory.h"
 #import "LDrawShaderRenderer.h"
+#import "LDrawTrace.h"
 #import "MeshSmooth.h"
 #import "GLMatrixMath.h"
+#import <float.h>
 #import OPEN_GL_HEADER
 #import OPEN_GL_EXT_HEADER
 
@@ -38,7 +41,8 @@ static const GLuint * idx_null = NULL;
 	because we draw the same bricks over and over and over again.
 	
 	When we instance, we identify the 'per instance' data - that is, data that is different for every instance.  In the case of
-	BrickSmith, the current/compliment color and transform are per instance data; the mesh and non-meta colors of the mesh are invariant.
+	BrickSmith, the current/compliment color, transform and selection are per instance data; the mesh and non-meta colors of the mesh
+	are invariant.
 	
 	(As an example, when drawing the plate with red wheels, the red color of the wheels and the shape of the part are invariant;
 	the current color used for the plate and the location of the whole part are per-instance data.)
@@ -72,6 +76,7 @@ static const GLuint * idx_null = NULL;
 #define WANT_STATS 0
 
 #define VERT_STRIDE 10								// Stride of our vertices - we always write X Y Z	NX NY NZ		R G B A
+#define INST_STRIDE 26								// Stride of our instances - current RGBA, compliment RGBA, 4x4 transform, selected, unselected
 #define INST_CUTOFF 5								// Minimum instances to use hw case, which has higher overhead to set up.  
 #define INST_MAX_COUNT (1024 * 128)					// Maximum instances to write per draw before going to immediate mode - avoids unbounded VRAM use.
 #define INST_RING_BUFFER_COUNT 4					// Number of VBOs to rotate for hw instancing - doesn't actually help, it turns out.
@@ -117,6 +122,7 @@ static void copy_vec3(GLfloat d[3], const GLfloat s[3]) { d[0] = s[0]; d[1] = s[
 static void copy_vec4(GLfloat d[4], const GLfloat s[4]) { d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = s[3]; }
 
 static GLuint inst_vbo_ring[INST_RING_BUFFER_COUNT] = { 0 };
+static unsigned int dl_destroy_generation = 0;		// Bumped by every LDrawDLDestroy; scenes compare against it.
 static int inst_ring_last = 0;
 
 
@@ -142,6 +148,7 @@ struct LDrawDLInstance {
 	GLfloat					color[4];
 	GLfloat					comp[4];
 	GLfloat					transform[16];
+	GLfloat					selected;
 };
 
 // A single DL.  A few notes on book-keeping:
@@ -160,6 +167,11 @@ struct LDrawDL {
 	GLuint					idx_vbo;				// Single VBO containing all mesh indices.
 #endif
 	int						tex_count;				// Number of per-textures; untex case is always first if present.
+	GLfloat					bounds[6];				// Min and max XYZ of the mesh, for culling draws replayed from a scene.
+	GLsizeiptr				geo_bytes;				// Sizes of the VBOs, for memory accounting.
+#if WANT_SMOOTH
+	GLsizeiptr				idx_bytes;
+#endif
 	#if WANT_STATS
 	int						vrt_count;
 #if WANT_SMOOTH
@@ -170,6 +182,21 @@ struct LDrawDL {
 
 };
 
+// A DL that has been fully built and smoothed in system memory, but not yet
+// uploaded to VBOs.  This is the hand-off between LDrawDLBuilderPrepare, which
+// may run on any thread, and LDrawDLPreparedFinish, which must talk to the GL.
+struct LDrawDLPrepared {
+	int						flags;					// See flags defs above.
+	int						tex_count;
+	int						vertex_count;
+	GLfloat *				vertexes;				// VERT_STRIDE floats per vertex.
+#if WANT_SMOOTH
+	int						index_count;
+	GLuint *				indexes;
+#endif
+	struct LDrawDLPerTex	texes[0];				// Variable size array of textures, as in the DL.
+};
+
 //==========  SESSION DATA STRUCTURES ========================================
 
 // We write all instancing info into a single huge VBO.  This avoids the need
@@ -185,6 +212,7 @@ struct LDrawDLSegment {
 	struct LDrawDLPerTex *	dl;					// Ptr to the per-tex info for that brick - only untexed bricks get instanced, so we only have one "per tex", by definition.
 	float *					inst_base;			// VBO-relative ptr to the instance data base in the instance VBO.
 	int						inst_count;			// Number of instances startingat that offset.
+	int						selected_count;		// How many of those are selected, and so need the wire-frame pass.
 };
 	
 
@@ -201,6 +229,7 @@ struct LDrawDLSortedInstanceLink {
 	GLfloat									color[4];
 	GLfloat									comp[4];
 	GLfloat									transform[16];
+	GLfloat									selected;
 };
 
 
@@ -228,12 +257,29 @@ struct LDrawDLSession {
 	
 	struct LDrawDLSortedInstanceLink *	sorted_head;			// Linked list + count for DLs being drawn later to Z sort.
 	int									sort_count;
+	#if DEBUG_DL_SELECTION_BATCHING
+	int									imm_count;				// Number of DLs that had to be drawn right away.
+	#endif
 
 	GLfloat								model_view[16];			// Model-view matrix, used to Z sort translucent objects.
 	GLuint								inst_ring;				// If using more than one instancing buffer, this tells which one we use.
 };
 
 
+// A recorded scene.  Draws and drag handles are kept in growable arrays, in
+// the order they were made, so that replay submits them just as the original
+// traversal would have.
+struct LDrawDLScene {
+	struct LDrawDLSceneDraw *			draws;
+	int									draw_count;
+	int									draw_capacity;
+	struct LDrawDLSceneHandle *			handles;
+	int									handle_count;
+	int									handle_capacity;
+	unsigned int						destroy_generation;		// dl_destroy_generation as of the last recorded draw.
+};
+
+
 
 //========== Dastructures for BUILDING a VBO ==============================
 
@@ -303,6 +349,19 @@ struct LDrawDLBuilder * LDrawDLBuilderCreate()
 }//end LDrawDLBuilderCreate
 
 
+//========== LDrawDLBuilderDestroy ===============================================
+//
+// Purpose:	Throw out a builder without making anything from it.
+//
+//================================================================================
+void LDrawDLBuilderDestroy(struct LDrawDLBuilder * ctx)
+{
+	// The builder itself lives in its own pool.
+	LDrawBDPDestroy(ctx->alloc);
+
+}//end LDrawDLBuilderDestroy
+
+
 //========== LDrawDLBuilderSetTex ================================================
 //
 // Purpose:	Change the current texture we are adding geometry to in a builder.
@@ -467,12 +526,16 @@ void LDrawDLBuilderAddQuad(struct LDrawDLBuilder * ctx, const GLfloat v[12], GLf
 //
 // Purpose:	Add one line to the current DL builder in the current texture.
 //
+// Notes:	The normal passed in is ignored; line vertices are stored with a 
+//			zero normal, which is how the shader tells lines from faces.
+//
 //================================================================================
 void LDrawDLBuilderAddLine(struct LDrawDLBuilder * ctx, const GLfloat v[6], GLfloat n[3], GLfloat c[4])
 {
 		 if(c[3] == 0.0f)	ctx->flags |= dl_has_meta;
 	else if(c[3] != 1.0f)	ctx->flags |= dl_has_alpha;
 
+	static const GLfloat zero[3] = { 0.0f, 0.0f, 0.0f };
 	int i;
 	struct LDrawDLBuilderVertexLink * nl = (struct LDrawDLBuilderVertexLink *) LDrawBDPAllocate(ctx->alloc, sizeof(struct LDrawDLBuilderVertexLink) + sizeof(GLfloat) * VERT_STRIDE * 2);
 	nl->next = NULL;
@@ -480,7 +543,7 @@ void LDrawDLBuilderAddLine(struct LDrawDLBuilder * ctx, const GLfloat v[6], GLfl
 	for(i = 0; i < 2; ++i)
 	{
 		copy_vec3(nl->data+VERT_STRIDE*i  ,v+i*3);
-		copy_vec3(nl->data+VERT_STRIDE*i+3,n    );
+		copy_vec3(nl->data+VERT_STRIDE*i+3,zero );
 		copy_vec4(nl->data+VERT_STRIDE*i+6,c    );
 	}
 	
@@ -497,18 +560,21 @@ void LDrawDLBuilderAddLine(struct LDrawDLBuilder * ctx, const GLfloat v[6], GLfl
 }//end LDrawDLBuilderAddLine
 
 
-//========== LDrawDLBuilderFinish ================================================
+//========== LDrawDLBuilderPrepareInternal =======================================
 //
 // Purpose:	Take all of the accumulated data in a DL and bake it down to one
-//			final form.
+//			final form, in system memory.
 //
 // Notes:	The DL is, while being built, a series of linked lists in a BDP for
-//			speed.  The finished DL is a malloc'd block of memory, pre-sized to
-//			fit the DL perfectly, and one VBO.  So this routine does the counting,
-//			final allocations, and copying.
+//			speed.  The prepared DL is a malloc'd block of memory, pre-sized to
+//			fit the mesh perfectly.  So this routine does the counting, 
+//			smoothing, final allocations, and copying.
+//
+//			No GL calls are made here, so this (the expensive half of making a 
+//			DL) can run on any thread.  LDrawDLPreparedFinish does the upload.
 //
 //================================================================================
-struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
+static struct LDrawDLPrepared * LDrawDLBuilderPrepareInternal(struct LDrawDLBuilder * ctx)
 {
 #if WANT_SMOOTH
 	#if TIME_SMOOTHING
@@ -553,19 +619,13 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 		return NULL;
 	}
 	
-	// Malloc DL structure with extra storage for variable-sized tex array.
-	struct LDrawDL * dl = (struct LDrawDL *) malloc(sizeof(struct LDrawDL) + sizeof(struct LDrawDLPerTex) * total_texes);
-	
-	// All per-session linked list ptrs start null.
-	dl->next_dl = NULL;
-	dl->instance_head = NULL;
-	dl->instance_tail = NULL;
-	dl->instance_count = 0;
+	// Malloc prepared structure with extra storage for variable-sized tex array.
+	struct LDrawDLPrepared * prep = (struct LDrawDLPrepared *) malloc(sizeof(struct LDrawDLPrepared) + sizeof(struct LDrawDLPerTex) * total_texes);
 	
-	dl->tex_count = total_texes;
+	prep->tex_count = total_texes;
 
-	struct LDrawDLPerTex * cur_tex = dl->texes;	
-	dl->flags = ctx->flags;
+	struct LDrawDLPerTex * cur_tex = prep->texes;	
+	prep->flags = ctx->flags;
 
 	total_tris /= 3;
 	total_quads /= 4;
@@ -590,7 +650,7 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 		if(s->tri_head == NULL && s->line_head == NULL && s->quad_head == NULL)
 			continue;
 		if(s->spec.tex_obj != 0)
-			dl->flags |= dl_has_tex;
+			prep->flags |= dl_has_tex;
 
 		for(l = s->tri_head; l; l = l->next)
 		{
@@ -615,7 +675,7 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 		if(s->tri_head == NULL && s->line_head == NULL && s->quad_head == NULL)
 			continue;
 		if(s->spec.tex_obj != 0)
-			dl->flags |= dl_has_tex;
+			prep->flags |= dl_has_tex;
 
 		for(l = s->line_head; l; l = l->next)
 		{
@@ -636,16 +696,10 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 	int total_vertices, total_indices;
 	get_final_mesh_counts(M,&total_vertices,&total_indices);
 
-	glGenBuffers(1,&dl->geo_vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, dl->geo_vbo);
-	glGenBuffers(1,&dl->idx_vbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, dl->idx_vbo);
-
-	glBufferData(GL_ARRAY_BUFFER, total_vertices * sizeof(GLfloat) * VERT_STRIDE, NULL, GL_STATIC_DRAW);
-	volatile GLfloat * vertex_ptr = (volatile GLfloat *) glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, total_indices * sizeof(GLuint), NULL, GL_STATIC_DRAW);
-	volatile GLuint * index_ptr = (volatile GLuint *) glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY);
+	prep->vertex_count = total_vertices;
+	prep->vertexes = (GLfloat *) malloc(total_vertices * sizeof(GLfloat) * VERT_STRIDE);
+	prep->index_count = total_indices;
+	prep->indexes = (GLuint *) malloc(total_indices * sizeof(GLuint));
 	
 	// Grab variable size arrays for the start/offsets of each sub-part of our big pile-o-mesh...
 	// the mesher will give us back our tris sorted by texture.
@@ -660,9 +714,9 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 	write_indexed_mesh(
 		M,
 		total_vertices,
-		vertex_ptr,
+		prep->vertexes,
 		total_indices,
-		index_ptr,
+		prep->indexes,
 		0,
 		line_start,
 		line_count,
@@ -675,6 +729,9 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 	
 	for(s = ctx->head; s; s = s->next)
 	{
+		if(s->tri_head == NULL && s->line_head == NULL && s->quad_head == NULL)
+			continue;
+
 		memcpy(&cur_tex->spec, &s->spec, sizeof(struct LDrawTextureSpec));
 		
 		cur_tex->quad_off = quad_start[ti];
@@ -690,29 +747,15 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 
 	destroy_mesh(M);
 
-	#if WANT_STATS
-	dl->vrt_count = total_vertices;
-	dl->idx_count = total_indices;
-	#endif	
-	
-	glUnmapBuffer(GL_ARRAY_BUFFER);
-	glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
-	glBindBuffer(GL_ARRAY_BUFFER,0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
-
 	// Release the BDP that contains all of the build-related junk.
 	LDrawBDPDestroy(ctx->alloc);
 
 	#if TIME_SMOOTHING
 	NSTimeInterval endTime = [NSDate timeIntervalSinceReferenceDate];			
-	#if WANT_STATS
-	printf("Optimize took %f seconds for %d indices, %d vertices.\n",  endTime - startTime, dl->idx_count, dl->vrt_count);
-	#else
-	printf("Optimize took %f seconds.\n",  endTime - startTime);
-	#endif
+	printf("Optimize took %f seconds for %d indices, %d vertices.\n",  endTime - startTime, total_indices, total_vertices);
 	#endif
 	
-	return dl;
+	return prep;
 #else
 	int total_texes = 0;
 	int total_vertices = 0;
@@ -743,29 +786,17 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 		return NULL;
 	}
 	
-	// Malloc DL structure with extra storage for variable-sized tex array.
-	struct LDrawDL * dl = (struct LDrawDL *) malloc(sizeof(struct LDrawDL) + sizeof(struct LDrawDLPerTex) * total_texes);
-	
-	// All per-session linked list ptrs start null.
-	dl->next_dl = NULL;
-	dl->instance_head = NULL;
-	dl->instance_tail = NULL;
-	dl->instance_count = 0;
-	
-	dl->tex_count = total_texes;
+	// Malloc prepared structure with extra storage for variable-sized tex array.
+	struct LDrawDLPrepared * prep = (struct LDrawDLPrepared *) malloc(sizeof(struct LDrawDLPrepared) + sizeof(struct LDrawDLPerTex) * total_texes);
 	
-	#if WANT_STATS
-	dl->vrt_count = total_vertices;
-	#endif	
+	prep->tex_count = total_texes;
+	prep->vertex_count = total_vertices;
+	prep->vertexes = (GLfloat *) malloc(total_vertices * sizeof(GLfloat) * VERT_STRIDE);
 	
-	// Generate and map a VBO for our mesh data.
-	glGenBuffers(1,&dl->geo_vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, dl->geo_vbo);
-	glBufferData(GL_ARRAY_BUFFER, total_vertices * sizeof(GLfloat) * VERT_STRIDE, NULL, GL_STATIC_DRAW);
-	GLfloat * buf_ptr = (GLfloat *) glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+	GLfloat * buf_ptr = prep->vertexes;
 	int cur_v = 0;
-	struct LDrawDLPerTex * cur_tex = dl->texes;	
-	dl->flags = ctx->flags;
+	struct LDrawDLPerTex * cur_tex = prep->texes;	
+	prep->flags = ctx->flags;
 	
 	// Now: walk our building textures - for each non-empty one, we will copy it into
 	// the tex array and push its vertices.
@@ -774,13 +805,13 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 		if(s->tri_head == NULL && s->line_head == NULL && s->quad_head == NULL)
 			continue;
 		if(s->spec.tex_obj != 0)
-			dl->flags |= dl_has_tex;
+			prep->flags |= dl_has_tex;
 		memcpy(&cur_tex->spec, &s->spec, sizeof(struct LDrawTextureSpec));
 		cur_tex->line_off = cur_v;
 		cur_tex->line_count = 0;
 
 		// These loops copy the actual geometry (in linked lists of data) into the
-		// VBO that is mapped.
+		// vertex array.
 
 		for(l = s->line_head; l; l = l->next)
 		{
@@ -815,18 +846,219 @@ struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
 		++cur_tex;
 	}
 	
-	glUnmapBuffer(GL_ARRAY_BUFFER);
-	glBindBuffer(GL_ARRAY_BUFFER,0);
-
 	// Release the BDP that contains all of the build-related junk.
 	LDrawBDPDestroy(ctx->alloc);
 	
-	return dl;
+	return prep;
 
 #endif	
+}//end LDrawDLBuilderPrepareInternal
+
+
+//========== prepared_byte_size ==================================================
+//
+// Purpose:	Return the system memory held by a prepared DL.
+//
+//================================================================================
+static size_t prepared_byte_size(struct LDrawDLPrepared * prep)
+{
+	size_t bytes = sizeof(struct LDrawDLPrepared) + sizeof(struct LDrawDLPerTex) * prep->tex_count;
+	bytes += prep->vertex_count * sizeof(GLfloat) * VERT_STRIDE;
+	#if WANT_SMOOTH
+	bytes += prep->index_count * sizeof(GLuint);
+	#endif
+	return bytes;
+
+}//end prepared_byte_size
+
+
+//========== LDrawDLBuilderPrepare ===============================================
+//
+// Purpose:	Bake a DL down to system memory; see LDrawDLBuilderPrepareInternal.
+//			This wrapper only adds the trace span and memory accounting, as the
+//			real thing has too many ways out to bracket directly.
+//
+//================================================================================
+struct LDrawDLPrepared * LDrawDLBuilderPrepare(struct LDrawDLBuilder * ctx)
+{
+	TRACE_BEGIN("smooth");
+	struct LDrawDLPrepared * prep = LDrawDLBuilderPrepareInternal(ctx);
+	if(prep)
+		MEMORY_ALLOC(LDrawMemoryPreparedDL, prepared_byte_size(prep));
+	TRACE_END("smooth");
+	return prep;
+
+}//end LDrawDLBuilderPrepare
+
+
+//========== LDrawDLPreparedFinish ===============================================
+//
+// Purpose:	Upload a prepared DL into VBOs, producing a drawable DL.  The
+//			prepared DL is consumed.
+//
+// Notes:	This must be called with the GL context current, i.e. on the 
+//			thread that draws.
+//
+//================================================================================
+struct LDrawDL * LDrawDLPreparedFinish(struct LDrawDLPrepared * prep)
+{
+	if(prep == NULL)
+		return NULL;
+
+	TRACE_BEGIN("upload DL");
+
+	// Malloc DL structure with extra storage for variable-sized tex array.
+	struct LDrawDL * dl = (struct LDrawDL *) malloc(sizeof(struct LDrawDL) + sizeof(struct LDrawDLPerTex) * prep->tex_count);
+	
+	// All per-session linked list ptrs start null.
+	dl->next_dl = NULL;
+	dl->instance_head = NULL;
+	dl->instance_tail = NULL;
+	dl->instance_count = 0;
+	
+	dl->flags = prep->flags;
+	dl->tex_count = prep->tex_count;
+	memcpy(dl->texes, prep->texes, sizeof(struct LDrawDLPerTex) * prep->tex_count);
+	
+	// Remember the extent of the mesh; scenes cull against it when replayed.
+	int v;
+	const GLfloat * xyz = prep->vertexes;
+	dl->bounds[0] = dl->bounds[1] = dl->bounds[2] =  FLT_MAX;
+	dl->bounds[3] = dl->bounds[4] = dl->bounds[5] = -FLT_MAX;
+	for(v = 0; v < prep->vertex_count; ++v, xyz += VERT_STRIDE)
+	{
+		dl->bounds[0] = MIN(dl->bounds[0], xyz[0]);
+		dl->bounds[1] = MIN(dl->bounds[1], xyz[1]);
+		dl->bounds[2] = MIN(dl->bounds[2], xyz[2]);
+		dl->bounds[3] = MAX(dl->bounds[3], xyz[0]);
+		dl->bounds[4] = MAX(dl->bounds[4], xyz[1]);
+		dl->bounds[5] = MAX(dl->bounds[5], xyz[2]);
+	}
+	
+	#if WANT_STATS
+	dl->vrt_count = prep->vertex_count;
+	#if WANT_SMOOTH
+	dl->idx_count = prep->index_count;
+	#endif
+	#endif
+
+	dl->geo_bytes = prep->vertex_count * sizeof(GLfloat) * VERT_STRIDE;
+	glGenBuffers(1,&dl->geo_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, dl->geo_vbo);
+	glBufferData(GL_ARRAY_BUFFER, dl->geo_bytes, prep->vertexes, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER,0);
+	MEMORY_ALLOC(LDrawMemoryDLVertexes, dl->geo_bytes);
+
+	#if WANT_SMOOTH
+	dl->idx_bytes = prep->index_count * sizeof(GLuint);
+	glGenBuffers(1,&dl->idx_vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, dl->idx_vbo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, dl->idx_bytes, prep->indexes, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+	MEMORY_ALLOC(LDrawMemoryDLIndexes, dl->idx_bytes);
+	#endif
+
+	LDrawDLPreparedDestroy(prep);
+
+	TRACE_END("upload DL");
+
+	return dl;
+
+}//end LDrawDLPreparedFinish
+
+
+//========== LDrawDLPreparedDestroy ==============================================
+//
+// Purpose:	Free a prepared DL that will never be uploaded.
+//
+//================================================================================
+void LDrawDLPreparedDestroy(struct LDrawDLPrepared * prep)
+{
+	MEMORY_FREE(LDrawMemoryPreparedDL, prepared_byte_size(prep));
+	free(prep->vertexes);
+	#if WANT_SMOOTH
+	free(prep->indexes);
+	#endif
+	free(prep);
+
+}//end LDrawDLPreparedDestroy
+
+
+//========== LDrawDLBuilderFinish ================================================
+//
+// Purpose:	Take all of the accumulated data in a DL and bake it down to one
+//			final form: a DL ready to draw.
+//
+//================================================================================
+struct LDrawDL * LDrawDLBuilderFinish(struct LDrawDLBuilder * ctx)
+{
+	return LDrawDLPreparedFinish(LDrawDLBuilderPrepare(ctx));
+
 }//end LDrawDLBuilderFinish
 
 
+#if DEBUG_DL_MEMORY_BALANCE
+//========== LDrawDLCheckMemoryBalance ===========================================
+//
+// Purpose:	Build, smooth, upload and throw away a small DL every way a client
+//			can, and return true if every byte counted in LDrawMemory.h along
+//			the way was given back.
+//
+// Notes:	The GL context must be current, and nothing else may be building
+//			DLs at the time, or the totals will move for other reasons.
+//
+//================================================================================
+int LDrawDLCheckMemoryBalance(void)
+{
+	static const GLfloat quad[12]	= { 0,0,0,  1,0,0,  1,1,0,  0,1,0 };
+	static const GLfloat tri[9]		= { 0,0,0,  0,1,0,  0,0,1 };
+	static const GLfloat line[6]	= { 0,0,0,  1,1,0 };
+	GLfloat normal[3]				= { 0,0,1 };
+	GLfloat color[4]				= { 1,0,0,1 };
+	struct LDrawDLBuilder *	bld		= NULL;
+	struct LDrawDLPrepared * prep	= NULL;
+	struct LDrawDL *		dl		= NULL;
+	int						pass	= 0;
+	LDrawMemorySnapshot		before;
+
+	LDrawMemoryTakeSnapshot(&before);
+
+	// 0: uploaded, then destroyed.  1: prepared but never uploaded.  2: discarded 
+	// unbuilt.  3: empty, so nothing comes of it.
+	for(pass = 0; pass < 4; ++pass)
+	{
+		bld = LDrawDLBuilderCreate();
+		if(pass != 3)
+		{
+			LDrawDLBuilderAddQuad(bld, quad, normal, color);
+			LDrawDLBuilderAddTri(bld, tri, normal, color);
+			LDrawDLBuilderAddLine(bld, line, normal, color);
+		}
+		switch(pass)
+		{
+			case 0:
+			case 3:
+				dl = LDrawDLBuilderFinish(bld);
+				if(dl)
+					LDrawDLDestroy(dl);
+				break;
+			case 1:
+				prep = LDrawDLBuilderPrepare(bld);
+				if(prep)
+					LDrawDLPreparedDestroy(prep);
+				break;
+			case 2:
+				LDrawDLBuilderDestroy(bld);
+				break;
+		}
+	}
+
+	return LDrawMemoryIsBalancedSince(&before);
+
+}//end LDrawDLCheckMemoryBalance
+#endif
+
+
 //========== setup_tex_spec ======================================================
 //
 // Purpose:	Set up the GL with texturing info.
@@ -867,6 +1099,26 @@ static void setup_tex_spec(struct LDrawTextureSpec * spec)
 //================================================================================
 struct LDrawDLSession * LDrawDLSessionCreate(const GLfloat model_view[16])
 {
+	#if DEBUG_DL_MEMORY_BALANCE
+	// The first session is the earliest we can be sure the GL context is current.
+	static int memory_checked = 0;
+	if(!memory_checked)
+	{
+		memory_checked = 1;
+		int balanced = LDrawDLCheckMemoryBalance();
+		assert(balanced);
+	}
+	#endif
+	#if DEBUG_DL_SELECTION_BATCHING
+	// The check makes sessions of its own; the flag keeps it from recursing.
+	static int batching_checked = 0;
+	if(!batching_checked)
+	{
+		batching_checked = 1;
+		int batched = LDrawDLCheckSelectionBatching();
+		assert(batched);
+	}
+	#endif
 	struct LDrawBDP * alloc = LDrawBDPCreate();
 	struct LDrawDLSession * session = (struct LDrawDLSession *) LDrawBDPAllocate(alloc,sizeof(struct LDrawDLSession));
 	session->alloc = alloc;
@@ -874,6 +1126,9 @@ struct LDrawDLSession * LDrawDLSessionCreate(const GLfloat model_view[16])
 	session->dl_count = 0;
 	session->sorted_head = NULL;
 	session->sort_count = 0;
+	#if DEBUG_DL_SELECTION_BATCHING
+	session->imm_count = 0;
+	#endif
 	#if WANT_STATS
 	memset(&session->stats,0,sizeof(session->stats));
 	#endif
@@ -899,6 +1154,40 @@ static int compare_sorted_link(const void * lhs, const void * rhs)
 }//end compare_sorted_link
 
 
+//========== bind_segment ========================================================
+//
+// Purpose:	Point the vertex attributes at a hardware-instanced segment: the
+//			brick's mesh, and its instances in the instance VBO.  The selected
+//			attribute reads the instance float at selected_offset - the
+//			"selected" flag for the fill pass, "unselected" for the wire-frame
+//			pass.
+//
+//================================================================================
+static void bind_segment(struct LDrawDLSegment * s, GLuint inst_vbo, int selected_offset)
+{
+	glBindBuffer(GL_ARRAY_BUFFER,s->geo_vbo);
+	#if WANT_SMOOTH
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,s->idx_vbo);
+	#endif
+	float * p = NULL;
+	glVertexAttribPointer(attr_position, 3, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p);
+	glVertexAttribPointer(attr_normal, 3, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p+3);
+	glVertexAttribPointer(attr_color, 4, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p+6);
+
+	glBindBuffer(GL_ARRAY_BUFFER,inst_vbo);
+
+	p = s->inst_base;
+	glVertexAttribPointer(attr_color_current, 4, GL_FLOAT, GL_FALSE, INST_STRIDE * sizeof(GLfloat), p  );
+	glVertexAttribPointer(attr_color_compliment, 4, GL_FLOAT, GL_FALSE, INST_STRIDE * sizeof(GLfloat), p+4);
+	glVertexAttribPointer(attr_transform_x, 4, GL_FLOAT, GL_FALSE, INST_STRIDE * sizeof(GLfloat), p+8);
+	glVertexAttribPointer(attr_transform_y, 4, GL_FLOAT, GL_FALSE, INST_STRIDE * sizeof(GLfloat), p+12);
+	glVertexAttribPointer(attr_transform_z, 4, GL_FLOAT, GL_FALSE, INST_STRIDE * sizeof(GLfloat), p+16);
+	glVertexAttribPointer(attr_transform_w, 4, GL_FLOAT, GL_FALSE, INST_STRIDE * sizeof(GLfloat), p+20);
+	glVertexAttribPointer(attr_selected, 1, GL_FLOAT, GL_FALSE, INST_STRIDE * sizeof(GLfloat), p+selected_offset);
+	
+}//end bind_segment
+
+
 //========== LDrawDLSessionDrawAndDestroy ========================================
 //
 // Purpose:	Draw any DLs that were deferred during drawing, then nuke the
@@ -920,12 +1209,15 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 
 		// If we do not yet have a VBO for instancing, build one now.
 		if(inst_vbo_ring[session->inst_ring] == 0)
+		{
 			glGenBuffers(1,&inst_vbo_ring[session->inst_ring]);
+			MEMORY_ALLOC(LDrawMemoryInstanceBuffers, INST_MAX_COUNT * sizeof(GLfloat)*INST_STRIDE);
+		}
 			
 			
 		// Map our instance buffer so we can write instancing data.
 		glBindBuffer(GL_ARRAY_BUFFER, inst_vbo_ring[session->inst_ring]);
-		glBufferData(GL_ARRAY_BUFFER,INST_MAX_COUNT * sizeof(GLfloat)*24, NULL, GL_DYNAMIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER,INST_MAX_COUNT * sizeof(GLfloat)*INST_STRIDE, NULL, GL_DYNAMIC_DRAW);
 		GLfloat * inst_base = (GLfloat *) glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
 		GLfloat * inst_data = inst_base;
 		int		  inst_remain = INST_MAX_COUNT;
@@ -947,6 +1239,7 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 				cur_segment->inst_base = NULL; 
 				cur_segment->inst_base += (inst_data - inst_base);
 				cur_segment->inst_count = dl->instance_count;
+				cur_segment->selected_count = 0;
 				
 				#if WANT_STATS
 					session->stats.num_btch_ins++;
@@ -977,7 +1270,10 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 					inst_data[21] = inst->transform[7];
 					inst_data[22] = inst->transform[11];
 					inst_data[23] = inst->transform[15];
-					inst_data += 24;
+					inst_data[24] = inst->selected;
+					inst_data[25] = 1.0f - inst->selected;
+					cur_segment->selected_count += (inst->selected != 0.0f);
+					inst_data += INST_STRIDE;
 					--inst_remain;
 				}
 				++cur_segment;
@@ -1010,6 +1306,11 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 						glVertexAttrib4f(attr_transform_x+i,inst->transform[i],inst->transform[4+i],inst->transform[8+i],inst->transform[12+i]);
 					glVertexAttrib4fv(attr_color_current, inst->color);
 					glVertexAttrib4fv(attr_color_compliment, inst->comp);
+					
+					// This copy is drawn on its own anyway, so a selected one 
+					// can simply be drawn as a wire frame.
+					if(inst->selected)
+						glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 			
 					struct LDrawDLPerTex * tptr = dl->texes;
 					
@@ -1028,6 +1329,9 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 					if(tptr->quad_count)
 						glDrawArrays(GL_QUADS,tptr->quad_off,tptr->quad_count);
 					#endif					
+					
+					if(inst->selected)
+						glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 				}
 			}
 			
@@ -1056,12 +1360,14 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 			glEnableVertexAttribArray(attr_transform_w);
 			glEnableVertexAttribArray(attr_color_current);
 			glEnableVertexAttribArray(attr_color_compliment);
+			glEnableVertexAttribArray(attr_selected);
 			glVertexAttribDivisorARB(attr_transform_x,1);
 			glVertexAttribDivisorARB(attr_transform_y,1);
 			glVertexAttribDivisorARB(attr_transform_z,1);
 			glVertexAttribDivisorARB(attr_transform_w,1);
 			glVertexAttribDivisorARB(attr_color_current,1);
 			glVertexAttribDivisorARB(attr_color_compliment,1);
+			glVertexAttribDivisorARB(attr_selected,1);
 
 			// Main loop 2 over DLs - for each DL that had hw-instances we built a segment
 			// in our array.  Bind the DL itself, as well as the instance pointers, and do an instanced-draw.
@@ -1069,25 +1375,7 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 			struct LDrawDLSegment * s;
 			for(s = segments; s < cur_segment; ++s)
 			{
-
-				glBindBuffer(GL_ARRAY_BUFFER,s->geo_vbo);
-				#if WANT_SMOOTH
-				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,s->idx_vbo);
-				#endif
-				float * p = NULL;
-				glVertexAttribPointer(attr_position, 3, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p);
-				glVertexAttribPointer(attr_normal, 3, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p+3);
-				glVertexAttribPointer(attr_color, 4, GL_FLOAT, GL_FALSE, VERT_STRIDE * sizeof(GLfloat), p+6);
-
-				glBindBuffer(GL_ARRAY_BUFFER,inst_vbo_ring[session->inst_ring]);
-
-				p = s->inst_base;
-				glVertexAttribPointer(attr_color_current, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p  );
-				glVertexAttribPointer(attr_color_compliment, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p+4);
-				glVertexAttribPointer(attr_transform_x, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p+8);
-				glVertexAttribPointer(attr_transform_y, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p+12);
-				glVertexAttribPointer(attr_transform_z, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p+16);
-				glVertexAttribPointer(attr_transform_w, 4, GL_FLOAT, GL_FALSE, 24 * sizeof(GLfloat), p+20);
+				bind_segment(s, inst_vbo_ring[session->inst_ring], 24);
 				
 				#if WANT_SMOOTH	
 				if(s->dl->line_count)
@@ -1105,6 +1393,34 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 					glDrawArraysInstancedARB(GL_QUADS,s->dl->quad_off,s->dl->quad_count, s->inst_count);
 				#endif
 			}
+			
+			// Wire-frame pass.  The shader dropped the faces of the selected 
+			// copies above, keeping only their edges.  Now draw the faces of 
+			// any segment with a selected copy again as lines, this time 
+			// feeding the shader each copy's "unselected" flag, so that it is 
+			// the unselected copies whose faces drop out.  That is one more 
+			// draw per brick however many copies are selected.
+			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			for(s = segments; s < cur_segment; ++s)
+			{
+				if(s->selected_count == 0)
+					continue;
+				
+				bind_segment(s, inst_vbo_ring[session->inst_ring], 25);
+				
+				#if WANT_SMOOTH	
+				if(s->dl->tri_count)
+					glDrawElementsInstancedARB(GL_TRIANGLES,s->dl->tri_count,GL_UNSIGNED_INT,idx_null+s->dl->tri_off, s->inst_count);
+				if(s->dl->quad_count)
+					glDrawElementsInstancedARB(GL_QUADS,s->dl->quad_count,GL_UNSIGNED_INT,idx_null+s->dl->quad_off, s->inst_count);
+				#else
+				if(s->dl->tri_count)
+					glDrawArraysInstancedARB(GL_TRIANGLES,s->dl->tri_off,s->dl->tri_count, s->inst_count);
+				if(s->dl->quad_count)
+					glDrawArraysInstancedARB(GL_QUADS,s->dl->quad_off,s->dl->quad_count, s->inst_count);
+				#endif
+			}
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
 			glDisableVertexAttribArray(attr_transform_x);
 			glDisableVertexAttribArray(attr_transform_y);
@@ -1112,12 +1428,14 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 			glDisableVertexAttribArray(attr_transform_w);
 			glDisableVertexAttribArray(attr_color_current);
 			glDisableVertexAttribArray(attr_color_compliment);
+			glDisableVertexAttribArray(attr_selected);
 			glVertexAttribDivisorARB(attr_transform_x,0);
 			glVertexAttribDivisorARB(attr_transform_y,0);
 			glVertexAttribDivisorARB(attr_transform_z,0);
 			glVertexAttribDivisorARB(attr_transform_w,0);
 			glVertexAttribDivisorARB(attr_color_current,0);
 			glVertexAttribDivisorARB(attr_color_compliment,0);
+			glVertexAttribDivisorARB(attr_selected,0);
 
 		}
 
@@ -1161,6 +1479,10 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 			glVertexAttrib4fv(attr_color_current, l->color);
 			glVertexAttrib4fv(attr_color_compliment, l->comp);
 			
+			// Drawn on its own, so a selected copy is simply a wire frame.
+			if(l->selected)
+				glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			
 			dl = l->dl;
 			glBindBuffer(GL_ARRAY_BUFFER,dl->geo_vbo);
 			#if WANT_SMOOTH
@@ -1199,6 +1521,9 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 					glDrawArrays(GL_QUADS,tptr->quad_off,tptr->quad_count);
 				#endif				
 			}
+			
+			if(l->selected)
+				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 			++l;
 		}
 	}
@@ -1207,6 +1532,7 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 	#if WANT_SMOOTH
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
 	#endif
+	glVertexAttrib1f(attr_selected, 0.0f);
 
 	#if WANT_STATS
 		printf("Immediate drawing: %d batches, %d vertices.\n",session->stats.num_btch_imm, session->stats.num_vert_imm);
@@ -1240,6 +1566,9 @@ void LDrawDLSessionDrawAndDestroy(struct LDrawDLSession * session)
 //			state like polygon offset that must be used now that isn't recorded
 //			by this API.
 //
+//			Selection is not such state: it rides along with the instance, so 
+//			a selected brick is batched with its unselected copies.
+//
 //================================================================================
 void LDrawDLDraw(
 									struct LDrawDLSession *			session,
@@ -1248,6 +1577,7 @@ void LDrawDLDraw(
 									const GLfloat 					cur_color[4],
 									const GLfloat 					cmp_color[4],
 									const GLfloat					transform[16],
+									int								selected,
 									int								draw_now)
 {
 	if(!draw_now)
@@ -1272,6 +1602,7 @@ void LDrawDLDraw(
 			memcpy(link->color,cur_color,sizeof(GLfloat)*4);
 			memcpy(link->comp,cmp_color,sizeof(GLfloat)*4);
 			memcpy(link->transform,transform,sizeof(GLfloat)*16);
+			link->selected = selected ? 1.0f : 0.0f;
 			session->sort_count++;
 			if(spec)
 				memcpy(&link->spec,spec,sizeof(struct LDrawTextureSpec));
@@ -1313,6 +1644,7 @@ void LDrawDLDraw(
 				memcpy(inst->color,cur_color,sizeof(GLfloat)*4);
 				memcpy(inst->comp,cmp_color,sizeof(GLfloat)*4);
 				memcpy(inst->transform,transform,sizeof(GLfloat)*16);
+				inst->selected = selected ? 1.0f : 0.0f;
 			}
 			return;
 		}
@@ -1320,6 +1652,9 @@ void LDrawDLDraw(
 	
 	// IMMEDIATE MODE DRAW CASE!  If we get here, we are going to draw this DL right now at this
 	// position.
+	#if DEBUG_DL_SELECTION_BATCHING
+	session->imm_count++;
+	#endif
 	#if WANT_STATS
 		session->stats.num_btch_imm++;
 		session->stats.num_vert_imm += dl->vrt_count;
@@ -1333,6 +1668,12 @@ void LDrawDLDraw(
 	glVertexAttrib4fv(attr_color_current, cur_color);
 	glVertexAttrib4fv(attr_color_compliment, cmp_color);
 	
+	// Drawn on its own, so a selected copy is simply a wire frame.  A draw_now 
+	// draw is already in wire frame; that is what forced it out here.
+	int wire_selected = selected && !draw_now;
+	if(wire_selected)
+		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	
 	assert(dl->tex_count > 0);
 	
 	// Bind our DL VBO and set up ptrs.
@@ -1400,9 +1741,121 @@ void LDrawDLDraw(
 		setup_tex_spec(spec);
 	}
 	
+	if(wire_selected)
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	
 }//end LDrawDLDraw
 
 
+#if DEBUG_DL_SELECTION_BATCHING
+//---------- count_session_batches ---------------------------------[static]--
+//
+// Purpose:	Count the draw calls LDrawDLSessionDrawAndDestroy would make for
+//			what has been drawn into the session so far: one per DL that gets
+//			hardware instancing, one per instance for the rest, one per sorted
+//			instance, plus whatever was already drawn immediately.
+//
+// Notes:	The wire-frame pass for selected copies is left out; it is at most
+//			one more per hardware-instanced DL, not one per selected copy.
+//
+//------------------------------------------------------------------------------
+static int count_session_batches(struct LDrawDLSession * session)
+{
+	struct LDrawDL *	dl		= NULL;
+	int					batches	= session->imm_count + session->sort_count;
+	
+	for(dl = session->dl_head; dl; dl = dl->next_dl)
+	{
+		if(dl->instance_count >= get_instance_cutoff())
+			batches += 1;
+		else
+			batches += dl->instance_count;
+	}
+	return batches;
+
+}//end count_session_batches
+
+
+//---------- discard_session ---------------------------------------[static]--
+//
+// Purpose:	Throw away a session without drawing anything, unhooking its 
+//			deferred instances from the DLs they were recorded on.
+//
+//------------------------------------------------------------------------------
+static void discard_session(struct LDrawDLSession * session)
+{
+	struct LDrawDL * dl = NULL;
+
+	while(session->dl_head)
+	{
+		dl = session->dl_head;
+		dl->instance_head = dl->instance_tail = NULL;
+		dl->instance_count = 0;
+		session->dl_head = dl->next_dl;
+		dl->next_dl = NULL;
+	}
+	LDrawBDPDestroy(session->alloc);
+
+}//end discard_session
+
+
+//========== LDrawDLCheckSelectionBatching =======================================
+//
+// Purpose:	Draw one DL many times into a session with none, some and all of 
+//			its copies selected, and return true if the session would make the
+//			same number of draw calls each time.
+//
+// Notes:	Selection travels with the instance; if it ever becomes GL state 
+//			again, selected copies fall out of their instancing batch and 
+//			this fails.
+//
+//			The GL context must be current.  Nothing is actually drawn.
+//
+//================================================================================
+int LDrawDLCheckSelectionBatching(void)
+{
+	static const GLfloat quad[12]		= { 0,0,0,  1,0,0,  1,1,0,  0,1,0 };
+	static const GLfloat line[6]		= { 0,0,0,  1,1,0 };
+	static const GLfloat identity[16]	= { 1,0,0,0,  0,1,0,0,  0,0,1,0,  0,0,0,1 };
+	GLfloat normal[3]					= { 0,0,1 };
+	GLfloat color[4]					= { 1,0,0,1 };
+	GLfloat transform[16];
+	struct LDrawDLBuilder *	bld			= LDrawDLBuilderCreate();
+	struct LDrawDL *		dl			= NULL;
+	struct LDrawDLSession * session		= NULL;
+	int						copies		= INST_CUTOFF * 4;
+	int						batches[3]	= { 0 };
+	int						pass		= 0;
+	int						i			= 0;
+
+	LDrawDLBuilderAddQuad(bld, quad, normal, color);
+	LDrawDLBuilderAddLine(bld, line, normal, color);
+	dl = LDrawDLBuilderFinish(bld);
+	if(dl == NULL)
+		return 0;
+
+	// 0: nothing selected.  1: every other copy.  2: select all.
+	for(pass = 0; pass < 3; ++pass)
+	{
+		session = LDrawDLSessionCreate(identity);
+		memcpy(transform, identity, sizeof(transform));
+		for(i = 0; i < copies; ++i)
+		{
+			transform[12] = (GLfloat) i;
+			LDrawDLDraw(session, dl, NULL, color, color, transform, pass == 2 || (pass == 1 && (i % 2)), 0);
+		}
+		batches[pass] = count_session_batches(session);
+		discard_session(session);
+	}
+	
+	LDrawDLDestroy(dl);
+
+	return batches[0] == batches[1] && batches[0] == batches[2];
+
+}//end LDrawDLCheckSelectionBatching
+#endif
+
+
 //========== LDrawDLDestroy ======================================================
 //
 // Purpose: free a display list - release GL and system memory.
@@ -1410,6 +1863,11 @@ void LDrawDLDraw(
 //================================================================================	
 void LDrawDLDestroy(struct LDrawDL * dl)
 {
+	// Any scene recorded before now may point to this DL.  Scenes don't own
+	// their DLs, so rather than track who points where, every destroy makes
+	// all existing scenes stale and they get re-recorded.
+	++dl_destroy_generation;
+
 	if(dl->instance_head != NULL)
 	{
 		// Special case: if our DL is destroyed WHILE a session is using it for
@@ -1429,8 +1887,270 @@ void LDrawDLDestroy(struct LDrawDL * dl)
 
 	#if WANT_SMOOTH
 	glDeleteBuffers(1,&dl->idx_vbo);
+	MEMORY_FREE(LDrawMemoryDLIndexes, dl->idx_bytes);
 	#endif
 	glDeleteBuffers(1,&dl->geo_vbo);
+	MEMORY_FREE(LDrawMemoryDLVertexes, dl->geo_bytes);
 	free(dl);
 
 }//end LDrawDLDestroy
+
+
+//========== LDrawDLGetBounds ====================================================
+//
+// Purpose:	Return the extent of a DL's mesh, in its own coordinates.
+//
+//================================================================================
+void LDrawDLGetBounds(struct LDrawDL * dl, GLfloat minXYZ[3], GLfloat maxXYZ[3])
+{
+	copy_vec3(minXYZ, dl->bounds);
+	copy_vec3(maxXYZ, dl->bounds + 3);
+
+}//end LDrawDLGetBounds
+
+
+//========== LDrawDLGetByteSize ==================================================
+//
+// Purpose:	Return the bytes of VBO memory a DL holds on the card.
+//
+//================================================================================
+size_t LDrawDLGetByteSize(struct LDrawDL * dl)
+{
+	size_t bytes = dl->geo_bytes;
+	#if WANT_SMOOTH
+	bytes += dl->idx_bytes;
+	#endif
+	return bytes;
+
+}//end LDrawDLGetByteSize
+
+
+//========== LDrawDLPreparedGetByteSize ==========================================
+//
+// Purpose:	Return the bytes of system memory a prepared DL holds.
+//
+//================================================================================
+size_t LDrawDLPreparedGetByteSize(struct LDrawDLPrepared * prep)
+{
+	return prepared_byte_size(prep);
+
+}//end LDrawDLPreparedGetByteSize
+
+
+//========== LDrawDLPreparedGetMesh ==============================================
+//
+// Purpose:	Return the vertex and index tables of a prepared DL.  They belong to
+//			the DL.
+//
+//================================================================================
+void LDrawDLPreparedGetMesh(
+							struct LDrawDLPrepared *		prep,
+							int *							out_vertex_count,
+							const GLfloat **				out_vertexes,
+							int *							out_index_count,
+							const GLuint **					out_indexes)
+{
+	assert(LDrawDLVertexStride == VERT_STRIDE);
+	
+	*out_vertex_count = prep->vertex_count;
+	*out_vertexes = prep->vertexes;
+	#if WANT_SMOOTH
+	*out_index_count = prep->index_count;
+	*out_indexes = prep->indexes;
+	#else
+	*out_index_count = 0;
+	*out_indexes = NULL;
+	#endif
+
+}//end LDrawDLPreparedGetMesh
+
+
+//========== LDrawDLPreparedGetTexCount ==========================================
+//
+// Purpose:	Return the number of textures the DL's faces are split among.
+//
+//================================================================================
+int LDrawDLPreparedGetTexCount(struct LDrawDLPrepared * prep)
+{
+	return prep->tex_count;
+
+}//end LDrawDLPreparedGetTexCount
+
+
+//========== LDrawDLPreparedGetTexFaces ==========================================
+//
+// Purpose:	Return where the triangle and quad corners of one texture start, and
+//			how many there are.  Counts are of corners, not faces.
+//
+//================================================================================
+void LDrawDLPreparedGetTexFaces(
+							struct LDrawDLPrepared *		prep,
+							int								tex_index,
+							int *							out_tri_start,
+							int *							out_tri_count,
+							int *							out_quad_start,
+							int *							out_quad_count)
+{
+	struct LDrawDLPerTex * tex = prep->texes + tex_index;
+	
+	*out_tri_start = tex->tri_off;
+	*out_tri_count = tex->tri_count;
+	*out_quad_start = tex->quad_off;
+	*out_quad_count = tex->quad_count;
+
+}//end LDrawDLPreparedGetTexFaces
+
+
+//========== LDrawDLSceneCreate ==================================================
+//
+// Purpose:	Create an empty scene to record draws into.
+//
+//================================================================================
+struct LDrawDLScene * LDrawDLSceneCreate()
+{
+	struct LDrawDLScene * scene = (struct LDrawDLScene *) calloc(1, sizeof(struct LDrawDLScene));
+	scene->destroy_generation = dl_destroy_generation;
+	return scene;
+
+}//end LDrawDLSceneCreate
+
+
+//========== LDrawDLSceneDestroy =================================================
+//
+// Purpose:	Free a scene.  The DLs it refers to are not touched; they belong to
+//			the directives that built them.
+//
+//================================================================================
+void LDrawDLSceneDestroy(struct LDrawDLScene * scene)
+{
+	free(scene->draws);
+	free(scene->handles);
+	free(scene);
+
+}//end LDrawDLSceneDestroy
+
+
+//========== LDrawDLSceneAddDraw =================================================
+//
+// Purpose:	Record one DL draw, with the same arguments LDrawDLDraw takes.
+//
+//================================================================================
+void LDrawDLSceneAddDraw(
+									struct LDrawDLScene *			scene,
+									struct LDrawDL *				dl,
+									struct LDrawTextureSpec *		spec,
+									const GLfloat					cur_color[4],
+									const GLfloat					cmp_color[4],
+									const GLfloat					transform[16],
+									int								selected,
+									int								draw_now)
+{
+	if(scene->draw_count == scene->draw_capacity)
+	{
+		scene->draw_capacity = MAX(256, scene->draw_capacity * 2);
+		scene->draws = (struct LDrawDLSceneDraw *) realloc(scene->draws, sizeof(struct LDrawDLSceneDraw) * scene->draw_capacity);
+	}
+	
+	struct LDrawDLSceneDraw * draw = scene->draws + scene->draw_count;
+	++scene->draw_count;
+	
+	// Clear padding too, so that scenes can be compared byte for byte.
+	memset(draw, 0, sizeof(struct LDrawDLSceneDraw));
+	draw->dl = dl;
+	if(spec)
+		memcpy(&draw->spec, spec, sizeof(struct LDrawTextureSpec));
+	copy_vec4(draw->color, cur_color);
+	copy_vec4(draw->comp, cmp_color);
+	memcpy(draw->transform, transform, sizeof(GLfloat) * 16);
+	draw->selected = selected;
+	draw->draw_now = draw_now;
+	
+	// The traversal being recorded may itself have rebuilt (destroyed) DLs
+	// before drawing their replacements; those were never in this scene.
+	scene->destroy_generation = dl_destroy_generation;
+
+}//end LDrawDLSceneAddDraw
+
+
+//========== LDrawDLSceneAddDragHandle ===========================================
+//
+// Purpose:	Record a drag handle, already in model coordinates.
+//
+//================================================================================
+void LDrawDLSceneAddDragHandle(struct LDrawDLScene * scene, const GLfloat xyz[3], GLfloat size)
+{
+	if(scene->handle_count == scene->handle_capacity)
+	{
+		scene->handle_capacity = MAX(16, scene->handle_capacity * 2);
+		scene->handles = (struct LDrawDLSceneHandle *) realloc(scene->handles, sizeof(struct LDrawDLSceneHandle) * scene->handle_capacity);
+	}
+	
+	struct LDrawDLSceneHandle * handle = scene->handles + scene->handle_count;
+	++scene->handle_count;
+	
+	copy_vec3(handle->xyz, xyz);
+	handle->size = size;
+
+}//end LDrawDLSceneAddDragHandle
+
+
+//========== LDrawDLSceneGetDraws ================================================
+//
+// Purpose:	Return the recorded draws, in order, and how many there are.
+//
+//================================================================================
+int LDrawDLSceneGetDraws(struct LDrawDLScene * scene, const struct LDrawDLSceneDraw ** out_draws)
+{
+	*out_draws = scene->draws;
+	return scene->draw_count;
+
+}//end LDrawDLSceneGetDraws
+
+
+//========== LDrawDLSceneGetDragHandles ==========================================
+//
+// Purpose:	Return the recorded drag handles and how many there are.
+//
+//================================================================================
+int LDrawDLSceneGetDragHandles(struct LDrawDLScene * scene, const struct LDrawDLSceneHandle ** out_handles)
+{
+	*out_handles = scene->handles;
+	return scene->handle_count;
+
+}//end LDrawDLSceneGetDragHandles
+
+
+//========== LDrawDLSceneIsCurrent ===============================================
+//
+// Purpose:	Return true if every DL the scene refers to is still alive.
+//
+// Notes:	DLs belong to their directives, and can be destroyed out from under
+//			a scene by things the scene's directive never hears about - e.g. 
+//			another document rebuilding a model we reference, or the part 
+//			library reloading.  A scene is only safe to replay if no DL at all
+//			has been destroyed since it was recorded.
+//
+//================================================================================
+int LDrawDLSceneIsCurrent(struct LDrawDLScene * scene)
+{
+	return scene->destroy_generation == dl_destroy_generation;
+
+}//end LDrawDLSceneIsCurrent
+
+
+//========== LDrawDLSceneIsEqual =================================================
+//
+// Purpose:	Return true if two scenes would draw exactly the same thing.
+//
+// Notes:	This is for checking a cached scene against a fresh traversal; 
+//			recorded draws are plain data, so a byte compare is exact.
+//
+//================================================================================
+int LDrawDLSceneIsEqual(struct LDrawDLScene * a, struct LDrawDLScene * b)
+{
+	return	a->draw_count == b->draw_count
+		&&	a->handle_count == b->handle_count
+		&&	memcmp(a->draws, b->draws, sizeof(struct LDrawDLSceneDraw) * a->draw_count) == 0
+		&&	memcmp(a->handles, b->handles, sizeof(struct LDrawDLSceneHandle) * a->handle_count) == 0;
+
+}//end LDrawDLSceneIsEqual
@@ -122,6 +122,11 @@ typedef void (* LDrawDLCleanup_f)(LDrawDLHandle  who);			// Cleanup function ass
 - (void) pushWireFrame;
 - (void) popWireFrame;
 
+// Selection count - if a non-zero number of selection requests are outstanding, what we draw is
+// marked as selected.  This is cheap; it does not change how things are batched.
+- (void) pushSelected;
+- (void) popSelected;
+
 // Texture stack - sets up new texturing.  When the stack is totally popped, no texturing is applied.
 - (void) pushTexture:(struct LDrawTextureSpec *)tex_spec;
 - (void) popTexture;
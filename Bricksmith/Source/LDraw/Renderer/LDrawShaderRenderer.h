@@ -17,6 +17,12 @@
 	The renderer maintains a stack view of OpenGL state; as directives push their
 	info to the renderer, containing LDraw parts push and pop state to affect the
 	child parts that are drawn via the depth-first traversal.
+
+	Between beginRecordingScene: and endRecordingScene, nothing is culled and
+	nothing is drawn; every DL draw and drag handle goes into the scene instead.
+	drawScene: then draws a recorded scene from this renderer's point of view.
+	Since only the camera differs between viewports, views of the same model can
+	record once and each draw the same scene.
 	
 
 */
@@ -32,6 +38,7 @@ enum {
 	attr_color_current,
 	attr_color_compliment,
 	attr_texture_mix,
+	attr_selected,
 	attr_count
 };
 
@@ -43,6 +50,7 @@ enum {
 #define DL_STACK_DEPTH 64
 
 struct	LDrawDLBuilder;
+struct	LDrawDLScene;
 struct	LDrawBDP;
 struct	LDrawDragHandleInstance;
 
@@ -57,6 +65,7 @@ struct	LDrawDragHandleInstance;
 	int								color_stack_top;
 	
 	int								wire_frame_count;								// wire frame stack is just a count.
+	int								selected_count;									// selection stack is a count too.
 	
 	
 	struct LDrawTextureSpec			tex_stack[TEXTURE_STACK_DEPTH];					// Texture stack from push/pop texture.
@@ -73,6 +82,7 @@ struct	LDrawDragHandleInstance;
 	struct LDrawDLBuilder*			dl_now;											// This is the DL being built "right now".
 	
 	GLfloat							mvp[16];										// Cached MVP from when shader is built.
+	struct LDrawDLScene *			scene_now;										// If not null, DL draws are recorded into this scene rather than drawn.
 
 	struct LDrawDragHandleInstance *drag_handles;									// List of drag handles - deferred to draw at the end for perf and correct scaling.
 	GLfloat							scale;											// Needed to code Allen's res-independent drag handles...someday get this from viewport?
@@ -83,4 +93,8 @@ struct	LDrawDragHandleInstance;
 
 - (void) drawDragHandleImm:(GLfloat*)xyz withSize:(GLfloat)size;
 
+- (void) beginRecordingScene:(struct LDrawDLScene *)scene;
+- (void) endRecordingScene;
+- (void) drawScene:(struct LDrawDLScene *)scene;
+
 @end
@@ -10,6 +10,7 @@
 #import "LDrawShaderLoader.h"
 #import "LDrawDisplayList.h"
 #import "LDrawBDPAllocator.h"
+#import "LDrawTrace.h"
 #import "ColorLibrary.h"
 #import "GLMatrixMath.h"
 
@@ -25,7 +26,8 @@ static const char * attribs[] = {
 	"transform_w",
 	"color_current",
 	"color_compliment",
-	"texture_mix", NULL };
+	"texture_mix",
+	"selected", NULL };
 
 // Drag handle linked list.  When we get drag handle requests we transform the location into eye-space (to 'capture' the 
 // drag handle location, then we draw it later when our coordinate system isn't possibly scaled.
@@ -106,6 +108,7 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 
 	[[[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor] getColorRGBA:color_now];
 	glVertexAttrib1f(attr_texture_mix,0.0f);
+	glVertexAttrib1f(attr_selected,0.0f);
 	complimentColor(color_now, compl_now);
 	
 	// Set up the basic transform to be identity - our transform is on top of the MVP matrix.
@@ -143,7 +146,9 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 - (void) dealloc
 {
 	struct LDrawDragHandleInstance * dh;
+	TRACE_BEGIN("session flush");
 	LDrawDLSessionDrawAndDestroy(session);
+	TRACE_END("session flush");
 	session = nil;
 	
 	// Go through and draw the drag handles...
@@ -222,6 +227,9 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 // Notes:	we also look at the screen-space size of the box to decide if we can
 //			cull it because it's tiny or replace it with a box.
 //
+//			While recording a scene there is no camera to cull against, so 
+//			everything is drawn.
+//
 // TODO:	change hard-coded values to be compensated for aspect ratio, etc.
 //
 //================================================================================
@@ -230,6 +238,10 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 	if (minXYZ[0] > maxXYZ[0] ||
 		minXYZ[1] > maxXYZ[1] ||
 		minXYZ[2] > maxXYZ[2])		return cull_skip;
+
+	// Recorded scenes are culled when they are drawn, by each view in turn.
+	if(scene_now)
+		return cull_draw;
 		
 	GLfloat aabb_model[6] = { minXYZ[0], minXYZ[1], minXYZ[2], maxXYZ[0], maxXYZ[1], maxXYZ[2] };
 	GLfloat aabb_ndc[6];
@@ -451,6 +463,33 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 }//end popWireFrame:
 
 
+//========== pushSelected: =======================================================
+//
+// Purpose: push a change to drawing as selected.  Like wire frame this nests, 
+//			but it is instance data rather than GL state, so selected DLs are 
+//			still instanced along with everything else.
+//
+//================================================================================
+- (void) pushSelected
+{
+	++selected_count;
+		
+}//end pushSelected:
+
+
+//========== popSelected: ========================================================
+//
+// Purpose: undo a previous selection push - the push and pops must be balanced.
+//
+//================================================================================
+- (void) popSelected
+{
+	assert(selected_count > 0);
+	--selected_count;
+
+}//end popSelected:
+
+
 //========== drawQuad:normal:color: ==============================================
 //
 // Purpose: Adds one quad to the current display list.
@@ -521,17 +560,22 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 //================================================================================
 - (void) drawDragHandle:(GLfloat *)xyz withSize:(GLfloat)size
 {
-	struct LDrawDragHandleInstance * dh = (struct LDrawDragHandleInstance *) LDrawBDPAllocate(pool,sizeof(struct LDrawDragHandleInstance));
-	
-	dh->next = drag_handles;	
-	drag_handles = dh;
-	dh->size = 7.0;
-	
 	GLfloat handle_local[4] = { xyz[0], xyz[1], xyz[2], 1.0f };
 	GLfloat handle_world[4];
 	
 	applyMatrix(handle_world,transform_now, handle_local);
 	
+	if(scene_now)
+	{
+		LDrawDLSceneAddDragHandle(scene_now, handle_world, size);
+		return;
+	}
+	
+	struct LDrawDragHandleInstance * dh = (struct LDrawDragHandleInstance *) LDrawBDPAllocate(pool,sizeof(struct LDrawDragHandleInstance));
+	
+	dh->next = drag_handles;	
+	drag_handles = dh;
+	
 	dh->xyz[0] = handle_world[0];
 	dh->xyz[1] = handle_world[1];
 	dh->xyz[2] = handle_world[2];
@@ -698,9 +742,25 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 // Purpose:	draw a DL using the current state.  We pass this to our DL session 
 //			that sorts out how to actually do tihs.
 //
+// Notes:	When recording, the same state goes into the scene instead.
+//
 //================================================================================
 - (void) drawDL:(LDrawDLHandle)dl
 {
+	if(scene_now)
+	{
+		LDrawDLSceneAddDraw(
+			scene_now,
+			(struct LDrawDL *) dl,
+			&tex_now,
+			color_now,
+			compl_now,
+			transform_now,
+			selected_count > 0,
+			wire_frame_count > 0);
+		return;
+	}
+
 	LDrawDLDraw(
 		session,
 		(struct LDrawDL *) dl,
@@ -708,8 +768,138 @@ static void set_color4fv(GLfloat * c, GLfloat storage[4])
 		color_now,
 		compl_now,
 		transform_now,
+		selected_count > 0,
 		wire_frame_count > 0);
 
 }//end drawDL:
 
+
+//========== beginRecordingScene: ================================================
+//
+// Purpose:	Start recording draws into a scene instead of drawing them.
+//
+// Notes:	Recording must start and end with the stacks empty, so that the
+//			scene holds complete state for every draw.
+//
+//================================================================================
+- (void) beginRecordingScene:(struct LDrawDLScene *)scene
+{
+	assert(scene_now == NULL);
+	assert(transform_stack_top == 0 && color_stack_top == 0 && texture_stack_top == 0);
+	
+	scene_now = scene;
+
+}//end beginRecordingScene:
+
+
+//========== endRecordingScene ===================================================
+//
+// Purpose:	Stop recording; draws go to the session again.
+//
+//================================================================================
+- (void) endRecordingScene
+{
+	assert(scene_now != NULL);
+	assert(transform_stack_top == 0 && color_stack_top == 0 && texture_stack_top == 0);
+	
+	scene_now = NULL;
+
+}//end endRecordingScene
+
+
+//========== drawScene: ==========================================================
+//
+// Purpose:	Draw a recorded scene from this renderer's camera.
+//
+// Notes:	Each draw gets the culling it would have had in a traversal: off 
+//			screen or tiny DLs are skipped, and small ones become boxes.  Since
+//			every DL is culled on its own, a small submodel is drawn as a box 
+//			per part rather than one box for the whole thing.
+//
+//			The recorded state is loaded into our current state so that boxes
+//			and DLs go through the usual paths; wire frame draws are the ones
+//			recorded as draw-now.
+//
+//================================================================================
+- (void) drawScene:(struct LDrawDLScene *)scene
+{
+	const struct LDrawDLSceneDraw *		draws			= NULL;
+	const struct LDrawDLSceneHandle *	handles			= NULL;
+	int									draw_count		= LDrawDLSceneGetDraws(scene, &draws);
+	int									handle_count	= LDrawDLSceneGetDragHandles(scene, &handles);
+	GLfloat								saved_color[4];
+	GLfloat								saved_compl[4];
+	struct LDrawTextureSpec				saved_tex;
+	GLfloat								minXYZ[3];
+	GLfloat								maxXYZ[3];
+	GLfloat								xyz[3];
+	int									i;
+	int									culled			= 0;
+	int									boxed			= 0;
+
+	assert(scene_now == NULL);
+	assert(transform_stack_top == 0);
+	
+	memcpy(saved_color, color_now, sizeof(color_now));
+	memcpy(saved_compl, compl_now, sizeof(compl_now));
+	memcpy(&saved_tex, &tex_now, sizeof(tex_now));
+	
+	TRACE_BEGIN("cull");
+	for(i = 0; i < draw_count; ++i)
+	{
+		const struct LDrawDLSceneDraw * d = draws + i;
+		
+		memcpy(color_now, d->color, sizeof(color_now));
+		memcpy(compl_now, d->comp, sizeof(compl_now));
+		memcpy(&tex_now, &d->spec, sizeof(tex_now));
+		memcpy(transform_now, d->transform, sizeof(transform_now));
+		multMatrices(cull_now, mvp, transform_now);
+		
+		if(d->draw_now)
+			[self pushWireFrame];
+		if(d->selected)
+			[self pushSelected];
+		
+		LDrawDLGetBounds(d->dl, minXYZ, maxXYZ);
+		switch([self checkCull:minXYZ to:maxXYZ])
+		{
+			case cull_box:
+				[self drawBoxFrom:minXYZ to:maxXYZ];
+				++boxed;
+				break;
+			case cull_draw:
+				[self drawDL:d->dl];
+				break;
+			default:
+				++culled;
+				break;
+		}
+		
+		if(d->selected)
+			[self popSelected];
+		if(d->draw_now)
+			[self popWireFrame];
+	}
+	TRACE_END("cull");
+	TRACE_COUNTER("DLs culled", culled);
+	TRACE_COUNTER("DLs drawn as boxes", boxed);
+	TRACE_COUNTER("DLs drawn", draw_count - culled - boxed);
+	
+	// Back to the state we started with.
+	memcpy(color_now, saved_color, sizeof(color_now));
+	memcpy(compl_now, saved_compl, sizeof(compl_now));
+	memcpy(&tex_now, &saved_tex, sizeof(tex_now));
+	memset(transform_now,0,sizeof(transform_now));
+	transform_now[0] = transform_now[5] = transform_now[10] = transform_now[15] = 1.0f;
+	memcpy(cull_now,mvp,sizeof(mvp));
+	
+	// Handles were recorded in model space, which is where we are now.
+	for(i = 0; i < handle_count; ++i)
+	{
+		memcpy(xyz, handles[i].xyz, sizeof(xyz));
+		[self drawDragHandle:xyz withSize:handles[i].size];
+	}
+
+}//end drawScene:
+
 @end
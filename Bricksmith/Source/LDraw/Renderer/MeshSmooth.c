@@ -8,6 +8,7 @@
  */
 
 #include "MeshSmooth.h"
+#include "LDrawMemory.h"
 
 #pragma mark -
 //==============================================================================
@@ -947,6 +948,7 @@ struct Mesh *		create_mesh(int tri_count, int quad_count, int line_count)
 	ret->quad_count = quad_count;
 	
 	ret->faces = (struct Face *) malloc(sizeof(struct Face) * ret->face_capacity);
+	MEMORY_ALLOC(LDrawMemoryMeshSmooth, sizeof(struct Mesh) + sizeof(struct Vertex) * ret->vertex_capacity + sizeof(struct Face) * ret->face_capacity);
 	#if DEBUG
 	ret->flags = 0;
 	#endif
@@ -1005,8 +1007,9 @@ void				add_face(struct Mesh * mesh, const float p1[3], const float p2[3], const
 	}
 	else
 	{
-		f->normal[0] = f->normal[2] = 0.0f;
-		f->normal[1] = 1.0f;
+		// Lines have no normal; a zero one is what tells the shader this 
+		// vertex belongs to a line.
+		f->normal[0] = f->normal[1] = f->normal[2] = 0.0f;
 	}
 	
 	f->degree = p4 ? 4 : (p3 ? 3 : 2);
@@ -1685,6 +1688,7 @@ void				destroy_mesh(struct Mesh * mesh)
 		}
 	}
 	
+	MEMORY_FREE(LDrawMemoryMeshSmooth, sizeof(struct Mesh) + sizeof(struct Vertex) * mesh->vertex_capacity + sizeof(struct Face) * mesh->face_capacity);
 	free(mesh->vertices);
 	free(mesh->faces);
 	free(mesh);
@@ -0,0 +1,54 @@
+//==============================================================================
+//
+// File:		LDrawConnections.h
+//
+// Purpose:		Connection points: the places where one part can be pressed
+//				onto another.
+//
+//				Parts don't say where they connect, but they are built out of
+//				standard primitives which do: every stud on a brick is a
+//				reference to stud.dat or one of its relatives, and the tubes
+//				and pins underneath which grip studs are stud4.dat, stud3.dat
+//				and friends. A stud primitive supplies a stud connection at its
+//				base; a tube primitive supplies anti-stud connections where the
+//				bases of the studs it grips end up, in the plane of the
+//				underside.
+//
+//				A stud and an anti-stud connect when they are at the same point
+//				and their axes are parallel. The sign of the axis isn't
+//				compared, because tube primitives are routinely used flipped.
+//
+//				Only the common stud and tube primitives are recognized.
+//				Anything else just has no connections.
+//
+//==============================================================================
+#import <Foundation/Foundation.h>
+
+#import "MatrixMath.h"
+
+
+// Most connections any single primitive supplies.
+#define LDRAW_CONNECTIONS_PER_PRIMITIVE_MAX		4
+
+
+typedef enum LDrawConnectionGender
+{
+	LDrawConnectionStud		= 0,
+	LDrawConnectionAntiStud	= 1
+
+} LDrawConnectionGenderT;
+
+
+typedef struct LDrawConnection
+{
+	Point3					position;
+	Vector3					axis;			// unit length; the way the stud points
+	LDrawConnectionGenderT	gender;
+
+} LDrawConnection;
+
+
+extern NSUInteger	LDrawConnectionsForPrimitive(NSString *referenceName, LDrawConnection *connectionsOut);
+extern void			LDrawConnectionsAppendTransformed(NSMutableData *destination, const LDrawConnection *connections, NSUInteger count, Matrix4 transform);
+extern void			LDrawConnectionsRemoveDuplicates(NSMutableData *connections);
+extern BOOL			LDrawConnectionsMate(const LDrawConnection *connection1, const LDrawConnection *connection2);
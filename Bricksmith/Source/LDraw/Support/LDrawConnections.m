@@ -0,0 +1,221 @@
+//==============================================================================
+//
+// File:		LDrawConnections.m
+//
+// Purpose:		Connection points of the standard stud primitives. See
+//				LDrawConnections.h.
+//
+// Notes:		Every stud primitive is modeled with its base at the origin and
+//				the stud rising toward -y.
+//
+//				The tube primitives are 4 LDU tall, running from y = 0 up to
+//				y = -4, and parts place them upside-down with a y scale of -1
+//				(plates) or -5 (bricks) so that the end at -4 lands in the
+//				plane of the underside. That end is where the studs they grip
+//				have their bases, so it is where the anti-studs go whatever the
+//				scale. stud4 sits between four studs; stud3 between two.
+//
+//==============================================================================
+#import "LDrawConnections.h"
+
+// Placement keys are rounded to this grid when removing duplicates, in LDraw
+// units.
+#define CONNECTION_DUPLICATE_GRID		0.01
+
+// Cosine of the largest angle at which two axes still count as parallel.
+#define CONNECTION_AXIS_TOLERANCE		0.99
+
+
+typedef struct PrimitiveConnections
+{
+	const char				*name;
+	LDrawConnectionGenderT	gender;
+	NSUInteger				count;
+	float					offsets[LDRAW_CONNECTIONS_PER_PRIMITIVE_MAX][3];
+
+} PrimitiveConnections;
+
+
+static const PrimitiveConnections primitiveTable[] =
+{
+	{ "stud",		LDrawConnectionStud,		1, { {0, 0, 0} } },
+	{ "stud2",		LDrawConnectionStud,		1, { {0, 0, 0} } },
+	{ "stud2a",		LDrawConnectionStud,		1, { {0, 0, 0} } },
+	{ "stud6",		LDrawConnectionStud,		1, { {0, 0, 0} } },
+	{ "stud6a",		LDrawConnectionStud,		1, { {0, 0, 0} } },
+	{ "stud10",		LDrawConnectionStud,		1, { {0, 0, 0} } },
+	{ "stud13",		LDrawConnectionStud,		1, { {0, 0, 0} } },
+	{ "stud15",		LDrawConnectionStud,		1, { {0, 0, 0} } },
+	{ "stud20",		LDrawConnectionStud,		1, { {0, 0, 0} } },
+	{ "stud22a",	LDrawConnectionStud,		1, { {0, 0, 0} } },
+	{ "studa",		LDrawConnectionStud,		1, { {0, 0, 0} } },
+	{ "studel",		LDrawConnectionStud,		1, { {0, 0, 0} } },
+	{ "studp01",	LDrawConnectionStud,		1, { {0, 0, 0} } },
+
+	{ "stud4",		LDrawConnectionAntiStud,	4, { {10, -4, 10}, {-10, -4, 10}, {10, -4, -10}, {-10, -4, -10} } },
+	{ "stud4a",		LDrawConnectionAntiStud,	4, { {10, -4, 10}, {-10, -4, 10}, {10, -4, -10}, {-10, -4, -10} } },
+	{ "stud3",		LDrawConnectionAntiStud,	2, { {10, -4, 0}, {-10, -4, 0} } },
+	{ "stud3a",		LDrawConnectionAntiStud,	2, { {10, -4, 0}, {-10, -4, 0} } },
+};
+
+static int CompareConnections(const void *connection1, const void *connection2);
+
+
+//========== LDrawConnectionsForPrimitive ======================================
+//
+// Purpose:		Writes the connections supplied by the primitive referenceName,
+//				in the primitive's own coordinates, into connectionsOut, which
+//				must have room for LDRAW_CONNECTIONS_PER_PRIMITIVE_MAX. Returns
+//				how many there were; 0 for anything not a stud primitive.
+//
+// Notes:		Logo studs ("stud-logo3.dat" and the like) connect just like
+//				the plain stud they decorate.
+//
+//==============================================================================
+NSUInteger LDrawConnectionsForPrimitive(NSString *referenceName, LDrawConnection *connectionsOut)
+{
+	NSString                    *name       = [[[referenceName lowercaseString] stringByReplacingOccurrencesOfString:@"\\" withString:@"/"] lastPathComponent];
+	NSRange                     logoRange   = NSMakeRange(NSNotFound, 0);
+	const char                  *baseName   = NULL;
+	const PrimitiveConnections  *entry      = NULL;
+	NSUInteger                  tableSize   = sizeof(primitiveTable) / sizeof(PrimitiveConnections);
+	NSUInteger                  counter     = 0;
+	NSUInteger                  offset      = 0;
+
+	name        = [name stringByDeletingPathExtension];
+	logoRange   = [name rangeOfString:@"-logo"];
+	if(logoRange.location != NSNotFound)
+		name = [name substringToIndex:logoRange.location];
+
+	baseName = [name UTF8String];
+
+	for(counter = 0; counter < tableSize; counter++)
+	{
+		entry = &primitiveTable[counter];
+
+		if(strcmp(entry->name, baseName) == 0)
+		{
+			for(offset = 0; offset < entry->count; offset++)
+			{
+				connectionsOut[offset].position = V3Make(entry->offsets[offset][0], entry->offsets[offset][1], entry->offsets[offset][2]);
+				connectionsOut[offset].axis     = V3Make(0, -1, 0);
+				connectionsOut[offset].gender   = entry->gender;
+			}
+			return entry->count;
+		}
+	}
+
+	return 0;
+
+}//end LDrawConnectionsForPrimitive
+
+
+//========== LDrawConnectionsAppendTransformed =================================
+//
+// Purpose:		Appends count connections to destination, after moving them
+//				through transform.
+//
+//==============================================================================
+void LDrawConnectionsAppendTransformed(NSMutableData *destination, const LDrawConnection *connections, NSUInteger count, Matrix4 transform)
+{
+	NSUInteger      oldLength   = [destination length];
+	LDrawConnection *appended   = NULL;
+	Point3          tip         = ZeroPoint3;
+	NSUInteger      counter     = 0;
+
+	[destination setLength:oldLength + sizeof(LDrawConnection) * count];
+	appended = (LDrawConnection *)((char *)[destination mutableBytes] + oldLength);
+
+	for(counter = 0; counter < count; counter++)
+	{
+		tip = V3Add(connections[counter].position, connections[counter].axis);
+
+		appended[counter].position  = V3MulPointByProjMatrix(connections[counter].position, transform);
+		appended[counter].axis      = V3Normalize(V3Sub(V3MulPointByProjMatrix(tip, transform), appended[counter].position));
+		appended[counter].gender    = connections[counter].gender;
+	}
+
+}//end LDrawConnectionsAppendTransformed
+
+
+//========== LDrawConnectionsRemoveDuplicates ==================================
+//
+// Purpose:		Drops connections lying on top of an earlier one of the same
+//				gender. Parts built up out of subparts often place the same
+//				stud twice.
+//
+//==============================================================================
+void LDrawConnectionsRemoveDuplicates(NSMutableData *connections)
+{
+	LDrawConnection *entries    = [connections mutableBytes];
+	NSUInteger      count       = [connections length] / sizeof(LDrawConnection);
+	NSUInteger      kept        = 0;
+	NSUInteger      counter     = 0;
+
+	if(count < 2)
+		return;
+
+	qsort(entries, count, sizeof(LDrawConnection), CompareConnections);
+
+	for(counter = 1; counter < count; counter++)
+	{
+		if(CompareConnections(&entries[kept], &entries[counter]) != 0)
+		{
+			kept++;
+			entries[kept] = entries[counter];
+		}
+	}
+
+	[connections setLength:(kept + 1) * sizeof(LDrawConnection)];
+
+}//end LDrawConnectionsRemoveDuplicates
+
+
+//========== LDrawConnectionsMate ==============================================
+//
+// Purpose:		Returns YES if the two connections would fit together were they
+//				at the same spot: one is a stud, the other an anti-stud, and
+//				they point along the same line.
+//
+//==============================================================================
+BOOL LDrawConnectionsMate(const LDrawConnection *connection1, const LDrawConnection *connection2)
+{
+	return (	connection1->gender != connection2->gender
+			&&	fabsf(V3Dot(connection1->axis, connection2->axis)) >= CONNECTION_AXIS_TOLERANCE );
+
+}//end LDrawConnectionsMate
+
+
+#pragma mark -
+
+//---------- CompareConnections --------------------------------------[static]--
+//
+// Purpose:		qsort comparator which orders connections by gender, then by
+//				position rounded to CONNECTION_DUPLICATE_GRID.
+//
+//------------------------------------------------------------------------------
+static int CompareConnections(const void *connection1, const void *connection2)
+{
+	const LDrawConnection   *first      = connection1;
+	const LDrawConnection   *second     = connection2;
+	const float             *position1  = &first->position.x;
+	const float             *position2  = &second->position.x;
+	long                    rounded1    = 0;
+	long                    rounded2    = 0;
+	int                     axis        = 0;
+
+	if(first->gender != second->gender)
+		return (first->gender < second->gender) ? -1 : 1;
+
+	for(axis = 0; axis < 3; axis++)
+	{
+		rounded1 = lround(position1[axis] / CONNECTION_DUPLICATE_GRID);
+		rounded2 = lround(position2[axis] / CONNECTION_DUPLICATE_GRID);
+
+		if(rounded1 != rounded2)
+			return (rounded1 < rounded2) ? -1 : 1;
+	}
+
+	return 0;
+
+}//end CompareConnections
@@ -12,6 +12,7 @@
 
 #import "MatrixMath.h"
 #import "LDrawFastSet.h"
+#import "LDrawHitList.h"
 #import "LDrawRenderer.h"
 
 // This uses the hacky C wrapper around NSSet to improve performance.
@@ -22,6 +23,7 @@
 @class LDrawFile;
 @class LDrawModel;
 @class LDrawStep;
+struct LDrawPrimitiveSink;
 
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -101,7 +103,10 @@ typedef enum CacheFlags {
 	// The bounding box of the directive has changed and is no longer valid.
 	CacheFlagBounds      = 1,
 	DisplayList		     = 2,
-    ContainerInvalid     = 4  // Subdirectives have changed in a way that may invalidate the cache
+    ContainerInvalid     = 4, // Subdirectives have changed in a way that may invalidate the cache
+	
+	// The text the directive writes out to an LDraw file has changed.
+	CacheFlagText        = 8
 } CacheFlagsT;
 
 typedef enum Message {
@@ -192,7 +197,7 @@ typedef enum Message {
 - (void) debugDrawboundingBox;
 
 // Hit testing primitives
-- (void) hitTest:(Ray3)pickRay transform:(Matrix4)transform viewScale:(float)scaleFactor boundsOnly:(BOOL)boundsOnly creditObject:(id)creditObject hits:(NSMutableDictionary *)hits;
+- (void) hitTest:(Ray3)pickRay transform:(Matrix4)transform viewScale:(float)scaleFactor boundsOnly:(BOOL)boundsOnly creditObject:(id)creditObject hits:(LDrawHitList *)hits;
 - (BOOL) boxTest:(Box2)bounds transform:(Matrix4)transform boundsOnly:(BOOL)boundsOnly creditObject:(id)creditObject hits:(NSMutableSet *)hits;
 - (void) depthTest:(Point2)testPt inBox:(Box2)bounds transform:(Matrix4)transform creditObject:(id)creditObject bestObject:(id *)bestObject bestDepth:(float *)bestDepth;
 
@@ -209,6 +214,7 @@ typedef enum Message {
 - (LDrawFile *) enclosingFile;
 - (LDrawModel *) enclosingModel;
 - (LDrawStep *) enclosingStep;
+- (BOOL) hasVisibleContent;
 - (BOOL) isSelected;
 
 - (void) setEnclosingDirective:(LDrawContainer *)newParent;
@@ -229,6 +235,9 @@ typedef enum Message {
 		 currentTransform:(Matrix4)transform
 		  normalTransform:(Matrix3)normalTransform
 				recursive:(BOOL)recursive;
+- (void) flattenIntoSink:(struct LDrawPrimitiveSink *)sink
+			currentColor:(LDrawColor *)parentColor
+		currentTransform:(Matrix4)transform;
 - (BOOL) isAncestorInList:(NSArray *)containers;
 - (void) noteNeedsDisplay;
 - (void) optimizeOpenGL;
@@ -241,5 +250,6 @@ typedef enum Message {
 - (void) sendMessageToObservers:(MessageT) msg;					// Send a specific message to all observers.
 - (void) invalCache:(CacheFlagsT) flags;						// Invalidate cache bits - this notifies observers as needed.  Flags are the bits to invalidate, not the net effect.
 - (CacheFlagsT) revalCache:(CacheFlagsT) flags;						// Revalidate flags - no notifications are sent, but internals are updated.  Returns which flags _were_ dirty.
+- (void) revalCacheRecursively:(CacheFlagsT) flags;				// Revalidate flags on this directive and everything it contains.
 
 @end
@@ -12,6 +12,7 @@
 #import "LDrawContainer.h"
 #import "LDrawFile.h"
 #import "LDrawModel.h"
+#import "LDrawPrimitiveSink.h"
 #import "LDrawStep.h"
 	
 @implementation LDrawDirective
@@ -324,7 +325,7 @@
 //						current object has been hit. (Used to credit nested 
 //						geometry to its parent.) If nil, the hit object credits 
 //						itself. 
-//				hits - keys are hit objects. Values are NSNumbers of hit depths.
+//				hits - the nearest objects hit so far, with their depths.
 //
 //==============================================================================
 - (void) hitTest:(Ray3)pickRay
@@ -332,7 +333,7 @@
 	   viewScale:(float)scaleFactor
 	  boundsOnly:(BOOL)boundsOnly
 	creditObject:(id)creditObject
-			hits:(NSMutableDictionary *)hits
+			hits:(LDrawHitList *)hits
 {
 	//subclasses should override this with hit-detection code
 	
@@ -637,6 +638,23 @@
 }//end enclosingStep
 
 
+//========== hasVisibleContent =================================================
+//
+// Purpose:		Returns whether this directive has anything to draw or hit-test.
+//
+// Notes:		Containers keep track of which children answer YES, so that 
+//				traversals can pass over the rest without visiting them. 
+//				Anything whose answer changes must tell its enclosing directive 
+//				with -directiveDidChangeVisibility:.
+//
+//==============================================================================
+- (BOOL) hasVisibleContent
+{
+	return YES;
+
+}//end hasVisibleContent
+
+
 //========== isSelected ========================================================
 //
 // Purpose:		Returns whether this directive thinks it's selected.
@@ -776,6 +794,27 @@
 }//end flattenIntoLines:triangles:quadrilaterals:other:currentColor:
 
 
+//========== flattenIntoSink:currentColor:currentTransform: ====================
+//
+// Purpose:		Streams every primitive in this directive (and everything it 
+//				references) into sink, transformed into the coordinates of the 
+//				top-level model and with its color resolved. 
+//
+// Notes:		This is the streaming alternative to 
+//				-flattenIntoLines:triangles:quadrilaterals:..., for exporting 
+//				and analyzing models. Nothing is copied or allocated per 
+//				primitive, and the receiver is left untouched. 
+//
+//==============================================================================
+- (void) flattenIntoSink:(LDrawPrimitiveSink *)sink
+			currentColor:(LDrawColor *)parentColor
+		currentTransform:(Matrix4)transform
+{
+	// By default, a directive produces no primitives.
+
+}//end flattenIntoSink:currentColor:currentTransform:
+
+
 //========== isAncestorInList: =================================================
 //
 // Purpose:		Given a list of LDrawContainers, returns YES if any of the 
@@ -813,6 +852,9 @@
 //==============================================================================
 - (void) noteNeedsDisplay
 {
+	// Anything changed enough to redraw may well write out differently too.
+	[self invalCache:CacheFlagText];
+	
 	[[NSNotificationCenter defaultCenter]
 					postNotificationName:LDrawDirectiveDidChangeNotification
 								  object:self];
@@ -1082,4 +1124,21 @@
 	return were_dirty;
 }
 
+
+//============== revalCacheRecursively =========================================
+//
+// Purpose:		Revalidates the given flags on this directive and, in 
+//				containers, on every directive beneath it.
+//
+// Usage:		An observer which caches something computed from an entire 
+//				subtree (such as its written text) calls this after rebuilding 
+//				the cache. Otherwise a descendant left dirty from before would 
+//				swallow the inval notification for its next change.
+//
+//==============================================================================
+- (void) revalCacheRecursively:(CacheFlagsT) flags
+{
+	[self revalCache:flags];
+}
+
 @end
@@ -215,7 +215,7 @@ static const float HandleDiameter	= 7.0;
 	   viewScale:(float)scaleFactor
 	  boundsOnly:(BOOL)boundsOnly
 	creditObject:(id)creditObject
-			hits:(NSMutableDictionary *)hits
+			hits:(LDrawHitList *)hits
 {
 	float   handleScale     = 0.0;
 	float   drawRadius      = 0.0;
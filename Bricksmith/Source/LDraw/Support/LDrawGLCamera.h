@@ -53,6 +53,16 @@ typedef enum
 	GLfloat					projection[16];
 	GLfloat					modelView[16];
 	GLfloat					orientation[16];
+	
+	// The matrices above as Matrix4s, and those derived from them. Rebuilt the 
+	// first time they are asked for after either matrix changes. 
+	Matrix4					modelViewMatrix;
+	Matrix4					inverseModelViewMatrix;
+	Matrix4					projectionMatrix;
+	Matrix4					modelViewProjectionMatrix;
+	Matrix4					inverseModelViewProjectionMatrix;
+	NSUInteger				matrixVersion;			// incremented whenever modelView or projection change
+	NSUInteger				cachedMatrixVersion;	// matrixVersion when the Matrix4s were built
 
 	ProjectionModeT         projectionMode;
 	LocationModeT			locationMode;
@@ -77,6 +87,16 @@ typedef enum
 - (GLfloat*)getProjection;
 - (GLfloat*)getModelView;
 
+// Output - the same transform, cached for coordinate conversions.  The version
+// changes whenever the transform does, so callers may cache things derived from
+// it too.
+- (NSUInteger) matrixVersion;
+- (Matrix4) modelViewMatrix;
+- (Matrix4) inverseModelViewMatrix;
+- (Matrix4) projectionMatrix;
+- (Matrix4) modelViewProjectionMatrix;
+- (Matrix4) inverseModelViewProjectionMatrix;
+
 // Output - camera meta-data for UI/persistence.  The camera outpust perspective/orthographic and a Euler viewing angle; 
 // the client code creates the "known" views.
 - (CGFloat) zoomPercentage;
@@ -23,6 +23,14 @@
 #define WALKTHROUGH_NEAR	20.0
 #define WALKTHROUGH_FAR		20000.0
 
+@interface LDrawGLCamera (Private)
+
+- (void) matricesDidChange;
+- (void) updateMatrices;
+
+@end
+
+
 @implementation LDrawGLCamera
 
 #pragma mark -
@@ -54,6 +62,7 @@
 	buildRotationMatrix(orientation,180,1,0,0);
 	buildIdentity(modelView);
 	buildIdentity(projection);
+	[self matricesDidChange];
 	
 	return self;	
 }//end init
@@ -131,6 +140,91 @@
 }//end getModelView
 
 
+//========== matrixVersion =====================================================
+//
+// Purpose:		Returns a number which changes every time the modelview or 
+//				projection matrix does. 
+//
+//==============================================================================
+- (NSUInteger) matrixVersion
+{
+	return self->matrixVersion;
+	
+}//end matrixVersion
+
+
+//========== modelViewMatrix ===================================================
+//
+// Purpose:		Returns the current modelview matrix as a Matrix4.
+//
+//==============================================================================
+- (Matrix4) modelViewMatrix
+{
+	[self updateMatrices];
+	return self->modelViewMatrix;
+	
+}//end modelViewMatrix
+
+
+//========== inverseModelViewMatrix ============================================
+//
+// Purpose:		Returns the inverse of the current modelview matrix, which 
+//				carries camera coordinates back into the model.
+//
+//==============================================================================
+- (Matrix4) inverseModelViewMatrix
+{
+	[self updateMatrices];
+	return self->inverseModelViewMatrix;
+	
+}//end inverseModelViewMatrix
+
+
+//========== projectionMatrix ==================================================
+//
+// Purpose:		Returns the current projection matrix as a Matrix4.
+//
+//==============================================================================
+- (Matrix4) projectionMatrix
+{
+	[self updateMatrices];
+	return self->projectionMatrix;
+	
+}//end projectionMatrix
+
+
+//========== modelViewProjectionMatrix =========================================
+//
+// Purpose:		Returns the modelview matrix followed by the projection; it 
+//				takes model points straight to clip coordinates. 
+//
+// Notes:		Pass it to V3ProjectWithMatrix.
+//
+//==============================================================================
+- (Matrix4) modelViewProjectionMatrix
+{
+	[self updateMatrices];
+	return self->modelViewProjectionMatrix;
+	
+}//end modelViewProjectionMatrix
+
+
+//========== inverseModelViewProjectionMatrix ==================================
+//
+// Purpose:		Returns the inverse of -modelViewProjectionMatrix, which takes 
+//				clip coordinates back to the model. 
+//
+// Notes:		Pass it to V3UnprojectWithInverse.
+//
+//==============================================================================
+- (Matrix4) inverseModelViewProjectionMatrix
+{
+	[self updateMatrices];
+	return self->inverseModelViewProjectionMatrix;
+	
+}//end inverseModelViewProjectionMatrix
+
+
 //========== zoomPercentage ====================================================
 //
 // Purpose:		Returns the current zoom percentage.
@@ -178,7 +272,7 @@
 	TransformComponents  components			= IdentityComponents;
 	Tuple3				 degrees			= ZeroPoint3;
 	
-	transformation = Matrix4CreateFromGLMatrix4([self getModelView]);
+	transformation = [self modelViewMatrix];
 	transformation = Matrix4Rotate(transformation, V3Make(180, 0, 0)); // LDraw is upside-down
 	Matrix4DecomposeTransformation(transformation, &components);
 	degrees = components.rotate;
@@ -460,6 +554,8 @@
 				fabs(cameraDistance) + fieldDepth/2 );	// far
 	}
 	
+	[self matricesDidChange];
+	
 }//end makeProjection
 
 
@@ -493,9 +589,51 @@
 		multMatrices(modelView,temp1,flip);		
 	}
 	
+	[self matricesDidChange];
+	
 }//end makeModelView
 
 
+//========== matricesDidChange =================================================
+//
+// Purpose:		Call after writing modelView or projection. The Matrix4 copies 
+//				are out of date until the next -updateMatrices. 
+//
+//==============================================================================
+- (void) matricesDidChange
+{
+	self->matrixVersion += 1;
+	
+}//end matricesDidChange
+
+
+//========== updateMatrices ====================================================
+//
+// Purpose:		Rebuilds the Matrix4 copies of the transform, with their 
+//				products and inverses, if the transform has changed since they 
+//				were last built. 
+//
+// Notes:		A single mouse event may convert several points, and the 
+//				inverses are not cheap; this way they are worked out once per 
+//				change of view rather than once per point. 
+//
+//==============================================================================
+- (void) updateMatrices
+{
+	if(self->cachedMatrixVersion != self->matrixVersion)
+	{
+		self->modelViewMatrix					= Matrix4CreateFromGLMatrix4(self->modelView);
+		self->projectionMatrix					= Matrix4CreateFromGLMatrix4(self->projection);
+		self->inverseModelViewMatrix			= Matrix4Invert(self->modelViewMatrix);
+		self->modelViewProjectionMatrix			= Matrix4Multiply(self->modelViewMatrix, self->projectionMatrix);
+		self->inverseModelViewProjectionMatrix	= Matrix4Invert(self->modelViewProjectionMatrix);
+		
+		self->cachedMatrixVersion = self->matrixVersion;
+	}
+	
+}//end updateMatrices
+
+
 //========== tickle ============================================================
 //
 // Purpose:		Cause the camera to recompute the document size, scrolling
@@ -707,9 +845,8 @@
 	Box2 viewport = V2MakeBox(0,0,1,1);		// Fake view-port - this gets us our scaled point in viewport-proportional units.
 	
 	// - Near clipping plane unprojection
-	Point3 nearModelPoint = V3Project(modelPoint,
-								 Matrix4CreateFromGLMatrix4(modelView),
-								 Matrix4CreateFromGLMatrix4(projection),
+	Point3 nearModelPoint = V3ProjectWithMatrix(modelPoint,
+								 [self modelViewProjectionMatrix],
 								 viewport);
 
 	Point2 viewportProportion  = V2Make(nearModelPoint.x,nearModelPoint.y);
@@ -734,7 +871,7 @@
 	Point2  newCenter           = ZeroPoint2;
 	float   zEval               = 0;
 	float	zNear				= 0;
-	Matrix4 modelViewMatrix     = Matrix4CreateFromGLMatrix4(modelView);
+	Matrix4 currentModelView    = [self modelViewMatrix];
 	Point4  transformedPoint    = ZeroPoint4;
 	Box2    newVisibleRect      = ZeroBox2;
 	Box2    currentClippingRect = ZeroBox2;
@@ -742,7 +879,7 @@
 	
 	// For the camera calculation, we need effective world coordinates, not 
 	// model coordinates. 
-	transformedPoint = V4MulPointByMatrix(V4FromPoint3(modelPoint), modelViewMatrix);
+	transformedPoint = V4MulPointByMatrix(V4FromPoint3(modelPoint), currentModelView);
 	
 	// Perspective distortion makes this more complicated. The camera is in a 
 	// fixed position, but the frustum changes with the scrollbars. We need to 
@@ -920,7 +1057,7 @@
 	//Get the current transformation matrix. By using its inverse, we can 
 	// convert projection-coordinates back to the model coordinates they 
 	// are displaying.
-	Matrix4 inversed = Matrix4Invert(Matrix4CreateFromGLMatrix4([self getModelView]));
+	Matrix4 inversed = [self inverseModelViewMatrix];
 	
 	// clear any translation resulting from a rotation center
 	inversed.element[3][0] = 0;
@@ -19,6 +19,7 @@
 //Forward declarations
 @class LDrawDirective;
 @class LDrawDragHandle;
+@class LDrawSharedScene;
 @protocol LDrawGLRendererDelegate;
 @protocol LDrawGLCameraScroller;
 
@@ -60,6 +61,7 @@ typedef enum
 													// and here in -mouseUp: to handle such cases.
 	
 	LDrawGLCamera *			camera;
+	LDrawSharedScene *		sharedScene;			// recorded traversal of fileBeingDrawn, shared with other views of it
 	
 	// Drawing Environment
 	LDrawColor				*color;					// default color to draw parts if none is specified
@@ -83,6 +85,10 @@ typedef enum
 	Point3                  initialDragLocation;	// point in model where part was positioned at draggingEntered
 	Vector3					nudgeVector;			// direction of nudge action (valid only in nudgeAction callback)
 	LDrawDragHandle			*activeDragHandle;		// drag handle hit on last mouse-down (or nil)
+	BOOL					vertexesNeedOptimizing;	// a drag moved primitives; only their slots have been rewritten
+	Point2					pendingMouseOverPoint;	// latest point a throttled -publishMouseOverPoint: passed over
+	BOOL					mouseOverIsScheduled;	// a trailing publish of pendingMouseOverPoint is on the way
+	NSTimeInterval			lastMouseOverTime;		// when -publishMouseOverPoint: last found the model point
 }
 
 // Initialization
@@ -165,8 +171,11 @@ typedef enum
 // Utilities
 //- (NSArray *) getDirectivesUnderPoint:(Point2)point_view amongDirectives:(NSArray *)directives fastDraw:(BOOL)fastDraw;
 - (NSArray *) getDirectivesUnderRect:(Box2)rect_view amongDirectives:(NSArray *)directives fastDraw:(BOOL)fastDraw;
-//- (NSArray *) getPartsFromHits:(NSDictionary *)hits;
+//- (NSArray *) getPartsFromHits:(const LDrawHitList *)hits;
+- (void) noteVertexesNeedOptimizing;
+- (void) optimizeDeferredVertexes;
 - (void) publishMouseOverPoint:(Point2)viewPoint;
+- (void) publishPendingMouseOverPoint;
 - (void) setZoomPercentage:(CGFloat)newPercentage preservePoint:(Point2)viewPoint;		// This and setZoomPercentage are how we zoom.
 - (void) scrollCenterToModelPoint:(Point3)modelPoint;									// These two are how we do gesture-based scrolls
 - (void) scrollModelPoint:(Point3)modelPoint toViewportProportionalPoint:(Point2)viewportPoint;
@@ -203,6 +212,7 @@ typedef enum
 - (void) LDrawGLRenderer:(LDrawGLRenderer*)renderer wantsToSelectDirectives:(NSArray *)directivesToSelect selectionMode:(SelectionModeT) selectionMode;
 - (void) LDrawGLRenderer:(LDrawGLRenderer*)renderer willBeginDraggingHandle:(LDrawDragHandle *)dragHandle;
 - (void) LDrawGLRenderer:(LDrawGLRenderer*)renderer dragHandleDidMove:(LDrawDragHandle *)dragHandle;
+- (Vector3) LDrawGLRenderer:(LDrawGLRenderer*)renderer snapDisplacement:(Vector3)displacement ofDirectives:(NSArray *)directives;
 
 - (void) markPreviousSelection:(LDrawGLRenderer*)renderer;
 - (void) unmarkPreviousSelection:(LDrawGLRenderer*)renderer;
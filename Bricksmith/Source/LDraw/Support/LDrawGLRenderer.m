@@ -23,11 +23,13 @@
 
 #import "LDrawColor.h"
 #import "LDrawDirective.h"
+#import "LDrawDisplayList.h"
 #import "LDrawDragHandle.h"
 #import "LDrawFile.h"
 #import "LDrawModel.h"
 #import "LDrawPart.h"
 #import "LDrawStep.h"
+#import "LDrawTrace.h"
 #import "LDrawUtilities.h"
 #import "LDrawShaderRenderer.h"
 #include "LDrawVertexes.h"
@@ -43,10 +45,37 @@
 
 
 #define DEBUG_DRAWING				0	// print fps of drawing, and never fall back to bounding boxes no matter how slow.
+#define DEBUG_SHARED_SCENE			0	// re-record the scene every frame and complain if the shared one didn't match.
 #define SIMPLIFICATION_THRESHOLD	0.3 // seconds
+#define DRAG_UPDATE_INTERVAL		(1.0 / 30) // seconds between mouse-over points while dragging
 
 #define HANDLE_SIZE 3
 
+
+//------------------------------------------------------------------------------
+//
+// LDrawSharedScene
+//
+// The recorded traversal of one directive, shared by every renderer drawing 
+// it. The recording is thrown out whenever the directive announces a change.
+//
+//------------------------------------------------------------------------------
+@interface LDrawSharedScene : NSObject
+{
+	LDrawDirective			*directive;		// not retained; only used as the key
+	struct LDrawDLScene		*scene;			// NULL until recorded
+}
++ (LDrawSharedScene *) sharedSceneForDirective:(LDrawDirective *)directive;
+- (id) initWithDirective:(LDrawDirective *)directive;
+- (struct LDrawDLScene *) scene;
+- (void) setScene:(struct LDrawDLScene *)newScene;
+- (void) directiveDidChange:(NSNotification *)notification;
+@end
+
+// LDrawDirective -> LDrawSharedScene; neither retained.
+static NSMapTable *sharedScenes = nil;
+
+
 @implementation LDrawGLRenderer
 
 #pragma mark -
@@ -255,10 +284,69 @@
 	#else
 
 		LDrawShaderRenderer * ren = [[LDrawShaderRenderer alloc] initWithScale:[self zoomPercentageForGL]/100. modelView:[camera getModelView] projection:[camera getProjection]];	
-		[self->fileBeingDrawn drawSelf:ren];
+		struct LDrawDLScene * scene = [self->sharedScene scene];
+		BOOL isDraggingIn = (	[self->fileBeingDrawn respondsToSelector:@selector(draggingDirectives)]
+							 &&	[(id)self->fileBeingDrawn draggingDirectives] != nil );
+	
+		if(isDraggingIn == YES)
+		{
+			// Directives being dragged in are drawn from temporary DLs, which 
+			// can't outlive this traversal; so draw directly. The traversal 
+			// may rebuild DLs the shared scene points to, so it goes too.
+			[self->sharedScene setScene:NULL];
+			TRACE_BEGIN("traverse");
+			[self->fileBeingDrawn drawSelf:ren];
+			TRACE_END("traverse");
+		}
+		else
+		{
+			// Scenes point at DLs they don't own. If any DL has been freed 
+			// since this one was recorded (another file rebuilt a model we 
+			// use, the library reloaded...), it can't be trusted.
+			if(scene != NULL && LDrawDLSceneIsCurrent(scene) == NO)
+			{
+				[self->sharedScene setScene:NULL];
+				scene = NULL;
+			}
+		#if DEBUG_SHARED_SCENE
+			if(scene != NULL)
+			{
+				struct LDrawDLScene * fresh = LDrawDLSceneCreate();
+				[ren beginRecordingScene:fresh];
+				[self->fileBeingDrawn drawSelf:ren];
+				[ren endRecordingScene];
+				if(LDrawDLSceneIsEqual(scene, fresh) == NO)
+					NSLog(@"Shared scene for %@ was out of date.", self->fileBeingDrawn);
+				[self->sharedScene setScene:fresh];
+				scene = fresh;
+			}
+		#endif
+			// Every view onto this file shares one traversal. Whoever draws 
+			// first after a change records it; each view then does only its 
+			// own culling and drawing.
+			if(scene == NULL)
+			{
+				scene = LDrawDLSceneCreate();
+				TRACE_BEGIN("traverse");
+				[ren beginRecordingScene:scene];
+				[self->fileBeingDrawn drawSelf:ren];
+				[ren endRecordingScene];
+				TRACE_END("traverse");
+				[self->sharedScene setScene:scene];
+			}
+			[ren drawScene:scene];
+		}
 		[ren release];
 
 	#endif
+	
+	#if WANT_TRACING
+		// Everything traversed since the last frame, hit testing included.
+		TRACE_COUNTER("directives visited", LDrawTraversalVisitedCount);
+		TRACE_COUNTER("directives skipped", LDrawTraversalSkippedCount);
+		LDrawTraversalVisitedCount = 0;
+		LDrawTraversalSkippedCount = 0;
+	#endif
   
 	// We allow primitive drawing to leave their VAO bound to avoid setting the VAO
 	// back to zero between every draw call.  Set it once here to avoid usign some
@@ -449,10 +537,7 @@
 //==============================================================================
 - (Matrix4) getInverseMatrix
 {
-	Matrix4	transformation	= Matrix4CreateFromGLMatrix4([camera getModelView]);
-	Matrix4	inversed		= Matrix4Invert(transformation);
-	
-	return inversed;
+	return [camera inverseModelViewMatrix];
 	
 }//end getInverseMatrix
 
@@ -470,7 +555,7 @@
 //==============================================================================
 - (Matrix4) getMatrix
 {
-	return Matrix4CreateFromGLMatrix4([camera getModelView]);
+	return [camera modelViewMatrix];
 	
 }//end getMatrix
 
@@ -806,6 +891,11 @@
 	[self->fileBeingDrawn release];
 	self->fileBeingDrawn = newFile;
 	
+	[self->sharedScene release];
+	self->sharedScene = nil;
+	if(newFile)
+		self->sharedScene = [[LDrawSharedScene sharedSceneForDirective:newFile] retain];
+	
 	if(newFile)
 	{
 		bounds = [newFile boundingBox3];
@@ -1071,8 +1161,8 @@
 		if(V3EqualBoxes(boundingBox, InvalidBox) == NO)
 		{		
 			// Project the bounds onto the 2D "canvas"
-			modelView   = Matrix4CreateFromGLMatrix4([camera getModelView]);
-			projection  = Matrix4CreateFromGLMatrix4([camera getProjection]);
+			modelView   = [camera modelViewMatrix];
+			projection  = [camera projectionMatrix];
 			viewport    = [self viewport];
 
 			projectedBounds = [(id)self->fileBeingDrawn
@@ -1193,6 +1283,9 @@
 		[self->delegate LDrawGLRendererNeedsRedisplay:self];
 	}
 	
+	// Handle drags put off updating the vertexes until now.
+	[self optimizeDeferredVertexes];
+	
 	self->activeDragHandle = nil;
 	self->isTrackingDrag = NO; //not anymore.
 	self->selectionMarquee = ZeroBox2;
@@ -1272,9 +1365,7 @@
 		
 		Box2 test_box = V2MakeBoxFromPoints( V2Make(x1, y1), V2Make(x2, y2) );
 
-		Matrix4	mvp =			Matrix4Multiply(
-										Matrix4CreateFromGLMatrix4([camera getModelView]),
-										Matrix4CreateFromGLMatrix4([camera getProjection]));
+		Matrix4	mvp =			[camera modelViewProjectionMatrix];
 					
 		id bestObject = nil;
 		[fileBeingDrawn depthTest:point_clip inBox:test_box transform:mvp creditObject:nil bestObject:&bestObject bestDepth:&depth];
@@ -1397,10 +1488,9 @@
 					 
 	if(moved)
 	{
-		if([self->fileBeingDrawn respondsToSelector:@selector(optimizeVertexes)])
-		{
-			[(id)self->fileBeingDrawn optimizeVertexes];
-		}
+		// Only the moved primitive's vertexes are rewritten now; the whole 
+		// model is re-optimized once the drag ends. 
+		[self noteVertexesNeedOptimizing];
 
 		[self->fileBeingDrawn noteNeedsDisplay];
 
@@ -1722,10 +1812,13 @@
 {
 	if([self->fileBeingDrawn respondsToSelector:@selector(setDraggingDirectives:)])
 	{
+		// This re-optimizes the vertexes itself.
 		[(id)self->fileBeingDrawn setDraggingDirectives:nil];
+		self->vertexesNeedOptimizing = NO;
 		
 		[self->fileBeingDrawn noteNeedsDisplay];
 	}
+	[self optimizeDeferredVertexes];
 }
 
 
@@ -1734,6 +1827,12 @@
 // Purpose:		Adjusts the directives so they align with the given drag 
 //				location, in window coordinates. 
 //
+// Notes:		This runs for every mouse-moved event of the drag, so it only 
+//				moves the dragged directives. Parts draw their library meshes 
+//				through their own transforms, and dragged primitives only have 
+//				their own vertex slots rewritten; the full re-optimization 
+//				waits for -endDragging. 
+//
 //==============================================================================
 - (void) updateDragWithPosition:(Point2)point_view
 				  constrainAxis:(BOOL)constrainAxis
@@ -1758,10 +1857,7 @@
 						 constrainAxis:constrainAxis];
 		if(moved)
 		{
-			if([self->fileBeingDrawn respondsToSelector:@selector(optimizeVertexes)])
-			{
-				[(id)self->fileBeingDrawn optimizeVertexes];
-			}
+			[self noteVertexesNeedOptimizing];
 			
 			[self->fileBeingDrawn noteNeedsDisplay];
 		}
@@ -1827,6 +1923,14 @@
 	// Snap the displacement to the grid.
 	displacement			= [firstDirective position:displacement snappedToGrid:self->gridSpacing];
 	
+	// Then let the delegate pull it onto a nearby connection. An axis 
+	// constraint is a request to move exactly along the axis, so it wins. 
+	if(		constrainAxis == NO
+	   &&	[self->delegate respondsToSelector:@selector(LDrawGLRenderer:snapDisplacement:ofDirectives:)] )
+	{
+		displacement		= [self->delegate LDrawGLRenderer:self snapDisplacement:displacement ofDirectives:directives];
+	}
+	
 	//---------- Update the parts' positions  ------------------------------
 	
 	if(V3EqualPoints(displacement, ZeroPoint3) == NO)
@@ -1928,9 +2032,7 @@
 
 		Box2	test_box = V2MakeBox(x1,y1,x2-x1,y2-y1);
 
-	Matrix4	mvp =			Matrix4Multiply(
-									Matrix4CreateFromGLMatrix4([camera getModelView]),
-									Matrix4CreateFromGLMatrix4([camera getProjection]));
+	Matrix4	mvp =			[camera modelViewProjectionMatrix];
 				
 	id bestObject = nil;
 	[fileBeingDrawn depthTest:point_clip inBox:test_box transform:mvp creditObject:nil bestObject:&bestObject bestDepth:&depth];
@@ -1977,22 +2079,22 @@
 		Ray3                pickRay                 = {{0}};
 		Point3              pickRay_end             = ZeroPoint3;
 		Box2				viewport	            = [self viewport];
-		NSMutableDictionary *hits                   = [NSMutableDictionary dictionary];
+		LDrawHitList        hits;
 		NSUInteger          counter                 = 0;
+		
+		LDrawHitListInit(&hits);
 
 		// convert to 3D viewport coordinates
 		contextNear		= V3Make(point_viewport.x, point_viewport.y, 0.0);
 		contextFar		= V3Make(point_viewport.x, point_viewport.y, 1.0);
 		
 		// Pick Ray
-		pickRay.origin      = V3Unproject(contextNear,
-										  Matrix4CreateFromGLMatrix4([camera getModelView]),
-										  Matrix4CreateFromGLMatrix4([camera getProjection]),
-										  viewport);
-		pickRay_end         = V3Unproject(contextFar,
-										  Matrix4CreateFromGLMatrix4([camera getModelView]),
-										  Matrix4CreateFromGLMatrix4([camera getProjection]),
-										  viewport);
+		pickRay.origin      = V3UnprojectWithInverse(contextNear,
+													 [camera inverseModelViewProjectionMatrix],
+													 viewport);
+		pickRay_end         = V3UnprojectWithInverse(contextFar,
+													 [camera inverseModelViewProjectionMatrix],
+													 viewport);
 		pickRay.direction   = V3Sub(pickRay_end, pickRay.origin);
 		pickRay.direction	= V3Normalize(pickRay.direction);
 		
@@ -2004,10 +2106,10 @@
 											  viewScale:[self zoomPercentageForGL]/100.
 											 boundsOnly:fastDraw
 										   creditObject:nil
-												   hits:hits];
+												   hits:&hits];
 		}
 		
-		clickedDirectives = [self getPartsFromHits:hits];
+		clickedDirectives = [self getPartsFromHits:&hits];
 	}
 
 	return clickedDirectives;
@@ -2062,9 +2164,7 @@
 
 		Box2	test_box = V2MakeBox(x1,y1,x2-x1,y2-y1);
 		
-		Matrix4	mvp =			Matrix4Multiply(
-									  Matrix4CreateFromGLMatrix4([camera getModelView]),
-									  Matrix4CreateFromGLMatrix4([camera getProjection]));
+		Matrix4	mvp =			[camera modelViewProjectionMatrix];
 										
 		// Do hit test
 		for(counter = 0; counter < [directives count]; counter++)
@@ -2097,47 +2197,27 @@
 //				returned from -[LDrawDirective hitTest:...]
 //
 //				Each time something's geometry intersects our pick ray under the 
-//				mouse (and it has a different name), it generates a hit record. 
-//				So we have to investigate our hits and figure out which hit was 
-//				the nearest to the front (smallest minimum depth); that is the 
-//				one we clicked on. 
+//				mouse, it generates a hit record. The hit list keeps only the 
+//				nearest hit for each object, already sorted by depth, so the 
+//				first one is what we clicked on. 
 //
-// Returns:		Array of all the parts under the click. The nearest part is 
-//				guaranteed to be the first entry in the array. There is no 
-//				defined order for the rest of the parts.
+// Returns:		Array of the parts under the click, nearest first. Only the 
+//				nearest LDRAW_HIT_LIST_CAPACITY are there; a nonzero 
+//				LDrawHitListGetOverflowCount means more were behind them. 
 //
 //==============================================================================
 #if 0
 // not used due to depth test
-- (NSArray *) getPartsFromHits:(NSDictionary *)hits
+- (NSArray *) getPartsFromHits:(const LDrawHitList *)hits
 {
-	NSMutableArray  *clickedDirectives  = [NSMutableArray arrayWithCapacity:[hits count]];
-	LDrawDirective  *currentDirective   = nil;
-	float           minimumDepth        = INFINITY;
-	float           currentDepth        = 0;
-	
-	// The hit record depths are mapped as depths along the pick ray. We are 
-	// looking for the shallowest point, because that's what we clicked on. 
+	int             hitCount            = LDrawHitListGetCount(hits);
+	NSMutableArray  *clickedDirectives  = [NSMutableArray arrayWithCapacity:hitCount];
+	int             counter             = 0;
 	
-	for(NSValue *key in hits)
+	for(counter = 0; counter < hitCount; counter++)
 	{
-		currentDirective    = [key pointerValue];
-		currentDepth        = [[hits objectForKey:key] floatValue];
-		
-//		NSLog(@"Hit depth %f %@", currentDepth, currentDirective);
-		
-		if(currentDepth < minimumDepth)
-		{
-			// guarantee shallowest object is first in array
-			[clickedDirectives insertObject:currentDirective atIndex:0];
-			minimumDepth = currentDepth;
-		}
-		else
-		{
-			[clickedDirectives addObject:currentDirective];
-		}
+		[clickedDirectives addObject:(id)LDrawHitListGetObject(hits, counter)];
 	}
-//	NSLog(@"===============================================");
 	
 	return clickedDirectives;
 	
@@ -2145,34 +2225,124 @@
 #endif
 
 
+//========== noteVertexesNeedOptimizing ========================================
+//
+// Purpose:		A drag moved primitives, so the model's optimized vertexes are 
+//				out of date. 
+//
+// Notes:		Re-optimizing means the whole model, and mouse events come much 
+//				faster than that is worth. The moved primitives have already 
+//				marked their own slots dirty, so only those are rewritten now. 
+//				The full re-optimization waits for the end of the drag. 
+//
+//==============================================================================
+- (void) noteVertexesNeedOptimizing
+{
+	self->vertexesNeedOptimizing = YES;
+	
+	if([self->fileBeingDrawn respondsToSelector:@selector(updateChangedVertexes)])
+	{
+		[(id)self->fileBeingDrawn updateChangedVertexes];
+	}
+	
+}//end noteVertexesNeedOptimizing
+
+
+//========== optimizeDeferredVertexes ==========================================
+//
+// Purpose:		Brings the model's optimized vertexes fully up to date after a 
+//				drag only patched the primitives it moved. 
+//
+//==============================================================================
+- (void) optimizeDeferredVertexes
+{
+	if(self->vertexesNeedOptimizing == YES)
+	{
+		if([self->fileBeingDrawn respondsToSelector:@selector(optimizeVertexes)])
+		{
+			[(id)self->fileBeingDrawn optimizeVertexes];
+		}
+		self->vertexesNeedOptimizing = NO;
+	}
+
+}//end optimizeDeferredVertexes
+
+
 //========== publishMouseOverPoint: ============================================
 //
 // Purpose:		Informs the delegate that the mouse is hovering over the model 
 //				point under the view point. 
 //
+// Notes:		Finding the point means depth-testing the model, and mouse 
+//				events can come much faster than anyone can read the 
+//				coordinates. So we publish at most every DRAG_UPDATE_INTERVAL. 
+//				A point which comes too soon is held, and published when the 
+//				interval is up unless a newer one replaces it; the last place 
+//				the mouse stopped is always the one shown. 
+//
 //==============================================================================
 - (void) publishMouseOverPoint:(Point2)point_view
 {
-	Point3		modelPoint			= ZeroPoint3;
-	Vector3		modelAxisForX		= ZeroPoint3;
-	Vector3		modelAxisForY		= ZeroPoint3;
-	Vector3		modelAxisForZ		= ZeroPoint3;
-	Vector3		confidence			= ZeroPoint3;
+	Point3			modelPoint			= ZeroPoint3;
+	Vector3			modelAxisForX		= ZeroPoint3;
+	Vector3			modelAxisForY		= ZeroPoint3;
+	Vector3			modelAxisForZ		= ZeroPoint3;
+	Vector3			confidence			= ZeroPoint3;
+	NSTimeInterval	now					= [NSDate timeIntervalSinceReferenceDate];
+	NSTimeInterval	wait				= self->lastMouseOverTime + DRAG_UPDATE_INTERVAL - now;
+	
+	if([self->delegate respondsToSelector:@selector(LDrawGLRenderer:mouseIsOverPoint:confidence:)] == NO)
+		return;
 	
-	if([self->delegate respondsToSelector:@selector(LDrawGLRenderer:mouseIsOverPoint:confidence:)])
+	if(wait > 0)
 	{
-		modelPoint = [self modelPointForPoint:point_view];
-		
-		if([self projectionMode] == ProjectionModeOrthographic)
+		self->pendingMouseOverPoint = point_view;
+		if(self->mouseOverIsScheduled == NO)
 		{
-			[self getModelAxesForViewX:&modelAxisForX Y:&modelAxisForY Z:&modelAxisForZ];
-			
-			confidence = V3Add(modelAxisForX, modelAxisForY);
+			self->mouseOverIsScheduled = YES;
+			[self performSelector:@selector(publishPendingMouseOverPoint)
+					   withObject:nil
+					   afterDelay:wait
+						  inModes:[NSArray arrayWithObject:NSRunLoopCommonModes]];
 		}
+		return;
+	}
+	
+	// Anything held back is older than this.
+	if(self->mouseOverIsScheduled == YES)
+	{
+		[NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(publishPendingMouseOverPoint) object:nil];
+		self->mouseOverIsScheduled = NO;
+	}
+	
+	self->lastMouseOverTime = now;
+	
+	modelPoint = [self modelPointForPoint:point_view];
+	
+	if([self projectionMode] == ProjectionModeOrthographic)
+	{
+		[self getModelAxesForViewX:&modelAxisForX Y:&modelAxisForY Z:&modelAxisForZ];
 		
-		[self->delegate LDrawGLRenderer:self mouseIsOverPoint:modelPoint confidence:confidence];
+		confidence = V3Add(modelAxisForX, modelAxisForY);
 	}
-}
+	
+	[self->delegate LDrawGLRenderer:self mouseIsOverPoint:modelPoint confidence:confidence];
+	
+}//end publishMouseOverPoint:
+
+
+//========== publishPendingMouseOverPoint ======================================
+//
+// Purpose:		The interval is up; publish the last point we held back.
+//
+//==============================================================================
+- (void) publishPendingMouseOverPoint
+{
+	self->mouseOverIsScheduled = NO;
+	
+	[self publishMouseOverPoint:self->pendingMouseOverPoint];
+	
+}//end publishPendingMouseOverPoint
 
 
 //========== setZoomPercentage:preservePoint: ==================================
@@ -2425,10 +2595,9 @@
 		contextPoint = V3Make(viewportPoint.x, viewportPoint.y, depth);
 	
 		// Convert back to a point in the model.
-		modelPoint = V3Unproject(contextPoint,
-								  Matrix4CreateFromGLMatrix4([camera getModelView]),
-								  Matrix4CreateFromGLMatrix4([camera getProjection]),
-								 [self viewport]);
+		modelPoint = V3UnprojectWithInverse(contextPoint,
+											[camera inverseModelViewProjectionMatrix],
+											[self viewport]);
 	}
 	
 	return modelPoint;
@@ -2479,16 +2648,14 @@
 	// 0.0 (on the near clipping plane) to 1.0 (the far clipping plane). 
 	
 	// - Near clipping plane unprojection
-	nearModelPoint = V3Unproject(V3Make(contextPoint.x, contextPoint.y, 0.0),
-								  Matrix4CreateFromGLMatrix4([camera getModelView]),
-								  Matrix4CreateFromGLMatrix4([camera getProjection]),
-								 viewport);
+	nearModelPoint = V3UnprojectWithInverse(V3Make(contextPoint.x, contextPoint.y, 0.0),
+											[camera inverseModelViewProjectionMatrix],
+											viewport);
 	
 	// - Far clipping plane unprojection
-	farModelPoint = V3Unproject(V3Make(contextPoint.x, contextPoint.y, 1.0),
-								  Matrix4CreateFromGLMatrix4([camera getModelView]),
-								  Matrix4CreateFromGLMatrix4([camera getProjection]),
-								viewport);
+	farModelPoint = V3UnprojectWithInverse(V3Make(contextPoint.x, contextPoint.y, 1.0),
+										   [camera inverseModelViewProjectionMatrix],
+										   viewport);
 	
 	//---------- Derive the actual point from the depth point --------------
 	//
@@ -2555,7 +2722,9 @@
 - (void) dealloc
 {
 	[[NSNotificationCenter defaultCenter] removeObserver:self];
+	[NSObject cancelPreviousPerformRequestsWithTarget:self];
 	
+	[sharedScene	release];
 	[fileBeingDrawn	release];
 
 	[camera release];
@@ -2565,4 +2734,129 @@
 }//end dealloc
 
 
+@end
+
+
+#pragma mark -
+
+@implementation LDrawSharedScene
+
+//========== sharedSceneForDirective: ==========================================
+//
+// Purpose:		Returns the scene every renderer drawing directive should use.
+//
+//==============================================================================
++ (LDrawSharedScene *) sharedSceneForDirective:(LDrawDirective *)directive
+{
+	LDrawSharedScene    *sharedScene    = nil;
+	
+	if(sharedScenes == nil)
+	{
+		sharedScenes = [[NSMapTable alloc] initWithKeyOptions:(NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality)
+												 valueOptions:(NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality)
+													 capacity:0];
+	}
+	
+	sharedScene = NSMapGet(sharedScenes, directive);
+	if(sharedScene == nil)
+	{
+		sharedScene = [[[LDrawSharedScene alloc] initWithDirective:directive] autorelease];
+		NSMapInsert(sharedScenes, directive, sharedScene);
+	}
+	
+	return sharedScene;
+	
+}//end sharedSceneForDirective:
+
+
+//========== initWithDirective: ================================================
+//
+// Purpose:		Starts out with nothing recorded, and listens for the changes 
+//				which make a recording useless.
+//
+// Notes:		These are the same notifications which make renderers redraw, 
+//				so the scene is always gone by the time they do.
+//
+//==============================================================================
+- (id) initWithDirective:(LDrawDirective *)directiveIn
+{
+	self = [super init];
+	if(self)
+	{
+		directive = directiveIn;
+		
+		[[NSNotificationCenter defaultCenter]
+				addObserver:self
+				   selector:@selector(directiveDidChange:)
+					   name:LDrawDirectiveDidChangeNotification
+					 object:directive ];
+		
+		[[NSNotificationCenter defaultCenter]
+				addObserver:self
+				   selector:@selector(directiveDidChange:)
+					   name:LDrawFileActiveModelDidChangeNotification
+					 object:directive ];
+	}
+	return self;
+	
+}//end initWithDirective:
+
+
+//========== scene =============================================================
+//
+// Purpose:		Returns the recorded scene, or NULL if it needs recording.
+//
+//==============================================================================
+- (struct LDrawDLScene *) scene
+{
+	return self->scene;
+	
+}//end scene
+
+
+//========== setScene: =========================================================
+//
+// Purpose:		Takes ownership of a newly-recorded scene. Pass NULL to throw 
+//				out the recording.
+//
+//==============================================================================
+- (void) setScene:(struct LDrawDLScene *)newScene
+{
+	if(self->scene != NULL && self->scene != newScene)
+		LDrawDLSceneDestroy(self->scene);
+	
+	self->scene = newScene;
+	
+}//end setScene:
+
+
+//========== directiveDidChange: ===============================================
+//
+// Purpose:		The directive changed; what we recorded is out of date.
+//
+//==============================================================================
+- (void) directiveDidChange:(NSNotification *)notification
+{
+	[self setScene:NULL];
+	
+}//end directiveDidChange:
+
+
+//========== dealloc ===========================================================
+//
+// Purpose:		The last view of the directive is gone.
+//
+//==============================================================================
+- (void) dealloc
+{
+	[[NSNotificationCenter defaultCenter] removeObserver:self];
+	NSMapRemove(sharedScenes, directive);
+	
+	[self setScene:NULL];
+	
+	[super dealloc];
+	
+}//end dealloc
+
+
 @end
@@ -0,0 +1,138 @@
+//==============================================================================
+//
+// File:		LDrawHitList.c
+//
+// Purpose:		Closest-hits accumulator for hit testing. See LDrawHitList.h.
+//
+// Notes:		The list is small enough that a linear search for the credit
+//				object beats anything cleverer, and registering a hit never
+//				touches the heap.
+//
+//				Keeping only the nearest objects loses nothing we report: an
+//				object is only ever pushed off the end by a full list of objects
+//				all hit nearer than it was. If it is hit again nearer still, it
+//				comes back in at its new depth. What is lost is the rest of the
+//				objects behind them; those are tallied in overflowCount.
+//
+//==============================================================================
+#include "LDrawHitList.h"
+
+
+//========== LDrawHitListInit ==================================================
+//
+// Purpose:		Empties the list.
+//
+//==============================================================================
+void LDrawHitListInit(LDrawHitList *list)
+{
+	list->count			= 0;
+	list->overflowCount	= 0;
+
+}//end LDrawHitListInit
+
+
+//========== LDrawHitListRegister ==============================================
+//
+// Purpose:		Records that object was hit at depth along the pick ray. Only
+//				the shallowest hit for each object is kept.
+//
+//==============================================================================
+void LDrawHitListRegister(LDrawHitList *list, const void *object, float depth)
+{
+	LDrawHitRecord	*records	= list->records;
+	int 			index		= 0;
+
+	for(index = 0; index < list->count; index++)
+	{
+		if(records[index].object == object)
+			break;
+	}
+
+	if(index < list->count)
+	{
+		// Already hit; only a shallower hit moves it.
+		if(depth >= records[index].depth)
+			return;
+	}
+	else if(list->count < LDRAW_HIT_LIST_CAPACITY)
+	{
+		index = list->count;
+		list->count++;
+	}
+	else
+	{
+		// Full. Bump the deepest record, unless this is deeper still. Either 
+		// way, one object under the ray is now missing from the list. 
+		list->overflowCount++;
+		
+		index = LDRAW_HIT_LIST_CAPACITY - 1;
+		if(depth >= records[index].depth)
+			return;
+	}
+
+	// Slide deeper records down into the vacated slot until we find this
+	// hit's place.
+	while(index > 0 && records[index - 1].depth > depth)
+	{
+		records[index] = records[index - 1];
+		index--;
+	}
+	records[index].object	= object;
+	records[index].depth	= depth;
+
+}//end LDrawHitListRegister
+
+
+//========== LDrawHitListGetCount ==============================================
+//
+// Purpose:		Returns the number of distinct objects hit (at most
+//				LDRAW_HIT_LIST_CAPACITY).
+//
+//==============================================================================
+int LDrawHitListGetCount(const LDrawHitList *list)
+{
+	return list->count;
+
+}//end LDrawHitListGetCount
+
+
+//========== LDrawHitListGetOverflowCount ======================================
+//
+// Purpose:		Returns how many times a hit was left out because the list was
+//				full of nearer objects. Zero means the list holds every object
+//				the ray hit.
+//
+// Notes:		An object can be left out more than once, so this is an upper
+//				bound on the number of objects missing rather than an exact
+//				count.
+//
+//==============================================================================
+int LDrawHitListGetOverflowCount(const LDrawHitList *list)
+{
+	return list->overflowCount;
+
+}//end LDrawHitListGetOverflowCount
+
+
+//========== LDrawHitListGetObject =============================================
+//
+// Purpose:		Returns the object of the index'th nearest hit.
+//
+//==============================================================================
+const void * LDrawHitListGetObject(const LDrawHitList *list, int index)
+{
+	return list->records[index].object;
+
+}//end LDrawHitListGetObject
+
+
+//========== LDrawHitListGetDepth ==============================================
+//
+// Purpose:		Returns the depth of the index'th nearest hit.
+//
+//==============================================================================
+float LDrawHitListGetDepth(const LDrawHitList *list, int index)
+{
+	return list->records[index].depth;
+
+}//end LDrawHitListGetDepth
@@ -0,0 +1,68 @@
+//==============================================================================
+//
+// File:		LDrawHitList.h
+//
+// Purpose:		Collects the results of a pick-ray hit test without allocating
+//				anything.
+//
+//				A hit test along a ray through dense geometry can hit thousands
+//				of primitives, most of them credited to the same few parts. The
+//				list keeps one record per credit object, at the shallowest depth
+//				that object was hit, and only the LDRAW_HIT_LIST_CAPACITY
+//				shallowest objects overall. Records are kept sorted by depth,
+//				so record 0 is always the nearest thing under the ray.
+//
+//				The list is a plain struct meant to live on the stack of whoever
+//				starts the hit test; initialize it with LDrawHitListInit.
+//
+//				Objects pushed off the end are counted, so a caller that needs
+//				everything under the ray can tell when the list fell short.
+//
+//				This is plain C, header and implementation alike.
+//
+//==============================================================================
+#ifndef LDrawHitList_h
+#define LDrawHitList_h
+
+// Number of distinct objects a hit list remembers.
+#define LDRAW_HIT_LIST_CAPACITY		16
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Types
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct LDrawHitRecord
+{
+	const void		*object;			// the credit object (not retained)
+	float			depth;				// shallowest depth along the pick ray
+
+} LDrawHitRecord;
+
+
+typedef struct LDrawHitList
+{
+	int				count;
+	int				overflowCount;		// objects hit but kept out by nearer ones
+	LDrawHitRecord	records[LDRAW_HIT_LIST_CAPACITY];	// sorted by depth, shallowest first
+
+} LDrawHitList;
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+////////////////////////////////////////////////////////////////////////////////
+
+extern void				LDrawHitListInit(LDrawHitList *list);
+extern void				LDrawHitListRegister(LDrawHitList *list, const void *object, float depth);
+
+extern int				LDrawHitListGetCount(const LDrawHitList *list);
+extern int				LDrawHitListGetOverflowCount(const LDrawHitList *list);
+extern const void *		LDrawHitListGetObject(const LDrawHitList *list, int index);
+extern float			LDrawHitListGetDepth(const LDrawHitList *list, int index);
+
+#endif
@@ -0,0 +1,94 @@
+//==============================================================================
+//
+// File:		LDrawMemory.h
+//
+// Purpose:		Running totals of the big allocations made by the model and the
+//				renderer, in system memory and on the graphics card, so that we
+//				can tell which of them is growing.
+//
+//				Each allocation site is tagged with what the memory is for.
+//				MEMORY_ALLOC counts a block against its tag and MEMORY_FREE takes
+//				it back off, with the same byte count. Every tag should read zero
+//				once whatever made its blocks has been torn down; a tag which
+//				doesn't is leaking. With DEBUG_DL_MEMORY_BALANCE on, this is 
+//				checked by taking a snapshot, round-tripping display lists 
+//				through every path (LDrawDLCheckMemoryBalance), and comparing.
+//
+//				These are only totals. For the per-document and per-part split
+//				of display list memory, ask the models themselves; see
+//				-[LDrawModel displayListByteSize] and
+//				-[PartLibrary displayListByteSizesByPart].
+//
+//				This header is plain C so that the C renderer files can use it.
+//				Counting compiles away unless WANT_MEMORY_ACCOUNTING is set.
+//
+//==============================================================================
+#ifndef LDrawMemory_h
+#define LDrawMemory_h
+
+#include <stdint.h>
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Types
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef enum
+{
+	LDrawMemoryBDP				= 0,	// BDP pool pages (system)
+	LDrawMemoryMeshSmooth		= 1,	// MeshSmooth meshes, while a DL is smoothed (system)
+	LDrawMemoryPreparedDL		= 2,	// DLs built but not yet uploaded (system)
+	LDrawMemoryDLVertexes		= 3,	// DL vertex buffers (GPU)
+	LDrawMemoryDLIndexes		= 4,	// DL index buffers (GPU)
+	LDrawMemoryInstanceBuffers	= 5,	// instancing rings of the DL sessions (GPU)
+	LDrawMemoryVertexBuffers	= 6,	// LDrawVertexes buffers (GPU)
+	LDrawMemoryTextures			= 7,	// part library textures (GPU)
+	LDrawMemoryTagCount			= 8
+
+} LDrawMemoryTagT;
+
+
+// The totals at one moment, for checking that some piece of work gave back 
+// everything it took. 
+typedef struct LDrawMemorySnapshot
+{
+	int64_t			bytes[LDrawMemoryTagCount];
+	int64_t			blocks[LDrawMemoryTagCount];
+
+} LDrawMemorySnapshot;
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Instrumentation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if WANT_MEMORY_ACCOUNTING
+	#define MEMORY_ALLOC(tag, bytes)		LDrawMemoryCount(tag,  (int64_t)(bytes),  1)
+	#define MEMORY_FREE(tag, bytes)			LDrawMemoryCount(tag, -(int64_t)(bytes), -1)
+#else
+	#define MEMORY_ALLOC(tag, bytes)		do { } while(0)
+	#define MEMORY_FREE(tag, bytes)			do { } while(0)
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+////////////////////////////////////////////////////////////////////////////////
+
+extern void				LDrawMemoryCount(LDrawMemoryTagT tag, int64_t bytes, int blocks);
+
+extern int64_t			LDrawMemoryGetBytes(LDrawMemoryTagT tag);
+extern int64_t			LDrawMemoryGetBlocks(LDrawMemoryTagT tag);
+extern const char *		LDrawMemoryGetTagName(LDrawMemoryTagT tag);
+extern int				LDrawMemoryIsBalanced(void);
+
+extern void				LDrawMemoryTakeSnapshot(LDrawMemorySnapshot *snapshot);
+extern int				LDrawMemoryIsBalancedSince(const LDrawMemorySnapshot *snapshot);
+
+#endif
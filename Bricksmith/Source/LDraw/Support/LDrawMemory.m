@@ -0,0 +1,153 @@
+//==============================================================================
+//
+// File:		LDrawMemory.m
+//
+// Purpose:		Running totals of allocations by tag. See LDrawMemory.h.
+//
+// Notes:		Blocks are counted from any thread, so the totals are updated
+//				atomically. A report reads each total on its own; totals read
+//				while other threads are busy may be a block apart from one
+//				another, but none of them is ever torn.
+//
+//==============================================================================
+#import "LDrawMemory.h"
+
+#import <libkern/OSAtomic.h>
+
+static volatile int64_t	MemoryBytes[LDrawMemoryTagCount];
+static volatile int64_t	MemoryBlocks[LDrawMemoryTagCount];
+
+static const char		*MemoryTagNames[LDrawMemoryTagCount] = {	"BDP pools",
+																	"MeshSmooth meshes",
+																	"prepared display lists",
+																	"display list vertexes",
+																	"display list indexes",
+																	"instance buffers",
+																	"LDrawVertexes buffers",
+																	"textures" };
+
+
+//========== LDrawMemoryCount ==================================================
+//
+// Purpose:		Adds bytes and blocks to the totals for tag. Freeing passes
+//				negative counts.
+//
+//==============================================================================
+void LDrawMemoryCount(LDrawMemoryTagT tag, int64_t bytes, int blocks)
+{
+	OSAtomicAdd64Barrier(bytes,  &MemoryBytes[tag]);
+	OSAtomicAdd64Barrier(blocks, &MemoryBlocks[tag]);
+
+}//end LDrawMemoryCount
+
+
+//========== LDrawMemoryGetBytes ===============================================
+//
+// Purpose:		Returns the bytes currently counted against tag.
+//
+//==============================================================================
+int64_t LDrawMemoryGetBytes(LDrawMemoryTagT tag)
+{
+	return OSAtomicAdd64Barrier(0, &MemoryBytes[tag]);
+
+}//end LDrawMemoryGetBytes
+
+
+//========== LDrawMemoryGetBlocks ==============================================
+//
+// Purpose:		Returns the number of blocks currently counted against tag.
+//
+//==============================================================================
+int64_t LDrawMemoryGetBlocks(LDrawMemoryTagT tag)
+{
+	return OSAtomicAdd64Barrier(0, &MemoryBlocks[tag]);
+
+}//end LDrawMemoryGetBlocks
+
+
+//========== LDrawMemoryGetTagName =============================================
+//
+// Purpose:		Returns a human-readable name for tag.
+//
+//==============================================================================
+const char * LDrawMemoryGetTagName(LDrawMemoryTagT tag)
+{
+	return MemoryTagNames[tag];
+
+}//end LDrawMemoryGetTagName
+
+
+//========== LDrawMemoryIsBalanced =============================================
+//
+// Purpose:		Returns nonzero if every tag is back to zero bytes and zero
+//				blocks, as it should be after everything has been torn down.
+//
+// Notes:		The instancing rings and the part library's textures live as
+//				long as the program does, so they are left out.
+//
+//==============================================================================
+int LDrawMemoryIsBalanced(void)
+{
+	int counter = 0;
+
+	for(counter = 0; counter < LDrawMemoryTagCount; counter++)
+	{
+		if(		counter == LDrawMemoryInstanceBuffers
+			||	counter == LDrawMemoryTextures )
+		{
+			continue;
+		}
+		if(		LDrawMemoryGetBytes(counter)  != 0
+			||	LDrawMemoryGetBlocks(counter) != 0 )
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+
+}//end LDrawMemoryIsBalanced
+
+
+//========== LDrawMemoryTakeSnapshot ===========================================
+//
+// Purpose:		Copies down every total as it stands now.
+//
+//==============================================================================
+void LDrawMemoryTakeSnapshot(LDrawMemorySnapshot *snapshot)
+{
+	int counter = 0;
+
+	for(counter = 0; counter < LDrawMemoryTagCount; counter++)
+	{
+		snapshot->bytes[counter]	= LDrawMemoryGetBytes(counter);
+		snapshot->blocks[counter]	= LDrawMemoryGetBlocks(counter);
+	}
+
+}//end LDrawMemoryTakeSnapshot
+
+
+//========== LDrawMemoryIsBalancedSince ========================================
+//
+// Purpose:		Returns nonzero if every total is just what it was when snapshot
+//				was taken; that is, whatever was allocated since has been freed.
+//
+// Notes:		Only meaningful if nothing else is allocating at the same time.
+//
+//==============================================================================
+int LDrawMemoryIsBalancedSince(const LDrawMemorySnapshot *snapshot)
+{
+	int counter = 0;
+
+	for(counter = 0; counter < LDrawMemoryTagCount; counter++)
+	{
+		if(		LDrawMemoryGetBytes(counter)  != snapshot->bytes[counter]
+			||	LDrawMemoryGetBlocks(counter) != snapshot->blocks[counter] )
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+
+}//end LDrawMemoryIsBalancedSince
@@ -0,0 +1,95 @@
+//==============================================================================
+//
+// File:		LDrawMeshExporter.h
+//
+// Purpose:		Writes a model's surfaces out as a triangle mesh, for renderers
+//				and 3D printers: glTF, Wavefront OBJ or binary STL.
+//
+//				The same part is usually used over and over, so flattening the
+//				whole model into one mesh would smooth and store each part
+//				thousands of times. Instead each library part (and each submodel
+//				with loose primitives of its own) is smoothed once, exactly as
+//				the renderer does it, and then written out for every place it is
+//				used:
+//
+//				glTF	Each part mesh is written once per color it needs--once
+//						in all, if it has no meta-colors--and each part becomes
+//						a node referring to its mesh.
+//				OBJ		OBJ has no instancing, so every part is written as its
+//						own group, transformed, with materials by color.
+//				STL		Every triangle is transformed and written on the fly.
+//
+//				Nothing is kept per part; memory is bounded by the unique part
+//				meshes (plus, for glTF, a few numbers per mesh).
+//
+//				Directives report what they draw through -collectMeshExport:,
+//				much as they report parts through -collectPartReport:. A part
+//				brackets whatever it draws with -beginPart:/-endPart; a model
+//				reports its own surfaces with -addMeshOfModel:.
+//
+//				LDraw runs -Y up in LDraw units. STL and OBJ come out in
+//				millimeters and glTF in meters, with +Y up.
+//
+//==============================================================================
+#import <Foundation/Foundation.h>
+
+#import "MatrixMath.h"
+
+@class LDrawContainer;
+@class LDrawModel;
+@class LDrawPart;
+
+
+// Output formats
+typedef enum
+{
+	LDrawMeshFormatGLTF		= 0,
+	LDrawMeshFormatOBJ		= 1,
+	LDrawMeshFormatSTL		= 2
+
+} LDrawMeshFormatT;
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// class LDrawMeshExporter
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface LDrawMeshExporter : NSObject
+{
+	NSString			*path;
+	LDrawMeshFormatT	format;
+
+	FILE				*file;
+	FILE				*binaryFile;			// glTF buffer
+	NSMapTable			*meshes;				// LDrawModel -> LDrawMeshExportMesh
+	NSMutableData		*frames;				// stack of LDrawMeshExportFrame
+	NSMutableData		*glTFMeshes;			// LDrawMeshExportGLTFMesh, in glTF mesh order
+	NSMutableDictionary	*materials;				// OBJ material name -> MTL entry
+	unsigned long long	binaryLength;
+
+	NSUInteger			instanceCount;
+	NSUInteger			triangleCount;
+	NSUInteger			vertexCount;			// OBJ vertexes written so far
+	NSTimeInterval		elapsedTime;
+}
+
+// Initialization
++ (BOOL) getFormat:(LDrawMeshFormatT *)formatOut forPathExtension:(NSString *)extension;
+- (id) initWithPath:(NSString *)pathIn format:(LDrawMeshFormatT)formatIn;
+
+// Accessors
+- (NSTimeInterval) elapsedTime;
+- (NSUInteger) instanceCount;
+- (NSUInteger) meshCount;
+- (NSUInteger) triangleCount;
+
+// Exporting
+- (BOOL) writeContainer:(LDrawContainer *)container;
+
+// Collecting
+- (void) beginPart:(LDrawPart *)part;
+- (void) endPart;
+- (void) addMeshOfModel:(LDrawModel *)model;
+
+@end
@@ -0,0 +1,1146 @@
+//==============================================================================
+//
+// File:		LDrawMeshExporter.m
+//
+// Purpose:		Writes a model out as a triangle mesh. See LDrawMeshExporter.h.
+//
+// Notes:		Part meshes come from the same collector and smoother the
+//				renderer uses to build its display lists, so an exported part
+//				looks just like it does on screen. Quads are split into
+//				triangles and lines are left out. Textured meshes can't be
+//				collected off screen (see LDrawDLCollector.h), so they are left
+//				out too.
+//
+//				Meta-colors are resolved the way the shader does: alpha 0 marks
+//				one, and red mixes between the current color and its
+//				compliment.
+//
+//				The glTF JSON is written as we go. Nodes are streamed out in the
+//				order parts are found; the root node has to list them all as
+//				its children, so it goes last, and everything which depends only
+//				on the unique meshes follows it.
+//
+//==============================================================================
+#import "LDrawMeshExporter.h"
+
+#import <libkern/OSByteOrder.h>
+#import <stdio.h>
+
+#import "ColorLibrary.h"
+#import "LDrawColor.h"
+#import "LDrawContainer.h"
+#import "LDrawDisplayList.h"
+#import "LDrawDLCollector.h"
+#import "LDrawModel.h"
+#import "LDrawPart.h"
+#import "LDrawTrace.h"
+
+// Size of one LDraw unit in the output.
+#define LDU_IN_MILLIMETERS		0.4
+#define LDU_IN_METERS			0.0004
+
+// glTF constants
+#define GLTF_FLOAT				5126
+#define GLTF_UNSIGNED_INT		5125
+#define GLTF_ARRAY_BUFFER		34962
+#define GLTF_ELEMENT_BUFFER		34963
+
+
+// Where the collection stands inside nested parts.
+typedef struct LDrawMeshExportFrame
+{
+	Matrix4			transform;				// model to output coordinates
+	LDrawColor		*color;					// current color (not retained)
+	NSString		*name;					// innermost part (not retained)
+
+} LDrawMeshExportFrame;
+
+
+// One mesh written to the glTF buffer.
+typedef struct LDrawMeshExportGLTFMesh
+{
+	unsigned long long	byteOffset;
+	int					vertexCount;
+	int					indexCount;
+	float				minimum[3];
+	float				maximum[3];
+	BOOL				isTranslucent;
+
+} LDrawMeshExportGLTFMesh;
+
+
+//------------------------------------------------------------------------------
+//
+// LDrawMeshExportMesh
+//
+// The smoothed surfaces of one model.
+//
+//------------------------------------------------------------------------------
+@interface LDrawMeshExportMesh : NSObject
+{
+@public
+	struct LDrawDLPrepared	*prepared;				// NULL if there is nothing to export
+	int						vertexCount;
+	const GLfloat			*vertexes;				// LDrawDLVertexStride floats each; belong to prepared
+	NSMutableData			*triangles;				// GLuint vertex indexes, three per triangle
+	NSUInteger				triangleCount;
+	BOOL					hasMetaColors;
+	NSInteger				glTFMesh;				// without meta-colors, the one glTF mesh, or -1
+	NSMapTable				*glTFMeshesByColor;		// with meta-colors, LDrawColor -> NSNumber
+}
+- (id) initWithModel:(LDrawModel *)model;
+@end
+
+
+@interface LDrawMeshExporter (Private)
+
+- (LDrawMeshExportFrame *) currentFrame;
+- (LDrawMeshExportMesh *) meshForModel:(LDrawModel *)model;
+
+- (BOOL) openFiles;
+- (BOOL) closeFiles;
+- (void) writePreamble;
+- (void) writePostamble;
+
+- (void) writeGLTFNodeForMesh:(LDrawMeshExportMesh *)mesh frame:(LDrawMeshExportFrame *)frame;
+- (NSInteger) writeGLTFMesh:(LDrawMeshExportMesh *)mesh color:(LDrawColor *)color;
+- (void) writeGLTFPostamble;
+- (void) writeOBJGroupForMesh:(LDrawMeshExportMesh *)mesh frame:(LDrawMeshExportFrame *)frame;
+- (NSString *) OBJMaterialForColor:(const GLfloat *)rgba;
+- (BOOL) writeMTLFile;
+- (void) writeSTLTrianglesForMesh:(LDrawMeshExportMesh *)mesh frame:(LDrawMeshExportFrame *)frame;
+
+@end
+
+static uint32_t	PackColor(const GLfloat *rgba);
+static void		ResolveColor(const GLfloat *vertexColor, const GLfloat *current, const GLfloat *compliment, GLfloat *resolved);
+static void		WriteFloats(FILE *file, const float *values, size_t count);
+static void		WriteInts(FILE *file, const uint32_t *values, size_t count);
+static void		WriteJSONString(FILE *file, NSString *string);
+
+
+@implementation LDrawMeshExporter
+
+#pragma mark -
+#pragma mark INITIALIZATION
+#pragma mark -
+
+//========== getFormat:forPathExtension: =======================================
+//
+// Purpose:		Finds the format written to files with the given extension.
+//				Returns NO if we don't write that kind of file.
+//
+//==============================================================================
++ (BOOL) getFormat:(LDrawMeshFormatT *)formatOut forPathExtension:(NSString *)extension
+{
+	NSString	*lowercase	= [extension lowercaseString];
+	BOOL		found		= YES;
+
+	if([lowercase isEqualToString:@"gltf"])
+		*formatOut = LDrawMeshFormatGLTF;
+	else if([lowercase isEqualToString:@"obj"])
+		*formatOut = LDrawMeshFormatOBJ;
+	else if([lowercase isEqualToString:@"stl"])
+		*formatOut = LDrawMeshFormatSTL;
+	else
+		found = NO;
+
+	return found;
+
+}//end getFormat:forPathExtension:
+
+
+//========== initWithPath:format: ==============================================
+//
+// Purpose:		Prepares to write one model to path. glTF and OBJ also write a
+//				companion file (.bin or .mtl) next to it.
+//
+//==============================================================================
+- (id) initWithPath:(NSString *)pathIn format:(LDrawMeshFormatT)formatIn
+{
+	self = [super init];
+	if(self)
+	{
+		path        = [pathIn copy];
+		format      = formatIn;
+		meshes      = [[NSMapTable alloc] initWithKeyOptions:(NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality)
+											valueOptions:NSPointerFunctionsStrongMemory
+												capacity:256];
+		frames      = [[NSMutableData alloc] init];
+		glTFMeshes  = [[NSMutableData alloc] init];
+		materials   = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+
+}//end initWithPath:format:
+
+
+#pragma mark -
+#pragma mark ACCESSORS
+#pragma mark -
+
+//========== elapsedTime =======================================================
+//
+// Purpose:		Seconds the last -writeContainer: took.
+//
+//==============================================================================
+- (NSTimeInterval) elapsedTime
+{
+	return self->elapsedTime;
+
+}//end elapsedTime
+
+
+//========== instanceCount =====================================================
+//
+// Purpose:		Number of part meshes placed in the model.
+//
+//==============================================================================
+- (NSUInteger) instanceCount
+{
+	return self->instanceCount;
+
+}//end instanceCount
+
+
+//========== meshCount =========================================================
+//
+// Purpose:		Number of distinct meshes smoothed. For glTF, the number of
+//				meshes written, which counts a mesh with meta-colors once for
+//				each color it was used in.
+//
+//==============================================================================
+- (NSUInteger) meshCount
+{
+	LDrawMeshExportMesh *mesh   = nil;
+	NSUInteger          count   = 0;
+
+	if(self->format == LDrawMeshFormatGLTF)
+		count = [self->glTFMeshes length] / sizeof(LDrawMeshExportGLTFMesh);
+	else
+	{
+		for(mesh in [self->meshes objectEnumerator])
+		{
+			if(mesh->prepared != NULL)
+				count++;
+		}
+	}
+	return count;
+
+}//end meshCount
+
+
+//========== triangleCount =====================================================
+//
+// Purpose:		Number of triangles in the model as placed, whether or not they
+//				were written out once per part.
+//
+//==============================================================================
+- (NSUInteger) triangleCount
+{
+	return self->triangleCount;
+
+}//end triangleCount
+
+
+#pragma mark -
+#pragma mark EXPORTING
+#pragma mark -
+
+//========== writeContainer: ===================================================
+//
+// Purpose:		Writes everything container draws. Returns NO if the files
+//				could not be written.
+//
+// Notes:		An exporter writes only once.
+//
+//==============================================================================
+- (BOOL) writeContainer:(LDrawContainer *)container
+{
+	NSTimeInterval			startTime	= [NSDate timeIntervalSinceReferenceDate];
+	LDrawMeshExportFrame	root;
+	BOOL					success 	= NO;
+
+	TRACE_BEGIN("export mesh");
+
+	// glTF puts the change of axes on the root node; the others have to bake
+	// it into every vertex.
+	memset(&root, 0, sizeof(root));
+	root.transform	= IdentityMatrix4;
+	root.color		= [[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor];
+	if(self->format != LDrawMeshFormatGLTF)
+	{
+		root.transform.element[0][0] =  LDU_IN_MILLIMETERS;
+		root.transform.element[1][1] = -LDU_IN_MILLIMETERS;
+		root.transform.element[2][2] = -LDU_IN_MILLIMETERS;
+	}
+	[self->frames setLength:0];
+	[self->frames appendBytes:&root length:sizeof(root)];
+
+	if([self openFiles] == YES)
+	{
+		[self writePreamble];
+		[container collectMeshExport:self];
+		[self writePostamble];
+
+		success = [self closeFiles];
+	}
+
+	TRACE_END("export mesh");
+
+	self->elapsedTime = [NSDate timeIntervalSinceReferenceDate] - startTime;
+
+	return success;
+
+}//end writeContainer:
+
+
+#pragma mark -
+#pragma mark COLLECTING
+#pragma mark -
+
+//========== beginPart: ========================================================
+//
+// Purpose:		Everything reported until the matching -endPart is drawn by
+//				part, in its position and color.
+//
+//==============================================================================
+- (void) beginPart:(LDrawPart *)part
+{
+	LDrawMeshExportFrame	frame		= *[self currentFrame];
+	LDrawColor				*partColor	= [part LDrawColor];
+
+	frame.transform = Matrix4Multiply([part transformationMatrix], frame.transform);
+	frame.name      = [part referenceName];
+
+	if([partColor colorCode] == LDrawEdgeColor)
+		frame.color = [frame.color complimentColor];
+	else if([partColor colorCode] != LDrawCurrentColor)
+		frame.color = partColor;
+
+	[self->frames appendBytes:&frame length:sizeof(frame)];
+
+}//end beginPart:
+
+
+//========== endPart ===========================================================
+//
+// Purpose:		Returns to the position and color of the enclosing part.
+//
+//==============================================================================
+- (void) endPart
+{
+	[self->frames setLength:[self->frames length] - sizeof(LDrawMeshExportFrame)];
+
+}//end endPart
+
+
+//========== addMeshOfModel: ===================================================
+//
+// Purpose:		Writes out model's own surfaces where the current part puts
+//				them.
+//
+//==============================================================================
+- (void) addMeshOfModel:(LDrawModel *)model
+{
+	NSAutoreleasePool		*pool	= [[NSAutoreleasePool alloc] init];
+	LDrawMeshExportMesh 	*mesh	= [self meshForModel:model];
+	LDrawMeshExportFrame	*frame	= [self currentFrame];
+
+	// A big model has tens of thousands of parts; don't let their scraps
+	// pile up.
+	if(mesh->prepared != NULL)
+	{
+		self->instanceCount += 1;
+		self->triangleCount += mesh->triangleCount;
+
+		switch(self->format)
+		{
+			case LDrawMeshFormatGLTF:
+				[self writeGLTFNodeForMesh:mesh frame:frame];
+				break;
+			case LDrawMeshFormatOBJ:
+				[self writeOBJGroupForMesh:mesh frame:frame];
+				break;
+			case LDrawMeshFormatSTL:
+				[self writeSTLTrianglesForMesh:mesh frame:frame];
+				break;
+		}
+	}
+
+	[pool release];
+
+}//end addMeshOfModel:
+
+
+#pragma mark -
+#pragma mark UTILITIES
+#pragma mark -
+
+//========== currentFrame ======================================================
+//
+// Purpose:		The innermost part being collected.
+//
+//==============================================================================
+- (LDrawMeshExportFrame *) currentFrame
+{
+	char *top = (char *)[self->frames mutableBytes] + [self->frames length];
+
+	return (LDrawMeshExportFrame *)(top - sizeof(LDrawMeshExportFrame));
+
+}//end currentFrame
+
+
+//========== meshForModel: =====================================================
+//
+// Purpose:		Returns the smoothed surfaces of model, smoothing them the first
+//				time model is used.
+//
+//==============================================================================
+- (LDrawMeshExportMesh *) meshForModel:(LDrawModel *)model
+{
+	LDrawMeshExportMesh *mesh = [self->meshes objectForKey:model];
+
+	if(mesh == nil)
+	{
+		mesh = [[LDrawMeshExportMesh alloc] initWithModel:model];
+		[self->meshes setObject:mesh forKey:model];
+		[mesh release];
+	}
+	return mesh;
+
+}//end meshForModel:
+
+
+//========== openFiles =========================================================
+//
+// Purpose:		Opens the output and, for glTF, its buffer.
+//
+//==============================================================================
+- (BOOL) openFiles
+{
+	NSString *binaryPath = nil;
+
+	self->file = fopen([self->path fileSystemRepresentation], "wb");
+
+	if(self->file != NULL && self->format == LDrawMeshFormatGLTF)
+	{
+		binaryPath          = [[self->path stringByDeletingPathExtension] stringByAppendingPathExtension:@"bin"];
+		self->binaryFile    = fopen([binaryPath fileSystemRepresentation], "wb");
+
+		if(self->binaryFile == NULL)
+		{
+			fclose(self->file);
+			self->file = NULL;
+		}
+	}
+
+	return (self->file != NULL);
+
+}//end openFiles
+
+
+//========== closeFiles ========================================================
+//
+// Purpose:		Flushes everything out. Returns NO if anything failed to write.
+//
+//==============================================================================
+- (BOOL) closeFiles
+{
+	BOOL success = YES;
+
+	if(ferror(self->file) || fclose(self->file) != 0)
+		success = NO;
+	self->file = NULL;
+
+	if(self->binaryFile != NULL)
+	{
+		if(ferror(self->binaryFile) || fclose(self->binaryFile) != 0)
+			success = NO;
+		self->binaryFile = NULL;
+	}
+
+	if(self->format == LDrawMeshFormatOBJ && success == YES)
+		success = [self writeMTLFile];
+
+	return success;
+
+}//end closeFiles
+
+
+//========== writePreamble =====================================================
+//
+// Purpose:		Writes whatever comes before the first part.
+//
+//==============================================================================
+- (void) writePreamble
+{
+	char		header[80]	= "Bricksmith";
+	uint32_t	count		= 0;
+	NSString	*mtlName	= nil;
+
+	switch(self->format)
+	{
+		case LDrawMeshFormatGLTF:
+			fputs("{\"asset\":{\"version\":\"2.0\",\"generator\":\"Bricksmith\"},\n\"nodes\":[\n", self->file);
+			break;
+
+		case LDrawMeshFormatOBJ:
+			mtlName = [[[self->path lastPathComponent] stringByDeletingPathExtension] stringByAppendingPathExtension:@"mtl"];
+			fprintf(self->file, "# Bricksmith\nmtllib %s\n", [mtlName UTF8String]);
+			break;
+
+		case LDrawMeshFormatSTL:
+			// The triangle count is filled in at the end.
+			fwrite(header, sizeof(header), 1, self->file);
+			WriteInts(self->file, &count, 1);
+			break;
+	}
+
+}//end writePreamble
+
+
+//========== writePostamble ====================================================
+//
+// Purpose:		Finishes off the output after the last part.
+//
+//==============================================================================
+- (void) writePostamble
+{
+	uint32_t count = (uint32_t)self->triangleCount;
+
+	switch(self->format)
+	{
+		case LDrawMeshFormatGLTF:
+			[self writeGLTFPostamble];
+			break;
+
+		case LDrawMeshFormatOBJ:
+			break;
+
+		case LDrawMeshFormatSTL:
+			fseek(self->file, 80, SEEK_SET);
+			WriteInts(self->file, &count, 1);
+			break;
+	}
+
+}//end writePostamble
+
+
+#pragma mark -
+
+//========== writeGLTFNodeForMesh:frame: =======================================
+//
+// Purpose:		Writes a node placing mesh in the current part's position and
+//				color, writing the mesh itself if this is its first use.
+//
+//==============================================================================
+- (void) writeGLTFNodeForMesh:(LDrawMeshExportMesh *)mesh frame:(LDrawMeshExportFrame *)frame
+{
+	NSNumber	*meshNumber 	= nil;
+	NSInteger	meshIndex		= mesh->glTFMesh;
+	GLfloat 	matrix[16]		= {0};
+	int 		counter 		= 0;
+
+	if(mesh->hasMetaColors)
+	{
+		meshNumber = [mesh->glTFMeshesByColor objectForKey:frame->color];
+		if(meshNumber == nil)
+		{
+			meshIndex   = [self writeGLTFMesh:mesh color:frame->color];
+			meshNumber  = [NSNumber numberWithInteger:meshIndex];
+			[mesh->glTFMeshesByColor setObject:meshNumber forKey:frame->color];
+		}
+		meshIndex = [meshNumber integerValue];
+	}
+	else if(meshIndex < 0)
+	{
+		meshIndex       = [self writeGLTFMesh:mesh color:frame->color];
+		mesh->glTFMesh  = meshIndex;
+	}
+
+	// Our row-vector matrices read out in the column-major order glTF wants.
+	Matrix4GetGLMatrix4(frame->transform, matrix);
+
+	if(self->instanceCount > 1)
+		fputs(",\n", self->file);
+	fprintf(self->file, "{\"mesh\":%ld,", (long)meshIndex);
+	if(frame->name != nil)
+	{
+		fputs("\"name\":", self->file);
+		WriteJSONString(self->file, frame->name);
+		fputs(",", self->file);
+	}
+	fputs("\"matrix\":[", self->file);
+	for(counter = 0; counter < 16; counter++)
+		fprintf(self->file, "%s%.7g", counter ? "," : "", matrix[counter]);
+	fputs("]}", self->file);
+
+}//end writeGLTFNodeForMesh:frame:
+
+
+//========== writeGLTFMesh:color: ==============================================
+//
+// Purpose:		Appends mesh, in color, to the buffer. Returns its glTF mesh
+//				index.
+//
+//==============================================================================
+- (NSInteger) writeGLTFMesh:(LDrawMeshExportMesh *)mesh color:(LDrawColor *)color
+{
+	LDrawMeshExportGLTFMesh record;
+	const GLfloat			*vertex 		= NULL;
+	const GLuint			*corners		= [mesh->triangles bytes];
+	GLfloat 				current[4]		= {0};
+	GLfloat 				compliment[4]	= {0};
+	GLfloat 				resolved[4] 	= {0};
+	Vector3 				normal			= ZeroPoint3;
+	int 					counter 		= 0;
+	int 					axis			= 0;
+
+	[color getColorRGBA:current];
+	[[color complimentColor] getColorRGBA:compliment];
+
+	memset(&record, 0, sizeof(record));
+	record.byteOffset   = self->binaryLength;
+	record.vertexCount  = mesh->vertexCount;
+	record.indexCount   = (int)mesh->triangleCount * 3;
+
+	// Positions
+	for(axis = 0; axis < 3; axis++)
+	{
+		record.minimum[axis] =  INFINITY;
+		record.maximum[axis] = -INFINITY;
+	}
+	for(counter = 0; counter < mesh->vertexCount; counter++)
+	{
+		vertex = mesh->vertexes + counter * LDrawDLVertexStride;
+		for(axis = 0; axis < 3; axis++)
+		{
+			record.minimum[axis] = MIN(record.minimum[axis], vertex[axis]);
+			record.maximum[axis] = MAX(record.maximum[axis], vertex[axis]);
+		}
+		WriteFloats(self->binaryFile, vertex, 3);
+	}
+
+	// Normals; glTF insists they be unit length.
+	for(counter = 0; counter < mesh->vertexCount; counter++)
+	{
+		vertex  = mesh->vertexes + counter * LDrawDLVertexStride;
+		normal  = V3Normalize(V3Make(vertex[3], vertex[4], vertex[5]));
+		WriteFloats(self->binaryFile, &normal.x, 1);
+		WriteFloats(self->binaryFile, &normal.y, 1);
+		WriteFloats(self->binaryFile, &normal.z, 1);
+	}
+
+	// Colors
+	for(counter = 0; counter < mesh->vertexCount; counter++)
+	{
+		vertex = mesh->vertexes + counter * LDrawDLVertexStride;
+		ResolveColor(vertex + 6, current, compliment, resolved);
+		if(resolved[3] < 1.0)
+			record.isTranslucent = YES;
+		WriteFloats(self->binaryFile, resolved, 4);
+	}
+
+	// Indexes
+	WriteInts(self->binaryFile, corners, record.indexCount);
+
+	self->binaryLength += (unsigned long long)record.vertexCount * (3 + 3 + 4) * sizeof(float);
+	self->binaryLength += (unsigned long long)record.indexCount * sizeof(uint32_t);
+
+	[self->glTFMeshes appendBytes:&record length:sizeof(record)];
+
+	return [self->glTFMeshes length] / sizeof(LDrawMeshExportGLTFMesh) - 1;
+
+}//end writeGLTFMesh:color:
+
+
+//========== writeGLTFPostamble ================================================
+//
+// Purpose:		Writes the root node, which turns LDraw's axes into glTF's, and
+//				then the meshes and the layout of the buffer.
+//
+//==============================================================================
+- (void) writeGLTFPostamble
+{
+	const LDrawMeshExportGLTFMesh	*records		= [self->glTFMeshes bytes];
+	const LDrawMeshExportGLTFMesh	*record 		= NULL;
+	NSUInteger						meshCount		= [self->glTFMeshes length] / sizeof(LDrawMeshExportGLTFMesh);
+	NSString						*binaryName 	= nil;
+	unsigned long long				offset			= 0;
+	unsigned long long				vertexBytes 	= 0;
+	NSUInteger						counter 		= 0;
+
+	// Root node
+	if(self->instanceCount > 0)
+		fputs(",\n", self->file);
+	fputs("{\"name\":", self->file);
+	WriteJSONString(self->file, [[self->path lastPathComponent] stringByDeletingPathExtension]);
+	fprintf(self->file, ",\"matrix\":[%g,0,0,0, 0,%g,0,0, 0,0,%g,0, 0,0,0,1]",
+			LDU_IN_METERS, -LDU_IN_METERS, -LDU_IN_METERS);
+	if(self->instanceCount > 0)
+	{
+		fputs(",\"children\":[", self->file);
+		for(counter = 0; counter < self->instanceCount; counter++)
+			fprintf(self->file, "%s%lu", counter ? "," : "", (unsigned long)counter);
+		fputs("]", self->file);
+	}
+	fputs("}\n],\n", self->file);
+	fprintf(self->file, "\"scene\":0,\n\"scenes\":[{\"nodes\":[%lu]}]", (unsigned long)self->instanceCount);
+
+	if(meshCount > 0)
+	{
+		// LDraw parts aren't reliably wound, so show both sides.
+		fputs(",\n\"materials\":["
+			  "{\"name\":\"Opaque\",\"doubleSided\":true,\"pbrMetallicRoughness\":{\"metallicFactor\":0,\"roughnessFactor\":0.5}},"
+			  "{\"name\":\"Translucent\",\"doubleSided\":true,\"alphaMode\":\"BLEND\",\"pbrMetallicRoughness\":{\"metallicFactor\":0,\"roughnessFactor\":0.1}}]", self->file);
+
+		// Each mesh has four accessors and four buffer views, in the order
+		// they were written to the buffer.
+		fputs(",\n\"meshes\":[", self->file);
+		for(counter = 0; counter < meshCount; counter++)
+		{
+			record = records + counter;
+			fprintf(self->file, "%s\n{\"primitives\":[{\"attributes\":{\"POSITION\":%lu,\"NORMAL\":%lu,\"COLOR_0\":%lu},\"indices\":%lu,\"material\":%d}]}",
+					counter ? "," : "",
+					(unsigned long)counter * 4, (unsigned long)counter * 4 + 1, (unsigned long)counter * 4 + 2, (unsigned long)counter * 4 + 3,
+					record->isTranslucent ? 1 : 0);
+		}
+		fputs("],\n\"accessors\":[", self->file);
+		for(counter = 0; counter < meshCount; counter++)
+		{
+			record = records + counter;
+			fprintf(self->file, "%s\n{\"bufferView\":%lu,\"componentType\":%d,\"count\":%d,\"type\":\"VEC3\",\"min\":[%.7g,%.7g,%.7g],\"max\":[%.7g,%.7g,%.7g]}",
+					counter ? "," : "", (unsigned long)counter * 4, GLTF_FLOAT, record->vertexCount,
+					record->minimum[0], record->minimum[1], record->minimum[2],
+					record->maximum[0], record->maximum[1], record->maximum[2]);
+			fprintf(self->file, ",\n{\"bufferView\":%lu,\"componentType\":%d,\"count\":%d,\"type\":\"VEC3\"}",
+					(unsigned long)counter * 4 + 1, GLTF_FLOAT, record->vertexCount);
+			fprintf(self->file, ",\n{\"bufferView\":%lu,\"componentType\":%d,\"count\":%d,\"type\":\"VEC4\"}",
+					(unsigned long)counter * 4 + 2, GLTF_FLOAT, record->vertexCount);
+			fprintf(self->file, ",\n{\"bufferView\":%lu,\"componentType\":%d,\"count\":%d,\"type\":\"SCALAR\"}",
+					(unsigned long)counter * 4 + 3, GLTF_UNSIGNED_INT, record->indexCount);
+		}
+		fputs("],\n\"bufferViews\":[", self->file);
+		for(counter = 0; counter < meshCount; counter++)
+		{
+			record      = records + counter;
+			offset      = record->byteOffset;
+			vertexBytes = (unsigned long long)record->vertexCount * sizeof(float);
+			fprintf(self->file, "%s\n{\"buffer\":0,\"byteOffset\":%llu,\"byteLength\":%llu,\"target\":%d}",
+					counter ? "," : "", offset, vertexBytes * 3, GLTF_ARRAY_BUFFER);
+			fprintf(self->file, ",\n{\"buffer\":0,\"byteOffset\":%llu,\"byteLength\":%llu,\"target\":%d}",
+					offset + vertexBytes * 3, vertexBytes * 3, GLTF_ARRAY_BUFFER);
+			fprintf(self->file, ",\n{\"buffer\":0,\"byteOffset\":%llu,\"byteLength\":%llu,\"target\":%d}",
+					offset + vertexBytes * 6, vertexBytes * 4, GLTF_ARRAY_BUFFER);
+			fprintf(self->file, ",\n{\"buffer\":0,\"byteOffset\":%llu,\"byteLength\":%llu,\"target\":%d}",
+					offset + vertexBytes * 10, (unsigned long long)record->indexCount * sizeof(uint32_t), GLTF_ELEMENT_BUFFER);
+		}
+
+		binaryName = [[[self->path lastPathComponent] stringByDeletingPathExtension] stringByAppendingPathExtension:@"bin"];
+		binaryName = [binaryName stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding];
+		fputs("],\n\"buffers\":[{\"uri\":", self->file);
+		WriteJSONString(self->file, binaryName);
+		fprintf(self->file, ",\"byteLength\":%llu}]", self->binaryLength);
+	}
+	fputs("\n}\n", self->file);
+
+}//end writeGLTFPostamble
+
+
+#pragma mark -
+
+//========== writeOBJGroupForMesh:frame: =======================================
+//
+// Purpose:		Writes mesh as a group of its own, transformed into place.
+//
+//==============================================================================
+- (void) writeOBJGroupForMesh:(LDrawMeshExportMesh *)mesh frame:(LDrawMeshExportFrame *)frame
+{
+	Matrix3 		normalTransform = Matrix3MakeNormalTransformFromProjMatrix(frame->transform);
+	BOOL			isMirrored		= (Matrix4x4Determinant(&frame->transform) < 0);
+	const GLuint	*corners		= [mesh->triangles bytes];
+	const GLfloat	*vertex 		= NULL;
+	GLfloat 		current[4]		= {0};
+	GLfloat 		compliment[4]	= {0};
+	GLfloat 		resolved[4] 	= {0};
+	NSString		*material		= nil;
+	uint32_t		colorKey		= 0;
+	uint32_t		lastColorKey	= 0;
+	Point3			position		= ZeroPoint3;
+	Vector3 		normal			= ZeroPoint3;
+	NSUInteger		base			= self->vertexCount + 1; // OBJ counts from 1
+	NSUInteger		a				= 0;
+	NSUInteger		b				= 0;
+	NSUInteger		c				= 0;
+	NSUInteger		counter 		= 0;
+
+	[frame->color getColorRGBA:current];
+	[[frame->color complimentColor] getColorRGBA:compliment];
+
+	fprintf(self->file, "g %s_%lu\n",
+			frame->name ? [[frame->name stringByReplacingOccurrencesOfString:@" " withString:@"_"] UTF8String] : "model",
+			(unsigned long)self->instanceCount);
+
+	for(counter = 0; counter < (NSUInteger)mesh->vertexCount; counter++)
+	{
+		vertex      = mesh->vertexes + counter * LDrawDLVertexStride;
+		position    = V3MulPointByProjMatrix(V3Make(vertex[0], vertex[1], vertex[2]), frame->transform);
+		normal      = V3Normalize(V3MulPointByMatrix(V3Make(vertex[3], vertex[4], vertex[5]), normalTransform));
+
+		fprintf(self->file, "v %.4f %.4f %.4f\nvn %.4f %.4f %.4f\n",
+				position.x, position.y, position.z,
+				normal.x, normal.y, normal.z);
+	}
+
+	// Faces are all one color, so the first corner's will do.
+	for(counter = 0; counter < mesh->triangleCount; counter++)
+	{
+		a = corners[counter * 3];
+		b = corners[counter * 3 + (isMirrored ? 2 : 1)];
+		c = corners[counter * 3 + (isMirrored ? 1 : 2)];
+
+		ResolveColor(mesh->vertexes + a * LDrawDLVertexStride + 6, current, compliment, resolved);
+		colorKey = PackColor(resolved);
+		if(material == nil || colorKey != lastColorKey)
+		{
+			material        = [self OBJMaterialForColor:resolved];
+			lastColorKey    = colorKey;
+			fprintf(self->file, "usemtl %s\n", [material UTF8String]);
+		}
+
+		fprintf(self->file, "f %lu//%lu %lu//%lu %lu//%lu\n",
+				(unsigned long)(base + a), (unsigned long)(base + a),
+				(unsigned long)(base + b), (unsigned long)(base + b),
+				(unsigned long)(base + c), (unsigned long)(base + c));
+	}
+
+	self->vertexCount += mesh->vertexCount;
+
+}//end writeOBJGroupForMesh:frame:
+
+
+//========== OBJMaterialForColor: ==============================================
+//
+// Purpose:		Returns the name of the material for an RGBA color, noting it
+//				for the material file.
+//
+//==============================================================================
+- (NSString *) OBJMaterialForColor:(const GLfloat *)rgba
+{
+	NSString	*name		= nil;
+	NSString	*material	= nil;
+
+	name = [NSString stringWithFormat:@"color_%08X", PackColor(rgba)];
+
+	if([self->materials objectForKey:name] == nil)
+	{
+		material = [NSString stringWithFormat:@"newmtl %@\nKa 0 0 0\nKd %.4f %.4f %.4f\nKs 0.1 0.1 0.1\nd %.4f\n\n",
+					name, rgba[0], rgba[1], rgba[2], rgba[3]];
+		[self->materials setObject:material forKey:name];
+	}
+
+	return name;
+
+}//end OBJMaterialForColor:
+
+
+//========== writeMTLFile ======================================================
+//
+// Purpose:		Writes out the materials the OBJ file used.
+//
+//==============================================================================
+- (BOOL) writeMTLFile
+{
+	NSString		*mtlPath	= [[self->path stringByDeletingPathExtension] stringByAppendingPathExtension:@"mtl"];
+	NSMutableString *contents	= [NSMutableString stringWithString:@"# Bricksmith\n\n"];
+	NSArray 		*names		= [[self->materials allKeys] sortedArrayUsingSelector:@selector(compare:)];
+	NSString		*name		= nil;
+
+	for(name in names)
+		[contents appendString:[self->materials objectForKey:name]];
+
+	return [contents writeToFile:mtlPath atomically:YES encoding:NSUTF8StringEncoding error:NULL];
+
+}//end writeMTLFile
+
+
+#pragma mark -
+
+//========== writeSTLTrianglesForMesh:frame: ===================================
+//
+// Purpose:		Writes every triangle of mesh, transformed into place.
+//
+// Notes:		Facet normals are recomputed from the transformed triangle, as
+//				STL expects them to agree with the winding.
+//
+//==============================================================================
+- (void) writeSTLTrianglesForMesh:(LDrawMeshExportMesh *)mesh frame:(LDrawMeshExportFrame *)frame
+{
+	BOOL			isMirrored		= (Matrix4x4Determinant(&frame->transform) < 0);
+	const GLuint	*corners		= [mesh->triangles bytes];
+	const GLfloat	*vertex 		= NULL;
+	Point3			points[3];
+	Vector3 		normal			= ZeroPoint3;
+	float			facet[12]		= {0};
+	uint16_t		attributes		= 0;
+	NSUInteger		counter 		= 0;
+	int 			corner			= 0;
+	int 			slot			= 0;
+
+	for(counter = 0; counter < mesh->triangleCount; counter++)
+	{
+		for(corner = 0; corner < 3; corner++)
+		{
+			slot            = (isMirrored && corner > 0) ? 3 - corner : corner;
+			vertex          = mesh->vertexes + corners[counter * 3 + corner] * LDrawDLVertexStride;
+			points[slot]    = V3MulPointByProjMatrix(V3Make(vertex[0], vertex[1], vertex[2]), frame->transform);
+		}
+		normal = V3Normalize(V3Cross(V3Sub(points[1], points[0]), V3Sub(points[2], points[0])));
+
+		facet[0] = normal.x;	facet[1] = normal.y;	facet[2] = normal.z;
+		for(corner = 0; corner < 3; corner++)
+		{
+			facet[3 + corner * 3]		= points[corner].x;
+			facet[3 + corner * 3 + 1]	= points[corner].y;
+			facet[3 + corner * 3 + 2]	= points[corner].z;
+		}
+		WriteFloats(self->file, facet, 12);
+		fwrite(&attributes, sizeof(attributes), 1, self->file);
+	}
+
+}//end writeSTLTrianglesForMesh:frame:
+
+
+#pragma mark -
+#pragma mark DESTRUCTOR
+#pragma mark -
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Lets go of the meshes.
+//
+//==============================================================================
+- (void) dealloc
+{
+	if(self->file != NULL)
+		fclose(self->file);
+	if(self->binaryFile != NULL)
+		fclose(self->binaryFile);
+
+	[path		release];
+	[meshes		release];
+	[frames		release];
+	[glTFMeshes	release];
+	[materials	release];
+
+	[super dealloc];
+
+}//end dealloc
+
+
+@end
+
+
+@implementation LDrawMeshExportMesh
+
+//========== initWithModel: ====================================================
+//
+// Purpose:		Collects and smooths model's own surfaces, and splits them into
+//				triangles.
+//
+//==============================================================================
+- (id) initWithModel:(LDrawModel *)model
+{
+	LDrawDLCollector	*collector		= nil;
+	const GLuint		*indexes		= NULL;
+	int 				indexCount		= 0;
+	int 				texCount		= 0;
+	int 				triStart		= 0;
+	int 				triCount		= 0;
+	int 				quadStart		= 0;
+	int 				quadCount		= 0;
+	GLuint				corners[6]		= {0};
+	int 				tex 			= 0;
+	int 				counter 		= 0;
+	int 				corner			= 0;
+
+	self = [super init];
+	if(self)
+	{
+		glTFMesh            = -1;
+		glTFMeshesByColor   = [[NSMapTable alloc] initWithKeyOptions:(NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality)
+													 valueOptions:NSPointerFunctionsStrongMemory
+														 capacity:4];
+		triangles           = [[NSMutableData alloc] init];
+
+		collector = [[LDrawDLCollector alloc] init];
+		[model collectSelf:collector];
+		prepared = [collector prepare];
+		[collector release];
+
+		if(prepared != NULL)
+		{
+			LDrawDLPreparedGetMesh(prepared, &vertexCount, &vertexes, &indexCount, &indexes);
+			texCount = LDrawDLPreparedGetTexCount(prepared);
+
+			for(tex = 0; tex < texCount; tex++)
+			{
+				LDrawDLPreparedGetTexFaces(prepared, tex, &triStart, &triCount, &quadStart, &quadCount);
+
+				for(counter = triStart; counter < triStart + triCount; counter++)
+				{
+					corners[0] = indexes ? indexes[counter] : counter;
+					[triangles appendBytes:corners length:sizeof(GLuint)];
+				}
+				for(counter = quadStart; counter + 3 < quadStart + quadCount; counter += 4)
+				{
+					for(corner = 0; corner < 4; corner++)
+						corners[corner] = indexes ? indexes[counter + corner] : counter + corner;
+
+					// ABCD becomes ABC + ACD
+					corners[5] = corners[3];
+					corners[4] = corners[2];
+					corners[3] = corners[0];
+					[triangles appendBytes:corners length:sizeof(GLuint) * 6];
+				}
+			}
+			triangleCount = [triangles length] / (sizeof(GLuint) * 3);
+
+			for(counter = 0; counter < vertexCount; counter++)
+			{
+				if(vertexes[counter * LDrawDLVertexStride + 9] == 0.0)
+					hasMetaColors = YES;
+			}
+
+			// Nothing but lines
+			if(triangleCount == 0)
+			{
+				LDrawDLPreparedDestroy(prepared);
+				prepared = NULL;
+			}
+		}
+	}
+	return self;
+
+}//end initWithModel:
+
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Frees the mesh.
+//
+//==============================================================================
+- (void) dealloc
+{
+	if(prepared != NULL)
+		LDrawDLPreparedDestroy(prepared);
+	[triangles			release];
+	[glTFMeshesByColor	release];
+
+	[super dealloc];
+
+}//end dealloc
+
+
+@end
+
+
+//---------- PackColor -----------------------------------------------[static]--
+//
+// Purpose:		Packs an RGBA color into 8 bits per component, as 0xRRGGBBAA.
+//
+//------------------------------------------------------------------------------
+static uint32_t PackColor(const GLfloat *rgba)
+{
+	uint32_t	packed	= 0;
+	int 		counter = 0;
+
+	for(counter = 0; counter < 4; counter++)
+		packed = (packed << 8) | (uint32_t)(rgba[counter] * 255 + 0.5);
+
+	return packed;
+
+}//end PackColor
+
+
+//---------- ResolveColor --------------------------------------------[static]--
+//
+// Purpose:		Turns a mesh vertex color into a real one, mixing between the
+//				current and compliment colors for a meta-color just as the
+//				shader does.
+//
+//------------------------------------------------------------------------------
+static void ResolveColor(const GLfloat *vertexColor, const GLfloat *current, const GLfloat *compliment, GLfloat *resolved)
+{
+	float	mix 	= vertexColor[0];
+	int 	counter = 0;
+
+	if(vertexColor[3] == 0.0)
+	{
+		for(counter = 0; counter < 4; counter++)
+			resolved[counter] = current[counter] * (1 - mix) + compliment[counter] * mix;
+	}
+	else
+		memcpy(resolved, vertexColor, sizeof(GLfloat) * 4);
+
+}//end ResolveColor
+
+
+//---------- WriteFloats ---------------------------------------------[static]--
+//
+// Purpose:		Writes floats in little-endian order, as STL and glTF require.
+//
+//------------------------------------------------------------------------------
+static void WriteFloats(FILE *file, const float *values, size_t count)
+{
+	WriteInts(file, (const uint32_t *)values, count);
+
+}//end WriteFloats
+
+
+//---------- WriteInts -----------------------------------------------[static]--
+//
+// Purpose:		Writes 32-bit integers in little-endian order.
+//
+//------------------------------------------------------------------------------
+static void WriteInts(FILE *file, const uint32_t *values, size_t count)
+{
+#if __LITTLE_ENDIAN__
+	fwrite(values, sizeof(uint32_t), count, file);
+#else
+	uint32_t	swapped 	= 0;
+	size_t		counter 	= 0;
+
+	for(counter = 0; counter < count; counter++)
+	{
+		swapped = OSSwapHostToLittleInt32(values[counter]);
+		fwrite(&swapped, sizeof(uint32_t), 1, file);
+	}
+#endif
+
+}//end WriteInts
+
+
+//---------- WriteJSONString -----------------------------------------[static]--
+//
+// Purpose:		Writes string as a quoted JSON string.
+//
+//------------------------------------------------------------------------------
+static void WriteJSONString(FILE *file, NSString *string)
+{
+	const unsigned char *characters = (const unsigned char *)[string UTF8String];
+
+	fputc('"', file);
+	for(; *characters; characters++)
+	{
+		if(*characters == '"' || *characters == '\\')
+			fprintf(file, "\\%c", *characters);
+		else if(*characters < 0x20)
+			fprintf(file, "\\u%04x", *characters);
+		else
+			fputc(*characters, file);
+	}
+	fputc('"', file);
+
+}//end WriteJSONString
@@ -42,6 +42,7 @@ typedef enum
 // Utilities
 - (NSString *) findLDrawPath;
 - (NSString *) pathForPartName:(NSString *)partName;
+- (BOOL) isTopLevelPartPath:(NSString *)partPath;
 - (NSString *) pathForTextureName:(NSString *)imageName;
 - (BOOL) validateLDrawFolder:(NSString *)folderPath;
 
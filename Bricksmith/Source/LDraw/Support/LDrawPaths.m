@@ -430,6 +430,32 @@
 }//end pathForPartName:
 
 
+//========== isTopLevelPartPath: ===============================================
+//
+// Purpose:		Returns YES if partPath (as found by pathForPartName:) is a part 
+//				in its own right -- directly in one of the parts folders -- 
+//				rather than a subpart or primitive. 
+//
+// Notes:		Only top-level parts are placed in models; subparts and 
+//				primitives are normally flattened into the parts using them. 
+//
+//==============================================================================
+- (BOOL) isTopLevelPartPath:(NSString *)partPath
+{
+	NSString    *folderPath = [partPath stringByDeletingLastPathComponent];
+	LDrawDomain domain      = LDrawUserOfficial;
+	BOOL        isTopLevel  = NO;
+	
+	for(domain = LDrawUserOfficial; domain <= LDrawInternalUnofficial && isTopLevel == NO; domain++)
+	{
+		isTopLevel = [folderPath isEqualToString:[[self partsPathForDomain:domain] stringByStandardizingPath]];
+	}
+	
+	return isTopLevel;
+	
+}//end isTopLevelPartPath:
+
+
 //========== pathForTextureName: ===============================================
 //
 // Purpose:		Searches the LDraw folder for a texture with the given name.
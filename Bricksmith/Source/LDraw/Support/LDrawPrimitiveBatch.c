@@ -0,0 +1,363 @@
+//==============================================================================
+//
+// File:		LDrawPrimitiveBatch.c
+//
+// Purpose:		Batched triangle and quadrilateral fixups. See
+//				LDrawPrimitiveBatch.h.
+//
+//				The loops below are written for the vectorizer: restrict
+//				pointers, no calls and no branches. Every decision is made with
+//				a select, and the bow-tie corner exchange is done by choosing
+//				each output corner from the inputs rather than swapping.
+//
+//==============================================================================
+#include "LDrawPrimitiveBatch.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+// A primitive is degenerate when the sine of the angle between its two normal
+// edges is smaller than this. Zero-length edges are degenerate too.
+#define DEGENERATE_SINE		1e-6f
+
+
+//========== LDrawPrimitiveBatchCreate() =======================================
+//
+// Purpose:		Returns an empty batch with room for capacity primitives of
+//				vertexCount (3 or 4) corners each.
+//
+//==============================================================================
+LDrawPrimitiveBatch *LDrawPrimitiveBatchCreate(int vertexCount, size_t capacity)
+{
+	LDrawPrimitiveBatch *batch          = calloc(1, sizeof(LDrawPrimitiveBatch));
+	size_t              floatArrayCount = vertexCount * 3 + 3;
+	float               *floats         = NULL;
+	int                 corner          = 0;
+
+	assert(vertexCount == 3 || vertexCount == 4);
+
+	// Room for at least one, so that every array has a distinct address.
+	if(capacity == 0)
+		capacity = 1;
+
+	batch->vertexCount  = vertexCount;
+	batch->capacity     = capacity;
+	batch->storage      = malloc(capacity * (floatArrayCount * sizeof(float) + sizeof(unsigned char)));
+
+	floats = batch->storage;
+	for(corner = 0; corner < vertexCount; corner++)
+	{
+		batch->x[corner] = floats;	floats += capacity;
+		batch->y[corner] = floats;	floats += capacity;
+		batch->z[corner] = floats;	floats += capacity;
+	}
+	batch->normalX  = floats;	floats += capacity;
+	batch->normalY  = floats;	floats += capacity;
+	batch->normalZ  = floats;	floats += capacity;
+	batch->flags    = (unsigned char *)floats;
+
+	return batch;
+
+}//end LDrawPrimitiveBatchCreate
+
+
+//========== LDrawPrimitiveBatchFree() =========================================
+//
+// Purpose:		Frees the batch and all of its arrays.
+//
+//==============================================================================
+void LDrawPrimitiveBatchFree(LDrawPrimitiveBatch *batch)
+{
+	if(batch)
+	{
+		free(batch->storage);
+		free(batch);
+	}
+}//end LDrawPrimitiveBatchFree
+
+
+//========== LDrawPrimitiveBatchAdd() ==========================================
+//
+// Purpose:		Appends a primitive with the given corners (vertexCount of
+//				them), and returns its index in the batch.
+//
+//==============================================================================
+size_t LDrawPrimitiveBatchAdd(LDrawPrimitiveBatch *batch, const Point3 *vertexes)
+{
+	size_t  index   = batch->count;
+	int     corner  = 0;
+
+	assert(index < batch->capacity);
+
+	for(corner = 0; corner < batch->vertexCount; corner++)
+	{
+		batch->x[corner][index] = vertexes[corner].x;
+		batch->y[corner][index] = vertexes[corner].y;
+		batch->z[corner][index] = vertexes[corner].z;
+	}
+	batch->normalX[index]   = 0;
+	batch->normalY[index]   = 0;
+	batch->normalZ[index]   = 0;
+	batch->flags[index]     = 0;
+
+	batch->count += 1;
+
+	return index;
+
+}//end LDrawPrimitiveBatchAdd
+
+
+//========== LDrawPrimitiveBatchGetVertexes() ==================================
+//
+// Purpose:		Copies the (possibly reordered) corners of the primitive at
+//				index into vertexes, which must have room for vertexCount.
+//
+//==============================================================================
+void LDrawPrimitiveBatchGetVertexes(const LDrawPrimitiveBatch *batch, size_t index, Point3 *vertexes)
+{
+	int corner = 0;
+
+	assert(index < batch->count);
+
+	for(corner = 0; corner < batch->vertexCount; corner++)
+	{
+		vertexes[corner].x = batch->x[corner][index];
+		vertexes[corner].y = batch->y[corner][index];
+		vertexes[corner].z = batch->z[corner][index];
+	}
+}//end LDrawPrimitiveBatchGetVertexes
+
+
+//========== LDrawPrimitiveBatchGetNormal() ====================================
+//
+// Purpose:		Returns the (unnormalized) normal of the primitive at index.
+//
+//==============================================================================
+Vector3 LDrawPrimitiveBatchGetNormal(const LDrawPrimitiveBatch *batch, size_t index)
+{
+	Vector3 normal;
+
+	assert(index < batch->count);
+
+	normal.x = batch->normalX[index];
+	normal.y = batch->normalY[index];
+	normal.z = batch->normalZ[index];
+
+	return normal;
+
+}//end LDrawPrimitiveBatchGetNormal
+
+
+//---------- FixTriangles --------------------------------------------[static]--
+//
+// Purpose:		The triangle loop. Compilers only trust restrict on parameters,
+//				so the arrays come in as parameters.
+//
+//------------------------------------------------------------------------------
+static size_t FixTriangles(size_t count,
+						   const float * restrict x1, const float * restrict y1, const float * restrict z1,
+						   const float * restrict x2, const float * restrict y2, const float * restrict z2,
+						   const float * restrict x3, const float * restrict y3, const float * restrict z3,
+						   float * restrict nx, float * restrict ny, float * restrict nz,
+						   unsigned char * restrict flags)
+{
+	size_t  degenerate  = 0;
+	size_t  counter     = 0;
+
+	for(counter = 0; counter < count; counter++)
+	{
+		float ax = x2[counter] - x1[counter];
+		float ay = y2[counter] - y1[counter];
+		float az = z2[counter] - z1[counter];
+		float bx = x3[counter] - x1[counter];
+		float by = y3[counter] - y1[counter];
+		float bz = z3[counter] - z1[counter];
+
+		float cx = (ay * bz) - (az * by);
+		float cy = (az * bx) - (ax * bz);
+		float cz = (ax * by) - (ay * bx);
+
+		float crossLength2  = cx*cx + cy*cy + cz*cz;
+		float edgeLength2   = (ax*ax + ay*ay + az*az) * (bx*bx + by*by + bz*bz);
+		int   isDegenerate  = (crossLength2 <= edgeLength2 * (DEGENERATE_SINE * DEGENERATE_SINE));
+
+		nx[counter]     = cx;
+		ny[counter]     = cy;
+		nz[counter]     = cz;
+		flags[counter]  = (unsigned char)(isDegenerate ? LDrawPrimitiveBatchDegenerate : 0);
+		degenerate      += isDegenerate;
+	}
+
+	return degenerate;
+
+}//end FixTriangles
+
+
+//---------- FixQuadrilaterals ---------------------------------------[static]--
+//
+// Purpose:		The quadrilateral loop; see FixTriangles. This only decides
+//				which bow-ties to untangle; ReorderCorners does it.
+//
+//------------------------------------------------------------------------------
+static size_t FixQuadrilaterals(size_t count,
+								const float * restrict x1, const float * restrict y1, const float * restrict z1,
+								const float * restrict x2, const float * restrict y2, const float * restrict z2,
+								const float * restrict x3, const float * restrict y3, const float * restrict z3,
+								const float * restrict x4, const float * restrict y4, const float * restrict z4,
+								float * restrict nx, float * restrict ny, float * restrict nz,
+								unsigned char * restrict flags)
+{
+	size_t  degenerate  = 0;
+	size_t  counter     = 0;
+
+	for(counter = 0; counter < count; counter++)
+	{
+		float p1x = x1[counter], p1y = y1[counter], p1z = z1[counter];
+		float p2x = x2[counter], p2y = y2[counter], p2z = z2[counter];
+		float p3x = x3[counter], p3y = y3[counter], p3z = z3[counter];
+		float p4x = x4[counter], p4y = y4[counter], p4z = z4[counter];
+
+		// Cross at 1: (2 - 1) x (4 - 1). This is also the normal.
+		float a12x = p2x - p1x, a12y = p2y - p1y, a12z = p2z - p1z;
+		float a14x = p4x - p1x, a14y = p4y - p1y, a14z = p4z - p1z;
+		float c1x = (a12y * a14z) - (a12z * a14y);
+		float c1y = (a12z * a14x) - (a12x * a14z);
+		float c1z = (a12x * a14y) - (a12y * a14x);
+
+		// Cross at 3: (4 - 3) x (2 - 3)
+		float a34x = p4x - p3x, a34y = p4y - p3y, a34z = p4z - p3z;
+		float a32x = p2x - p3x, a32y = p2y - p3y, a32z = p2z - p3z;
+		float c3x = (a34y * a32z) - (a34z * a32y);
+		float c3y = (a34z * a32x) - (a34x * a32z);
+		float c3z = (a34x * a32y) - (a34y * a32x);
+
+		// Cross at 4: (1 - 4) x (3 - 4)
+		float a41x = p1x - p4x, a41y = p1y - p4y, a41z = p1z - p4z;
+		float a43x = p3x - p4x, a43y = p3y - p4y, a43z = p3z - p4z;
+		float c4x = (a41y * a43z) - (a41z * a43y);
+		float c4y = (a41z * a43x) - (a41x * a43z);
+		float c4z = (a41x * a43y) - (a41y * a43x);
+
+		float dot14   = c1x*c4x + c1y*c4y + c1z*c4z;
+		float dot34   = c3x*c4x + c3y*c4y + c3z*c4z;
+		int   swap34  = (dot14 < 0);
+		int   swap23  = (dot14 >= 0) & (dot34 < 0);
+
+		float crossLength2  = c1x*c1x + c1y*c1y + c1z*c1z;
+		float edgeLength2   = (a12x*a12x + a12y*a12y + a12z*a12z) * (a14x*a14x + a14y*a14y + a14z*a14z);
+		int   isDegenerate  = (crossLength2 <= edgeLength2 * (DEGENERATE_SINE * DEGENERATE_SINE));
+
+		nx[counter] = c1x;
+		ny[counter] = c1y;
+		nz[counter] = c1z;
+
+		flags[counter]  = (unsigned char)(  (isDegenerate ? LDrawPrimitiveBatchDegenerate : 0)
+										  | (swap34 ? LDrawPrimitiveBatchSwapped3And4 : 0)
+										  | (swap23 ? LDrawPrimitiveBatchSwapped2And3 : 0) );
+		degenerate      += isDegenerate;
+	}
+
+	return degenerate;
+
+}//end FixQuadrilaterals
+
+
+//---------- ReorderCorners ------------------------------------------[static]--
+//
+// Purpose:		Untangles the bow-ties FixQuadrilaterals found, along one axis:
+//				pass the x arrays, then y, then z.
+//
+// Notes:		This is a separate loop because the whole job in one loop is
+//				too much for the vectorizer to if-convert.
+//
+//------------------------------------------------------------------------------
+static void ReorderCorners(size_t count,
+						   const unsigned char * restrict flags,
+						   float * restrict corner2,
+						   float * restrict corner3,
+						   float * restrict corner4)
+{
+	size_t  counter = 0;
+
+	for(counter = 0; counter < count; counter++)
+	{
+		unsigned char   flag    = flags[counter];
+		float           p2      = corner2[counter];
+		float           p3      = corner3[counter];
+		float           p4      = corner4[counter];
+		float           new2    = (flag & LDrawPrimitiveBatchSwapped2And3) ? p3 : p2;
+		float           new3    = (flag & LDrawPrimitiveBatchSwapped2And3) ? p2 : p3;
+		float           new4    = p4;
+
+		// The two exchanges never happen together.
+		new3    = (flag & LDrawPrimitiveBatchSwapped3And4) ? p4 : new3;
+		new4    = (flag & LDrawPrimitiveBatchSwapped3And4) ? p3 : new4;
+
+		corner2[counter] = new2;
+		corner3[counter] = new3;
+		corner4[counter] = new4;
+	}
+}//end ReorderCorners
+
+
+//========== LDrawPrimitiveBatchFixTriangles() =================================
+//
+// Purpose:		Computes the normal and degeneracy flag of every triangle in
+//				the batch. Returns the number of degenerate triangles.
+//
+// Notes:		The normal is (2 - 1) x (3 - 1), as in
+//				-[LDrawTriangle recomputeNormal].
+//
+//==============================================================================
+size_t LDrawPrimitiveBatchFixTriangles(LDrawPrimitiveBatch *batch)
+{
+	assert(batch->vertexCount == 3);
+
+	return FixTriangles(batch->count,
+						batch->x[0], batch->y[0], batch->z[0],
+						batch->x[1], batch->y[1], batch->z[1],
+						batch->x[2], batch->y[2], batch->z[2],
+						batch->normalX, batch->normalY, batch->normalZ,
+						batch->flags);
+
+}//end LDrawPrimitiveBatchFixTriangles
+
+
+//========== LDrawPrimitiveBatchFixQuadrilaterals() ============================
+//
+// Purpose:		Computes the normal and degeneracy flag of every quadrilateral
+//				in the batch, and puts the corners of bow-ties back in order.
+//				Returns the number of degenerate quadrilaterals.
+//
+// Notes:		This is -[LDrawQuadrilateral recomputeNormal] followed by
+//				-fixBowtie, so the normal is (2 - 1) x (4 - 1) of the corners
+//				*as given*. Either way it is perpendicular to the plane; only
+//				its length depends on the order.
+//
+//				See -fixBowtie for the pictures. In short, the crosses at
+//				corners 1, 3 and 4 of a proper quadrilateral all point the same
+//				way. If 1 and 4 disagree, exchange 3 and 4; otherwise if 3 and 4
+//				disagree, exchange 2 and 3.
+//
+//==============================================================================
+size_t LDrawPrimitiveBatchFixQuadrilaterals(LDrawPrimitiveBatch *batch)
+{
+	size_t  degenerate  = 0;
+
+	assert(batch->vertexCount == 4);
+
+	degenerate = FixQuadrilaterals(batch->count,
+								   batch->x[0], batch->y[0], batch->z[0],
+								   batch->x[1], batch->y[1], batch->z[1],
+								   batch->x[2], batch->y[2], batch->z[2],
+								   batch->x[3], batch->y[3], batch->z[3],
+								   batch->normalX, batch->normalY, batch->normalZ,
+								   batch->flags);
+
+	ReorderCorners(batch->count, batch->flags, batch->x[1], batch->x[2], batch->x[3]);
+	ReorderCorners(batch->count, batch->flags, batch->y[1], batch->y[2], batch->y[3]);
+	ReorderCorners(batch->count, batch->flags, batch->z[1], batch->z[2], batch->z[3]);
+
+	return degenerate;
+
+}//end LDrawPrimitiveBatchFixQuadrilaterals
@@ -0,0 +1,84 @@
+//==============================================================================
+//
+// File:		LDrawPrimitiveBatch.h
+//
+// Purpose:		Geometry fixups for many triangles or quadrilaterals at once.
+//
+//				A freshly-parsed triangle or quadrilateral needs its normal
+//				computed, and a quadrilateral whose corners were listed out of
+//				order (a "bow-tie") needs two of them exchanged. Doing that one
+//				object at a time is fine for an edit, but a big unofficial part
+//				or an imported mesh can have hundreds of thousands of them.
+//
+//				A batch holds the corners of many primitives of one kind in
+//				structure-of-arrays form--all the x1s together, then all the
+//				y1s, and so on--so the fixups run as straight, branch-free
+//				loops the compiler can vectorize. The results are exactly what
+//				-[LDrawTriangle recomputeNormal] and -[LDrawQuadrilateral
+//				recomputeNormal] followed by -fixBowtie produce.
+//
+// Usage:		Create a batch big enough for all the primitives, add each
+//				one's corners, run the fixup for its kind, then read the
+//				corners, normal and flags back out by index.
+//
+//==============================================================================
+#ifndef _LDrawPrimitiveBatch_
+#define _LDrawPrimitiveBatch_
+
+#include <stddef.h>
+
+#include "MatrixMath.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Types
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// What the fixup found out about each primitive.
+typedef enum LDrawPrimitiveBatchFlag
+{
+	LDrawPrimitiveBatchDegenerate	= 1 << 0,	// corners collinear or coincident; the normal is meaningless
+	LDrawPrimitiveBatchSwapped3And4	= 1 << 1,	// bow-tie: corners 3 and 4 were exchanged
+	LDrawPrimitiveBatchSwapped2And3	= 1 << 2	// bow-tie: corners 2 and 3 were exchanged
+
+} LDrawPrimitiveBatchFlagT;
+
+
+typedef struct LDrawPrimitiveBatch
+{
+	size_t			count;
+	size_t			capacity;
+	int				vertexCount;	// 3 or 4
+
+	float			*x[4];			// x[corner][primitive]; only the first vertexCount are allocated
+	float			*y[4];
+	float			*z[4];
+	float			*normalX;
+	float			*normalY;
+	float			*normalZ;
+	unsigned char	*flags;			// LDrawPrimitiveBatchFlagT
+
+	void			*storage;		// one allocation backs all of the above
+
+} LDrawPrimitiveBatch;
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+////////////////////////////////////////////////////////////////////////////////
+
+extern LDrawPrimitiveBatch	*LDrawPrimitiveBatchCreate(int vertexCount, size_t capacity);
+extern void					LDrawPrimitiveBatchFree(LDrawPrimitiveBatch *batch);
+
+extern size_t				LDrawPrimitiveBatchAdd(LDrawPrimitiveBatch *batch, const Point3 *vertexes);
+extern void					LDrawPrimitiveBatchGetVertexes(const LDrawPrimitiveBatch *batch, size_t index, Point3 *vertexes);
+extern Vector3				LDrawPrimitiveBatchGetNormal(const LDrawPrimitiveBatch *batch, size_t index);
+
+extern size_t				LDrawPrimitiveBatchFixTriangles(LDrawPrimitiveBatch *batch);
+extern size_t				LDrawPrimitiveBatchFixQuadrilaterals(LDrawPrimitiveBatch *batch);
+
+#endif //_LDrawPrimitiveBatch_
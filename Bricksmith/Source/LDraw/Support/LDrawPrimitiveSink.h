@@ -0,0 +1,97 @@
+//==============================================================================
+//
+// File:		LDrawPrimitiveSink.h
+//
+// Purpose:		A destination for the streaming flatten,
+//				-flattenIntoSink:currentColor:currentTransform:.
+//
+//				Instead of collecting transformed copies of LDrawLines,
+//				LDrawTriangles and LDrawQuadrilaterals in arrays, the streaming
+//				flatten hands each primitive to the sink as a plain struct,
+//				already transformed into the coordinates of the top-level model
+//				and with its color resolved. Nothing is allocated per primitive,
+//				so a model with millions of primitives costs only the time to
+//				visit them.
+//
+//				Two sinks are provided: one writes flat LDraw text, the other
+//				fixed-size binary records. Both write to a stdio FILE * passed
+//				as the sink context.
+//
+//				A sink which does not follow references sees only the
+//				primitives directly inside the flattened directive, untransformed
+//				-- the same ones a nonrecursive -flattenIntoLines:... collects.
+//				Each primitive names the element it came from, so such a sink
+//				can register the elements themselves.
+//
+//==============================================================================
+#import <Foundation/Foundation.h>
+#import OPEN_GL_HEADER
+
+#import "LDrawColor.h"
+#import "MatrixMath.h"
+
+@class LDrawDirective;
+@class LDrawDrawableElement;
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Types
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// The LDraw line type of the primitive, which is also its number of vertexes.
+typedef enum LDrawPrimitiveType
+{
+	LDrawPrimitiveLine				= 2,
+	LDrawPrimitiveTriangle			= 3,
+	LDrawPrimitiveQuadrilateral		= 4
+
+} LDrawPrimitiveTypeT;
+
+
+// A flattened primitive. Colors derived by Bricksmith rather than looked up in
+// the color library (such as the compliment of a part color, used for edge
+// lines) are given as LDrawColorCustomRGB; rgba is always filled in.
+typedef struct LDrawPrimitive
+{
+	LDrawPrimitiveTypeT		type;
+	LDrawColorT				colorCode;
+	GLfloat					rgba[4];
+	Point3					vertexes[4];	// only the first (type) are meaningful
+	
+	LDrawColor				*color;			// resolved color (not retained)
+	LDrawDrawableElement	*element;		// the untransformed source (not retained)
+
+} LDrawPrimitive;
+
+
+typedef void (*LDrawPrimitiveSinkFunction)(const LDrawPrimitive *primitive, void *context);
+
+// Receives directives which are not made of plain primitives (textures, which
+// draw their own geometry), in place of their contents.
+typedef void (*LDrawPrimitiveSinkOtherFunction)(LDrawDirective *directive, LDrawColor *parentColor, Matrix4 transform, void *context);
+
+typedef struct LDrawPrimitiveSink
+{
+	LDrawPrimitiveSinkFunction		accept;
+	LDrawPrimitiveSinkOtherFunction	acceptOther;		// NULL streams their contents as primitives
+	void							*context;
+	BOOL							followsReferences;	// NO skips parts, like a nonrecursive flatten
+	NSUInteger						primitiveCount;		// number of primitives accepted so far
+
+} LDrawPrimitiveSink;
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+////////////////////////////////////////////////////////////////////////////////
+
+extern LDrawPrimitiveSink	LDrawPrimitiveSinkMake(LDrawPrimitiveSinkFunction accept, void *context);
+extern void					LDrawPrimitiveSinkAccept(LDrawPrimitiveSink *sink, const LDrawPrimitive *primitive);
+
+// Ready-made sink functions. The context is an open FILE *.
+extern void					LDrawPrimitiveWriteText(const LDrawPrimitive *primitive, void *context);
+extern void					LDrawPrimitiveWriteBinary(const LDrawPrimitive *primitive, void *context);
@@ -0,0 +1,146 @@
+//==============================================================================
+//
+// File:		LDrawPrimitiveSink.m
+//
+// Purpose:		Sinks for the streaming flatten. See LDrawPrimitiveSink.h.
+//
+//				Binary record format, native byte order, one per primitive:
+//					int32_t		line type (2, 3 or 4)
+//					int32_t		LDraw color code (-2 for custom RGB)
+//					float[4]	RGBA
+//					float[3n]	n = line type vertexes, x y z each
+//
+//==============================================================================
+#import "LDrawPrimitiveSink.h"
+
+#import <stdio.h>
+#import <string.h>
+
+
+//---------- WriteFloat ----------------------------------------------[static]--
+//
+// Purpose:		Writes a number the same way +[LDrawUtilities
+//				outputStringForFloat:] does when not columnizing, minus the
+//				NSString: trailing zeroes (and a bare decimal point) removed.
+//
+//------------------------------------------------------------------------------
+static void WriteFloat(FILE *file, float number)
+{
+	char    formattedFloat[32]  = "";
+	char    *endOfString        = NULL;
+	size_t  fullLength          = 0;
+
+	snprintf(formattedFloat, sizeof(formattedFloat), "%f", number);
+	fullLength  = strlen(formattedFloat);
+	endOfString = &formattedFloat[fullLength - 1];
+
+	while(*endOfString == '0')
+	{
+		endOfString--;
+	}
+	if(*endOfString != '.')
+	{
+		endOfString++;
+	}
+	*endOfString = '\0';
+
+	fputc(' ', file);
+	fputs(formattedFloat, file);
+
+}//end WriteFloat
+
+
+//========== LDrawPrimitiveSinkMake ============================================
+//
+// Purpose:		Returns a sink which passes every primitive to accept, 
+//				following part references all the way down.
+//
+//==============================================================================
+LDrawPrimitiveSink LDrawPrimitiveSinkMake(LDrawPrimitiveSinkFunction accept, void *context)
+{
+	LDrawPrimitiveSink sink;
+
+	sink.accept				= accept;
+	sink.acceptOther		= NULL;
+	sink.context			= context;
+	sink.followsReferences	= YES;
+	sink.primitiveCount		= 0;
+
+	return sink;
+
+}//end LDrawPrimitiveSinkMake
+
+
+//========== LDrawPrimitiveSinkAccept ==========================================
+//
+// Purpose:		Delivers one flattened primitive to the sink.
+//
+//==============================================================================
+void LDrawPrimitiveSinkAccept(LDrawPrimitiveSink *sink, const LDrawPrimitive *primitive)
+{
+	sink->primitiveCount += 1;
+	sink->accept(primitive, sink->context);
+
+}//end LDrawPrimitiveSinkAccept
+
+
+//========== LDrawPrimitiveWriteText ===========================================
+//
+// Purpose:		Writes the primitive as a line of LDraw text, DOS line endings
+//				and all.
+//
+//==============================================================================
+void LDrawPrimitiveWriteText(const LDrawPrimitive *primitive, void *context)
+{
+	FILE    *file       = (FILE *)context;
+	int     counter     = 0;
+
+	fprintf(file, "%d ", (int)primitive->type);
+
+	if(primitive->colorCode == LDrawColorCustomRGB)
+	{
+		fprintf(file, "0x%d%02X%02X%02X",
+					  (primitive->rgba[3] == 1.0) ? 2 : 3,
+					  (uint8_t)(primitive->rgba[0] * 255),
+					  (uint8_t)(primitive->rgba[1] * 255),
+					  (uint8_t)(primitive->rgba[2] * 255) );
+	}
+	else
+		fprintf(file, "%d", (int)primitive->colorCode);
+
+	for(counter = 0; counter < primitive->type; counter++)
+	{
+		WriteFloat(file, primitive->vertexes[counter].x);
+		WriteFloat(file, primitive->vertexes[counter].y);
+		WriteFloat(file, primitive->vertexes[counter].z);
+	}
+
+	fputs("\r\n", file);
+
+}//end LDrawPrimitiveWriteText
+
+
+//========== LDrawPrimitiveWriteBinary =========================================
+//
+// Purpose:		Writes the primitive as a binary record (format above).
+//
+//==============================================================================
+void LDrawPrimitiveWriteBinary(const LDrawPrimitive *primitive, void *context)
+{
+	FILE    *file           = (FILE *)context;
+	int32_t header[2]       = { primitive->type, primitive->colorCode };
+	float   coordinates[12] = {};
+	int     counter         = 0;
+
+	for(counter = 0; counter < primitive->type; counter++)
+	{
+		coordinates[counter * 3 + 0] = primitive->vertexes[counter].x;
+		coordinates[counter * 3 + 1] = primitive->vertexes[counter].y;
+		coordinates[counter * 3 + 2] = primitive->vertexes[counter].z;
+	}
+
+	fwrite(header,				sizeof(int32_t),	2,						file);
+	fwrite(primitive->rgba,		sizeof(GLfloat),	4,						file);
+	fwrite(coordinates,			sizeof(float),		primitive->type * 3,	file);
+
+}//end LDrawPrimitiveWriteBinary
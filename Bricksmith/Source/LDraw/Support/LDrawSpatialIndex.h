@@ -0,0 +1,51 @@
+//==============================================================================
+//
+// File:		LDrawSpatialIndex.h
+//
+// Purpose:		A dynamic index of objects by bounding box, for finding which
+//				objects overlap without comparing every pair.
+//
+//				The index is a uniform grid hashed into buckets: each object is
+//				filed under every grid cell its box touches, so a query only
+//				looks at objects sharing a cell with the query box, whichever
+//				way the model is laid out. Moving an object re-files just that
+//				object. The few objects too big to file cell by cell (such as
+//				baseplates) are kept on a short list which every query checks.
+//
+//				This class knows nothing about LDraw. Objects are retained and
+//				compared by identity.
+//
+//==============================================================================
+#import <Foundation/Foundation.h>
+
+#import "MatrixMath.h"
+
+struct SpatialGrid;
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// class LDrawSpatialIndex
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface LDrawSpatialIndex : NSObject
+{
+	struct SpatialGrid  *grid;				// boxes filed by the grid cells they touch
+	NSMapTable          *entryIndexes;		// object -> entry in grid + 1
+}
+
+// Accessors
+- (Box3) boundsForObject:(id)object;
+- (NSUInteger) count;
+- (BOOL) containsObject:(id)object;
+
+- (void) setBounds:(Box3)bounds forObject:(id)object;
+- (void) removeObject:(id)object;
+- (void) removeAllObjects;
+
+// Queries
+- (NSArray *) objectsIntersectingBox:(Box3)box;
+- (NSArray *) objectsIntersectingObject:(id)object;
+- (NSArray *) intersectingPairs;
+
+@end
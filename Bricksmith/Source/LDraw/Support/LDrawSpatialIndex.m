@@ -0,0 +1,841 @@
+//==============================================================================
+//
+// File:		LDrawSpatialIndex.m
+//
+// Purpose:		A dynamic grid index of objects by bounding box. See
+//				LDrawSpatialIndex.h.
+//
+// Notes:		Space is divided into cubes SPATIAL_CELL_SIZE on a side. Each
+//				object gets one cell record per cube its box touches, and cell
+//				records are filed in buckets chosen from the cube. Buckets are
+//				doubly-linked chains threaded through one flat array, and each
+//				object's cell records are chained together as well, so an
+//				object can be unfiled in time proportional to its size. Freed
+//				slots are reused before the arrays grow.
+//
+//				Different cubes may share a bucket; a query checks the cube of
+//				each record it finds, and stamps each object it tests so that an
+//				object filed under several of the cubes it visits is only tested
+//				once.
+//
+//==============================================================================
+#import "LDrawSpatialIndex.h"
+
+#import <stdlib.h>
+#import <string.h>
+
+// Edge of the cubes into which space is divided, in LDraw units. Two studs; an
+// ordinary brick touches a dozen cubes or fewer.
+#define SPATIAL_CELL_SIZE				40.0f
+
+// Objects which would touch more cubes than this are not filed by cube but
+// kept on a list which every query checks. Only the biggest plates get there.
+#define SPATIAL_CELLS_PER_ENTRY_MAX		128
+
+// A query box touching more cubes than this simply checks every object.
+#define SPATIAL_CELLS_PER_QUERY_MAX		4096
+
+// Cube coordinates are clamped to this distance from the origin, so absurd
+// coordinates can't overflow the arithmetic.
+#define SPATIAL_CELL_LIMIT				(1 << 20)
+
+#define SPATIAL_NO_ENTRY				(-1)
+
+
+//------------------------------------------------------------------------------
+//
+// SpatialGrid
+//
+//------------------------------------------------------------------------------
+typedef struct SpatialEntry
+{
+	Box3		bounds;
+	id			object;				// nil while the slot is free
+	int32_t		firstCell;			// this entry's cell records, through nextForEntry
+	int32_t		next;				// next large entry, or next free slot
+	int32_t		previous;			// previous large entry
+	uint32_t	stamp;				// last query which tested this entry
+	BOOL		isLarge;
+
+} SpatialEntry;
+
+
+typedef struct SpatialCell
+{
+	int32_t		x;
+	int32_t		y;
+	int32_t		z;
+	int32_t		entry;
+	int32_t		next;				// next in bucket, or next free slot
+	int32_t		previous;			// SPATIAL_NO_ENTRY if first in bucket
+	int32_t		nextForEntry;
+	uint32_t	bucket;
+
+} SpatialCell;
+
+
+struct SpatialGrid
+{
+	SpatialEntry	*entries;
+	int32_t			entryCapacity;
+	int32_t			entriesUsed;	// slots ever handed out
+	int32_t			freeEntries;
+
+	SpatialCell		*cells;
+	int32_t			cellCapacity;
+	int32_t			cellsUsed;		// slots ever handed out
+	int32_t			cellCount;		// slots holding a record
+	int32_t			freeCells;
+
+	int32_t			*buckets;		// first cell record in each bucket
+	uint32_t		bucketCount;	// power of two
+
+	int32_t			largeEntries;
+	uint32_t		queryStamp;
+};
+
+typedef struct SpatialGrid SpatialGrid;
+
+typedef void (*SpatialGridVisitor)(SpatialEntry *entry, int32_t entryIndex, void *context);
+
+
+typedef struct PairContext
+{
+	NSMutableArray	*pairs;
+	int32_t			firstIndex;
+	id				firstObject;
+
+} PairContext;
+
+
+static SpatialGrid	*SpatialGridCreate(void);
+static void			SpatialGridFree(SpatialGrid *grid);
+static void			SpatialGridRemoveAll(SpatialGrid *grid);
+static int32_t		SpatialGridInsert(SpatialGrid *grid, id object, Box3 bounds);
+static void			SpatialGridMove(SpatialGrid *grid, int32_t entryIndex, Box3 bounds);
+static void			SpatialGridRemove(SpatialGrid *grid, int32_t entryIndex);
+static void			SpatialGridQuery(SpatialGrid *grid, Box3 box, SpatialGridVisitor visitor, void *context);
+static void			FileEntry(SpatialGrid *grid, int32_t entryIndex);
+static void			UnfileEntry(SpatialGrid *grid, int32_t entryIndex);
+static void			AddCell(SpatialGrid *grid, int32_t entryIndex, int32_t cellX, int32_t cellY, int32_t cellZ);
+static void			GrowBuckets(SpatialGrid *grid);
+static uint64_t		CellRangeForBox(Box3 box, int32_t *minimum, int32_t *maximum);
+static uint32_t		BucketForCell(int32_t cellX, int32_t cellY, int32_t cellZ, uint32_t bucketCount);
+static void			CollectObject(SpatialEntry *entry, int32_t entryIndex, void *context);
+static void			CollectPair(SpatialEntry *entry, int32_t entryIndex, void *context);
+
+
+@implementation LDrawSpatialIndex
+
+//========== init ==============================================================
+//
+// Purpose:		Initialize an empty index.
+//
+//==============================================================================
+- (id) init
+{
+	self = [super init];
+	if(self)
+	{
+		entryIndexes    = [[NSMapTable alloc] initWithKeyOptions:(NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality)
+												valueOptions:(NSPointerFunctionsOpaqueMemory | NSPointerFunctionsIntegerPersonality)
+													capacity:0];
+		grid            = SpatialGridCreate();
+	}
+	return self;
+
+}//end init
+
+
+#pragma mark -
+#pragma mark ACCESSORS
+#pragma mark -
+
+//========== boundsForObject: ==================================================
+//
+// Purpose:		Returns the box most recently given for object, or InvalidBox.
+//
+//==============================================================================
+- (Box3) boundsForObject:(id)object
+{
+	NSUInteger  indexPlusOne    = (NSUInteger)NSMapGet(self->entryIndexes, object);
+
+	if(indexPlusOne == 0)
+		return InvalidBox;
+	else
+		return self->grid->entries[indexPlusOne - 1].bounds;
+
+}//end boundsForObject:
+
+
+//========== count =============================================================
+//
+// Purpose:		Returns the number of objects in the index.
+//
+//==============================================================================
+- (NSUInteger) count
+{
+	return NSCountMapTable(self->entryIndexes);
+
+}//end count
+
+
+//========== containsObject: ===================================================
+//
+// Purpose:		Returns YES if object has been given a box.
+//
+//==============================================================================
+- (BOOL) containsObject:(id)object
+{
+	return (NSMapGet(self->entryIndexes, object) != NULL);
+
+}//end containsObject:
+
+
+#pragma mark -
+
+//========== setBounds:forObject: ==============================================
+//
+// Purpose:		Adds object to the index, or moves it if it is already there.
+//
+// Notes:		Objects with InvalidBox bounds have no place in space; they are
+//				removed.
+//
+//==============================================================================
+- (void) setBounds:(Box3)bounds forObject:(id)object
+{
+	NSUInteger  indexPlusOne    = (NSUInteger)NSMapGet(self->entryIndexes, object);
+	int32_t     index           = 0;
+
+	if(V3EqualBoxes(bounds, InvalidBox))
+	{
+		[self removeObject:object];
+		return;
+	}
+
+	if(indexPlusOne != 0)
+	{
+		SpatialGridMove(self->grid, (int32_t)(indexPlusOne - 1), bounds);
+	}
+	else
+	{
+		index = SpatialGridInsert(self->grid, [object retain], bounds);
+		NSMapInsert(self->entryIndexes, object, (void *)(NSUInteger)(index + 1));
+	}
+
+}//end setBounds:forObject:
+
+
+//========== removeObject: =====================================================
+//
+// Purpose:		Takes object out of the index.
+//
+//==============================================================================
+- (void) removeObject:(id)object
+{
+	NSUInteger  indexPlusOne    = (NSUInteger)NSMapGet(self->entryIndexes, object);
+
+	if(indexPlusOne != 0)
+	{
+		NSMapRemove(self->entryIndexes, object);
+		SpatialGridRemove(self->grid, (int32_t)(indexPlusOne - 1));
+		[object release];
+	}
+
+}//end removeObject:
+
+
+//========== removeAllObjects ==================================================
+//
+// Purpose:		Empties the index.
+//
+//==============================================================================
+- (void) removeAllObjects
+{
+	int32_t counter = 0;
+
+	for(counter = 0; counter < self->grid->entriesUsed; counter++)
+	{
+		[self->grid->entries[counter].object release];
+	}
+	NSResetMapTable(self->entryIndexes);
+
+	SpatialGridRemoveAll(self->grid);
+
+}//end removeAllObjects
+
+
+#pragma mark -
+#pragma mark QUERIES
+#pragma mark -
+
+//========== objectsIntersectingBox: ===========================================
+//
+// Purpose:		Returns every object whose box overlaps or touches box.
+//
+//==============================================================================
+- (NSArray *) objectsIntersectingBox:(Box3)box
+{
+	NSMutableArray  *objects    = [NSMutableArray array];
+
+	SpatialGridQuery(self->grid, box, CollectObject, objects);
+
+	return objects;
+
+}//end objectsIntersectingBox:
+
+
+//========== objectsIntersectingObject: ========================================
+//
+// Purpose:		Returns every other object whose box overlaps that of object.
+//
+//==============================================================================
+- (NSArray *) objectsIntersectingObject:(id)object
+{
+	NSMutableArray  *objects    = nil;
+
+	if([self containsObject:object] == NO)
+		return [NSArray array];
+
+	objects = (NSMutableArray *)[self objectsIntersectingBox:[self boundsForObject:object]];
+	[objects removeObjectIdenticalTo:object];
+
+	return objects;
+
+}//end objectsIntersectingObject:
+
+
+//========== intersectingPairs =================================================
+//
+// Purpose:		Returns every pair of objects whose boxes overlap, as an array
+//				of two-element arrays.
+//
+// Notes:		Each object queries the grid with its own box and keeps only the
+//				partners filed after it, so every pair comes out once.
+//
+//==============================================================================
+- (NSArray *) intersectingPairs
+{
+	PairContext     context;
+	SpatialEntry    *entry      = NULL;
+	int32_t         counter     = 0;
+
+	context.pairs = [NSMutableArray array];
+
+	for(counter = 0; counter < self->grid->entriesUsed; counter++)
+	{
+		entry = &self->grid->entries[counter];
+		if(entry->object == nil)
+			continue;
+
+		context.firstIndex  = counter;
+		context.firstObject = entry->object;
+
+		SpatialGridQuery(self->grid, entry->bounds, CollectPair, &context);
+	}
+
+	return context.pairs;
+
+}//end intersectingPairs
+
+
+#pragma mark -
+#pragma mark DESTRUCTOR
+#pragma mark -
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Index withdrawn from circulation.
+//
+//==============================================================================
+- (void) dealloc
+{
+	[self removeAllObjects];
+
+	SpatialGridFree(grid);
+	[entryIndexes release];
+
+	[super dealloc];
+
+}//end dealloc
+
+
+@end
+
+
+#pragma mark -
+
+//---------- SpatialGridCreate ---------------------------------------[static]--
+//
+// Purpose:		Returns a new, empty grid.
+//
+//------------------------------------------------------------------------------
+static SpatialGrid *SpatialGridCreate(void)
+{
+	SpatialGrid *grid   = calloc(1, sizeof(SpatialGrid));
+	uint32_t    bucket  = 0;
+
+	grid->bucketCount   = 256;
+	grid->buckets       = malloc(sizeof(int32_t) * grid->bucketCount);
+
+	for(bucket = 0; bucket < grid->bucketCount; bucket++)
+		grid->buckets[bucket] = SPATIAL_NO_ENTRY;
+
+	grid->freeEntries   = SPATIAL_NO_ENTRY;
+	grid->freeCells     = SPATIAL_NO_ENTRY;
+	grid->largeEntries  = SPATIAL_NO_ENTRY;
+
+	return grid;
+
+}//end SpatialGridCreate
+
+
+//---------- SpatialGridFree -----------------------------------------[static]--
+//
+// Purpose:		Frees the grid. The objects in it are the caller's problem.
+//
+//------------------------------------------------------------------------------
+static void SpatialGridFree(SpatialGrid *grid)
+{
+	free(grid->entries);
+	free(grid->cells);
+	free(grid->buckets);
+	free(grid);
+
+}//end SpatialGridFree
+
+
+//---------- SpatialGridRemoveAll ------------------------------------[static]--
+//
+// Purpose:		Forgets every entry, keeping the memory for reuse.
+//
+//------------------------------------------------------------------------------
+static void SpatialGridRemoveAll(SpatialGrid *grid)
+{
+	uint32_t    bucket  = 0;
+
+	for(bucket = 0; bucket < grid->bucketCount; bucket++)
+		grid->buckets[bucket] = SPATIAL_NO_ENTRY;
+
+	grid->entriesUsed   = 0;
+	grid->freeEntries   = SPATIAL_NO_ENTRY;
+	grid->cellsUsed     = 0;
+	grid->cellCount     = 0;
+	grid->freeCells     = SPATIAL_NO_ENTRY;
+	grid->largeEntries  = SPATIAL_NO_ENTRY;
+
+}//end SpatialGridRemoveAll
+
+
+//---------- SpatialGridInsert ---------------------------------------[static]--
+//
+// Purpose:		Files object with the given bounds and returns its entry index.
+//
+//------------------------------------------------------------------------------
+static int32_t SpatialGridInsert(SpatialGrid *grid, id object, Box3 bounds)
+{
+	int32_t         entryIndex  = grid->freeEntries;
+	SpatialEntry    *entry      = NULL;
+
+	if(entryIndex != SPATIAL_NO_ENTRY)
+	{
+		grid->freeEntries = grid->entries[entryIndex].next;
+	}
+	else
+	{
+		if(grid->entriesUsed == grid->entryCapacity)
+		{
+			grid->entryCapacity = MAX(64, grid->entryCapacity * 2);
+			grid->entries       = realloc(grid->entries, sizeof(SpatialEntry) * grid->entryCapacity);
+		}
+		entryIndex = grid->entriesUsed;
+		grid->entriesUsed += 1;
+	}
+
+	entry           = &grid->entries[entryIndex];
+	entry->bounds   = bounds;
+	entry->object   = object;
+	entry->stamp    = 0;
+
+	FileEntry(grid, entryIndex);
+
+	return entryIndex;
+
+}//end SpatialGridInsert
+
+
+//---------- SpatialGridMove -----------------------------------------[static]--
+//
+// Purpose:		Gives an entry new bounds, re-filing it only if the cubes it
+//				touches changed.
+//
+//------------------------------------------------------------------------------
+static void SpatialGridMove(SpatialGrid *grid, int32_t entryIndex, Box3 bounds)
+{
+	SpatialEntry    *entry          = &grid->entries[entryIndex];
+	int32_t         oldMinimum[3];
+	int32_t         oldMaximum[3];
+	int32_t         newMinimum[3];
+	int32_t         newMaximum[3];
+
+	CellRangeForBox(entry->bounds, oldMinimum, oldMaximum);
+	CellRangeForBox(bounds, newMinimum, newMaximum);
+
+	entry->bounds = bounds;
+
+	if(		memcmp(oldMinimum, newMinimum, sizeof(oldMinimum)) != 0
+	   ||	memcmp(oldMaximum, newMaximum, sizeof(oldMaximum)) != 0 )
+	{
+		UnfileEntry(grid, entryIndex);
+		FileEntry(grid, entryIndex);
+	}
+
+}//end SpatialGridMove
+
+
+//---------- SpatialGridRemove ---------------------------------------[static]--
+//
+// Purpose:		Unfiles an entry and puts its slot on the free list.
+//
+//------------------------------------------------------------------------------
+static void SpatialGridRemove(SpatialGrid *grid, int32_t entryIndex)
+{
+	SpatialEntry    *entry  = &grid->entries[entryIndex];
+
+	UnfileEntry(grid, entryIndex);
+
+	entry->object       = nil;
+	entry->next         = grid->freeEntries;
+	grid->freeEntries   = entryIndex;
+
+}//end SpatialGridRemove
+
+
+//---------- SpatialGridQuery ----------------------------------------[static]--
+//
+// Purpose:		Calls visitor once for each entry whose box overlaps or touches
+//				box.
+//
+//------------------------------------------------------------------------------
+static void SpatialGridQuery(SpatialGrid *grid, Box3 box, SpatialGridVisitor visitor, void *context)
+{
+	SpatialEntry    *entry          = NULL;
+	SpatialCell     *cell           = NULL;
+	int32_t         minimum[3];
+	int32_t         maximum[3];
+	int32_t         cellX           = 0;
+	int32_t         cellY           = 0;
+	int32_t         cellZ           = 0;
+	int32_t         cellIndex       = 0;
+	int32_t         entryIndex      = 0;
+	uint32_t        stamp           = 0;
+
+	// Stamps must be unique among live entries; start over if they wrap.
+	grid->queryStamp += 1;
+	if(grid->queryStamp == 0)
+	{
+		for(entryIndex = 0; entryIndex < grid->entriesUsed; entryIndex++)
+			grid->entries[entryIndex].stamp = 0;
+		grid->queryStamp = 1;
+	}
+	stamp = grid->queryStamp;
+
+	if(CellRangeForBox(box, minimum, maximum) > SPATIAL_CELLS_PER_QUERY_MAX)
+	{
+		for(entryIndex = 0; entryIndex < grid->entriesUsed; entryIndex++)
+		{
+			entry = &grid->entries[entryIndex];
+			if(entry->object != nil && V3BoxesIntersect(entry->bounds, box))
+				visitor(entry, entryIndex, context);
+		}
+		return;
+	}
+
+	for(cellX = minimum[0]; cellX <= maximum[0]; cellX++)
+	{
+		for(cellY = minimum[1]; cellY <= maximum[1]; cellY++)
+		{
+			for(cellZ = minimum[2]; cellZ <= maximum[2]; cellZ++)
+			{
+				cellIndex = grid->buckets[BucketForCell(cellX, cellY, cellZ, grid->bucketCount)];
+
+				for( ; cellIndex != SPATIAL_NO_ENTRY; cellIndex = cell->next)
+				{
+					cell = &grid->cells[cellIndex];
+					if(cell->x != cellX || cell->y != cellY || cell->z != cellZ)
+						continue;
+
+					entry = &grid->entries[cell->entry];
+					if(entry->stamp == stamp)
+						continue;
+					entry->stamp = stamp;
+
+					if(V3BoxesIntersect(entry->bounds, box))
+						visitor(entry, cell->entry, context);
+				}
+			}
+		}
+	}
+
+	for(entryIndex = grid->largeEntries; entryIndex != SPATIAL_NO_ENTRY; entryIndex = entry->next)
+	{
+		entry = &grid->entries[entryIndex];
+
+		if(V3BoxesIntersect(entry->bounds, box))
+			visitor(entry, entryIndex, context);
+	}
+
+}//end SpatialGridQuery
+
+
+//---------- FileEntry -----------------------------------------------[static]--
+//
+// Purpose:		Files an entry under each cube its box touches, or on the large
+//				list if that would be too many.
+//
+//------------------------------------------------------------------------------
+static void FileEntry(SpatialGrid *grid, int32_t entryIndex)
+{
+	SpatialEntry    *entry          = &grid->entries[entryIndex];
+	int32_t         minimum[3];
+	int32_t         maximum[3];
+	int32_t         cellX           = 0;
+	int32_t         cellY           = 0;
+	int32_t         cellZ           = 0;
+
+	entry->firstCell = SPATIAL_NO_ENTRY;
+
+	if(CellRangeForBox(entry->bounds, minimum, maximum) > SPATIAL_CELLS_PER_ENTRY_MAX)
+	{
+		entry->isLarge  = YES;
+		entry->previous = SPATIAL_NO_ENTRY;
+		entry->next     = grid->largeEntries;
+
+		if(entry->next != SPATIAL_NO_ENTRY)
+			grid->entries[entry->next].previous = entryIndex;
+		grid->largeEntries = entryIndex;
+	}
+	else
+	{
+		entry->isLarge  = NO;
+
+		for(cellX = minimum[0]; cellX <= maximum[0]; cellX++)
+			for(cellY = minimum[1]; cellY <= maximum[1]; cellY++)
+				for(cellZ = minimum[2]; cellZ <= maximum[2]; cellZ++)
+					AddCell(grid, entryIndex, cellX, cellY, cellZ);
+	}
+
+}//end FileEntry
+
+
+//---------- UnfileEntry ---------------------------------------------[static]--
+//
+// Purpose:		Takes an entry out of every bucket (or the large list).
+//
+//------------------------------------------------------------------------------
+static void UnfileEntry(SpatialGrid *grid, int32_t entryIndex)
+{
+	SpatialEntry    *entry      = &grid->entries[entryIndex];
+	SpatialCell     *cell       = NULL;
+	int32_t         cellIndex   = 0;
+	int32_t         nextCell    = 0;
+
+	if(entry->isLarge)
+	{
+		if(entry->previous != SPATIAL_NO_ENTRY)
+			grid->entries[entry->previous].next = entry->next;
+		else
+			grid->largeEntries = entry->next;
+
+		if(entry->next != SPATIAL_NO_ENTRY)
+			grid->entries[entry->next].previous = entry->previous;
+	}
+	else
+	{
+		for(cellIndex = entry->firstCell; cellIndex != SPATIAL_NO_ENTRY; cellIndex = nextCell)
+		{
+			cell        = &grid->cells[cellIndex];
+			nextCell    = cell->nextForEntry;
+
+			if(cell->previous != SPATIAL_NO_ENTRY)
+				grid->cells[cell->previous].next = cell->next;
+			else
+				grid->buckets[cell->bucket] = cell->next;
+
+			if(cell->next != SPATIAL_NO_ENTRY)
+				grid->cells[cell->next].previous = cell->previous;
+
+			cell->next      = grid->freeCells;
+			grid->freeCells = cellIndex;
+			grid->cellCount -= 1;
+		}
+	}
+
+	entry->firstCell    = SPATIAL_NO_ENTRY;
+	entry->isLarge      = NO;
+
+}//end UnfileEntry
+
+
+//---------- AddCell -------------------------------------------------[static]--
+//
+// Purpose:		Files one cell record for an entry.
+//
+//------------------------------------------------------------------------------
+static void AddCell(SpatialGrid *grid, int32_t entryIndex, int32_t cellX, int32_t cellY, int32_t cellZ)
+{
+	SpatialCell     *cell       = NULL;
+	int32_t         cellIndex   = 0;
+	uint32_t        bucket      = 0;
+
+	// Keep chains short. This has to happen before a slot is taken, because 
+	// re-filing tells free slots from used ones by the free list. 
+	if(grid->cellCount >= grid->bucketCount * 2)
+		GrowBuckets(grid);
+
+	cellIndex = grid->freeCells;
+	if(cellIndex != SPATIAL_NO_ENTRY)
+	{
+		grid->freeCells = grid->cells[cellIndex].next;
+	}
+	else
+	{
+		if(grid->cellsUsed == grid->cellCapacity)
+		{
+			grid->cellCapacity  = MAX(256, grid->cellCapacity * 2);
+			grid->cells         = realloc(grid->cells, sizeof(SpatialCell) * grid->cellCapacity);
+		}
+		cellIndex = grid->cellsUsed;
+		grid->cellsUsed += 1;
+	}
+
+	bucket              = BucketForCell(cellX, cellY, cellZ, grid->bucketCount);
+	cell                = &grid->cells[cellIndex];
+	cell->x             = cellX;
+	cell->y             = cellY;
+	cell->z             = cellZ;
+	cell->entry         = entryIndex;
+	cell->bucket        = bucket;
+	cell->previous      = SPATIAL_NO_ENTRY;
+	cell->next          = grid->buckets[bucket];
+	cell->nextForEntry  = grid->entries[entryIndex].firstCell;
+
+	if(cell->next != SPATIAL_NO_ENTRY)
+		grid->cells[cell->next].previous = cellIndex;
+	grid->buckets[bucket] = cellIndex;
+
+	grid->entries[entryIndex].firstCell = cellIndex;
+	grid->cellCount += 1;
+
+}//end AddCell
+
+
+//---------- GrowBuckets ---------------------------------------------[static]--
+//
+// Purpose:		Doubles the number of buckets and re-files every cell record.
+//
+//------------------------------------------------------------------------------
+static void GrowBuckets(SpatialGrid *grid)
+{
+	SpatialCell     *cell       = NULL;
+	int32_t         cellIndex   = 0;
+	uint32_t        bucket      = 0;
+
+	grid->bucketCount   *= 2;
+	grid->buckets       = realloc(grid->buckets, sizeof(int32_t) * grid->bucketCount);
+
+	for(bucket = 0; bucket < grid->bucketCount; bucket++)
+		grid->buckets[bucket] = SPATIAL_NO_ENTRY;
+
+	// Free records must not be filed. Mark them by walking the free list.
+	for(cellIndex = grid->freeCells; cellIndex != SPATIAL_NO_ENTRY; cellIndex = grid->cells[cellIndex].next)
+		grid->cells[cellIndex].bucket = UINT32_MAX;
+
+	for(cellIndex = 0; cellIndex < grid->cellsUsed; cellIndex++)
+	{
+		cell = &grid->cells[cellIndex];
+		if(cell->bucket == UINT32_MAX)
+			continue;
+
+		bucket          = BucketForCell(cell->x, cell->y, cell->z, grid->bucketCount);
+		cell->bucket    = bucket;
+		cell->previous  = SPATIAL_NO_ENTRY;
+		cell->next      = grid->buckets[bucket];
+
+		if(cell->next != SPATIAL_NO_ENTRY)
+			grid->cells[cell->next].previous = cellIndex;
+		grid->buckets[bucket] = cellIndex;
+	}
+
+}//end GrowBuckets
+
+
+//---------- CellRangeForBox -----------------------------------------[static]--
+//
+// Purpose:		Finds the first and last cube touched by box along each axis,
+//				and returns how many cubes that is altogether.
+//
+//------------------------------------------------------------------------------
+static uint64_t CellRangeForBox(Box3 box, int32_t *minimum, int32_t *maximum)
+{
+	const float *boxMinimum = &box.min.x;
+	const float *boxMaximum = &box.max.x;
+	uint64_t    cellCount   = 1;
+	int         axis        = 0;
+
+	for(axis = 0; axis < 3; axis++)
+	{
+		minimum[axis] = (int32_t)MAX(-SPATIAL_CELL_LIMIT, MIN(SPATIAL_CELL_LIMIT, floorf(boxMinimum[axis] / SPATIAL_CELL_SIZE)));
+		maximum[axis] = (int32_t)MAX(-SPATIAL_CELL_LIMIT, MIN(SPATIAL_CELL_LIMIT, floorf(boxMaximum[axis] / SPATIAL_CELL_SIZE)));
+
+		if(maximum[axis] < minimum[axis])
+			maximum[axis] = minimum[axis];
+
+		cellCount *= (uint64_t)(maximum[axis] - minimum[axis] + 1);
+	}
+
+	return cellCount;
+
+}//end CellRangeForBox
+
+
+//---------- BucketForCell -------------------------------------------[static]--
+//
+// Purpose:		Spatial hash of a cube.
+//
+//------------------------------------------------------------------------------
+static uint32_t BucketForCell(int32_t cellX, int32_t cellY, int32_t cellZ, uint32_t bucketCount)
+{
+	uint32_t mixed = ((uint32_t)cellX * 73856093u) ^ ((uint32_t)cellY * 19349663u) ^ ((uint32_t)cellZ * 83492791u);
+
+	return mixed & (bucketCount - 1);
+
+}//end BucketForCell
+
+
+//---------- CollectObject -------------------------------------------[static]--
+//
+// Purpose:		Query visitor which adds each object found to an array.
+//
+//------------------------------------------------------------------------------
+static void CollectObject(SpatialEntry *entry, int32_t entryIndex, void *context)
+{
+	[(NSMutableArray *)context addObject:entry->object];
+
+}//end CollectObject
+
+
+//---------- CollectPair ---------------------------------------------[static]--
+//
+// Purpose:		Query visitor which records a pair with every object filed after
+//				the one doing the query.
+//
+//------------------------------------------------------------------------------
+static void CollectPair(SpatialEntry *entry, int32_t entryIndex, void *context)
+{
+	PairContext *pairContext = context;
+
+	if(entryIndex > pairContext->firstIndex)
+		[pairContext->pairs addObject:[NSArray arrayWithObjects:pairContext->firstObject, entry->object, nil]];
+
+}//end CollectPair
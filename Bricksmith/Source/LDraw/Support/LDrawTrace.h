@@ -0,0 +1,61 @@
+//==============================================================================
+//
+// File:		LDrawTrace.h
+//
+// Purpose:		A low-overhead recorder of timed events, for finding out where
+//				the time goes in a running program.
+//
+//				Code brackets work with TRACE_BEGIN and TRACE_END, and reports
+//				running totals with TRACE_COUNTER. While recording is off, each
+//				of these costs one test of a global flag. While it is on, an
+//				event is a timestamp and a few stores into a ring buffer owned by
+//				the calling thread; there are no locks and no allocation except
+//				the first time a thread records anything.
+//
+//				Each thread's ring holds the most recent TRACE_BUFFER_EVENTS of
+//				its events. LDrawTraceWriteChromeJSON writes every ring out in
+//				the Chrome trace format, which chrome://tracing (and other trace
+//				viewers) can open.
+//
+//				Event names are not copied. They must be string literals, or
+//				otherwise live forever.
+//
+//				All of this compiles away unless WANT_TRACING is set.
+//
+//==============================================================================
+#import <Foundation/Foundation.h>
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Instrumentation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if WANT_TRACING
+	#define TRACE_BEGIN(name)				do { if(LDrawTraceIsRecording) LDrawTraceBegin(name); } while(0)
+	#define TRACE_END(name)					do { if(LDrawTraceIsRecording) LDrawTraceEnd(name); } while(0)
+	#define TRACE_COUNTER(name, value)		do { if(LDrawTraceIsRecording) LDrawTraceCounter(name, value); } while(0)
+#else
+	#define TRACE_BEGIN(name)				do { } while(0)
+	#define TRACE_END(name)					do { } while(0)
+	#define TRACE_COUNTER(name, value)		do { } while(0)
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Nonzero while events are being recorded. Read it; don't write it.
+extern volatile int		LDrawTraceIsRecording;
+
+extern void				LDrawTraceSetRecording(int recording);
+
+extern void				LDrawTraceBegin(const char *name);
+extern void				LDrawTraceEnd(const char *name);
+extern void				LDrawTraceCounter(const char *name, double value);
+
+extern int				LDrawTraceWriteChromeJSON(const char *path);
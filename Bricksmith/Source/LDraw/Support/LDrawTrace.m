@@ -0,0 +1,354 @@
+//==============================================================================
+//
+// File:		LDrawTrace.m
+//
+// Purpose:		A low-overhead recorder of timed events. See LDrawTrace.h.
+//
+// Notes:		A thread only ever writes its own ring, so recording needs no
+//				lock. The list of rings is locked only to add to it, which each
+//				thread does once, and to write it out.
+//
+//				Rings outlive their threads so that work done on short-lived
+//				dispatch threads still shows up in the trace. A ring whose
+//				thread has exited is retired until its events have been written
+//				out (or recording starts over); only an empty one is handed to
+//				the next new thread.
+//
+//				Writing out pauses recording, but a thread in the middle of an
+//				event can still finish it; at worst, a full ring may show one
+//				torn event at its oldest end.
+//
+//==============================================================================
+#import "LDrawTrace.h"
+
+#import <libkern/OSAtomic.h>
+#import <mach/mach_time.h>
+#import <pthread.h>
+#import <stdio.h>
+
+// Events kept per thread. Must be a power of two.
+#define TRACE_BUFFER_EVENTS		16384
+
+
+typedef struct LDrawTraceEvent
+{
+	uint64_t		time;					// mach_absolute_time
+	const char		*name;
+	double			value;					// counters only
+	char			phase;					// 'B', 'E' or 'C', as in the Chrome format
+
+} LDrawTraceEvent;
+
+
+typedef struct LDrawTraceBuffer
+{
+	struct LDrawTraceBuffer	*next;
+	uint64_t				threadID;
+	int						isMainThread;
+	volatile int			inUse;			// owned by a live thread
+	volatile uint32_t		written;		// events ever written; the ring index is written % TRACE_BUFFER_EVENTS
+	LDrawTraceEvent			events[TRACE_BUFFER_EVENTS];
+
+} LDrawTraceBuffer;
+
+
+volatile int					LDrawTraceIsRecording	= 0;
+
+static pthread_once_t			TraceOnce				= PTHREAD_ONCE_INIT;
+static pthread_key_t			TraceBufferKey;
+static pthread_mutex_t			TraceBuffersLock		= PTHREAD_MUTEX_INITIALIZER;
+static LDrawTraceBuffer			*TraceBuffers			= NULL;
+static uint64_t					TraceStartTime			= 0;
+static mach_timebase_info_data_t TraceTimebase;
+
+static void				TraceInitialize(void);
+static void				ReleaseThreadBuffer(void *buffer);
+static LDrawTraceBuffer	*ThreadBuffer(void);
+static void				RecordEvent(char phase, const char *name, double value);
+static void				WriteEvent(FILE *file, LDrawTraceBuffer *buffer, LDrawTraceEvent *event);
+
+
+#pragma mark -
+#pragma mark RECORDING
+#pragma mark -
+
+//========== LDrawTraceSetRecording ============================================
+//
+// Purpose:		Starts or stops recording. Starting throws out whatever was
+//				recorded before.
+//
+//==============================================================================
+void LDrawTraceSetRecording(int recording)
+{
+	LDrawTraceBuffer	*buffer 	= NULL;
+
+	pthread_once(&TraceOnce, TraceInitialize);
+
+	if(recording && !LDrawTraceIsRecording)
+	{
+		pthread_mutex_lock(&TraceBuffersLock);
+		for(buffer = TraceBuffers; buffer != NULL; buffer = buffer->next)
+		{
+			buffer->written = 0;
+		}
+		pthread_mutex_unlock(&TraceBuffersLock);
+
+		TraceStartTime = mach_absolute_time();
+	}
+
+	OSMemoryBarrier();
+	LDrawTraceIsRecording = (recording != 0);
+
+}//end LDrawTraceSetRecording
+
+
+//========== LDrawTraceBegin ===================================================
+//
+// Purpose:		Marks the start of a span of work on this thread.
+//
+//==============================================================================
+void LDrawTraceBegin(const char *name)
+{
+	RecordEvent('B', name, 0);
+
+}//end LDrawTraceBegin
+
+
+//========== LDrawTraceEnd =====================================================
+//
+// Purpose:		Marks the end of the span most recently begun on this thread.
+//
+//==============================================================================
+void LDrawTraceEnd(const char *name)
+{
+	RecordEvent('E', name, 0);
+
+}//end LDrawTraceEnd
+
+
+//========== LDrawTraceCounter =================================================
+//
+// Purpose:		Records the current value of a counter, which trace viewers
+//				graph over time.
+//
+//==============================================================================
+void LDrawTraceCounter(const char *name, double value)
+{
+	RecordEvent('C', name, value);
+
+}//end LDrawTraceCounter
+
+
+#pragma mark -
+#pragma mark WRITING
+#pragma mark -
+
+//========== LDrawTraceWriteChromeJSON =========================================
+//
+// Purpose:		Writes everything recorded so far to path, in the Chrome trace
+//				event format. Returns nonzero on success.
+//
+// Notes:		Recording is paused while writing and then picks up again where
+//				it was.
+//
+//				A full ring may have lost the beginnings of spans whose ends it
+//				still holds; those ends are skipped.
+//
+//				Rings of threads which have exited are emptied once written, 
+//				so the next write won't repeat them.
+//
+//==============================================================================
+int LDrawTraceWriteChromeJSON(const char *path)
+{
+	FILE				*file			= NULL;
+	int 				wasRecording	= LDrawTraceIsRecording;
+	LDrawTraceBuffer	*buffer 		= NULL;
+	LDrawTraceEvent 	*event			= NULL;
+	uint32_t			written 		= 0;
+	uint32_t			counter 		= 0;
+	int 				depth			= 0;
+
+	pthread_once(&TraceOnce, TraceInitialize);
+
+	file = fopen(path, "w");
+	if(file == NULL)
+		return 0;
+
+	LDrawTraceIsRecording = 0;
+	OSMemoryBarrier();
+
+	fputs("{\"traceEvents\":[\n", file);
+	fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Bricksmith\"}}", file);
+
+	pthread_mutex_lock(&TraceBuffersLock);
+	for(buffer = TraceBuffers; buffer != NULL; buffer = buffer->next)
+	{
+		written = buffer->written;
+		if(written == 0)
+			continue;
+
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%llu,\"args\":{\"name\":\"%s\"}}",
+				(unsigned long long)buffer->threadID,
+				buffer->isMainThread ? "main" : "worker");
+
+		depth   = 0;
+		counter = (written > TRACE_BUFFER_EVENTS) ? written - TRACE_BUFFER_EVENTS : 0;
+		for(; counter < written; counter++)
+		{
+			event = &buffer->events[counter & (TRACE_BUFFER_EVENTS - 1)];
+
+			if(event->phase == 'B')
+				depth++;
+			else if(event->phase == 'E')
+			{
+				if(depth == 0)
+					continue;
+				depth--;
+			}
+			WriteEvent(file, buffer, event);
+		}
+		
+		// A dead thread's events are now safely on disk, so its ring can go 
+		// back into service. 
+		if(buffer->inUse == 0)
+			buffer->written = 0;
+	}
+	pthread_mutex_unlock(&TraceBuffersLock);
+
+	fputs("\n]}\n", file);
+	fclose(file);
+
+	OSMemoryBarrier();
+	LDrawTraceIsRecording = wasRecording;
+
+	return 1;
+
+}//end LDrawTraceWriteChromeJSON
+
+
+#pragma mark -
+#pragma mark UTILITIES
+#pragma mark -
+
+//---------- TraceInitialize -----------------------------------------[static]--
+//
+// Purpose:		One-time setup.
+//
+//------------------------------------------------------------------------------
+static void TraceInitialize(void)
+{
+	pthread_key_create(&TraceBufferKey, ReleaseThreadBuffer);
+	mach_timebase_info(&TraceTimebase);
+
+}//end TraceInitialize
+
+
+//---------- ReleaseThreadBuffer -------------------------------------[static]--
+//
+// Purpose:		The thread which owned buffer has exited. Its events stay put
+//				until they are written out; only then can another thread claim 
+//				the buffer.
+//
+//------------------------------------------------------------------------------
+static void ReleaseThreadBuffer(void *buffer)
+{
+	OSMemoryBarrier();
+	((LDrawTraceBuffer *)buffer)->inUse = 0;
+
+}//end ReleaseThreadBuffer
+
+
+//---------- ThreadBuffer --------------------------------------------[static]--
+//
+// Purpose:		Returns the calling thread's ring, finding or making one the
+//				first time.
+//
+//------------------------------------------------------------------------------
+static LDrawTraceBuffer *ThreadBuffer(void)
+{
+	LDrawTraceBuffer	*buffer 	= NULL;
+
+	pthread_once(&TraceOnce, TraceInitialize);
+
+	buffer = pthread_getspecific(TraceBufferKey);
+	if(buffer == NULL)
+	{
+		pthread_mutex_lock(&TraceBuffersLock);
+
+		// Reuse a dead thread's ring only if nothing in it is waiting to be 
+		// written; starting it over would lose those events. 
+		for(buffer = TraceBuffers; buffer != NULL; buffer = buffer->next)
+		{
+			if(buffer->inUse == 0 && buffer->written == 0)
+				break;
+		}
+		if(buffer == NULL)
+		{
+			buffer          = calloc(1, sizeof(LDrawTraceBuffer));
+			buffer->next    = TraceBuffers;
+			TraceBuffers    = buffer;
+		}
+
+		pthread_threadid_np(NULL, &buffer->threadID);
+		buffer->isMainThread    = pthread_main_np();
+		buffer->inUse           = 1;
+
+		pthread_mutex_unlock(&TraceBuffersLock);
+
+		pthread_setspecific(TraceBufferKey, buffer);
+	}
+
+	return buffer;
+
+}//end ThreadBuffer
+
+
+//---------- RecordEvent ---------------------------------------------[static]--
+//
+// Purpose:		Puts one event in the calling thread's ring.
+//
+// Notes:		The event is filled in before the count is bumped, so a reader
+//				never sees an event which is only half there.
+//
+//------------------------------------------------------------------------------
+static void RecordEvent(char phase, const char *name, double value)
+{
+	LDrawTraceBuffer	*buffer 	= ThreadBuffer();
+	uint32_t			written 	= buffer->written;
+	LDrawTraceEvent 	*event		= &buffer->events[written & (TRACE_BUFFER_EVENTS - 1)];
+
+	event->time     = mach_absolute_time();
+	event->name     = name;
+	event->value    = value;
+	event->phase    = phase;
+
+	OSMemoryBarrier();
+	buffer->written = written + 1;
+
+}//end RecordEvent
+
+
+//---------- WriteEvent ----------------------------------------------[static]--
+//
+// Purpose:		Writes one event as a Chrome trace event. Times are in
+//				microseconds from the start of recording.
+//
+//------------------------------------------------------------------------------
+static void WriteEvent(FILE *file, LDrawTraceBuffer *buffer, LDrawTraceEvent *event)
+{
+	double	microseconds	= 0;
+
+	microseconds = (double)(event->time - TraceStartTime) * TraceTimebase.numer / TraceTimebase.denom / 1000.0;
+
+	fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%llu",
+			event->name,
+			event->phase,
+			microseconds,
+			(unsigned long long)buffer->threadID);
+
+	if(event->phase == 'C')
+		fprintf(file, ",\"args\":{\"value\":%g}", event->value);
+
+	fputs("}", file);
+
+}//end WriteEvent
@@ -11,6 +11,7 @@
 #import <Foundation/Foundation.h>
 
 #import "ColorLibrary.h"
+#import "LDrawHitList.h"
 #import "MatrixMath.h"
 
 @class LDrawDirective;
@@ -51,6 +52,7 @@ typedef enum
 
 // Parsing
 + (Class) classForDirectiveBeginningWithLine:(NSString *)line;
++ (void) fixGeometryOfParsedDirectives:(id *)directives count:(NSUInteger)count;
 + (LDrawColor *) parseColorFromField:(NSString *)colorField;
 + (NSString *) readNextField:(NSString *) partialDirective
 				   remainder:(NSString **) remainder;
@@ -66,7 +68,7 @@ typedef enum
 + (LDrawVertexes *) boundingCube;
 
 // Hit Detection
-+ (void) registerHitForObject:(id)hitObject depth:(float)depth creditObject:(id)creditObject hits:(NSMutableDictionary *)hits;
++ (void) registerHitForObject:(id)hitObject depth:(float)depth creditObject:(id)creditObject hits:(LDrawHitList *)hits;
 + (void) registerHitForObject:(id)hitObject creditObject:(id)creditObject hits:(NSMutableSet *)hits;
 
 // Images
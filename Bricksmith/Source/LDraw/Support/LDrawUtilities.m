@@ -19,6 +19,7 @@
 #import "LDrawPart.h"
 #import "LDrawQuadrilateral.h"
 #import "LDrawTexture.h"
+#import "LDrawTrace.h"
 #import "LDrawTriangle.h"
 #import "LDrawVertexes.h"
 #import "PartLibrary.h"
@@ -149,6 +150,29 @@ static NSString				*defaultAuthor		= @"anonymous";
 }//end classForDirectiveBeginningWithLine:
 
 
+//---------- fixGeometryOfParsedDirectives:count: --------------------[static]--
+//
+// Purpose:		Finishes the geometry of the triangles and quadrilaterals among 
+//				freshly-parsed directives, all at once. Call this once for 
+//				every batch of directives parsed from lines, before putting 
+//				them in a container. 
+//
+//------------------------------------------------------------------------------
++ (void) fixGeometryOfParsedDirectives:(id *)directives count:(NSUInteger)count
+{
+	NSUInteger  degenerateCount = 0;
+	
+	TRACE_BEGIN("fix primitive geometry");
+	
+	degenerateCount += [LDrawTriangle       fixGeometryOfParsedDirectives:directives count:count];
+	degenerateCount += [LDrawQuadrilateral  fixGeometryOfParsedDirectives:directives count:count];
+	
+	TRACE_END("fix primitive geometry");
+	TRACE_COUNTER("degenerate primitives", degenerateCount);
+	
+}//end fixGeometryOfParsedDirectives:count:
+
+
 //---------- parseColorFromField: ------------------------------------[static]--
 //
 // Purpose:		Returns the color code which is represented by the field.
@@ -605,8 +629,8 @@ static NSString				*defaultAuthor		= @"anonymous";
 
 //---------- registerHitForObject:depth:creditObject:hits: -----------[static]--
 //
-// Purpose:		Adds a hit record to the hits dictionary such that only the 
-//				nearest hits per credit object survive. 
+// Purpose:		Adds a hit record to the hit list such that only the nearest 
+//				hit per credit object survives. 
 //
 // Parameters:	hitObject - the exact object whose geometry was hit
 //				depth - the distance in the depth of field
@@ -615,37 +639,17 @@ static NSString				*defaultAuthor		= @"anonymous";
 //				hits - the list of hit records to modify
 //
 //------------------------------------------------------------------------------
-+ (void) registerHitForObject:(id)hitObject depth:(float)hitDepth creditObject:(id)creditObject hits:(NSMutableDictionary *)hits
++ (void) registerHitForObject:(id)hitObject depth:(float)hitDepth creditObject:(id)creditObject hits:(LDrawHitList *)hits
 {
-	NSNumber    *existingRecord = [hits objectForKey:creditObject];
-	float       existingDepth   = 0;
-	NSValue     *key            = nil;
-	
-	// NSDictionary copies its keys (which we don't want to do!), so we'll just 
-	// wrap the pointers. 
+	// This is called for every primitive along the pick ray, so it must not 
+	// allocate anything. 
 	if(creditObject == nil)
 	{
-		key = [NSValue valueWithPointer:hitObject];
-	}
-	else
-	{
-		key = [NSValue valueWithPointer:creditObject];
-	}
-
-	existingRecord = [hits objectForKey:key];
-	if(existingRecord == nil)
-	{
-		existingDepth = INFINITY;
+		LDrawHitListRegister(hits, hitObject, hitDepth);
 	}
 	else
 	{
-		existingDepth = [existingRecord floatValue];
-	}
-	
-	// Found a shallower intersection point? Record the hit.
-	if(hitDepth < existingDepth)
-	{
-		[hits setObject:[NSNumber numberWithFloat:hitDepth] forKey:key];
+		LDrawHitListRegister(hits, creditObject, hitDepth);
 	}
 }
 
@@ -0,0 +1,51 @@
+//==============================================================================
+//
+// File:		LDrawVertexSlots.h
+//
+// Purpose:		Slot bookkeeping for one kind of primitive in an LDrawVertexes
+//				buffer.
+//
+//				Each primitive is assigned a fixed slot, and its vertexes live
+//				at that slot's position in every color's vertex buffer. Adding,
+//				removing or changing a primitive therefore touches only its own
+//				slot; freed slots are reused before new ones are opened, and
+//				capacity grows geometrically so the buffers are rarely
+//				reallocated.
+//
+//				This class knows nothing of OpenGL. It only decides where
+//				things go and remembers which slots need to be rewritten.
+//
+//==============================================================================
+#import <Foundation/Foundation.h>
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// class LDrawVertexSlots
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface LDrawVertexSlots : NSObject
+{
+	NSMutableArray      *primitives;	// index is slot; NSNull for free slots
+	NSMapTable          *slotTable;		// primitive (by identity) -> slot + 1
+	NSMutableIndexSet   *freeSlots;
+	NSMutableIndexSet   *dirtySlots;
+	NSUInteger          capacity;
+}
+
+// Accessors
+- (NSUInteger) capacity;
+- (NSIndexSet *) dirtySlots;
+- (id) primitiveAtSlot:(NSUInteger)slot;
+- (NSUInteger) slotCount;
+- (NSUInteger) slotOfPrimitive:(id)primitive;
+
+- (void) setPrimitives:(NSArray *)primitivesIn;
+
+// Actions
+- (NSUInteger) addPrimitive:(id)primitive;
+- (NSUInteger) removePrimitive:(id)primitive;
+- (BOOL) markPrimitiveDirty:(id)primitive;
+- (void) clearDirtySlots;
+
+@end
@@ -0,0 +1,289 @@
+//==============================================================================
+//
+// File:		LDrawVertexSlots.m
+//
+// Purpose:		Slot bookkeeping for one kind of primitive in an LDrawVertexes
+//				buffer. See LDrawVertexSlots.h.
+//
+// Notes:		The slot count is the high-water mark: one past the last slot
+//				in use. Trailing free slots are trimmed off so that the drawn
+//				range shrinks when the last primitives go away. Free slots in
+//				the middle stay behind as holes until they are reused; the
+//				buffer owner writes degenerate vertexes into them.
+//
+//==============================================================================
+#import "LDrawVertexSlots.h"
+
+
+// Smallest capacity allocated when slots must be added to a full table.
+#define MINIMUM_SLOT_CAPACITY	16
+
+
+@implementation LDrawVertexSlots
+
+//========== init ==============================================================
+//
+// Purpose:		Initialize the object.
+//
+//==============================================================================
+- (id) init
+{
+	self = [super init];
+	if(self)
+	{
+		self->primitives    = [[NSMutableArray alloc] init];
+		self->slotTable     = [[NSMapTable alloc] initWithKeyOptions:(NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality)
+													valueOptions:(NSPointerFunctionsOpaqueMemory | NSPointerFunctionsIntegerPersonality)
+														capacity:0];
+		self->freeSlots     = [[NSMutableIndexSet alloc] init];
+		self->dirtySlots    = [[NSMutableIndexSet alloc] init];
+		self->capacity      = 0;
+	}
+	return self;
+
+}//end init
+
+
+#pragma mark -
+#pragma mark ACCESSORS
+#pragma mark -
+
+//========== capacity ==========================================================
+//
+// Purpose:		Returns the number of slots the buffers should have room for.
+//
+// Notes:		This only ever changes when the table fills up (or is replaced
+//				wholesale), so the buffer owner can compare it against the
+//				capacity it last allocated to decide whether a patch is enough.
+//
+//==============================================================================
+- (NSUInteger) capacity
+{
+	return self->capacity;
+
+}//end capacity
+
+
+//========== dirtySlots ========================================================
+//
+// Purpose:		Returns the slots whose vertexes must be rewritten. Some of them
+//				may now lie beyond the slot count; those need not be written.
+//
+//==============================================================================
+- (NSIndexSet *) dirtySlots
+{
+	return self->dirtySlots;
+
+}//end dirtySlots
+
+
+//========== primitiveAtSlot: ==================================================
+//
+// Purpose:		Returns the primitive occupying slot, or nil if it is free.
+//
+//==============================================================================
+- (id) primitiveAtSlot:(NSUInteger)slot
+{
+	id  primitive   = nil;
+
+	if(slot < [self->primitives count])
+	{
+		primitive = [self->primitives objectAtIndex:slot];
+
+		if(primitive == [NSNull null])
+			primitive = nil;
+	}
+
+	return primitive;
+
+}//end primitiveAtSlot:
+
+
+//========== slotCount =========================================================
+//
+// Purpose:		Returns the number of slots which must be drawn.
+//
+//==============================================================================
+- (NSUInteger) slotCount
+{
+	return [self->primitives count];
+
+}//end slotCount
+
+
+//========== slotOfPrimitive: ==================================================
+//
+// Purpose:		Returns the slot holding primitive, or NSNotFound.
+//
+//==============================================================================
+- (NSUInteger) slotOfPrimitive:(id)primitive
+{
+	NSUInteger  slotPlusOne = (NSUInteger)NSMapGet(self->slotTable, primitive);
+
+	if(slotPlusOne == 0)
+		return NSNotFound;
+	else
+		return slotPlusOne - 1;
+
+}//end slotOfPrimitive:
+
+
+#pragma mark -
+
+//========== setPrimitives: ====================================================
+//
+// Purpose:		Replaces the entire contents of the table, packing primitivesIn
+//				into consecutive slots with no room to spare.
+//
+// Notes:		Bulk-loaded vertexes (library parts in particular) seldom change
+//				afterwards, so there is no point in reserving space for growth.
+//				The first addition will take care of that.
+//
+//==============================================================================
+- (void) setPrimitives:(NSArray *)primitivesIn
+{
+	NSUInteger  counter = 0;
+
+	[self->primitives   removeAllObjects];
+	[self->freeSlots    removeAllIndexes];
+	[self->dirtySlots   removeAllIndexes];
+	NSResetMapTable(self->slotTable);
+
+	[self->primitives addObjectsFromArray:primitivesIn];
+
+	for(counter = 0; counter < [self->primitives count]; counter++)
+	{
+		NSMapInsert(self->slotTable, [self->primitives objectAtIndex:counter], (void *)(counter + 1));
+	}
+
+	self->capacity = [self->primitives count];
+
+}//end setPrimitives:
+
+
+#pragma mark -
+#pragma mark ACTIONS
+#pragma mark -
+
+//========== addPrimitive: =====================================================
+//
+// Purpose:		Assigns primitive a slot and marks it dirty. Returns the slot.
+//
+// Notes:		The lowest free slot is reused if there is one. Otherwise a new
+//				slot is opened at the end, doubling the capacity if necessary.
+//
+//==============================================================================
+- (NSUInteger) addPrimitive:(id)primitive
+{
+	NSUInteger  slot    = [self slotOfPrimitive:primitive];
+
+	if(slot == NSNotFound)
+	{
+		if([self->freeSlots count] > 0)
+		{
+			slot = [self->freeSlots firstIndex];
+			[self->freeSlots removeIndex:slot];
+			[self->primitives replaceObjectAtIndex:slot withObject:primitive];
+		}
+		else
+		{
+			slot = [self->primitives count];
+			[self->primitives addObject:primitive];
+
+			if(slot >= self->capacity)
+				self->capacity = MAX(MINIMUM_SLOT_CAPACITY, self->capacity * 2);
+		}
+
+		NSMapInsert(self->slotTable, primitive, (void *)(slot + 1));
+	}
+
+	[self->dirtySlots addIndex:slot];
+
+	return slot;
+
+}//end addPrimitive:
+
+
+//========== removePrimitive: ==================================================
+//
+// Purpose:		Frees the slot of primitive and marks it dirty so that it gets
+//				cleared. Returns the freed slot, or NSNotFound if the primitive
+//				was not here.
+//
+//==============================================================================
+- (NSUInteger) removePrimitive:(id)primitive
+{
+	NSUInteger  slot    = [self slotOfPrimitive:primitive];
+
+	if(slot != NSNotFound)
+	{
+		NSMapRemove(self->slotTable, primitive);
+		[self->primitives replaceObjectAtIndex:slot withObject:[NSNull null]];
+		[self->freeSlots addIndex:slot];
+		[self->dirtySlots addIndex:slot];
+
+		// Trim trailing holes so they don't have to be drawn.
+		while([self->primitives count] > 0 && [self->primitives lastObject] == [NSNull null])
+		{
+			[self->freeSlots removeIndex:[self->primitives count] - 1];
+			[self->primitives removeLastObject];
+		}
+	}
+
+	return slot;
+
+}//end removePrimitive:
+
+
+//========== markPrimitiveDirty: ===============================================
+//
+// Purpose:		Notes that the vertexes of primitive have changed. Returns NO if
+//				the primitive has no slot here.
+//
+//==============================================================================
+- (BOOL) markPrimitiveDirty:(id)primitive
+{
+	NSUInteger  slot    = [self slotOfPrimitive:primitive];
+
+	if(slot != NSNotFound)
+		[self->dirtySlots addIndex:slot];
+
+	return (slot != NSNotFound);
+
+}//end markPrimitiveDirty:
+
+
+//========== clearDirtySlots ===================================================
+//
+// Purpose:		Called once every buffer has been brought up to date.
+//
+//==============================================================================
+- (void) clearDirtySlots
+{
+	[self->dirtySlots removeAllIndexes];
+
+}//end clearDirtySlots
+
+
+#pragma mark -
+#pragma mark DESTRUCTOR
+#pragma mark -
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Out of slots.
+//
+//==============================================================================
+- (void) dealloc
+{
+	[primitives release];
+	[slotTable  release];
+	[freeSlots  release];
+	[dirtySlots release];
+
+	[super dealloc];
+
+}//end dealloc
+
+
+@end
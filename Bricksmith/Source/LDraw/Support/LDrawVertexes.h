@@ -16,6 +16,7 @@
 @class LDrawLine;
 @class LDrawTriangle;
 @class LDrawQuadrilateral;
+@class LDrawVertexSlots;
 
 ////////////////////////////////////////////////////////////////////////////////
 struct OptimizationTags
@@ -30,6 +31,14 @@ struct OptimizationTags
 	GLsizei			lineCount;
 	GLsizei			triangleCount;
 	GLsizei			quadCount;	
+	
+	// Slot capacities the buffer was laid out for. When a slot table outgrows 
+	// these, the buffer must be regenerated rather than patched. 
+	GLsizei			lineCapacity;
+	GLsizei			triangleCapacity;
+	GLsizei			quadCapacity;
+	
+	GLsizeiptr		bufferSize;					// bytes in the VBO, for memory accounting
 };
 
 
@@ -47,6 +56,11 @@ struct OptimizationTags
 	NSMutableArray          *everythingElse;
 	BOOL					acceptsNonPrimitives;
 	
+	// Where each primitive lives in the vertex buffers
+	LDrawVertexSlots        *lineSlots;
+	LDrawVertexSlots        *triangleSlots;
+	LDrawVertexSlots        *quadrilateralSlots;
+	
 	NSMutableDictionary		*colorOptimizations; // key is @"%f %f %f %f", value is OptimizationTags in NSValue
 	NSMutableDictionary		*colorWireframeOptimizations; // key is @"%f %f %f %f", value is OptimizationTags in NSValue
 	BOOL					needsRebuilding;
@@ -60,6 +74,7 @@ struct OptimizationTags
 			other:(NSArray *)everythingElseIn;
 - (void) setAcceptsNonPrimitives:(BOOL)flag;
 - (void) setVertexesNeedRebuilding;
+- (void) updateDirective:(LDrawDirective *)directive;
 			
 - (void) addDirective:(LDrawDirective *)directive;
 - (void) addLine:(LDrawLine *)line;
@@ -77,7 +92,10 @@ struct OptimizationTags
 - (void) optimizeOpenGLWithParentColor:(LDrawColor *)parentColor;
 - (void) optimizeSolidWithParentColor:(LDrawColor *)color;
 - (void) optimizeWireframeWithParentColor:(LDrawColor *)color;
-- (void) rebuildAllOptimizations;
+- (struct OptimizationTags) buildOptimizationWithParentColor:(LDrawColor *)color wireframe:(BOOL)wireframe;
+- (void) getLayout:(struct OptimizationTags *)tags wireframe:(BOOL)wireframe;
+- (void) updateAllOptimizations;
+- (void) patchOptimizationsInDictionary:(NSMutableDictionary *)optimizations forColor:(LDrawColor *)color wireframe:(BOOL)wireframe;
 - (void) removeAllOptimizations;
 
 @end
@@ -23,10 +23,21 @@
 #import OPEN_GL_EXT_HEADER
 
 #import "LDrawLine.h"
+#import "LDrawMemory.h"
 #import "LDrawTriangle.h"
 #import "LDrawQuadrilateral.h"
+#import "LDrawVertexSlots.h"
+
+// Number of vertexes a quadrilateral occupies in a filled buffer.
+#if TESSELATE_QUADS
+	#define QUAD_VERTEX_COUNT	6
+#else
+	#define QUAD_VERTEX_COUNT	4
+#endif
 
 static void DeleteOptimizationTags(struct OptimizationTags tags);
+static void PatchSlots(LDrawVertexSlots *slots, GLint regionOffset, GLsizei vertexesPerSlot, LDrawColor *color, BOOL wireframe);
+static VBOVertexData *WriteSlots(LDrawVertexSlots *slots, NSRange range, GLsizei vertexesPerSlot, VBOVertexData *buffer, LDrawColor *color, BOOL wireframe);
 
 @implementation LDrawVertexes
 
@@ -45,6 +56,10 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 		self->quadrilaterals                = [[NSMutableArray alloc] init];
 		self->everythingElse                = [[NSMutableArray alloc] init];
 		
+		self->lineSlots                     = [[LDrawVertexSlots alloc] init];
+		self->triangleSlots                 = [[LDrawVertexSlots alloc] init];
+		self->quadrilateralSlots            = [[LDrawVertexSlots alloc] init];
+		
 		self->colorOptimizations            = [[NSMutableDictionary alloc] init];
 		self->colorWireframeOptimizations   = [[NSMutableDictionary alloc] init];
 		self->needsRebuilding				= YES;
@@ -93,7 +108,10 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 			glDrawArrays(GL_LINES, tags.lineOffset, tags.lineCount * 2);
 		if(tags.triangleCount)
 			glDrawArrays(GL_TRIANGLES, tags.triangleOffset, tags.triangleCount * 3);
-#if (TESSELATE_QUADS == 0)
+#if TESSELATE_QUADS
+		if(tags.quadCount)
+			glDrawArrays(GL_TRIANGLES, tags.quadOffset, tags.quadCount * 6);
+#else
 		if(tags.quadCount)
 			glDrawArrays(GL_QUADS, tags.quadOffset, tags.quadCount * 4);
 #endif
@@ -124,7 +142,7 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 	   viewScale:(float)scaleFactor
 	  boundsOnly:(BOOL)boundsOnly
 	creditObject:(id)creditObject
-			hits:(NSMutableDictionary *)hits
+			hits:(LDrawHitList *)hits
 {
 	NSArray     *commands           = nil;
 	NSUInteger  commandCount        = 0;
@@ -348,6 +366,12 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 	[self->quadrilaterals	addObjectsFromArray:quadrilateralsIn];
 	[self->everythingElse	addObjectsFromArray:everythingElseIn];
 	
+	[self->lineSlots			setPrimitives:self->lines];
+	[self->triangleSlots		setPrimitives:self->triangles];
+	[self->quadrilateralSlots	setPrimitives:self->quadrilaterals];
+	
+	self->needsRebuilding = YES;
+	
 }//end setLines:triangles:quadrilaterals:other:
 
 
@@ -356,6 +380,9 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 // Purpose:		Marks all the optimizations of this vertex collection as needing 
 //				rebuilding. 
 //
+// Notes:		Prefer -updateDirective: when you know which primitive changed; 
+//				it only rewrites that primitive's vertexes. 
+//
 //==============================================================================
 - (void) setVertexesNeedRebuilding
 {
@@ -363,6 +390,29 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 }
 
 
+//========== updateDirective: ==================================================
+//
+// Purpose:		The vertexes, color, or visibility of the given primitive have 
+//				changed. Its slot will be rewritten in every optimization on the 
+//				next -updateAllOptimizations. 
+//
+//==============================================================================
+- (void) updateDirective:(LDrawDirective *)directive
+{
+	// Anything without a slot (parts, say) isn't drawn from our buffers, so 
+	// there is nothing to update. 
+	if([directive isMemberOfClass:[LDrawLine class]])
+		[self->lineSlots markPrimitiveDirty:directive];
+	
+	else if([directive isKindOfClass:[LDrawTriangle class]])
+		[self->triangleSlots markPrimitiveDirty:directive];
+	
+	else if([directive isKindOfClass:[LDrawQuadrilateral class]])
+		[self->quadrilateralSlots markPrimitiveDirty:directive];
+	
+}//end updateDirective:
+
+
 #pragma mark -
 
 //========== addDirective: =====================================================
@@ -395,40 +445,40 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 
 //========== addLine: ==========================================================
 //
-// Purpose:		Register a line to be included in the optimized vertexes. The 
-//				object must be re-optimized now. 
+// Purpose:		Register a line to be included in the optimized vertexes. Its 
+//				slot is rewritten on the next update. 
 //
 //==============================================================================
 - (void) addLine:(LDrawLine *)line
 {
 	[self->lines addObject:line];
-	self->needsRebuilding = YES;
+	[self->lineSlots addPrimitive:line];
 }
 
 
 //========== addTriangle: ======================================================
 //
 // Purpose:		Register a triangle to be included in the optimized vertexes. 
-//				The object must be re-optimized now. 
+//				Its slot is rewritten on the next update. 
 //
 //==============================================================================
 - (void) addTriangle:(LDrawTriangle *)triangle
 {
 	[self->triangles addObject:triangle];
-	self->needsRebuilding = YES;
+	[self->triangleSlots addPrimitive:triangle];
 }
 
 
 //========== addQuadrilateral: =================================================
 //
 // Purpose:		Register a quadrilateral to be included in the optimized 
-//				vertexes. The object must be re-optimized now. 
+//				vertexes. Its slot is rewritten on the next update. 
 //
 //==============================================================================
 - (void) addQuadrilateral:(LDrawQuadrilateral *)quadrilateral
 {
 	[self->quadrilaterals addObject:quadrilateral];
-	self->needsRebuilding = YES;
+	[self->quadrilateralSlots addPrimitive:quadrilateral];
 }
 
 
@@ -477,39 +527,39 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 //========== removeLine: =======================================================
 //
 // Purpose:		De-registers a line to be included in the optimized vertexes. 
-//				The object must be re-optimized now. 
+//				Its slot is rewritten on the next update. 
 //
 //==============================================================================
 - (void) removeLine:(LDrawLine *)line
 {
 	[self->lines removeObjectIdenticalTo:line];
-	self->needsRebuilding = YES;
+	[self->lineSlots removePrimitive:line];
 }
 
 
 //========== removeTriangle: ===================================================
 //
 // Purpose:		De-registers a line to be included in the optimized vertexes. 
-//				The object must be re-optimized now. 
+//				Its slot is rewritten on the next update. 
 //
 //==============================================================================
 - (void) removeTriangle:(LDrawTriangle *)triangle
 {
 	[self->triangles removeObjectIdenticalTo:triangle];
-	self->needsRebuilding = YES;
+	[self->triangleSlots removePrimitive:triangle];
 }
 
 
 //========== removeQuadrilateral: ==============================================
 //
 // Purpose:		De-registers a quadrilateral to be included in the optimized 
-//				vertexes. The object must be re-optimized now. 
+//				vertexes. Its slot is rewritten on the next update. 
 //
 //==============================================================================
 - (void) removeQuadrilateral:(LDrawQuadrilateral *)quadrilateral
 {
 	[self->quadrilaterals removeObjectIdenticalTo:quadrilateral];
-	self->needsRebuilding = YES;
+	[self->quadrilateralSlots removePrimitive:quadrilateral];
 }
 
 
@@ -563,75 +613,91 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 //==============================================================================
 - (void) optimizeSolidWithParentColor:(LDrawColor *)color
 {
-	VBOVertexData           *buffer                 = NULL;
-	struct OptimizationTags tags                    = {};
+	id                      key     = color;
+	NSValue                 *value  = [self->colorOptimizations objectForKey:key];
+	struct OptimizationTags tags    = {};
+	
+	// Replace any previous optimization for this color.
+	[value getValue:&tags];
+	DeleteOptimizationTags(tags);
+	
+	tags = [self buildOptimizationWithParentColor:color wireframe:NO];
+	
+	// Cache
+	value  = [NSValue valueWithBytes:&tags objCType:@encode(struct OptimizationTags)];
+	[self->colorOptimizations setObject:value forKey:key];
+	
+}//end optimizeSolidWithParentColor:
+
 
-	//---------- Lines VBO -----------------------------------------------------
+//========== optimizeWireframeWithParentColor: =================================
+//
+// Purpose:		The caller is asking this instance to optimize itself for faster 
+//				drawing as a wireframe. 
+//
+//==============================================================================
+- (void) optimizeWireframeWithParentColor:(LDrawColor *)color
+{
+	id                      key     = color;
+	NSValue                 *value  = [self->colorWireframeOptimizations objectForKey:key];
+	struct OptimizationTags tags    = {};
+	
+	// Replace any previous optimization for this color.
+	[value getValue:&tags];
+	DeleteOptimizationTags(tags);
+	
+	tags = [self buildOptimizationWithParentColor:color wireframe:YES];
+	
+	// Cache
+	value  = [NSValue valueWithBytes:&tags objCType:@encode(struct OptimizationTags)];
+	[self->colorWireframeOptimizations setObject:value forKey:key];
+	
+}//end optimizeWireframeWithParentColor:
+
+
+//========== buildOptimizationWithParentColor:wireframe: =======================
+//
+// Purpose:		Creates a vertex buffer holding every slot of every primitive 
+//				type, with room up to the capacity of the slot tables, and 
+//				returns its tags. 
+//
+// Notes:		The buffer is laid out as the line slots, then the triangle 
+//				slots, then the quadrilateral slots. Free slots and hidden 
+//				primitives are written as degenerate (all-zero) vertexes so 
+//				they draw nothing. 
+//
+//==============================================================================
+- (struct OptimizationTags) buildOptimizationWithParentColor:(LDrawColor *)color
+												   wireframe:(BOOL)wireframe
+{
+	struct OptimizationTags tags            = {};
+	size_t                  bufferSize      = 0;
+	VBOVertexData           *vertexes       = NULL;
+	GLsizei                 quadVertexCount = (wireframe ? 8 : QUAD_VERTEX_COUNT);
+	
+	[self getLayout:&tags wireframe:wireframe];
+	
+	bufferSize  = (  tags.lineCapacity      * 2
+				   + tags.triangleCapacity  * (wireframe ? 6 : 3)
+				   + tags.quadCapacity      * quadVertexCount ) * sizeof(VBOVertexData);
+	
+	if(bufferSize > 0)
 	{
+		vertexes = calloc(1, bufferSize);
+		
+		WriteSlots(self->lineSlots,				NSMakeRange(0, [self->lineSlots slotCount]),			2,									vertexes + tags.lineOffset,		color, wireframe);
+		WriteSlots(self->triangleSlots,			NSMakeRange(0, [self->triangleSlots slotCount]),		(wireframe ? 6 : 3),				vertexes + tags.triangleOffset,	color, wireframe);
+		WriteSlots(self->quadrilateralSlots,	NSMakeRange(0, [self->quadrilateralSlots slotCount]),	quadVertexCount,					vertexes + tags.quadOffset,		color, wireframe);
+		
 		glGenBuffers(1, &tags.anyVBOTag);
 		glBindBuffer(GL_ARRAY_BUFFER, tags.anyVBOTag);
+		glBufferData(GL_ARRAY_BUFFER, bufferSize, vertexes, GL_DYNAMIC_DRAW);
+		free(vertexes);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		
-		size_t			maxLineCount		= [self->lines count];
-		size_t			maxTriangleCount	= [self->triangles count];
-		size_t			maxQuadCount		= [self->quadrilaterals count];
-#if TESSELATE_QUADS
-		maxTriangleCount += ([self->quadrilaterals count] * 2);
-		maxQuadCount = 0;
-#endif
-		size_t			anyBufferSize = (maxLineCount * 2 + maxTriangleCount * 3 + maxQuadCount * 4) * sizeof(VBOVertexData);
-		VBOVertexData *	anyVertexes = malloc(anyBufferSize);
-		buffer = anyVertexes;
-		GLint			offset = 0;
+		tags.bufferSize = bufferSize;
+		MEMORY_ALLOC(LDrawMemoryVertexBuffers, bufferSize);
 		
-		tags.lineOffset = offset;
-		for(LDrawLine *currentDirective in self->lines)
-		{
-			if([currentDirective isHidden] == NO)
-			{
-				buffer = [currentDirective writeToVertexBuffer:buffer parentColor:color wireframe:NO];
-				tags.lineCount++;
-				offset += 2;
-			}
-		}
-		tags.triangleOffset = offset;
-		for(LDrawTriangle *currentDirective in self->triangles)
-		{
-			if([currentDirective isHidden] == NO)
-			{
-				buffer = [currentDirective writeToVertexBuffer:buffer parentColor:color wireframe:NO];
-				tags.triangleCount++;
-				offset += 3;
-			}
-		}
-	#if TESSELATE_QUADS
-		for(LDrawQuadrilateral *currentDirective in self->quadrilaterals)
-		{
-			if([currentDirective isHidden] == NO)
-			{
-				buffer = [currentDirective writeToVertexBuffer:buffer parentColor:color wireframe:NO];
-				tags.triangleCount += 2;
-				offset += 6;
-			}
-		}
-	#endif
-		tags.quadOffset = offset;
-	#if !TESSELATE_QUADS
-		for(LDrawQuadrilateral *currentDirective in self->quadrilaterals)
-		{
-			if([currentDirective isHidden] == NO)
-			{
-				buffer = [currentDirective writeToVertexBuffer:buffer parentColor:color wireframe:NO];
-				tags.quadCount++;
-				offset += 4;
-			}
-		}
-	
-	#endif
-			
-		glBufferData(GL_ARRAY_BUFFER, anyBufferSize, anyVertexes, GL_STATIC_DRAW);
-		free(anyVertexes);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
 		// Encapsulate in a VAO
 		glGenVertexArraysAPPLE(1, &tags.anyVAOTag);
 		glBindVertexArrayAPPLE(tags.anyVAOTag);
@@ -643,108 +709,72 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 		glNormalPointer(GL_FLOAT,    sizeof(VBOVertexData), (GLvoid*)(sizeof(float)*3));
 		glColorPointer(4, GL_FLOAT,  sizeof(VBOVertexData), (GLvoid*)(sizeof(float)*3 + sizeof(float)*3) );
 		
-		glBindVertexArrayAPPLE(0);		
+		glBindVertexArrayAPPLE(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 	
-	// Cache
-	id      key     = color;
-	NSValue *value  = [NSValue valueWithBytes:&tags objCType:@encode(struct OptimizationTags)];
-	[self->colorOptimizations setObject:value forKey:key];
+	return tags;
 	
-}//end optimizeOpenGL
+}//end buildOptimizationWithParentColor:wireframe:
 
 
-//========== optimizeWireframeWithParentColor: =================================
+//========== getLayout:wireframe: ==============================================
 //
-// Purpose:		The caller is asking this instance to optimize itself for faster 
-//				drawing as a wireframe. 
+// Purpose:		Fills in the capacities, offsets, and draw counts of tags from 
+//				the current state of the slot tables. The buffer names are left 
+//				alone. 
+//
+// Notes:		Draw counts run to the last slot in use, holes included; the 
+//				holes are degenerate. 
+//
+//				A wireframe buffer holds nothing but line segments, so it is 
+//				drawn as one run of lines from the start of the buffer to the 
+//				end of the last quadrilateral. 
 //
 //==============================================================================
-- (void) optimizeWireframeWithParentColor:(LDrawColor *)color
+- (void) getLayout:(struct OptimizationTags *)tags wireframe:(BOOL)wireframe
 {
-	VBOVertexData           *buffer                 = NULL;
-	struct OptimizationTags tags                    = {};
+	tags->lineCapacity      = [self->lineSlots			capacity];
+	tags->triangleCapacity  = [self->triangleSlots		capacity];
+	tags->quadCapacity      = [self->quadrilateralSlots	capacity];
 	
-	//---------- Lines VBO -----------------------------------------------------
+	if(wireframe == NO)
 	{
-		glGenBuffers(1, &tags.anyVBOTag);
-		glBindBuffer(GL_ARRAY_BUFFER, tags.anyVBOTag);
-
-		size_t          maxVertexCount  = 0;
-		size_t          linesBufferSize = 0;
-		VBOVertexData   *lineVertexes   = 0;
+		tags->lineOffset        = 0;
+		tags->triangleOffset    = tags->lineOffset		+ tags->lineCapacity * 2;
+		tags->quadOffset        = tags->triangleOffset	+ tags->triangleCapacity * 3;
 		
-		maxVertexCount += [self->lines count] * 2;
-		maxVertexCount += [self->triangles count] * 6;
-		maxVertexCount += [self->quadrilaterals count] * 8;
+		tags->lineCount         = [self->lineSlots			slotCount];
+		tags->triangleCount     = [self->triangleSlots		slotCount];
+		tags->quadCount         = [self->quadrilateralSlots	slotCount];
+	}
+	else
+	{
+		tags->lineOffset        = 0;
+		tags->triangleOffset    = tags->lineOffset		+ tags->lineCapacity * 2;
+		tags->quadOffset        = tags->triangleOffset	+ tags->triangleCapacity * 6;
 		
-		if(maxVertexCount)
-		{
-			linesBufferSize = maxVertexCount * sizeof(VBOVertexData);
-			lineVertexes    = malloc(linesBufferSize);
-			buffer          = lineVertexes;
-			
-			for(LDrawLine *currentDirective in self->lines)
-			{
-				if([currentDirective isHidden] == NO)
-				{
-					buffer = [currentDirective writeToVertexBuffer:buffer parentColor:color wireframe:YES];
-					tags.lineCount++;
-				}
-			}
-			for(LDrawTriangle *currentDirective in self->triangles)
-			{
-				if([currentDirective isHidden] == NO)
-				{
-					buffer = [currentDirective writeToVertexBuffer:buffer parentColor:color wireframe:YES];
-					tags.lineCount++;
-				}
-			}
-			for(LDrawQuadrilateral *currentDirective in self->quadrilaterals)
-			{
-				if([currentDirective isHidden] == NO)
-				{
-					buffer = [currentDirective writeToVertexBuffer:buffer parentColor:color wireframe:YES];
-					tags.lineCount++;
-				}
-			}
-			
-			glBufferData(GL_ARRAY_BUFFER, linesBufferSize, lineVertexes, GL_STATIC_DRAW);
-			free(lineVertexes);
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-			// Encapsulate in a VAO
-			glGenVertexArraysAPPLE(1, &tags.anyVAOTag);
-			glBindVertexArrayAPPLE(tags.anyVAOTag);
-			glEnableClientState(GL_VERTEX_ARRAY);
-			glEnableClientState(GL_NORMAL_ARRAY);
-			glEnableClientState(GL_COLOR_ARRAY);
-			glBindBuffer(GL_ARRAY_BUFFER, tags.anyVBOTag);
-			glVertexPointer(3, GL_FLOAT, sizeof(VBOVertexData), NULL);
-			glNormalPointer(GL_FLOAT,    sizeof(VBOVertexData), (GLvoid*)(sizeof(float)*3));
-			glColorPointer(4, GL_FLOAT,  sizeof(VBOVertexData), (GLvoid*)(sizeof(float)*3 + sizeof(float)*3) );
-
-			glBindVertexArrayAPPLE(0);
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-		}
-	}	
-
-	// Cache
-	id      key     = color;
-	NSValue *value  = [NSValue valueWithBytes:&tags objCType:@encode(struct OptimizationTags)];
-	[self->colorWireframeOptimizations setObject:value forKey:key];
+		tags->lineCount         = (tags->quadOffset + [self->quadrilateralSlots slotCount] * 8) / 2;
+		tags->triangleCount     = 0;
+		tags->quadCount         = 0;
+	}
 	
-}//end optimizeOpenGL
+}//end getLayout:wireframe:
 
 
-//========== rebuildAllOptimizations ===========================================
+//========== updateAllOptimizations ============================================
+//
+// Purpose:		Brings the optimized OpenGL structures for all existing 
+//				optimized colors up to date with the primitives. 
 //
-// Purpose:		Regenerates the optimized OpenGL structures for all existing 
-//				optimized colors. 
+// Notes:		Ordinarily only the slots of primitives which were added, 
+//				removed, or changed are rewritten in each buffer. A buffer is 
+//				only regenerated when a slot table has outgrown it (which 
+//				happens less and less often, since capacity doubles), or when 
+//				someone has asked for a full rebuild. 
 //
 //==============================================================================
-- (void) rebuildAllOptimizations
+- (void) updateAllOptimizations
 {
 	if(self->needsRebuilding)
 	{
@@ -759,7 +789,68 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 		}
 		self->needsRebuilding = NO;
 	}
-}//end rebuildAllOptimizations
+	else if(	[[self->lineSlots			dirtySlots] count] > 0
+			||	[[self->triangleSlots		dirtySlots] count] > 0
+			||	[[self->quadrilateralSlots	dirtySlots] count] > 0 )
+	{
+		for(LDrawColor *color in [self->colorOptimizations allKeys])
+		{
+			[self patchOptimizationsInDictionary:self->colorOptimizations forColor:color wireframe:NO];
+		}
+		for(LDrawColor *color in [self->colorWireframeOptimizations allKeys])
+		{
+			[self patchOptimizationsInDictionary:self->colorWireframeOptimizations forColor:color wireframe:YES];
+		}
+	}
+	
+	[self->lineSlots			clearDirtySlots];
+	[self->triangleSlots		clearDirtySlots];
+	[self->quadrilateralSlots	clearDirtySlots];
+	
+}//end updateAllOptimizations
+
+
+//========== patchOptimizationsInDictionary:forColor:wireframe: ================
+//
+// Purpose:		Rewrites the dirty slots in the buffer cached for color, or 
+//				regenerates the buffer if it is no longer big enough. 
+//
+//==============================================================================
+- (void) patchOptimizationsInDictionary:(NSMutableDictionary *)optimizations
+							   forColor:(LDrawColor *)color
+							  wireframe:(BOOL)wireframe
+{
+	NSValue                 *value  = [optimizations objectForKey:color];
+	struct OptimizationTags tags    = {};
+	
+	[value getValue:&tags];
+	
+	if(		tags.anyVBOTag          == 0
+		||	tags.lineCapacity       != [self->lineSlots capacity]
+		||	tags.triangleCapacity   != [self->triangleSlots capacity]
+		||	tags.quadCapacity       != [self->quadrilateralSlots capacity] )
+	{
+		DeleteOptimizationTags(tags);
+		tags = [self buildOptimizationWithParentColor:color wireframe:wireframe];
+	}
+	else
+	{
+		// Same layout; the draw counts may have moved.
+		[self getLayout:&tags wireframe:wireframe];
+		
+		glBindBuffer(GL_ARRAY_BUFFER, tags.anyVBOTag);
+		
+		PatchSlots(self->lineSlots,				tags.lineOffset,		2,											color, wireframe);
+		PatchSlots(self->triangleSlots,			tags.triangleOffset,	(wireframe ? 6 : 3),						color, wireframe);
+		PatchSlots(self->quadrilateralSlots,	tags.quadOffset,		(wireframe ? 8 : QUAD_VERTEX_COUNT),		color, wireframe);
+		
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	
+	value = [NSValue valueWithBytes:&tags objCType:@encode(struct OptimizationTags)];
+	[optimizations setObject:value forKey:color];
+	
+}//end patchOptimizationsInDictionary:forColor:wireframe:
 
 
 //========== removeAllOptimizations ============================================
@@ -791,6 +882,7 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 	}
 	
 	[self->colorOptimizations removeAllObjects];
+	[self->colorWireframeOptimizations removeAllObjects];
 	
 }//end removeAllOptimizations
 
@@ -813,6 +905,10 @@ static void DeleteOptimizationTags(struct OptimizationTags tags);
 	[quadrilaterals					release];
 	[everythingElse					release];
 	
+	[lineSlots						release];
+	[triangleSlots					release];
+	[quadrilateralSlots				release];
+	
 	[colorOptimizations				release];
 	[colorWireframeOptimizations	release];
 
@@ -842,8 +938,84 @@ void DeleteOptimizationTags(struct OptimizationTags tags)
 	{
 		glDeleteBuffers(1, &tags.anyVBOTag);		
 		glDeleteVertexArraysAPPLE(1, &tags.anyVAOTag);
+		MEMORY_FREE(LDrawMemoryVertexBuffers, tags.bufferSize);
 		
 		tags.anyVBOTag        = 0;
 		tags.anyVAOTag        = 0;
 	}
 }
+
+
+//========== PatchSlots ========================================================
+//
+// Purpose:		Rewrites each run of dirty slots in the bound array buffer with 
+//				one glBufferSubData apiece. 
+//
+// Parameters:	regionOffset	- vertex index at which slot 0 of slots begins
+//
+//==============================================================================
+void PatchSlots(LDrawVertexSlots *slots, GLint regionOffset, GLsizei vertexesPerSlot, LDrawColor *color, BOOL wireframe)
+{
+	NSIndexSet      *dirtySlots = [slots dirtySlots];
+	NSUInteger      slotCount   = [slots slotCount];
+	NSUInteger      firstSlot   = [dirtySlots firstIndex];
+	NSUInteger      lastSlot    = 0;
+	size_t          runSize     = 0;
+	VBOVertexData   *vertexes   = NULL;
+	
+	// Dirty slots past the end were trimmed away and are no longer drawn.
+	while(firstSlot != NSNotFound && firstSlot < slotCount)
+	{
+		lastSlot = firstSlot;
+		while(lastSlot + 1 < slotCount && [dirtySlots containsIndex:lastSlot + 1])
+		{
+			lastSlot++;
+		}
+		
+		runSize     = (lastSlot - firstSlot + 1) * vertexesPerSlot * sizeof(VBOVertexData);
+		vertexes    = malloc(runSize);
+		
+		WriteSlots(slots, NSMakeRange(firstSlot, lastSlot - firstSlot + 1), vertexesPerSlot, vertexes, color, wireframe);
+		
+		glBufferSubData(GL_ARRAY_BUFFER,
+						(regionOffset + firstSlot * vertexesPerSlot) * sizeof(VBOVertexData),
+						runSize,
+						vertexes);
+		free(vertexes);
+		
+		firstSlot = [dirtySlots indexGreaterThanIndex:lastSlot];
+	}
+	
+}//end PatchSlots
+
+
+//========== WriteSlots ========================================================
+//
+// Purpose:		Writes the vertexes for a range of slots into buffer, which is 
+//				the position of the first slot in the range. Returns the 
+//				position after the last slot. 
+//
+// Notes:		Every slot takes exactly vertexesPerSlot vertexes whether or not 
+//				it holds anything, so that its position never moves. 
+//
+//==============================================================================
+VBOVertexData *WriteSlots(LDrawVertexSlots *slots, NSRange range, GLsizei vertexesPerSlot, VBOVertexData *buffer, LDrawColor *color, BOOL wireframe)
+{
+	LDrawDrawableElement    *primitive  = nil;
+	NSUInteger              slot        = 0;
+	
+	for(slot = range.location; slot < NSMaxRange(range); slot++)
+	{
+		primitive = [slots primitiveAtSlot:slot];
+		
+		if(primitive != nil && [primitive isHidden] == NO)
+			[primitive writeToVertexBuffer:buffer parentColor:color wireframe:wireframe];
+		else
+			memset(buffer, 0, vertexesPerSlot * sizeof(VBOVertexData));
+		
+		buffer += vertexesPerSlot;
+	}
+	
+	return buffer;
+	
+}//end WriteSlots
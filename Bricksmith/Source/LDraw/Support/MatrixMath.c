@@ -1176,6 +1176,51 @@ bool V3RayIntersectsSegment(Ray3 segment1, Segment3 segment2,
 }
 
 
+//========== V3TrianglesIntersect ==============================================
+//
+// Purpose:		Returns true if the triangles (a0 a1 a2) and (b0 b1 b2) pass 
+//				through one another. 
+//
+// Notes:		Two triangles which are not coplanar intersect exactly when an 
+//				edge of one pierces the other. Coplanar triangles are reported 
+//				as not intersecting; they are touching, not passing through. 
+//
+//==============================================================================
+bool V3TrianglesIntersect(Point3 a0, Point3 a1, Point3 a2,
+						  Point3 b0, Point3 b1, Point3 b2)
+{
+	Point3  aVertexes[3]    = {a0, a1, a2};
+	Point3  bVertexes[3]    = {b0, b1, b2};
+	Ray3    edge            = {};
+	float   distance        = 0;
+	int     counter         = 0;
+	
+	for(counter = 0; counter < 3; counter++)
+	{
+		// The edge direction is not normalized, so the edge lies between 
+		// distance 0 and 1. 
+		edge.origin     = aVertexes[counter];
+		edge.direction  = V3Sub(aVertexes[(counter + 1) % 3], aVertexes[counter]);
+		if(		V3RayIntersectsTriangle(edge, b0, b1, b2, &distance, NULL)
+			&&	distance >= 0 && distance <= 1 )
+		{
+			return true;
+		}
+		
+		edge.origin     = bVertexes[counter];
+		edge.direction  = V3Sub(bVertexes[(counter + 1) % 3], bVertexes[counter]);
+		if(		V3RayIntersectsTriangle(edge, a0, a1, a2, &distance, NULL)
+			&&	distance >= 0 && distance <= 1 )
+		{
+			return true;
+		}
+	}
+	
+	return false;
+	
+}//end V3TrianglesIntersect
+
+
 //========== V3RayIntersectsSphere =============================================
 //
 // Purpose:		Returns whether the given (normalized) ray intersects the 
@@ -1337,6 +1382,90 @@ Box3 V3UnionBoxAndPoint(Box3 box, Point3 point)
 }//end V3UnionBoxAndPoint
 
 
+//========== V3TransformBox ====================================================
+//
+// Purpose:		Returns the axis-aligned box which exactly encloses box after it 
+//				has been transformed by m. 
+//
+// Notes:		For affine transforms this projects the box's extents onto each 
+//				axis (Arvo, "Transforming Axis-Aligned Bounding Boxes", Graphics 
+//				Gems), which gives the same answer as transforming all eight 
+//				corners at a fraction of the cost. Projective transforms fall 
+//				back on the eight corners. 
+//
+//==============================================================================
+Box3 V3TransformBox(Box3 box, Matrix4 m)
+{
+	Box3	bounds		= InvalidBox;
+	float	boxMin[3]	= {box.min.x, box.min.y, box.min.z};
+	float	boxMax[3]	= {box.max.x, box.max.y, box.max.z};
+	float	newMin[3]	= {};
+	float	newMax[3]	= {};
+	int		row			= 0;
+	int		column		= 0;
+	float	a			= 0.0;
+	float	b			= 0.0;
+	
+	if(V3EqualBoxes(box, InvalidBox))
+		return InvalidBox;
+	
+	if(		m.element[0][3] == 0 && m.element[1][3] == 0 && m.element[2][3] == 0
+		&&	m.element[3][3] == 1 )
+	{
+		// Start from the translation, then add the smaller and larger of each 
+		// row's contribution to every axis. 
+		for(column = 0; column < 3; column++)
+		{
+			newMin[column] = m.element[3][column];
+			newMax[column] = m.element[3][column];
+			
+			for(row = 0; row < 3; row++)
+			{
+				a = m.element[row][column] * boxMin[row];
+				b = m.element[row][column] * boxMax[row];
+				
+				newMin[column] += MIN(a, b);
+				newMax[column] += MAX(a, b);
+			}
+		}
+		
+		bounds.min = V3Make(newMin[0], newMin[1], newMin[2]);
+		bounds.max = V3Make(newMax[0], newMax[1], newMax[2]);
+	}
+	else
+	{
+		int		counter		= 0;
+		Point3	corner		= ZeroPoint3;
+		
+		for(counter = 0; counter < 8; counter++)
+		{
+			corner.x	= (counter & 1) ? box.max.x : box.min.x;
+			corner.y	= (counter & 2) ? box.max.y : box.min.y;
+			corner.z	= (counter & 4) ? box.max.z : box.min.z;
+			
+			bounds		= V3UnionBoxAndPoint(bounds, V3MulPointByProjMatrix(corner, m));
+		}
+	}
+	
+	return bounds;
+	
+}//end V3TransformBox
+
+
+//========== V3BoxesIntersect ==================================================
+//
+// Purpose:		Returns true if the two boxes overlap or touch.
+//
+//==============================================================================
+bool V3BoxesIntersect(Box3 aBox, Box3 bBox)
+{
+	return (	aBox.min.x <= bBox.max.x && bBox.min.x <= aBox.max.x
+			&&	aBox.min.y <= bBox.max.y && bBox.min.y <= aBox.max.y
+			&&	aBox.min.z <= bBox.max.z && bBox.min.z <= aBox.max.z );
+	
+}//end V3BoxesIntersect
+
+
 #pragma mark -
 
 //========== V3MulPointByMatrix ================================================
@@ -1465,11 +1594,49 @@ Matrix4 V3LookAt(Point3  eye,
 //
 //==============================================================================
 Point3 V3Project(Point3 objPoint, Matrix4 modelview, Matrix4 projection, Box2 viewport)
+{
+	return V3ProjectWithMatrix(objPoint, Matrix4Multiply(modelview, projection), viewport);
+	
+}//end V3Project
+
+
+//========== V3Unproject =======================================================
+//
+// Purpose:		Given a point in viewport coordinates, returns the location in 
+//				object coordinates. 
+//
+// Notes:		viewportPoint.z is the depth buffer location.
+//
+//				(Drop-in replacement for gluUnProject)
+//
+//==============================================================================
+Point3 V3Unproject(Point3 viewportPoint, Matrix4 modelview, Matrix4 projection, Box2 viewport)
+{
+	Matrix4 inversePM   = IdentityMatrix4;
+	Point3  modelPoint  = ZeroPoint3;
+	
+	inversePM   = Matrix4Invert( Matrix4Multiply(modelview, projection) );
+	modelPoint  = V3UnprojectWithInverse(viewportPoint, inversePM, viewport);
+	
+	return modelPoint;
+}
+
+
+//========== V3ProjectWithMatrix ===============================================
+//
+// Purpose:		Projects the given object point into viewport coordinates, 
+//				given the product of the modelview and projection matrices. 
+//
+// Notes:		Use this instead of V3Project when projecting many points 
+//				through the same matrices. 
+//
+//==============================================================================
+Point3 V3ProjectWithMatrix(Point3 objPoint, Matrix4 modelviewProjection, Box2 viewport)
 {
 	Point3  transformedPoint    = ZeroPoint3;
 	Point3  windowPoint         = ZeroPoint3;
 	
-	transformedPoint = V3MulPointByProjMatrix(objPoint, Matrix4Multiply(modelview, projection));
+	transformedPoint = V3MulPointByProjMatrix(objPoint, modelviewProjection);
 	
 	windowPoint.x = viewport.origin.x + (V2BoxWidth(viewport)  * (transformedPoint.x + 1)) / 2;
 	windowPoint.y = viewport.origin.y + (V2BoxHeight(viewport) * (transformedPoint.y + 1)) / 2;
@@ -1477,34 +1644,32 @@ Point3 V3Project(Point3 objPoint, Matrix4 modelview, Matrix4 projection, Box2 vi
 	
 	return windowPoint;
 	
-}//end V3Project
+}//end V3ProjectWithMatrix
 
 
-//========== V3Unproject =======================================================
+//========== V3UnprojectWithInverse ============================================
 //
 // Purpose:		Given a point in viewport coordinates, returns the location in 
-//				object coordinates. 
+//				object coordinates, given the inverse of the product of the 
+//				modelview and projection matrices. 
 //
-// Notes:		viewportPoint.z is the depth buffer location.
+// Notes:		viewportPoint.z is the depth buffer location. 
 //
-//				(Drop-in replacement for gluUnProject)
+//				Inverting the matrices is most of the work of V3Unproject; 
+//				callers who already have the inverse should use this. 
 //
 //==============================================================================
-Point3 V3Unproject(Point3 viewportPoint, Matrix4 modelview, Matrix4 projection, Box2 viewport)
+Point3 V3UnprojectWithInverse(Point3 viewportPoint, Matrix4 inverseModelviewProjection, Box2 viewport)
 {
-	Matrix4 inversePM   = IdentityMatrix4;
 	Point3  normalized  = ZeroPoint3;
-	Point3  modelPoint  = ZeroPoint3;
 	
 	normalized.x = 2 * (viewportPoint.x - viewport.origin.x) / V2BoxWidth(viewport) - 1;
 	normalized.y = 2 * (viewportPoint.y - viewport.origin.y) / V2BoxHeight(viewport) - 1;
 	normalized.z = 2 * (viewportPoint.z) - 1;
 	
-	inversePM   = Matrix4Invert( Matrix4Multiply(modelview, projection) );
-	modelPoint  = V3MulPointByProjMatrix(normalized, inversePM);
+	return V3MulPointByProjMatrix(normalized, inverseModelviewProjection);
 	
-	return modelPoint;
-}
+}//end V3UnprojectWithInverse
 
 
 //========== Matrix3x3Determinant ==============================================
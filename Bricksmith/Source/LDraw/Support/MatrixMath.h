@@ -281,18 +281,23 @@ extern void		V3Print(Point3 point);
 extern bool		V3RayIntersectsTriangle(Ray3 ray, Point3 vert0, Point3 vert1, Point3 vert2, float *distanceOut, Point2 *intersectPointOut);
 extern bool		V3RayIntersectsSegment(Ray3 segment1, Segment3 segment2, float tolerance, float *distanceOut);
 extern bool		V3RayIntersectsSphere(Ray3 ray, Point3 sphereCenter, float radius, float *distanceOut);
+extern bool		V3TrianglesIntersect(Point3 a0, Point3 a1, Point3 a2, Point3 b0, Point3 b1, Point3 b2);
 
 extern Box3		V3BoundsFromPoints(Point3 point1, Point3 point2);
 extern Point3	V3CenterOfBox(Box3 box);
 extern int		V3EqualBoxes(Box3 box1, Box3 box2);
 extern Box3		V3UnionBox(Box3 aBox, Box3 bBox);
 extern Box3		V3UnionBoxAndPoint(Box3 box, Point3 point);
+extern Box3		V3TransformBox(Box3 box, Matrix4 m);
+extern bool		V3BoxesIntersect(Box3 aBox, Box3 bBox);
 
 extern Point3	V3MulPointByMatrix(Point3 pin, Matrix3 m);
 extern Vector3	V3MulPointByProjMatrix(Point3 pin, Matrix4 m);
 extern Matrix4	V3LookAt(Point3  eye, Point3  center, Vector3 up, Matrix4 modelview);
 extern Point3	V3Project(Point3 objPoint, Matrix4 modelview, Matrix4 projection, Box2 viewport);
 extern Point3	V3Unproject(Point3 viewportPoint, Matrix4 modelview, Matrix4 projection, Box2 viewport);
+extern Point3	V3ProjectWithMatrix(Point3 objPoint, Matrix4 modelviewProjection, Box2 viewport);
+extern Point3	V3UnprojectWithInverse(Point3 viewportPoint, Matrix4 inverseModelviewProjection, Box2 viewport);
 
 extern float	Matrix3x3Determinant( float, float, float, float, float, float, float, float, float );
 extern Matrix3	Matrix3MakeNormalTransformFromProjMatrix(Matrix4 transformationMatrix);
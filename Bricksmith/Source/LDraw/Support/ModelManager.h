@@ -29,6 +29,11 @@
 // opened) then the client part will receive a notification that its model is
 // going away, and the next call to requestModel will return the new correct
 // model.
+//
+// Files the model manager opens on a document's behalf are watched on disk.
+// When one changes, only the submodels whose text changed are re-parsed and
+// swapped in; clients of those submodels get the same scope-changed message
+// described above, and nobody else is touched.
 
 
 ////////////////////////////////////////////////////////////////////////////////
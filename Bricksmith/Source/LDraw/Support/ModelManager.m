@@ -10,11 +10,136 @@
 //==============================================================================
 
 #import "ModelManager.h"
+
+#import <fcntl.h>
+#import <unistd.h>
+
 #import "StringCategory.h"
 #import "LDrawFile.h"
 #import "LDrawMPDModel.h"
 #import "LDrawUtilities.h"
 
+// Time to wait after the last change event before reloading a watched file.
+// Editors frequently write a file in several chunks (or write-then-rename), so
+// we coalesce the burst into one reload.
+#define FILE_CHANGE_COALESCE_DELAY		0.25
+
+
+//---------- HashSubmodelLines -------------------------------------------------
+//
+// Purpose:		Returns a 64-bit FNV-1a hash of the lines in range.  This is
+//				the content fingerprint used to decide whether a submodel in a
+//				watched file has changed.
+//
+//------------------------------------------------------------------------------
+static unsigned long long HashSubmodelLines(NSArray *lines, NSRange range)
+{
+	unsigned long long	hash		= 14695981039346656037ULL;
+	NSUInteger			counter		= 0;
+	
+	for(counter = range.location; counter < NSMaxRange(range); counter++)
+	{
+		const unsigned char *p = (const unsigned char *)[[lines objectAtIndex:counter] UTF8String];
+		
+		while(p && *p)
+		{
+			hash ^= *p++;
+			hash *= 1099511628211ULL;
+		}
+		
+		// Line separator, so that moving text across a line break is a change.
+		hash ^= '\n';
+		hash *= 1099511628211ULL;
+	}
+	
+	return hash;
+	
+}//end HashSubmodelLines
+
+
+//---------- SubmodelRangesForLines --------------------------------------------
+//
+// Purpose:		Splits the lines of a file into the ranges of its MPD submodels 
+//				exactly the way -[LDrawFile initWithLines:...] does.
+//
+//------------------------------------------------------------------------------
+static NSArray *SubmodelRangesForLines(NSArray *lines)
+{
+	NSMutableArray	*ranges			= [NSMutableArray array];
+	NSUInteger		lineCount		= [lines count];
+	NSUInteger		modelStartIndex	= 0;
+	NSRange			modelRange		= NSMakeRange(0, 0);
+	
+	while(modelStartIndex < lineCount)
+	{
+		modelRange = [LDrawMPDModel rangeOfDirectiveBeginningAtIndex:modelStartIndex
+															 inLines:lines
+															maxIndex:lineCount - 1];
+		[ranges addObject:[NSValue valueWithRange:modelRange]];
+		modelStartIndex = NSMaxRange(modelRange);
+	}
+	
+	return ranges;
+	
+}//end SubmodelRangesForLines
+
+
+//---------- SubmodelHashesForLines --------------------------------------------
+//
+// Purpose:		Returns an array of NSNumbers, one content hash per submodel.
+//
+//------------------------------------------------------------------------------
+static NSArray *SubmodelHashesForLines(NSArray *lines, NSArray *ranges)
+{
+	NSMutableArray	*hashes	= [NSMutableArray arrayWithCapacity:[ranges count]];
+	
+	for(NSValue *rangeValue in ranges)
+	{
+		[hashes addObject:[NSNumber numberWithUnsignedLongLong:HashSubmodelLines(lines, [rangeValue rangeValue])]];
+	}
+	
+	return hashes;
+	
+}//end SubmodelHashesForLines
+
+
+//---------- SubmodelKeysForLines ----------------------------------------------
+//
+// Purpose:		Returns a string per submodel by which a reload can recognize it 
+//				again: the lowercased name from its 0 FILE line.
+//
+// Notes:		A file that isn't MPD has a single model with no 0 FILE line; it 
+//				is keyed by position, which is all it has.
+//
+//------------------------------------------------------------------------------
+static NSArray *SubmodelKeysForLines(NSArray *lines, NSArray *ranges)
+{
+	NSMutableArray	*keys		= [NSMutableArray arrayWithCapacity:[ranges count]];
+	NSString		*modelName	= nil;
+	NSUInteger		counter		= 0;
+	
+	for(NSValue *rangeValue in ranges)
+	{
+		NSRange range = [rangeValue rangeValue];
+		
+		modelName = nil;
+		if(		range.length > 0
+		   &&	[LDrawMPDModel lineIsMPDModelStart:[lines objectAtIndex:range.location] modelName:&modelName] == YES
+		   &&	modelName != nil )
+		{
+			[keys addObject:[modelName lowercaseString]];
+		}
+		else
+		{
+			[keys addObject:[NSString stringWithFormat:@"#%lu", (unsigned long)counter]];
+		}
+		counter++;
+	}
+	
+	return keys;
+	
+}//end SubmodelKeysForLines
+
 // ModelManager Implementation:
 //
 // A "service table" is the object allocated for each signed in model to keep
@@ -23,6 +148,13 @@
 //
 // Note that each time a service table opens a model, that model in turn gets
 // a service table!  This is how recursive resolution of models works.
+//
+// Each file a service table opens is also watched for changes on disk.  When
+// the file changes, we hash the text of each submodel and compare against the
+// hashes from the last load; only submodels whose text actually changed are
+// re-parsed and swapped into the existing LDrawFile.  Parts that referenced a
+// swapped-out submodel get a scope-changed message and re-resolve; nobody else
+// is disturbed.
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -38,6 +170,44 @@
 // document is opened.
 - (void) documentSignInInternal:(NSString *) docPath withFile:(LDrawFile *) file;
 
+// Called after a watched file has swapped submodels, so that every document
+// that (directly or through other peer files) depends on it redraws.
+- (void) noteDependentsOfFileNeedDisplay:(LDrawFile *) changedFile;
+
+@end
+
+
+@class ModelServiceTable;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// ModelFileWatcher
+//
+// Watches one file opened by a service table and remembers the content hash
+// of each of its submodels as of the last (re)load.
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface ModelFileWatcher : NSObject {
+
+@public
+	NSString *				fileName;			// Key in the owning table's trackedFiles
+	NSString *				path;
+	NSArray *				submodelHashes;		// NSNumber * per submodel, in file order
+	NSArray *				submodelKeys;		// NSString * per submodel, in file order
+	ModelServiceTable *		table;				// weak - the table owns us
+
+@private
+	BOOL					isStopped;			// Once stopped, never restart
+#if USE_BLOCKS
+	dispatch_source_t		source;
+#endif
+}
+
+- (id)		initWithFileName:(NSString *) fileName path:(NSString *) path table:(ModelServiceTable *) table;
+- (void)	startWatching;
+- (void)	stopWatching;
+- (void)	cancelSource;
+
 @end
 
 
@@ -55,12 +225,14 @@
 
 	NSMutableSet *			peerFileNames;		// NSString * filename
 	NSMutableDictionary *	trackedFiles;		// NSString * filename -> LDrawFile* modelfile
+	NSMutableDictionary *	fileWatchers;		// NSString * filename -> ModelFileWatcher*
 }
 
 - (id)			initWithFileName:(NSString *) fileName parentDir:(NSString *) parentDir file:(LDrawFile *) file;
 - (void)		dealloc;
 - (LDrawFile *) beginService:(NSString *) fileName;
 - (BOOL)		dropService:(NSString *) fileName;		// Returns true if it realLy did find this thing and drop it!
+- (void)		reloadTrackedFile:(NSString *) fileName;
 
 @end
 
@@ -95,6 +267,7 @@
 	
 	peerFileNames	= [[NSMutableSet alloc] initWithArray:partNames];
 	trackedFiles	= [[NSMutableDictionary alloc] init];
+	fileWatchers	= [[NSMutableDictionary alloc] init];
 	
 	//NSLog(@"Found %d peers.\n", [self->peerFileNames count]);
 
@@ -117,6 +290,10 @@
 {
 	//NSLog(@"Nuking sevice table %p\n",self);
 	
+	// Stop watching first; a reload must never run against a dying table.
+	[[fileWatchers allValues] makeObjectsPerformSelector:@selector(stopWatching)];
+	[fileWatchers release];
+	
 	// Go through all tracked files and tell their first model's clients that
 	// they are going away.  
 	for(NSString * partName in trackedFiles)
@@ -180,6 +357,16 @@
 		[parsedFile release];			// Hash table tracked files retains the ONLY
 										// ref count - our "init" ref count gets tossed!
 		
+		// Remember what each submodel looked like so that a later change on 
+		// disk only costs us the submodels that were actually edited.
+		ModelFileWatcher * watcher = [[ModelFileWatcher alloc] initWithFileName:inFileName path:fullPath table:self];
+		NSArray * ranges = SubmodelRangesForLines(lines);
+		watcher->submodelHashes = [SubmodelHashesForLines(lines, ranges) retain];
+		watcher->submodelKeys	= [SubmodelKeysForLines(lines, ranges) retain];
+		[fileWatchers setObject:watcher forKey:inFileName];
+		[watcher startWatching];
+		[watcher release];
+		
 		// The model we just opened (to help the user's doc) might in turn refer to yet more 
 		// peer files, so recursively open service on it.  The "internal" version won't freak
 		// out that another document owns us.
@@ -216,6 +403,8 @@
 		// This releases any files that deadFile was in tunr using.
 		[[ModelManager sharedModelManager] documentSignOut:deadFile];
 
+		[[fileWatchers objectForKey:inFileName] stopWatching];
+		[fileWatchers removeObjectForKey:inFileName];
 		[trackedFiles removeObjectForKey:inFileName];
 
 		return TRUE;
@@ -223,6 +412,328 @@
 	return FALSE;
 }
 
+
+//========== reloadTrackedFile: ================================================
+//
+// Purpose:		A file we opened for a client changed on disk.  Re-read it and 
+//				swap in new copies of only those submodels whose text changed.
+//
+// Notes:		Submodels are matched by name, so adding, removing or reordering 
+//				submodels doesn't disturb the others.  A submodel whose hash 
+//				matches the one last loaded under its name is left completely 
+//				alone - its parsed directives, DLs and cached bounds survive.  
+//				If the file's order changed around it, it is moved in place 
+//				rather than removed and re-inserted, since removing a submodel 
+//				unresolves every part which uses it.
+//
+//				A replaced submodel tells its observers (parts referencing it, 
+//				both in this file and in client documents) that its scope 
+//				changed; they unresolve, and the next resolve finds the new 
+//				model by name.  That is the whole extent of the invalidation.
+//
+//==============================================================================
+- (void) reloadTrackedFile:(NSString *) inFileName
+{
+	LDrawFile *				trackedFile		= [trackedFiles objectForKey:inFileName];
+	ModelFileWatcher *		watcher			= [fileWatchers objectForKey:inFileName];
+	NSString *				fileContents	= nil;
+	NSArray *				lines			= nil;
+	NSArray *				ranges			= nil;
+	NSArray *				newHashes		= nil;
+	NSArray *				newKeys			= nil;
+	NSArray *				oldHashes		= nil;
+	NSArray *				oldKeys			= nil;
+	NSArray *				oldModels		= nil;
+	NSMutableDictionary *	oldIndexForKey	= nil;
+	NSNumber *				oldIndex		= nil;
+	NSUInteger				newCount		= 0;
+	NSUInteger				oldCount		= 0;
+	NSUInteger				counter			= 0;
+	id *					newModels		= NULL;
+	BOOL *					oldKept			= NULL;
+	BOOL					didSwap			= NO;
+	
+	if(trackedFile == nil || watcher == nil)
+		return;
+	
+	// The file may be mid-save or gone entirely; keep what we have.
+	fileContents = [LDrawUtilities stringFromFile:watcher->path];
+	if(fileContents == nil)
+		return;
+	
+	lines		= [fileContents separateByLine];
+	ranges		= SubmodelRangesForLines(lines);
+	newHashes	= SubmodelHashesForLines(lines, ranges);
+	newKeys		= SubmodelKeysForLines(lines, ranges);
+	oldHashes	= watcher->submodelHashes;
+	oldKeys		= watcher->submodelKeys;
+	oldModels	= [[[trackedFile submodels] copy] autorelease];
+	newCount	= [ranges count];
+	oldCount	= [oldModels count];
+	
+	// An empty file would leave the LDrawFile with no first model, which its 
+	// clients can't cope with.  Wait for something parseable.
+	if(newCount == 0)
+		return;
+	
+	// If our bookkeeping doesn't line up with the file (shouldn't happen), 
+	// treat every submodel as changed.
+	oldIndexForKey = [NSMutableDictionary dictionaryWithCapacity:oldCount];
+	if([oldHashes count] == oldCount && [oldKeys count] == oldCount)
+	{
+		// Backwards, so that the first of any duplicate names wins.
+		for(counter = oldCount; counter > 0; counter--)
+		{
+			[oldIndexForKey setObject:[NSNumber numberWithUnsignedInteger:counter - 1]
+							   forKey:[oldKeys objectAtIndex:counter - 1]];
+		}
+	}
+	
+	//---------- Parse changed submodels ---------------------------------------
+	
+	// newModels ends up holding the submodel for every slot of the new file: 
+	// an unchanged old model (retained) or a freshly-parsed one.
+	newModels	= calloc(newCount, sizeof(LDrawMPDModel*));
+	oldKept		= calloc(oldCount + 1, sizeof(BOOL));
+	
+	dispatch_group_t	group	= NULL;
+#if USE_BLOCKS
+	dispatch_queue_t	queue	= dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+						group	= dispatch_group_create();
+#endif
+	for(counter = 0; counter < newCount; counter++)
+	{
+		oldIndex = [oldIndexForKey objectForKey:[newKeys objectAtIndex:counter]];
+		
+		if(		oldIndex != nil
+		   &&	oldKept[[oldIndex unsignedIntegerValue]] == NO
+		   &&	[[oldHashes objectAtIndex:[oldIndex unsignedIntegerValue]] isEqualToNumber:[newHashes objectAtIndex:counter]] )
+		{
+			oldKept[[oldIndex unsignedIntegerValue]] = YES;
+			newModels[counter] = [[oldModels objectAtIndex:[oldIndex unsignedIntegerValue]] retain];
+			continue;
+		}
+		
+		NSRange modelRange = [[ranges objectAtIndex:counter] rangeValue];
+		NSUInteger insertIndex = counter;
+#if USE_BLOCKS
+		dispatch_group_async(group, queue,
+		^{
+#endif
+			newModels[insertIndex] = [[LDrawMPDModel alloc] initWithLines:lines inRange:modelRange parentGroup:group];
+#if USE_BLOCKS
+		});
+#endif
+	}
+#if USE_BLOCKS
+	dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+	dispatch_release(group);
+#endif
+	
+	//---------- Swap ----------------------------------------------------------
+	
+	[trackedFile lockForEditing];
+	
+	// Put every slot in order.  New models go in; kept models are moved into 
+	// place, never removed, so nothing which uses them notices.
+	for(counter = 0; counter < newCount; counter++)
+	{
+		LDrawMPDModel	*newModel		= newModels[counter];
+		NSArray			*current		= [trackedFile submodels];
+		NSUInteger		currentIndex	= [current indexOfObjectIdenticalTo:newModel];
+		
+		if(currentIndex == counter)
+			continue;
+		
+		if(currentIndex != NSNotFound)
+			[trackedFile moveDirectiveAtIndex:currentIndex toIndex:counter];
+		else
+		{
+			[trackedFile insertDirective:newModel atIndex:counter];
+			didSwap = YES;
+		}
+	}
+	
+	// What's left past the end is every old model that was replaced or 
+	// vanished from the file.  Only the dependents of those need to find out.
+	for(counter = 0; counter < oldCount; counter++)
+	{
+		if(oldKept[counter] == NO)
+		{
+			LDrawMPDModel *oldModel = [oldModels objectAtIndex:counter];
+			
+			[trackedFile removeDirective:oldModel];
+			[oldModel sendMessageToObservers:MessageScopeChanged];
+			didSwap = YES;
+		}
+	}
+	
+	[trackedFile unlockEditor];
+	
+	for(counter = 0; counter < newCount; counter++)
+		[newModels[counter] release];
+	free(newModels);
+	free(oldKept);
+	
+	[newHashes retain];
+	[watcher->submodelHashes release];
+	watcher->submodelHashes = newHashes;
+	
+	[newKeys retain];
+	[watcher->submodelKeys release];
+	watcher->submodelKeys = newKeys;
+	
+	if(didSwap)
+		[[ModelManager sharedModelManager] noteDependentsOfFileNeedDisplay:trackedFile];
+	
+}//end reloadTrackedFile:
+
+@end
+
+
+@implementation ModelFileWatcher
+
+//========== initWithFileName:path:table: ======================================
+//
+// Purpose:		Set up a watcher; it does nothing until -startWatching.
+//
+//==============================================================================
+- (id) initWithFileName:(NSString *) inFileName path:(NSString *) inPath table:(ModelServiceTable *) inTable
+{
+	self = [super init];
+	
+	self->fileName	= [inFileName retain];
+	self->path		= [inPath retain];
+	self->table		= inTable;
+	
+	return self;
+	
+}//end initWithFileName:path:table:
+
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Our source's handler only holds a weak pointer to us, so it 
+//				must be cancelled before we go.
+//
+//==============================================================================
+- (void) dealloc
+{
+	[self cancelSource];
+	
+	[fileName		release];
+	[path			release];
+	[submodelHashes	release];
+	[submodelKeys	release];
+	
+	[super dealloc];
+	
+}//end dealloc
+
+
+//========== startWatching =====================================================
+//
+// Purpose:		Open the file and start listening for vnode events on it.
+//
+// Notes:		Events are delivered on the main queue, because the reload 
+//				edits directive trees that the main thread draws.
+//
+//==============================================================================
+- (void) startWatching
+{
+#if USE_BLOCKS
+	int fd = -1;
+	
+	if(self->source != NULL || self->isStopped == YES)
+		return;
+	
+	fd = open([self->path fileSystemRepresentation], O_EVTONLY);
+	if(fd < 0)
+		return;
+	
+	self->source = dispatch_source_create(DISPATCH_SOURCE_TYPE_VNODE, fd,
+										  DISPATCH_VNODE_WRITE | DISPATCH_VNODE_EXTEND | DISPATCH_VNODE_DELETE | DISPATCH_VNODE_RENAME,
+										  dispatch_get_main_queue());
+	if(self->source == NULL)
+	{
+		close(fd);
+		return;
+	}
+	
+	// Non-retaining: we cancel the source before we die.
+	__block ModelFileWatcher *watcher = self;
+	
+	dispatch_source_set_event_handler(self->source,
+	^{
+		unsigned long flags = dispatch_source_get_data(watcher->source);
+		
+		// Safe-saving editors replace the file; our descriptor now points at 
+		// the dead inode, so re-open on the path after the reload.
+		if(flags & (DISPATCH_VNODE_DELETE | DISPATCH_VNODE_RENAME))
+			[watcher cancelSource];
+		
+		[NSObject cancelPreviousPerformRequestsWithTarget:watcher selector:@selector(fileDidChange) object:nil];
+		[watcher performSelector:@selector(fileDidChange) withObject:nil afterDelay:FILE_CHANGE_COALESCE_DELAY];
+	});
+	
+	dispatch_source_set_cancel_handler(self->source,
+	^{
+		close(fd);
+	});
+	
+	dispatch_resume(self->source);
+#endif
+}//end startWatching
+
+
+//========== stopWatching ======================================================
+//
+// Purpose:		Stop listening, including any reload already scheduled.  Safe 
+//				to call when not watching.
+//
+//==============================================================================
+- (void) stopWatching
+{
+	self->isStopped = YES;
+	[NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(fileDidChange) object:nil];
+	[self cancelSource];
+	
+}//end stopWatching
+
+
+//========== cancelSource ======================================================
+//
+// Purpose:		Close our vnode source without touching a pending reload.
+//
+//==============================================================================
+- (void) cancelSource
+{
+#if USE_BLOCKS
+	if(self->source != NULL)
+	{
+		dispatch_source_cancel(self->source);
+		dispatch_release(self->source);
+		self->source = NULL;
+	}
+#endif
+}//end cancelSource
+
+
+//========== fileDidChange =====================================================
+//
+// Purpose:		The burst of change events has settled; reload.
+//
+//==============================================================================
+- (void) fileDidChange
+{
+	// The table may drop us (and we may die) while reloading.
+	[[self retain] autorelease];
+	
+	[self->table reloadTrackedFile:self->fileName];
+	[self startWatching];
+	
+}//end fileDidChange
+
 @end
 
 
@@ -431,4 +942,27 @@ static ModelManager *SharedModelManager = nil;
 	return nil;
 }
 
+
+
+//========== noteDependentsOfFileNeedDisplay: ==================================
+//
+// Purpose:		Tell every file that tracks changedFile (and every file that 
+//				tracks those, and so on up to the user's documents) to redraw.
+//
+//==============================================================================
+- (void) noteDependentsOfFileNeedDisplay:(LDrawFile *) changedFile
+{
+	for(NSValue * key in [serviceTables allKeys])
+	{
+		ModelServiceTable * table = [serviceTables objectForKey:key];
+		
+		if(table != nil && [[table->trackedFiles allValues] indexOfObjectIdenticalTo:changedFile] != NSNotFound)
+		{
+			[table->file noteNeedsDisplay];
+			[self noteDependentsOfFileNeedDisplay:table->file];
+		}
+	}
+	
+}//end noteDependentsOfFileNeedDisplay:
+
 @end
@@ -0,0 +1,47 @@
+//==============================================================================
+//
+// File:		PartConnectionIndex.h
+//
+// Purpose:		Finds the studs and anti-studs near a point, so that parts being
+//				dragged can snap onto the ones already in the model.
+//
+//				The connection points of every part are kept in a spatial hash
+//				in the container's coordinates. Like PartInterferenceReport,
+//				the index is kept up to date incrementally: -update re-files
+//				only the parts which were added, removed or moved since last
+//				time, so it is cheap to call at the start of every drag. A
+//				query then only looks at the few hash cells around the point.
+//
+//==============================================================================
+#import <Foundation/Foundation.h>
+
+#import "LDrawConnections.h"
+
+@class LDrawContainer;
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// class PartConnectionIndex
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface PartConnectionIndex : NSObject
+{
+	LDrawContainer		*indexedObject;
+	NSMapTable			*placements;		// LDrawPart -> ConnectionPlacement
+	struct ConnectionHash	*hash;				// connection points in the container's coordinates
+}
+
+// Initialization
++ (PartConnectionIndex *) connectionIndexForContainer:(LDrawContainer *)container;
+
+// Collecting Information
+- (void) setLDrawContainer:(LDrawContainer *)newContainer;
+- (void) update;
+
+// Queries
+- (NSUInteger) connectionCount;
+- (BOOL) findMateForConnection:(const LDrawConnection *)connection withinDistance:(float)distance mate:(LDrawConnection *)mateOut;
+- (Vector3) snapDisplacement:(Vector3)displacement ofDirectives:(NSArray *)directives;
+
+@end
@@ -0,0 +1,716 @@
+//==============================================================================
+//
+// File:		PartConnectionIndex.m
+//
+// Purpose:		Spatial index of stud and anti-stud positions. See
+//				PartConnectionIndex.h.
+//
+// Notes:		The hash divides space into cubes CONNECTION_CELL_SIZE on a
+//				side, one stud pitch, and files each connection in a bucket
+//				chosen from the cube it lies in. Buckets are doubly-linked
+//				chains threaded through one flat array of entries, so a
+//				connection can be unlinked in constant time when its part
+//				moves, and freed entries are reused before the array grows.
+//
+//				Different cubes may share a bucket; a query simply measures
+//				everything in the buckets it visits. Since the snapping
+//				distance is less than the cell size, a query never has to look
+//				at more than two cells along each axis.
+//
+//				Coordinates are those of the indexed container, so the index
+//				should be given a single model. Parts referring to submodels
+//				have no connections of their own and are not indexed.
+//
+//==============================================================================
+#import "PartConnectionIndex.h"
+
+#import "LDrawContainer.h"
+#import "LDrawModel.h"
+#import "LDrawPart.h"
+#import "LDrawTrace.h"
+#import "MatrixMath.h"
+
+// Edge of the cubes into which space is hashed, in LDraw units.
+#define CONNECTION_CELL_SIZE			20.0f
+
+// How close a connection on a dragged part must come to one in the model
+// before the part snaps to it, in LDraw units.
+#define CONNECTION_SNAP_DISTANCE		8.0f
+
+// Most connection points of the dragged parts looked up per mouse movement.
+// A big selection carries thousands of studs, but the first few hundred
+// decide the snap just as well.
+#define CONNECTION_SNAP_QUERY_MAX		256
+
+#define CONNECTION_NO_ENTRY				(-1)
+
+
+//------------------------------------------------------------------------------
+//
+// ConnectionHash
+//
+//------------------------------------------------------------------------------
+typedef struct ConnectionEntry
+{
+	LDrawConnection	connection;
+	int32_t			next;			// next in bucket, or in the free list
+	int32_t			previous;		// CONNECTION_NO_ENTRY if first in bucket
+	uint32_t		bucket;
+
+} ConnectionEntry;
+
+
+struct ConnectionHash
+{
+	ConnectionEntry	*entries;
+	int32_t			entryCapacity;
+	int32_t			entriesUsed;	// slots ever handed out
+	int32_t			entryCount;		// slots holding a connection
+	int32_t			freeList;
+
+	int32_t			*buckets;		// first entry in each bucket
+	uint32_t		bucketCount;	// power of two
+};
+
+typedef struct ConnectionHash ConnectionHash;
+
+
+//------------------------------------------------------------------------------
+//
+// ConnectionPlacement
+//
+// What was recorded about one part the last time the index was updated.
+//
+//------------------------------------------------------------------------------
+@interface ConnectionPlacement : NSObject
+{
+@public
+	Matrix4		transformation;
+	NSData		*connectionPoints;	// the library model's, in part coordinates
+	int32_t		*entryIndexes;		// where each one was filed in the hash
+	NSUInteger	entryCount;
+}
+@end
+
+
+@implementation ConnectionPlacement
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Placement forgotten.
+//
+//==============================================================================
+- (void) dealloc
+{
+	[connectionPoints release];
+	free(entryIndexes);
+
+	[super dealloc];
+
+}//end dealloc
+
+@end
+
+
+@interface PartConnectionIndex (Private)
+
+- (void) removePart:(LDrawPart *)part;
+- (void) recordPart:(LDrawPart *)part placement:(ConnectionPlacement *)placement;
+
+@end
+
+static ConnectionHash	*ConnectionHashCreate(void);
+static void				ConnectionHashFree(ConnectionHash *hash);
+static void				ConnectionHashRemoveAll(ConnectionHash *hash);
+static int32_t			ConnectionHashInsert(ConnectionHash *hash, const LDrawConnection *connection);
+static void				ConnectionHashRemove(ConnectionHash *hash, int32_t entryIndex);
+static void				ConnectionHashGrowBuckets(ConnectionHash *hash);
+static float			ConnectionHashFindMate(const ConnectionHash *hash, const LDrawConnection *connection, float distance, LDrawConnection *mateOut);
+static uint32_t			BucketForCell(int32_t cellX, int32_t cellY, int32_t cellZ, uint32_t bucketCount);
+static uint32_t			BucketForPoint(Point3 point, uint32_t bucketCount);
+
+
+@implementation PartConnectionIndex
+
+#pragma mark -
+#pragma mark INITIALIZATION
+#pragma mark -
+
+//---------- connectionIndexForContainer: ----------------------------[static]--
+//
+// Purpose:		Returns an empty index of container. Call -update to fill it.
+//
+//------------------------------------------------------------------------------
++ (PartConnectionIndex *) connectionIndexForContainer:(LDrawContainer *)container
+{
+	PartConnectionIndex *index = [PartConnectionIndex new];
+
+	[index setLDrawContainer:container];
+
+	return [index autorelease];
+
+}//end connectionIndexForContainer:
+
+
+//========== init ==============================================================
+//
+// Purpose:		Creates an empty index.
+//
+//==============================================================================
+- (id) init
+{
+	self = [super init];
+	if(self)
+	{
+		placements  = [[NSMapTable alloc] initWithKeyOptions:(NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality)
+											valueOptions:NSPointerFunctionsStrongMemory
+												capacity:0];
+		hash        = ConnectionHashCreate();
+	}
+	return self;
+
+}//end init
+
+
+#pragma mark -
+#pragma mark COLLECTING INFORMATION
+#pragma mark -
+
+//========== setLDrawContainer: ================================================
+//
+// Purpose:		Sets the object whose parts we index. Everything recorded about
+//				the previous one is thrown away.
+//
+//==============================================================================
+- (void) setLDrawContainer:(LDrawContainer *)newContainer
+{
+	if(newContainer != self->indexedObject)
+	{
+		[newContainer			retain];
+		[self->indexedObject	release];
+
+		self->indexedObject = newContainer;
+
+		[self->placements removeAllObjects];
+		ConnectionHashRemoveAll(self->hash);
+	}
+
+}//end setLDrawContainer:
+
+
+//========== update ============================================================
+//
+// Purpose:		Brings the index up to date with the container.
+//
+// Notes:		Hidden parts are left out. That includes the originals of parts
+//				being dragged, which are hidden for the duration of the drag,
+//				so a part never snaps onto its own ghost.
+//
+//==============================================================================
+- (void) update
+{
+	NSArray             *elements           = [self->indexedObject allEnclosedElements];
+	NSMapTable          *currentParts       = [NSMapTable mapTableWithStrongToStrongObjects];
+	NSMutableArray      *removedParts       = [NSMutableArray array];
+	ConnectionPlacement *placement          = nil;
+	LDrawPart           *part               = nil;
+	id                  currentElement      = nil;
+	Matrix4             transformation      = IdentityMatrix4;
+	NSData              *connectionPoints   = nil;
+
+	TRACE_BEGIN("update connection index");
+
+	for(currentElement in elements)
+	{
+		if(		[currentElement isKindOfClass:[LDrawPart class]] == NO
+		   ||	[currentElement isHidden] == YES )
+			continue;
+
+		part                = currentElement;
+		connectionPoints    = [[part resolvedLibraryModel] connectionPoints];
+		if([connectionPoints length] == 0)
+			continue;
+
+		transformation      = [part transformationMatrix];
+		placement           = NSMapGet(self->placements, part);
+
+		NSMapInsert(currentParts, part, part);
+
+		if(		placement == nil
+		   ||	placement->connectionPoints != connectionPoints
+		   ||	memcmp(&placement->transformation, &transformation, sizeof(Matrix4)) != 0 )
+		{
+			[self removePart:part];
+
+			placement = [[ConnectionPlacement alloc] init];
+			placement->transformation   = transformation;
+			placement->connectionPoints = [connectionPoints retain];
+
+			[self recordPart:part placement:placement];
+
+			[placement release];
+		}
+	}
+
+	for(part in self->placements)
+	{
+		if(NSMapGet(currentParts, part) == nil)
+			[removedParts addObject:part];
+	}
+	for(part in removedParts)
+	{
+		[self removePart:part];
+	}
+
+	TRACE_END("update connection index");
+	TRACE_COUNTER("indexed connections", self->hash->entryCount);
+
+}//end update
+
+
+#pragma mark -
+#pragma mark QUERIES
+#pragma mark -
+
+//========== connectionCount ===================================================
+//
+// Purpose:		Returns the number of studs and anti-studs in the index.
+//
+//==============================================================================
+- (NSUInteger) connectionCount
+{
+	return self->hash->entryCount;
+
+}//end connectionCount
+
+
+//========== findMateForConnection:withinDistance:mate: ========================
+//
+// Purpose:		Looks for the nearest indexed connection which fits together
+//				with connection and is no more than distance away from it. If
+//				there is one, it is copied into mateOut and YES is returned.
+//
+// Notes:		distance must not exceed CONNECTION_CELL_SIZE.
+//
+//==============================================================================
+- (BOOL) findMateForConnection:(const LDrawConnection *)connection
+				withinDistance:(float)distance
+						  mate:(LDrawConnection *)mateOut
+{
+	assert(distance <= CONNECTION_CELL_SIZE);
+
+	return ConnectionHashFindMate(self->hash, connection, distance, mateOut) >= 0;
+
+}//end findMateForConnection:withinDistance:mate:
+
+
+//========== snapDisplacement:ofDirectives: ====================================
+//
+// Purpose:		Adjusts displacement, by which directives are about to be
+//				moved, so that the connection of theirs which ends up nearest a
+//				mating connection in the model lands exactly on it. Returns
+//				displacement unchanged if nothing comes within
+//				CONNECTION_SNAP_DISTANCE.
+//
+// Notes:		Only LDrawParts have connections; anything else in directives
+//				is ignored.
+//
+//==============================================================================
+- (Vector3) snapDisplacement:(Vector3)displacement ofDirectives:(NSArray *)directives
+{
+	NSMutableData   *moved          = [NSMutableData data];
+	LDrawConnection *connections    = NULL;
+	LDrawConnection mate;
+	LDrawConnection bestMate;
+	LDrawConnection bestMoved;
+	NSData          *points         = nil;
+	id              currentElement  = nil;
+	NSUInteger      count           = 0;
+	NSUInteger      counter         = 0;
+	float           nearest         = CONNECTION_SNAP_DISTANCE;
+	float           distance        = 0;
+	BOOL            found           = NO;
+
+	if(self->hash->entryCount == 0)
+		return displacement;
+
+	TRACE_BEGIN("snap to connections");
+
+	for(currentElement in directives)
+	{
+		if([currentElement isKindOfClass:[LDrawPart class]] == NO)
+			continue;
+
+		points = [[currentElement resolvedLibraryModel] connectionPoints];
+		LDrawConnectionsAppendTransformed(moved, [points bytes], [points length] / sizeof(LDrawConnection), [currentElement transformationMatrix]);
+
+		if([moved length] / sizeof(LDrawConnection) >= CONNECTION_SNAP_QUERY_MAX)
+			break;
+	}
+
+	connections = [moved mutableBytes];
+	count       = MIN([moved length] / sizeof(LDrawConnection), CONNECTION_SNAP_QUERY_MAX);
+
+	for(counter = 0; counter < count; counter++)
+	{
+		connections[counter].position = V3Add(connections[counter].position, displacement);
+
+		distance = ConnectionHashFindMate(self->hash, &connections[counter], nearest, &mate);
+		if(distance >= 0)
+		{
+			nearest     = distance;
+			bestMate    = mate;
+			bestMoved   = connections[counter];
+			found       = YES;
+		}
+	}
+
+	if(found == YES)
+		displacement = V3Add(displacement, V3Sub(bestMate.position, bestMoved.position));
+
+	TRACE_END("snap to connections");
+	TRACE_COUNTER("connection queries", count);
+
+	return displacement;
+
+}//end snapDisplacement:ofDirectives:
+
+
+#pragma mark -
+#pragma mark UTILITIES
+#pragma mark -
+
+//========== removePart: =======================================================
+//
+// Purpose:		Takes part's connections out of the hash and forgets it.
+//
+//==============================================================================
+- (void) removePart:(LDrawPart *)part
+{
+	ConnectionPlacement *placement  = NSMapGet(self->placements, part);
+	NSUInteger          counter     = 0;
+
+	if(placement != nil)
+	{
+		for(counter = 0; counter < placement->entryCount; counter++)
+		{
+			ConnectionHashRemove(self->hash, placement->entryIndexes[counter]);
+		}
+		NSMapRemove(self->placements, part);
+	}
+
+}//end removePart:
+
+
+//========== recordPart:placement: =============================================
+//
+// Purpose:		Files a new or moved part's connections in the hash.
+//
+//==============================================================================
+- (void) recordPart:(LDrawPart *)part placement:(ConnectionPlacement *)placement
+{
+	NSMutableData   *transformed    = [NSMutableData data];
+	LDrawConnection *connections    = NULL;
+	NSUInteger      count           = [placement->connectionPoints length] / sizeof(LDrawConnection);
+	NSUInteger      counter         = 0;
+
+	LDrawConnectionsAppendTransformed(transformed, [placement->connectionPoints bytes], count, placement->transformation);
+	connections = [transformed mutableBytes];
+
+	placement->entryIndexes = malloc(sizeof(int32_t) * count);
+	placement->entryCount   = count;
+
+	for(counter = 0; counter < count; counter++)
+	{
+		placement->entryIndexes[counter] = ConnectionHashInsert(self->hash, &connections[counter]);
+	}
+
+	NSMapInsert(self->placements, part, placement);
+
+}//end recordPart:placement:
+
+
+#pragma mark -
+#pragma mark DESTRUCTOR
+#pragma mark -
+
+//========== dealloc ===========================================================
+//
+// Purpose:		The end.
+//
+//==============================================================================
+- (void) dealloc
+{
+	[indexedObject	release];
+	[placements		release];
+	ConnectionHashFree(hash);
+
+	[super dealloc];
+
+}//end dealloc
+
+
+@end
+
+
+#pragma mark -
+
+//---------- ConnectionHashCreate ------------------------------------[static]--
+//
+// Purpose:		Returns an empty hash.
+//
+//------------------------------------------------------------------------------
+static ConnectionHash *ConnectionHashCreate(void)
+{
+	ConnectionHash  *hash   = calloc(1, sizeof(ConnectionHash));
+	uint32_t        counter = 0;
+
+	hash->freeList      = CONNECTION_NO_ENTRY;
+	hash->bucketCount   = 256;
+	hash->buckets       = malloc(sizeof(int32_t) * hash->bucketCount);
+
+	for(counter = 0; counter < hash->bucketCount; counter++)
+		hash->buckets[counter] = CONNECTION_NO_ENTRY;
+
+	return hash;
+
+}//end ConnectionHashCreate
+
+
+//---------- ConnectionHashFree --------------------------------------[static]--
+//
+// Purpose:		Releases the hash and all its storage.
+//
+//------------------------------------------------------------------------------
+static void ConnectionHashFree(ConnectionHash *hash)
+{
+	free(hash->entries);
+	free(hash->buckets);
+	free(hash);
+
+}//end ConnectionHashFree
+
+
+//---------- ConnectionHashRemoveAll ---------------------------------[static]--
+//
+// Purpose:		Empties the hash, keeping its storage for reuse.
+//
+//------------------------------------------------------------------------------
+static void ConnectionHashRemoveAll(ConnectionHash *hash)
+{
+	uint32_t counter = 0;
+
+	for(counter = 0; counter < hash->bucketCount; counter++)
+		hash->buckets[counter] = CONNECTION_NO_ENTRY;
+
+	hash->entriesUsed   = 0;
+	hash->entryCount    = 0;
+	hash->freeList      = CONNECTION_NO_ENTRY;
+
+}//end ConnectionHashRemoveAll
+
+
+//---------- ConnectionHashInsert ------------------------------------[static]--
+//
+// Purpose:		Files connection and returns the index of its entry, which is
+//				what must be passed to ConnectionHashRemove later.
+//
+//------------------------------------------------------------------------------
+static int32_t ConnectionHashInsert(ConnectionHash *hash, const LDrawConnection *connection)
+{
+	ConnectionEntry *entry      = NULL;
+	int32_t         entryIndex  = 0;
+	uint32_t        bucket      = 0;
+
+	// Keep chains short: about two connections to a bucket.
+	if(hash->entryCount >= hash->bucketCount * 2)
+		ConnectionHashGrowBuckets(hash);
+
+	if(hash->freeList != CONNECTION_NO_ENTRY)
+	{
+		entryIndex      = hash->freeList;
+		hash->freeList  = hash->entries[entryIndex].next;
+	}
+	else
+	{
+		if(hash->entriesUsed == hash->entryCapacity)
+		{
+			hash->entryCapacity = MAX(hash->entryCapacity * 2, 256);
+			hash->entries       = realloc(hash->entries, sizeof(ConnectionEntry) * hash->entryCapacity);
+		}
+		entryIndex = hash->entriesUsed;
+		hash->entriesUsed += 1;
+	}
+
+	bucket  = BucketForPoint(connection->position, hash->bucketCount);
+	entry   = &hash->entries[entryIndex];
+
+	entry->connection   = *connection;
+	entry->bucket       = bucket;
+	entry->previous     = CONNECTION_NO_ENTRY;
+	entry->next         = hash->buckets[bucket];
+
+	if(entry->next != CONNECTION_NO_ENTRY)
+		hash->entries[entry->next].previous = entryIndex;
+	hash->buckets[bucket] = entryIndex;
+
+	hash->entryCount += 1;
+
+	return entryIndex;
+
+}//end ConnectionHashInsert
+
+
+//---------- ConnectionHashRemove ------------------------------------[static]--
+//
+// Purpose:		Unlinks the entry from its bucket and puts it on the free list.
+//
+//------------------------------------------------------------------------------
+static void ConnectionHashRemove(ConnectionHash *hash, int32_t entryIndex)
+{
+	ConnectionEntry *entry = &hash->entries[entryIndex];
+
+	if(entry->previous != CONNECTION_NO_ENTRY)
+		hash->entries[entry->previous].next = entry->next;
+	else
+		hash->buckets[entry->bucket] = entry->next;
+
+	if(entry->next != CONNECTION_NO_ENTRY)
+		hash->entries[entry->next].previous = entry->previous;
+
+	entry->next     = hash->freeList;
+	hash->freeList  = entryIndex;
+
+	hash->entryCount -= 1;
+
+}//end ConnectionHashRemove
+
+
+//---------- ConnectionHashGrowBuckets -------------------------------[static]--
+//
+// Purpose:		Doubles the number of buckets and re-files every entry.
+//
+// Notes:		Entries keep their indexes, so the placements which refer to
+//				them stay valid.
+//
+//------------------------------------------------------------------------------
+static void ConnectionHashGrowBuckets(ConnectionHash *hash)
+{
+	ConnectionEntry *entry      = NULL;
+	int32_t         counter     = 0;
+	uint32_t        bucket      = 0;
+
+	hash->bucketCount   *= 2;
+	hash->buckets       = realloc(hash->buckets, sizeof(int32_t) * hash->bucketCount);
+
+	for(bucket = 0; bucket < hash->bucketCount; bucket++)
+		hash->buckets[bucket] = CONNECTION_NO_ENTRY;
+
+	// Free entries must not be filed. Mark them by walking the free list.
+	for(counter = hash->freeList; counter != CONNECTION_NO_ENTRY; counter = hash->entries[counter].next)
+		hash->entries[counter].bucket = UINT32_MAX;
+
+	for(counter = 0; counter < hash->entriesUsed; counter++)
+	{
+		entry = &hash->entries[counter];
+		if(entry->bucket == UINT32_MAX)
+			continue;
+
+		bucket          = BucketForPoint(entry->connection.position, hash->bucketCount);
+		entry->bucket   = bucket;
+		entry->previous = CONNECTION_NO_ENTRY;
+		entry->next     = hash->buckets[bucket];
+
+		if(entry->next != CONNECTION_NO_ENTRY)
+			hash->entries[entry->next].previous = counter;
+		hash->buckets[bucket] = counter;
+	}
+
+}//end ConnectionHashGrowBuckets
+
+
+//---------- ConnectionHashFindMate ----------------------------------[static]--
+//
+// Purpose:		Finds the nearest filed connection mating with connection and
+//				strictly less than distance from it. Copies it into mateOut and
+//				returns its distance, or returns -1 if there is none.
+//
+//------------------------------------------------------------------------------
+static float ConnectionHashFindMate(const ConnectionHash *hash, const LDrawConnection *connection, float distance, LDrawConnection *mateOut)
+{
+	const ConnectionEntry   *entry          = NULL;
+	Point3                  point           = connection->position;
+	int32_t                 minCell[3];
+	int32_t                 maxCell[3];
+	int32_t                 cellX           = 0;
+	int32_t                 cellY           = 0;
+	int32_t                 cellZ           = 0;
+	int32_t                 entryIndex      = 0;
+	float                   nearestSquared  = distance * distance;
+	float                   distanceSquared = 0;
+	float                   found           = -1;
+
+	minCell[0] = (int32_t)floorf((point.x - distance) / CONNECTION_CELL_SIZE);
+	minCell[1] = (int32_t)floorf((point.y - distance) / CONNECTION_CELL_SIZE);
+	minCell[2] = (int32_t)floorf((point.z - distance) / CONNECTION_CELL_SIZE);
+	maxCell[0] = (int32_t)floorf((point.x + distance) / CONNECTION_CELL_SIZE);
+	maxCell[1] = (int32_t)floorf((point.y + distance) / CONNECTION_CELL_SIZE);
+	maxCell[2] = (int32_t)floorf((point.z + distance) / CONNECTION_CELL_SIZE);
+
+	for(cellX = minCell[0]; cellX <= maxCell[0]; cellX++)
+	{
+		for(cellY = minCell[1]; cellY <= maxCell[1]; cellY++)
+		{
+			for(cellZ = minCell[2]; cellZ <= maxCell[2]; cellZ++)
+			{
+				entryIndex = hash->buckets[BucketForCell(cellX, cellY, cellZ, hash->bucketCount)];
+
+				for( ; entryIndex != CONNECTION_NO_ENTRY; entryIndex = entry->next)
+				{
+					entry           = &hash->entries[entryIndex];
+					distanceSquared = V3SquaredLength(V3Sub(entry->connection.position, point));
+
+					if(		distanceSquared < nearestSquared
+					   &&	LDrawConnectionsMate(&entry->connection, connection) )
+					{
+						nearestSquared  = distanceSquared;
+						*mateOut        = entry->connection;
+						found           = sqrtf(distanceSquared);
+					}
+				}
+			}
+		}
+	}
+
+	return found;
+
+}//end ConnectionHashFindMate
+
+
+//---------- BucketForCell -------------------------------------------[static]--
+//
+// Purpose:		Mixes the coordinates of a cell into a bucket number.
+//
+//------------------------------------------------------------------------------
+static uint32_t BucketForCell(int32_t cellX, int32_t cellY, int32_t cellZ, uint32_t bucketCount)
+{
+	uint32_t mixed = ((uint32_t)cellX * 73856093u) ^ ((uint32_t)cellY * 19349663u) ^ ((uint32_t)cellZ * 83492791u);
+
+	return mixed & (bucketCount - 1);
+
+}//end BucketForCell
+
+
+//---------- BucketForPoint ------------------------------------------[static]--
+//
+// Purpose:		Returns the bucket for the cell holding point.
+//
+//------------------------------------------------------------------------------
+static uint32_t BucketForPoint(Point3 point, uint32_t bucketCount)
+{
+	return BucketForCell((int32_t)floorf(point.x / CONNECTION_CELL_SIZE),
+						 (int32_t)floorf(point.y / CONNECTION_CELL_SIZE),
+						 (int32_t)floorf(point.z / CONNECTION_CELL_SIZE),
+						 bucketCount);
+
+}//end BucketForPoint
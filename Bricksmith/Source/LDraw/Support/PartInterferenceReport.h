@@ -0,0 +1,51 @@
+//==============================================================================
+//
+// File:		PartInterferenceReport.h
+//
+// Purpose:		Finds parts which have been placed twice in exactly the same
+//				spot, and parts whose surfaces pass through one another.
+//
+//				The report is kept up to date incrementally. It listens for
+//				LDrawDirectiveDidChangeNotification and remembers which parts
+//				and containers of the reported model changed; -update then
+//				re-examines only those parts, testing them against the others
+//				through a spatial index. Only the first update (or the first
+//				after -setLDrawContainer:) walks the whole model.
+//
+//==============================================================================
+#import <Foundation/Foundation.h>
+
+@class LDrawContainer;
+@class LDrawSpatialIndex;
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// class PartInterferenceReport
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface PartInterferenceReport : NSObject
+{
+	LDrawContainer		*reportedObject;
+	NSMapTable			*placements;			// LDrawPart -> PartPlacement
+	NSMutableDictionary	*placementGroups;		// placement key -> parts in that exact spot
+	LDrawSpatialIndex	*spatialIndex;			// LDrawPart -> bounds, slightly shrunk
+	NSMapTable			*overlaps;				// LDrawPart -> NSHashTable of the parts it passes through
+	NSHashTable			*changedDirectives;		// parts and containers changed since the last update
+	BOOL				needsFullUpdate;		// nothing recorded yet; walk the whole container
+	NSUInteger			nextModelOrder;			// order given to parts added after the first update
+}
+
+// Initialization
++ (PartInterferenceReport *) interferenceReportForContainer:(LDrawContainer *)container;
+
+// Collecting Information
+- (void) setLDrawContainer:(LDrawContainer *)newContainer;
+- (void) update;
+
+// Accessing Information
+- (NSArray *) duplicateParts;
+- (NSArray *) interferingPairs;
+- (NSArray *) interferingParts;
+
+@end
@@ -0,0 +1,905 @@
+//==============================================================================
+//
+// File:		PartInterferenceReport.m
+//
+// Purpose:		Finds duplicated and interfering parts. See
+//				PartInterferenceReport.h.
+//
+// Notes:		Duplicates are found by hashing: each part gets a key made of
+//				its name and its transformation matrix rounded to a fine grid,
+//				and parts sharing a key are in the same spot.
+//
+//				Interference is found in two passes. The spatial index supplies
+//				pairs of parts whose bounding boxes overlap (shrunk a hair, so
+//				that bricks merely sitting side by side don't count). Those
+//				candidates are then checked triangle against triangle. Each
+//				part's triangles are flattened into model coordinates the first
+//				time it is a candidate and kept until it moves.
+//
+//				Parts touching each other is normal; a stud fills its tube
+//				exactly. Triangles are therefore pulled in slightly toward their
+//				centers before testing, and faces lying in the same plane never
+//				count as crossing.
+//
+//				Coordinates are those of the reported container, so the report
+//				should be given a single model. Submodel references are treated
+//				as solid parts.
+//
+//==============================================================================
+#import "PartInterferenceReport.h"
+
+#import "ColorLibrary.h"
+#import "LDrawContainer.h"
+#import "LDrawPart.h"
+#import "LDrawPrimitiveSink.h"
+#import "LDrawSpatialIndex.h"
+#import "MatrixMath.h"
+
+// Grid to which placements are rounded when looking for duplicates. The
+// translation is in LDraw units; the rotation/scale terms are unitless.
+#define DUPLICATE_TRANSLATION_GRID	0.01
+#define DUPLICATE_ROTATION_GRID		0.001
+
+// Distance by which parts must pass into each other before they are reported,
+// in LDraw units.
+#define INTERFERENCE_TOLERANCE		0.1
+
+
+//------------------------------------------------------------------------------
+//
+// PartPlacement
+//
+// What was recorded about one part the last time the report was updated.
+//
+//------------------------------------------------------------------------------
+@interface PartPlacement : NSObject
+{
+@public
+	NSString	*placementKey;
+	Matrix4		transformation;
+	Box3		bounds;
+	NSUInteger	modelOrder;			// position of the part in the model when first seen
+	Point3		*triangles;			// 3 vertexes per triangle; NULL until needed
+	NSUInteger	triangleCount;
+	NSUInteger	triangleCapacity;
+}
+@end
+
+
+@implementation PartPlacement
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Placement forgotten.
+//
+//==============================================================================
+- (void) dealloc
+{
+	[placementKey release];
+	free(triangles);
+
+	[super dealloc];
+
+}//end dealloc
+
+@end
+
+
+@interface PartInterferenceReport (Private)
+
+- (void) updateAllParts;
+- (void) updateChangedParts;
+- (BOOL) refreshPart:(LDrawPart *)part;
+- (void) directiveDidChange:(NSNotification *)notification;
+- (void) removePart:(LDrawPart *)part;
+- (void) recordPart:(LDrawPart *)part placement:(PartPlacement *)placement;
+- (void) findOverlapsForPart:(LDrawPart *)part;
+- (BOOL) part:(LDrawPart *)part1 interferesWithPart:(LDrawPart *)part2;
+- (PartPlacement *) trianglesForPart:(LDrawPart *)part;
+
+@end
+
+static NSString *PlacementKey(LDrawPart *part, Matrix4 transformation);
+static void CollectTriangles(const LDrawPrimitive *primitive, void *context);
+static void AddTriangle(PartPlacement *placement, Point3 vertex0, Point3 vertex1, Point3 vertex2);
+static Point3 PullTowardCenter(Point3 vertex, Point3 center);
+static BOOL IsEnclosedBy(LDrawDirective *directive, LDrawContainer *container);
+
+
+@implementation PartInterferenceReport
+
+#pragma mark -
+#pragma mark INITIALIZATION
+#pragma mark -
+
+//---------- interferenceReportForContainer: -------------------------[static]--
+//
+// Purpose:		Returns an empty report on container. Call -update to fill it.
+//
+//------------------------------------------------------------------------------
++ (PartInterferenceReport *) interferenceReportForContainer:(LDrawContainer *)container
+{
+	PartInterferenceReport *report = [PartInterferenceReport new];
+
+	[report setLDrawContainer:container];
+
+	return [report autorelease];
+
+}//end interferenceReportForContainer:
+
+
+//========== init ==============================================================
+//
+// Purpose:		Creates an empty report.
+//
+//==============================================================================
+- (id) init
+{
+	self = [super init];
+	if(self)
+	{
+		placements      = [[NSMapTable alloc] initWithKeyOptions:(NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality)
+												valueOptions:NSPointerFunctionsStrongMemory
+													capacity:0];
+		overlaps        = [[NSMapTable alloc] initWithKeyOptions:(NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality)
+												valueOptions:NSPointerFunctionsStrongMemory
+													capacity:0];
+		placementGroups = [[NSMutableDictionary alloc] init];
+		spatialIndex    = [[LDrawSpatialIndex alloc] init];
+		changedDirectives = [[NSHashTable alloc] initWithOptions:(NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality)
+														capacity:0];
+		needsFullUpdate = YES;
+
+		[[NSNotificationCenter defaultCenter] addObserver:self
+												 selector:@selector(directiveDidChange:)
+													 name:LDrawDirectiveDidChangeNotification
+												   object:nil ];
+	}
+	return self;
+
+}//end init
+
+
+#pragma mark -
+#pragma mark COLLECTING INFORMATION
+#pragma mark -
+
+//========== setLDrawContainer: ================================================
+//
+// Purpose:		Sets the object on which we will report. Everything recorded
+//				about the previous one is thrown away.
+//
+//==============================================================================
+- (void) setLDrawContainer:(LDrawContainer *)newContainer
+{
+	if(newContainer != self->reportedObject)
+	{
+		[newContainer			retain];
+		[self->reportedObject	release];
+
+		self->reportedObject = newContainer;
+
+		[self->placements		removeAllObjects];
+		[self->overlaps			removeAllObjects];
+		[self->placementGroups	removeAllObjects];
+		[self->spatialIndex		removeAllObjects];
+		[self->changedDirectives removeAllObjects];
+
+		self->needsFullUpdate = YES;
+	}
+
+}//end setLDrawContainer:
+
+
+//========== update ============================================================
+//
+// Purpose:		Brings the report up to date with the container.
+//
+// Notes:		A part is re-examined only if it is new or its name, transform
+//				or bounds changed since the last update. Whether two parts
+//				interfere depends on nothing but those two parts, so the
+//				overlaps recorded between unchanged parts still stand.
+//
+//==============================================================================
+- (void) update
+{
+	if(self->needsFullUpdate == YES)
+		[self updateAllParts];
+	else
+		[self updateChangedParts];
+
+	[self->changedDirectives removeAllObjects];
+	self->needsFullUpdate = NO;
+
+}//end update
+
+
+//========== updateAllParts ====================================================
+//
+// Purpose:		Walks the whole container, recording every part. Anything we
+//				had recorded that is no longer there is dropped.
+//
+//==============================================================================
+- (void) updateAllParts
+{
+	NSArray         *elements       = [self->reportedObject allEnclosedElements];
+	NSMapTable      *currentParts   = [NSMapTable mapTableWithStrongToStrongObjects];
+	NSMutableArray  *changedParts   = [NSMutableArray array];
+	NSMutableArray  *removedParts   = [NSMutableArray array];
+	LDrawPart       *part           = nil;
+	id              currentElement  = nil;
+	NSUInteger      modelOrder      = 0;
+
+	// Find out what changed.
+	for(currentElement in elements)
+	{
+		if(		[currentElement isKindOfClass:[LDrawPart class]] == NO
+		   ||	[currentElement isHidden] == YES )
+			continue;
+
+		part = currentElement;
+		NSMapInsert(currentParts, part, part);
+
+		if([self refreshPart:part] == YES)
+			[changedParts addObject:part];
+
+		((PartPlacement *)NSMapGet(self->placements, part))->modelOrder = modelOrder;
+		modelOrder++;
+	}
+	self->nextModelOrder = modelOrder;
+
+	for(part in self->placements)
+	{
+		if(NSMapGet(currentParts, part) == nil)
+			[removedParts addObject:part];
+	}
+	for(part in removedParts)
+	{
+		[self removePart:part];
+	}
+
+	// Re-test only what moved. The index must hold every changed part before
+	// any of them is tested.
+	for(part in changedParts)
+	{
+		[self findOverlapsForPart:part];
+	}
+
+}//end updateAllParts
+
+
+//========== updateChangedParts ================================================
+//
+// Purpose:		Re-examines only the parts noted by -directiveDidChange: since
+//				the last update, plus everything inside the containers noted.
+//
+// Notes:		A part taken out of a container doesn't post anything itself;
+//				its old container does. So when any container changed, we check
+//				that each part recorded is still inside the reported object.
+//				That is a few pointer hops per part, with no geometry.
+//
+//==============================================================================
+- (void) updateChangedParts
+{
+	NSMutableArray  *candidates     = [NSMutableArray array];
+	NSMutableArray  *changedParts   = [NSMutableArray array];
+	NSMutableArray  *removedParts   = [NSMutableArray array];
+	LDrawPart       *part           = nil;
+	id              directive       = nil;
+	id              currentElement  = nil;
+	BOOL            containerChanged = NO;
+
+	for(directive in self->changedDirectives)
+	{
+		if([directive isKindOfClass:[LDrawPart class]])
+		{
+			[candidates addObject:directive];
+		}
+		else
+		{
+			containerChanged = YES;
+			for(currentElement in [(LDrawContainer *)directive allEnclosedElements])
+			{
+				if([currentElement isKindOfClass:[LDrawPart class]])
+					[candidates addObject:currentElement];
+			}
+		}
+	}
+
+	if(containerChanged == YES)
+	{
+		for(part in self->placements)
+		{
+			if(IsEnclosedBy(part, self->reportedObject) == NO)
+				[removedParts addObject:part];
+		}
+	}
+
+	for(part in candidates)
+	{
+		if(		[part isHidden] == YES
+		   ||	IsEnclosedBy(part, self->reportedObject) == NO )
+		{
+			[removedParts addObject:part];
+		}
+		else if([self refreshPart:part] == YES)
+		{
+			[changedParts addObject:part];
+		}
+	}
+
+	for(part in removedParts)
+	{
+		[self removePart:part];
+	}
+
+	for(part in changedParts)
+	{
+		// A part both moved and then removed is already gone.
+		if(NSMapGet(self->placements, part) != nil)
+			[self findOverlapsForPart:part];
+	}
+
+}//end updateChangedParts
+
+
+//========== refreshPart: ======================================================
+//
+// Purpose:		Records part afresh if it is new or changed since it was last
+//				recorded. Returns YES if it was; its overlaps must then be found
+//				again.
+//
+//==============================================================================
+- (BOOL) refreshPart:(LDrawPart *)part
+{
+	PartPlacement   *placement      = NSMapGet(self->placements, part);
+	Matrix4         transformation  = [part transformationMatrix];
+	Box3            bounds          = [part boundingBox3];
+	NSString        *placementKey   = PlacementKey(part, transformation);
+	NSUInteger      modelOrder      = 0;
+
+	if(		placement != nil
+	   &&	memcmp(&placement->transformation, &transformation, sizeof(Matrix4)) == 0
+	   &&	V3EqualBoxes(placement->bounds, bounds) == YES
+	   &&	[placement->placementKey isEqualToString:placementKey] == YES )
+	{
+		return NO;
+	}
+
+	// A moved part keeps its place in line; a new one goes to the back.
+	if(placement != nil)
+		modelOrder = placement->modelOrder;
+	else
+		modelOrder = self->nextModelOrder++;
+
+	[self removePart:part];
+
+	placement = [[PartPlacement alloc] init];
+	placement->placementKey     = [placementKey retain];
+	placement->transformation   = transformation;
+	placement->bounds           = bounds;
+	placement->modelOrder       = modelOrder;
+
+	[self recordPart:part placement:placement];
+
+	[placement release];
+
+	return YES;
+
+}//end refreshPart:
+
+
+#pragma mark -
+#pragma mark NOTIFICATIONS
+#pragma mark -
+
+//========== directiveDidChange: ===============================================
+//
+// Purpose:		Something posted LDrawDirectiveDidChangeNotification. If it is a
+//				part or container inside the reported object, remember it for
+//				the next update.
+//
+// Notes:		The document also posts for the whole file after most edits, as
+//				a redraw request. Those carry no news for us: the container
+//				which really changed posted too.
+//
+//==============================================================================
+- (void) directiveDidChange:(NSNotification *)notification
+{
+	id  directive   = [notification object];
+
+	if(		self->needsFullUpdate == YES
+	   ||	self->reportedObject == nil )
+		return;
+
+	if(		[directive isKindOfClass:[LDrawPart class]] == NO
+	   &&	[directive isKindOfClass:[LDrawContainer class]] == NO )
+		return;
+
+	if(		directive == self->reportedObject
+	   ||	IsEnclosedBy(directive, self->reportedObject) == YES )
+	{
+		[self->changedDirectives addObject:directive];
+	}
+
+}//end directiveDidChange:
+
+
+#pragma mark -
+#pragma mark ACCESSING INFORMATION
+#pragma mark -
+
+//========== duplicateParts ====================================================
+//
+// Purpose:		Returns the parts which sit in exactly the same place as another
+//				part of the same kind.
+//
+// Notes:		For each group of duplicates, the part appearing first in the
+//				model is considered the original and is left out. Parts added
+//				since the first update count as coming after everything else.
+//
+//==============================================================================
+- (NSArray *) duplicateParts
+{
+	NSMutableArray  *duplicates     = [NSMutableArray array];
+	NSArray         *group          = nil;
+	LDrawPart       *original       = nil;
+	LDrawPart       *part           = nil;
+	PartPlacement   *placement      = nil;
+	NSUInteger      firstOrder      = 0;
+
+	for(group in [self->placementGroups objectEnumerator])
+	{
+		if([group count] < 2)
+			continue;
+
+		original    = nil;
+		firstOrder  = NSNotFound;
+		for(part in group)
+		{
+			placement = NSMapGet(self->placements, part);
+			if(placement->modelOrder < firstOrder)
+			{
+				firstOrder  = placement->modelOrder;
+				original    = part;
+			}
+		}
+
+		for(part in group)
+		{
+			if(part != original)
+				[duplicates addObject:part];
+		}
+	}
+
+	return duplicates;
+
+}//end duplicateParts
+
+
+//========== interferingPairs ==================================================
+//
+// Purpose:		Returns every pair of parts which pass through each other, as
+//				two-element arrays.
+//
+//==============================================================================
+- (NSArray *) interferingPairs
+{
+	NSMutableArray  *pairs          = [NSMutableArray array];
+	NSHashTable     *partOverlaps   = nil;
+	LDrawPart       *part           = nil;
+	LDrawPart       *otherPart      = nil;
+
+	for(part in self->overlaps)
+	{
+		partOverlaps = NSMapGet(self->overlaps, part);
+
+		for(otherPart in partOverlaps)
+		{
+			// Each pair is recorded under both parts; report it once.
+			if(part < otherPart)
+				[pairs addObject:[NSArray arrayWithObjects:part, otherPart, nil]];
+		}
+	}
+
+	return pairs;
+
+}//end interferingPairs
+
+
+//========== interferingParts ==================================================
+//
+// Purpose:		Returns every part which passes through at least one other part.
+//
+//==============================================================================
+- (NSArray *) interferingParts
+{
+	NSMutableArray  *parts  = [NSMutableArray array];
+	LDrawPart       *part   = nil;
+
+	for(part in self->overlaps)
+	{
+		if([NSMapGet(self->overlaps, part) count] > 0)
+			[parts addObject:part];
+	}
+
+	return parts;
+
+}//end interferingParts
+
+
+#pragma mark -
+#pragma mark UTILITIES
+#pragma mark -
+
+//========== removePart: =======================================================
+//
+// Purpose:		Forgets everything recorded about part, including its overlaps
+//				with other parts.
+//
+//==============================================================================
+- (void) removePart:(LDrawPart *)part
+{
+	PartPlacement   *placement      = NSMapGet(self->placements, part);
+	NSMutableArray  *group          = nil;
+	NSHashTable     *partOverlaps   = NSMapGet(self->overlaps, part);
+	LDrawPart       *otherPart      = nil;
+
+	if(placement != nil)
+	{
+		group = [self->placementGroups objectForKey:placement->placementKey];
+		[group removeObjectIdenticalTo:part];
+		if([group count] == 0)
+			[self->placementGroups removeObjectForKey:placement->placementKey];
+	}
+
+	for(otherPart in partOverlaps)
+	{
+		[NSMapGet(self->overlaps, otherPart) removeObject:part];
+	}
+
+	[self->spatialIndex removeObject:part];
+	NSMapRemove(self->overlaps, part);
+	NSMapRemove(self->placements, part);
+
+}//end removePart:
+
+
+//========== recordPart:placement: =============================================
+//
+// Purpose:		Files a new or moved part under its placement key and in the
+//				spatial index.
+//
+//==============================================================================
+- (void) recordPart:(LDrawPart *)part placement:(PartPlacement *)placement
+{
+	NSMutableArray  *group          = [self->placementGroups objectForKey:placement->placementKey];
+	Box3            indexBounds     = placement->bounds;
+	Vector3         tolerance       = V3Make(INTERFERENCE_TOLERANCE, INTERFERENCE_TOLERANCE, INTERFERENCE_TOLERANCE);
+	NSHashTable     *partOverlaps   = nil;
+
+	NSMapInsert(self->placements, part, placement);
+
+	if(group == nil)
+	{
+		group = [NSMutableArray array];
+		[self->placementGroups setObject:group forKey:placement->placementKey];
+	}
+	[group addObject:part];
+
+	// Boxes which only touch are of no interest.
+	if(V3EqualBoxes(indexBounds, InvalidBox) == NO)
+	{
+		indexBounds.min = V3Add(indexBounds.min, tolerance);
+		indexBounds.max = V3Sub(indexBounds.max, tolerance);
+
+		if(		indexBounds.min.x <= indexBounds.max.x
+		   &&	indexBounds.min.y <= indexBounds.max.y
+		   &&	indexBounds.min.z <= indexBounds.max.z )
+		{
+			[self->spatialIndex setBounds:indexBounds forObject:part];
+		}
+	}
+
+	partOverlaps = [[NSHashTable alloc] initWithOptions:(NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality)
+											   capacity:0];
+	NSMapInsert(self->overlaps, part, partOverlaps);
+	[partOverlaps release];
+
+}//end recordPart:placement:
+
+
+//========== findOverlapsForPart: ==============================================
+//
+// Purpose:		Tests part against each part whose box overlaps its own, and
+//				records those it passes through.
+//
+// Notes:		Exact duplicates are left to -duplicateParts; they would
+//				otherwise be reported twice over.
+//
+//==============================================================================
+- (void) findOverlapsForPart:(LDrawPart *)part
+{
+	NSArray         *candidates     = [self->spatialIndex objectsIntersectingObject:part];
+	PartPlacement   *placement      = NSMapGet(self->placements, part);
+	PartPlacement   *otherPlacement = nil;
+	LDrawPart       *otherPart      = nil;
+
+	for(otherPart in candidates)
+	{
+		// Already found from the other side during this update.
+		if([NSMapGet(self->overlaps, part) containsObject:otherPart])
+			continue;
+
+		otherPlacement = NSMapGet(self->placements, otherPart);
+		if([placement->placementKey isEqualToString:otherPlacement->placementKey])
+			continue;
+
+		if([self part:part interferesWithPart:otherPart])
+		{
+			[NSMapGet(self->overlaps, part)			addObject:otherPart];
+			[NSMapGet(self->overlaps, otherPart)	addObject:part];
+		}
+	}
+
+}//end findOverlapsForPart:
+
+
+//========== part:interferesWithPart: ==========================================
+//
+// Purpose:		Returns YES if any triangle of part1 crosses a triangle of
+//				part2.
+//
+// Notes:		Only triangles of one part lying within the other's bounding box
+//				can possibly cross it, which usually rules out nearly all of
+//				them.
+//
+//==============================================================================
+- (BOOL) part:(LDrawPart *)part1 interferesWithPart:(LDrawPart *)part2
+{
+	PartPlacement   *placement1     = [self trianglesForPart:part1];
+	PartPlacement   *placement2     = [self trianglesForPart:part2];
+	Box3            overlapBounds   = InvalidBox;
+	Box3            triangleBounds  = InvalidBox;
+	NSUInteger      *nearTriangles  = NULL;
+	NSUInteger      nearCount       = 0;
+	Point3          *triangle1      = NULL;
+	Point3          *triangle2      = NULL;
+	NSUInteger      counter         = 0;
+	NSUInteger      counter2        = 0;
+	BOOL            interferes      = NO;
+
+	overlapBounds.min = V3Make(MAX(placement1->bounds.min.x, placement2->bounds.min.x),
+							   MAX(placement1->bounds.min.y, placement2->bounds.min.y),
+							   MAX(placement1->bounds.min.z, placement2->bounds.min.z));
+	overlapBounds.max = V3Make(MIN(placement1->bounds.max.x, placement2->bounds.max.x),
+							   MIN(placement1->bounds.max.y, placement2->bounds.max.y),
+							   MIN(placement1->bounds.max.z, placement2->bounds.max.z));
+
+	// Gather part2's triangles near the overlap once, rather than for each
+	// triangle of part1.
+	nearTriangles = malloc(sizeof(NSUInteger) * MAX(placement2->triangleCount, 1));
+	for(counter = 0; counter < placement2->triangleCount; counter++)
+	{
+		triangle2       = placement2->triangles + counter * 3;
+		triangleBounds  = V3BoundsFromPoints(triangle2[0], triangle2[1]);
+		triangleBounds  = V3UnionBoxAndPoint(triangleBounds, triangle2[2]);
+
+		if(V3BoxesIntersect(triangleBounds, overlapBounds))
+		{
+			nearTriangles[nearCount] = counter;
+			nearCount++;
+		}
+	}
+
+	for(counter = 0; counter < placement1->triangleCount && nearCount > 0 && interferes == NO; counter++)
+	{
+		triangle1       = placement1->triangles + counter * 3;
+		triangleBounds  = V3BoundsFromPoints(triangle1[0], triangle1[1]);
+		triangleBounds  = V3UnionBoxAndPoint(triangleBounds, triangle1[2]);
+
+		if(V3BoxesIntersect(triangleBounds, overlapBounds) == NO)
+			continue;
+
+		for(counter2 = 0; counter2 < nearCount && interferes == NO; counter2++)
+		{
+			triangle2 = placement2->triangles + nearTriangles[counter2] * 3;
+
+			interferes = V3TrianglesIntersect(triangle1[0], triangle1[1], triangle1[2],
+											  triangle2[0], triangle2[1], triangle2[2]);
+		}
+	}
+
+	free(nearTriangles);
+
+	return interferes;
+
+}//end part:interferesWithPart:
+
+
+//========== trianglesForPart: =================================================
+//
+// Purpose:		Returns the placement of part, with its triangles flattened into
+//				model coordinates.
+//
+// Notes:		Lines carry no volume and are skipped; quadrilaterals are split
+//				in two.
+//
+//==============================================================================
+- (PartPlacement *) trianglesForPart:(LDrawPart *)part
+{
+	PartPlacement       *placement  = NSMapGet(self->placements, part);
+	LDrawPrimitiveSink  sink;
+	LDrawColor          *color      = nil;
+
+	if(placement->triangles == NULL)
+	{
+		placement->triangleCapacity = 64;
+		placement->triangles        = malloc(sizeof(Point3) * 3 * placement->triangleCapacity);
+
+		sink    = LDrawPrimitiveSinkMake(CollectTriangles, placement);
+		color   = [[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor];
+
+		[part flattenIntoSink:&sink currentColor:color currentTransform:IdentityMatrix4];
+	}
+
+	return placement;
+
+}//end trianglesForPart:
+
+
+#pragma mark -
+#pragma mark DESTRUCTOR
+#pragma mark -
+
+//========== dealloc ===========================================================
+//
+// Purpose:		The end.
+//
+//==============================================================================
+- (void) dealloc
+{
+	[[NSNotificationCenter defaultCenter] removeObserver:self];
+
+	[reportedObject		release];
+	[placements			release];
+	[placementGroups	release];
+	[spatialIndex		release];
+	[overlaps			release];
+	[changedDirectives	release];
+
+	[super dealloc];
+
+}//end dealloc
+
+
+@end
+
+
+#pragma mark -
+
+//---------- PlacementKey --------------------------------------------[static]--
+//
+// Purpose:		Returns a string which is the same for two parts exactly when
+//				they are the same kind of part in the same place.
+//
+// Notes:		Rounding to a grid means two values straddling a grid line can
+//				still come out different. Real duplicates are nearly always
+//				copies with bit-identical matrices, so this is not a concern.
+//
+//------------------------------------------------------------------------------
+static NSString *PlacementKey(LDrawPart *part, Matrix4 transformation)
+{
+	NSMutableString *key    = [NSMutableString stringWithString:[[part referenceName] lowercaseString]];
+	double          grid    = 0;
+	int             row     = 0;
+	int             column  = 0;
+
+	for(row = 0; row < 4; row++)
+	{
+		grid = (row == 3) ? DUPLICATE_TRANSLATION_GRID : DUPLICATE_ROTATION_GRID;
+
+		for(column = 0; column < 3; column++)
+		{
+			[key appendFormat:@" %ld", lround(transformation.element[row][column] / grid)];
+		}
+	}
+
+	return key;
+
+}//end PlacementKey
+
+
+//---------- CollectTriangles ----------------------------------------[static]--
+//
+// Purpose:		Primitive sink function which adds the triangles of a part to
+//				its placement.
+//
+//------------------------------------------------------------------------------
+static void CollectTriangles(const LDrawPrimitive *primitive, void *context)
+{
+	PartPlacement   *placement  = context;
+	const Point3    *vertexes   = primitive->vertexes;
+
+	switch(primitive->type)
+	{
+		case LDrawPrimitiveTriangle:
+			AddTriangle(placement, vertexes[0], vertexes[1], vertexes[2]);
+			break;
+
+		case LDrawPrimitiveQuadrilateral:
+			AddTriangle(placement, vertexes[0], vertexes[1], vertexes[2]);
+			AddTriangle(placement, vertexes[2], vertexes[3], vertexes[0]);
+			break;
+
+		default:
+			break;
+	}
+
+}//end CollectTriangles
+
+
+//---------- AddTriangle ---------------------------------------------[static]--
+//
+// Purpose:		Appends a triangle, pulled in toward its center so that it no
+//				longer reaches the faces of parts it merely touches.
+//
+//------------------------------------------------------------------------------
+static void AddTriangle(PartPlacement *placement, Point3 vertex0, Point3 vertex1, Point3 vertex2)
+{
+	Point3      *triangle   = NULL;
+	Point3      center      = V3Make((vertex0.x + vertex1.x + vertex2.x) / 3,
+									 (vertex0.y + vertex1.y + vertex2.y) / 3,
+									 (vertex0.z + vertex1.z + vertex2.z) / 3);
+
+	if(placement->triangleCount == placement->triangleCapacity)
+	{
+		placement->triangleCapacity *= 2;
+		placement->triangles        = realloc(placement->triangles, sizeof(Point3) * 3 * placement->triangleCapacity);
+	}
+
+	triangle    = placement->triangles + placement->triangleCount * 3;
+	triangle[0] = PullTowardCenter(vertex0, center);
+	triangle[1] = PullTowardCenter(vertex1, center);
+	triangle[2] = PullTowardCenter(vertex2, center);
+
+	placement->triangleCount += 1;
+
+}//end AddTriangle
+
+
+//---------- PullTowardCenter ----------------------------------------[static]--
+//
+// Purpose:		Moves vertex INTERFERENCE_TOLERANCE closer to center, or onto
+//				it if it is closer than that already.
+//
+//------------------------------------------------------------------------------
+static Point3 PullTowardCenter(Point3 vertex, Point3 center)
+{
+	Vector3 inward  = V3Sub(center, vertex);
+	float   length  = V3Length(inward);
+
+	// Also catches a vertex sitting on the center, which has no direction.
+	if(length <= INTERFERENCE_TOLERANCE)
+		return center;
+	else
+		return V3Add(vertex, V3Scale(inward, INTERFERENCE_TOLERANCE / length));
+
+}//end PullTowardCenter
+
+
+//---------- IsEnclosedBy --------------------------------------------[static]--
+//
+// Purpose:		Returns YES if container is somewhere above directive.
+//
+//------------------------------------------------------------------------------
+static BOOL IsEnclosedBy(LDrawDirective *directive, LDrawContainer *container)
+{
+	LDrawContainer  *ancestor   = [directive enclosingDirective];
+
+	while(ancestor != nil && ancestor != container)
+		ancestor = [ancestor enclosingDirective];
+
+	return (ancestor != nil);
+
+}//end IsEnclosedBy
@@ -96,6 +96,9 @@ extern NSString	*Category_Subparts;
 - (LDrawDirective *) optimizedDrawableForPart:(LDrawPart *) part color:(LDrawColor *)color;
 - (GLuint) textureTagForTexture:(LDrawTexture*)texture;
 
+// Memory
+- (NSDictionary *) displayListByteSizesByPart;
+
 // Utilites
 - (void) addPartsInFolder:(NSString *)folderPath
 				toCatalog:(NSMutableDictionary *)catalog
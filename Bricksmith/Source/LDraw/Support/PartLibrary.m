@@ -18,12 +18,14 @@
 #import "MacLDraw.h"
 #import "LDrawFile.h"
 #import "LDrawKeywords.h"
+#import "LDrawMemory.h"
 #import "LDrawModel.h"
 #import "LDrawPart.h"
 #import "LDrawPathNames.h"
 #import "LDrawPaths.h"
 #import "LDrawStep.h"
 #import "LDrawTexture.h"
+#import "LDrawTrace.h"
 #import "LDrawUtilities.h"
 #import "LDrawVertexes.h"
 #import "StringCategory.h"
@@ -1032,8 +1034,6 @@ static PartLibrary *SharedPartLibrary = nil;
 //				This method can only find parts in the LDraw folder; it returns 
 //				nil if fed an MPD submodel name.
 //
-//				NOT THREAD SAFE!
-//
 // Notes:		The part is looked up by the name specified in the part command. 
 //				For regular parts and primitives, this is simply the filename 
 //				as found in LDraw/parts or LDraw/p. But for subparts found in 
@@ -1041,15 +1041,19 @@ static PartLibrary *SharedPartLibrary = nil;
 //				LDraw/p/48.) This icky inconsistency is handled in 
 //				-pathForFileName:.
 //
+//				The library is read and written through the catalog queue, 
+//				since files being parsed on other threads may be adding parts 
+//				to it at the same time. Two threads may both read a missing 
+//				part; the first one registered wins. 
+//
 //==============================================================================
 - (LDrawModel *) modelForName:(NSString *) imageName
 {
-	LDrawModel	*model		= nil;
-	NSString	*partPath	= nil;
+	__block LDrawModel	*model		= nil;
+	NSString			*partPath	= nil;
 	
 	// Has it already been parsed?
-	model = [self->loadedFiles objectForKey:imageName];
-
+	model = [self modelForName_threadSafe:imageName];
 
 	if(model == nil)
 	{
@@ -1060,7 +1064,20 @@ static PartLibrary *SharedPartLibrary = nil;
 		model		= [self readModelAtPath:partPath asynchronously:NO completionHandler:NULL];
 		
 		if(model != nil)
-			[self->loadedFiles setObject:model forKey:imageName];
+		{
+#if USE_BLOCKS
+			dispatch_sync(self->catalogAccessQueue, ^{
+#endif
+				LDrawModel	*registered	= [self->loadedFiles objectForKey:imageName];
+				
+				if(registered != nil)
+					model = registered;
+				else
+					[self->loadedFiles setObject:model forKey:imageName];
+#if USE_BLOCKS
+			});
+#endif
+		}
 	}
 
 	return model;
@@ -1290,6 +1307,10 @@ static PartLibrary *SharedPartLibrary = nil;
 
 			glBindTexture(GL_TEXTURE_2D, 0);
 			
+			// Textures are kept for good, so this is never given back. The 
+			// mipmaps add a third again. 
+			MEMORY_ALLOC(LDrawMemoryTextures, canvasRect.size.width * canvasRect.size.height * 4 * 4 / 3);
+			
 			[self->optimizedTextures setObject:[NSNumber numberWithUnsignedInt:textureTag] forKey:name];
 			
 			// free memory
@@ -1303,6 +1324,41 @@ static PartLibrary *SharedPartLibrary = nil;
 }
 
 
+#pragma mark -
+#pragma mark MEMORY
+#pragma mark -
+
+//========== displayListByteSizesByPart ========================================
+//
+// Purpose:		Returns the bytes held by the cached mesh of each loaded part, 
+//				keyed by part name. Parts without a mesh are left out. 
+//
+//==============================================================================
+- (NSDictionary *) displayListByteSizesByPart
+{
+	NSMutableDictionary *byteSizes  = [NSMutableDictionary dictionary];
+	
+#if USE_BLOCKS
+	dispatch_sync(self->catalogAccessQueue, ^{
+#endif
+		NSString    *partName   = nil;
+		NSUInteger  byteSize    = 0;
+		
+		for(partName in self->loadedFiles)
+		{
+			byteSize = [[self->loadedFiles objectForKey:partName] displayListByteSize];
+			if(byteSize > 0)
+				[byteSizes setObject:[NSNumber numberWithUnsignedInteger:byteSize] forKey:partName];
+		}
+#if USE_BLOCKS
+	});
+#endif
+	
+	return byteSizes;
+	
+}//end displayListByteSizesByPart
+
+
 #pragma mark -
 #pragma mark UTILITIES
 #pragma mark -
@@ -1745,6 +1801,7 @@ static PartLibrary *SharedPartLibrary = nil;
 	NSArray             *lines          = nil;
 	LDrawFile           *parsedFile     = nil;
 	dispatch_group_t    group           = NULL;
+	BOOL                isTopLevelPart  = NO;
 #if USE_BLOCKS
 	__block
 #endif
@@ -1758,12 +1815,15 @@ static PartLibrary *SharedPartLibrary = nil;
 	{
 		// We found it in the LDraw folder; now all we need to do is get the 
 		// model for it. 
+		TRACE_BEGIN("parse part");
+		isTopLevelPart  = [[LDrawPaths sharedPaths] isTopLevelPartPath:[partPath stringByStandardizingPath]];
 		fileContents    = [LDrawUtilities stringFromFile:partPath];
 		lines           = [fileContents separateByLine];
 		
 		parsedFile      = [[LDrawFile alloc] initWithLines:lines
 												   inRange:NSMakeRange(0, [lines count])
 											   parentGroup:group];
+		TRACE_END("parse part");
 	}
 	
 #if USE_BLOCKS
@@ -1771,7 +1831,9 @@ static PartLibrary *SharedPartLibrary = nil;
 	{
 		dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
 #endif
+		TRACE_BEGIN("flatten part");
 		[parsedFile optimizeStructure];
+		TRACE_END("flatten part");
 		model = [[[[parsedFile submodels] objectAtIndex:0] retain] autorelease];
 		// We are "leaking" the enclosing file, but returning an internal model 
 		// without disconnecting it from its file is pretty dodgy and it would 
@@ -1785,9 +1847,22 @@ static PartLibrary *SharedPartLibrary = nil;
 	{
 		dispatch_group_notify(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
 							  ^{
+								  TRACE_BEGIN("flatten part");
 								  [parsedFile optimizeStructure];
+								  TRACE_END("flatten part");
 								  model = [[[[parsedFile submodels] objectAtIndex:0] retain] autorelease];
 								  
+#if PREPARE_LIBRARY_MESHES
+								  // Nobody can draw the model until the completion 
+								  // block registers it, so this is the one safe 
+								  // moment to build its mesh off the main thread. 
+								  // Subparts and primitives are flattened into the 
+								  // parts using them and never drawn on their own, 
+								  // so only real parts are worth the trouble. 
+								  if(isTopLevelPart == YES)
+									  [model prepareDisplayList];
+#endif
+								  
 								  if(completionBlock)
 									  completionBlock(model);
 								  
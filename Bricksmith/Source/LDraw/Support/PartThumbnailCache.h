@@ -0,0 +1,76 @@
+//==============================================================================
+//
+// File:		PartThumbnailCache.h
+//
+// Purpose:		Supplies small preview pictures of library parts, for showing
+//				many parts at once in the part browser.
+//
+//				Drawing thousands of parts through OpenGL just to fill a table
+//				would stall the interface, so thumbnails are drawn in the
+//				background by a simple software renderer: the part's flattened
+//				triangles, flat-shaded, in the standard 3D view. Each picture
+//				is saved to disk, so a part is only ever drawn once.
+//
+//				Pictures on disk are named by a hash of the part file's
+//				contents; an edited part file gets a new picture. Rebuilding
+//				the part catalog throws them all away, which also catches
+//				changes to subparts and primitives a part uses.
+//
+// Usage:		Ask for -thumbnailForPartName: whenever a picture is wanted. If
+//				it isn't ready, you get NULL and the picture is made in the
+//				background; LDrawPartThumbnailDidLoadNotification announces
+//				when to ask again.
+//
+//				-copyThumbnailForPartName: does the whole job on the calling
+//				thread, for batch work.
+//
+//==============================================================================
+#import <Foundation/Foundation.h>
+#import <ApplicationServices/ApplicationServices.h>
+
+// A thumbnail requested from -thumbnailForPartName: is now available (or has
+// failed). Object is the cache; userInfo has PART_NUMBER_KEY -> part name. A
+// nil userInfo means all thumbnails were thrown away; ask again for any shown.
+extern NSString *LDrawPartThumbnailDidLoadNotification;
+
+// Edge length of a thumbnail, in pixels.
+#define PART_THUMBNAIL_PIXEL_SIZE		64
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// class PartThumbnailCache
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface PartThumbnailCache : NSObject
+{
+	NSString			*cacheFolderPath;
+	NSCache				*thumbnails;			// part name -> CGImageRef, or NSNull if it can't be drawn (main thread only)
+	NSMutableSet		*requestedNames;		// asked for, not yet delivered (main thread only)
+	NSMutableArray		*requestStack;			// names waiting for the work queue, newest last (locked)
+	dispatch_queue_t	workQueue;
+	NSUInteger			generation;				// incremented when the cache is emptied (locked)
+
+	// Statistics (locked)
+	NSUInteger			generatedCount;
+	CFTimeInterval		generationTime;
+	NSUInteger			cacheHitCount;
+	CFTimeInterval		cacheHitTime;
+}
+
+// Initialization
++ (PartThumbnailCache *) sharedThumbnailCache;
+- (id) initWithCacheFolderPath:(NSString *)pathIn;
+
+// Thumbnails
+- (CGImageRef) thumbnailForPartName:(NSString *)partName;
+- (CGImageRef) copyThumbnailForPartName:(NSString *)partName;
+- (void) removeAllThumbnails;
+
+// Statistics
+- (NSUInteger) cacheHitCount;
+- (CFTimeInterval) cacheHitTime;
+- (NSUInteger) generatedCount;
+- (CFTimeInterval) generationTime;
+
+@end
@@ -0,0 +1,816 @@
+//==============================================================================
+//
+// File:		PartThumbnailCache.m
+//
+// Purpose:		Background part thumbnails. See PartThumbnailCache.h.
+//
+// Notes:		The renderer is deliberately crude. Triangles are streamed out
+//				of the part with -flattenIntoSink:, turned to the standard 3D
+//				view and dropped through a depth buffer at twice the thumbnail
+//				size, one flat shade per face; the result is averaged down to
+//				size. Edge lines are not drawn.
+//
+//				Work is handed out newest request first, so that the rows on
+//				screen now are drawn before the ones scrolled past a moment ago.
+//				All thumbnails are made on one serial queue at low priority;
+//				they should never compete with the user's own model.
+//
+//==============================================================================
+#import "PartThumbnailCache.h"
+
+#import "ColorLibrary.h"
+#import "LDrawModel.h"
+#import "LDrawPaths.h"
+#import "LDrawPrimitiveSink.h"
+#import "LDrawTrace.h"
+#import "LDrawUtilities.h"
+#import "MacLDraw.h"
+#import "MatrixMath.h"
+#import "PartLibrary.h"
+
+// A thumbnail requested from -thumbnailForPartName: is now available (or has
+// failed). Object is the cache; userInfo has PART_NUMBER_KEY -> part name. A
+// nil userInfo means all thumbnails were thrown away; ask again for any shown.
+NSString *LDrawPartThumbnailDidLoadNotification = @"LDrawPartThumbnailDidLoadNotification";
+
+// Thumbnails kept in memory. Each is 16 KB.
+#define THUMBNAIL_MEMORY_COUNT_LIMIT	1000
+
+// Rendering
+#define THUMBNAIL_SUPERSAMPLING			2		// pixels drawn per thumbnail pixel, each way
+#define THUMBNAIL_MARGIN				0.05	// fraction of the picture left empty at each side
+#define THUMBNAIL_AMBIENT_LIGHT			0.35	// brightness of a face turned edge-on to the light
+
+static PartThumbnailCache	*SharedThumbnailCache = nil;
+
+
+//------------------------------------------------------------------------------
+//
+// ThumbnailMesh
+//
+// Triangles gathered from a part, already turned to the thumbnail view. In view
+// coordinates +X is right, +Y is down and the viewer looks toward +Z.
+//
+//------------------------------------------------------------------------------
+typedef struct ThumbnailTriangle
+{
+	Point3		vertexes[3];
+	GLfloat		rgba[4];
+
+} ThumbnailTriangle;
+
+
+typedef struct ThumbnailMesh
+{
+	Matrix4				view;
+	ThumbnailTriangle	*triangles;
+	NSUInteger			triangleCount;
+	NSUInteger			triangleCapacity;
+	Box3				bounds;
+
+} ThumbnailMesh;
+
+
+static CGImageRef	CreateThumbnailImage(LDrawModel *model, NSUInteger pixelSize);
+static void			CollectTriangles(const LDrawPrimitive *primitive, void *context);
+static void			AddTriangle(ThumbnailMesh *mesh, Point3 vertex0, Point3 vertex1, Point3 vertex2, const GLfloat *rgba);
+static void			DrawTriangle(const ThumbnailTriangle *triangle, float scale, Point2 offset, NSUInteger size, float *depths, uint8_t *samples);
+static BOOL			WriteThumbnailImage(CGImageRef image, NSString *path);
+static uint64_t		HashBytes(const uint8_t *bytes, NSUInteger length);
+
+
+@interface PartThumbnailCache (Private)
+
+- (void) generateNextRequestedThumbnail;
+- (void) deliverThumbnail:(CGImageRef)image forPartName:(NSString *)partName generation:(NSUInteger)requestGeneration;
+- (void) partLibraryReloaded:(NSNotification *)notification;
+- (NSString *) thumbnailPathForPartName:(NSString *)partName;
+
+@end
+
+
+@implementation PartThumbnailCache
+
+#pragma mark -
+#pragma mark INITIALIZATION
+#pragma mark -
+
+//---------- sharedThumbnailCache ------------------------------------[static]--
+//
+// Purpose:		Returns the thumbnail cache, which keeps its pictures in the
+//				user's Caches folder.
+//
+//------------------------------------------------------------------------------
++ (PartThumbnailCache *) sharedThumbnailCache
+{
+	NSString	*cachesPath			= nil;
+	NSString	*bundleIdentifier	= nil;
+
+	if(SharedThumbnailCache == nil)
+	{
+		cachesPath			= [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) objectAtIndex:0];
+		bundleIdentifier	= [[NSBundle mainBundle] bundleIdentifier];
+
+		if(bundleIdentifier != nil)
+			cachesPath = [cachesPath stringByAppendingPathComponent:bundleIdentifier];
+
+		SharedThumbnailCache = [[PartThumbnailCache alloc] initWithCacheFolderPath:
+										[cachesPath stringByAppendingPathComponent:@"Part Thumbnails"]];
+	}
+
+	return SharedThumbnailCache;
+
+}//end sharedThumbnailCache
+
+
+//========== initWithCacheFolderPath: ==========================================
+//
+// Purpose:		Creates a cache which keeps its pictures in the given folder.
+//				The folder is created if need be.
+//
+//==============================================================================
+- (id) initWithCacheFolderPath:(NSString *)pathIn
+{
+	self = [super init];
+	if(self)
+	{
+		cacheFolderPath	= [pathIn copy];
+		thumbnails		= [[NSCache alloc] init];
+		requestedNames	= [[NSMutableSet alloc] init];
+		requestStack	= [[NSMutableArray alloc] init];
+		workQueue		= dispatch_queue_create("com.AllenSmith.Bricksmith.PartThumbnails", NULL);
+
+		[thumbnails setCountLimit:THUMBNAIL_MEMORY_COUNT_LIMIT];
+		dispatch_set_target_queue(workQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0));
+
+		[[NSFileManager defaultManager] createDirectoryAtPath:cacheFolderPath
+								  withIntermediateDirectories:YES
+												   attributes:nil
+														error:NULL];
+
+		[[NSNotificationCenter defaultCenter] addObserver:self
+												 selector:@selector(partLibraryReloaded:)
+													 name:LDrawPartLibraryReloaded
+												   object:nil ];
+	}
+	return self;
+
+}//end initWithCacheFolderPath:
+
+
+#pragma mark -
+#pragma mark THUMBNAILS
+#pragma mark -
+
+//========== thumbnailForPartName: =============================================
+//
+// Purpose:		Returns the thumbnail of the named part if it is in memory.
+//				Otherwise returns NULL and starts loading it; the cache posts
+//				LDrawPartThumbnailDidLoadNotification when it is ready.
+//
+// Notes:		Main thread only. Parts which can't be drawn are remembered and
+//				keep returning NULL without further work.
+//
+//==============================================================================
+- (CGImageRef) thumbnailForPartName:(NSString *)partName
+{
+	id	thumbnail	= [self->thumbnails objectForKey:partName];
+
+	if(thumbnail == nil)
+	{
+		if([self->requestedNames containsObject:partName] == NO)
+		{
+			[self->requestedNames addObject:partName];
+			@synchronized(self)
+			{
+				[self->requestStack addObject:partName];
+			}
+
+			// One block per request; each one draws whatever was asked for
+			// most recently.
+			dispatch_async(self->workQueue, ^{
+				[self generateNextRequestedThumbnail];
+			});
+		}
+	}
+	else if(thumbnail == [NSNull null])
+		thumbnail = nil;
+
+	return (CGImageRef)thumbnail;
+
+}//end thumbnailForPartName:
+
+
+//========== copyThumbnailForPartName: =========================================
+//
+// Purpose:		Reads the thumbnail of the named part off disk, or draws and
+//				saves it if it isn't there yet. Returns NULL if the part can't
+//				be found or has nothing to draw. The caller releases the image.
+//
+// Notes:		Runs on the calling thread and skips the in-memory cache
+//				entirely.
+//
+//==============================================================================
+- (CGImageRef) copyThumbnailForPartName:(NSString *)partName
+{
+	CFAbsoluteTime	startTime		= CFAbsoluteTimeGetCurrent();
+	NSString		*thumbnailPath	= [self thumbnailPathForPartName:partName];
+	LDrawModel		*model			= nil;
+	CGImageRef		image			= NULL;
+
+	if(thumbnailPath != nil)
+	{
+		if([[NSFileManager defaultManager] fileExistsAtPath:thumbnailPath])
+		{
+			TRACE_BEGIN("read thumbnail");
+			image = CGImageRetain([LDrawUtilities imageAtPath:thumbnailPath]);
+			TRACE_END("read thumbnail");
+		}
+
+		if(image != NULL)
+		{
+			@synchronized(self)
+			{
+				self->cacheHitCount	+= 1;
+				self->cacheHitTime	+= CFAbsoluteTimeGetCurrent() - startTime;
+			}
+		}
+		else
+		{
+			TRACE_BEGIN("generate thumbnail");
+			model	= [[PartLibrary sharedPartLibrary] modelForName:[partName lowercaseString]];
+			image	= CreateThumbnailImage(model, PART_THUMBNAIL_PIXEL_SIZE);
+
+			if(image != NULL)
+				WriteThumbnailImage(image, thumbnailPath);
+			TRACE_END("generate thumbnail");
+
+			@synchronized(self)
+			{
+				self->generatedCount	+= 1;
+				self->generationTime	+= CFAbsoluteTimeGetCurrent() - startTime;
+			}
+		}
+	}
+
+	return image;
+
+}//end copyThumbnailForPartName:
+
+
+//========== removeAllThumbnails ===============================================
+//
+// Purpose:		Forgets every thumbnail, in memory and on disk. Requests still
+//				waiting are dropped; anyone who wants them must ask again.
+//
+// Notes:		Main thread only.
+//
+//==============================================================================
+- (void) removeAllThumbnails
+{
+	@synchronized(self)
+	{
+		self->generation += 1;
+		[self->requestStack removeAllObjects];
+	}
+	[self->thumbnails removeAllObjects];
+	[self->requestedNames removeAllObjects];
+
+	// The work queue is serial, so this waits out any thumbnail being written.
+	dispatch_async(self->workQueue, ^{
+		NSFileManager *fileManager = [[NSFileManager alloc] init];
+
+		[fileManager removeItemAtPath:self->cacheFolderPath error:NULL];
+		[fileManager createDirectoryAtPath:self->cacheFolderPath
+			   withIntermediateDirectories:YES
+								attributes:nil
+									 error:NULL];
+		[fileManager release];
+	});
+
+	// Anything asked for from here on is queued behind the cleanup.
+	[[NSNotificationCenter defaultCenter] postNotificationName:LDrawPartThumbnailDidLoadNotification
+														object:self ];
+
+}//end removeAllThumbnails
+
+
+#pragma mark -
+#pragma mark STATISTICS
+#pragma mark -
+
+//========== cacheHitCount =====================================================
+//
+// Purpose:		Returns the number of thumbnails which were read off disk.
+//
+//==============================================================================
+- (NSUInteger) cacheHitCount
+{
+	@synchronized(self)
+	{
+		return self->cacheHitCount;
+	}
+
+}//end cacheHitCount
+
+
+//========== cacheHitTime ======================================================
+//
+// Purpose:		Returns the total time spent reading thumbnails off disk,
+//				including finding and hashing the part files.
+//
+//==============================================================================
+- (CFTimeInterval) cacheHitTime
+{
+	@synchronized(self)
+	{
+		return self->cacheHitTime;
+	}
+
+}//end cacheHitTime
+
+
+//========== generatedCount ====================================================
+//
+// Purpose:		Returns the number of thumbnails which had to be drawn.
+//
+//==============================================================================
+- (NSUInteger) generatedCount
+{
+	@synchronized(self)
+	{
+		return self->generatedCount;
+	}
+
+}//end generatedCount
+
+
+//========== generationTime ====================================================
+//
+// Purpose:		Returns the total time spent drawing and saving thumbnails,
+//				including loading any parts which weren't loaded yet.
+//
+//==============================================================================
+- (CFTimeInterval) generationTime
+{
+	@synchronized(self)
+	{
+		return self->generationTime;
+	}
+
+}//end generationTime
+
+
+#pragma mark -
+#pragma mark UTILITIES
+#pragma mark -
+
+//========== generateNextRequestedThumbnail ====================================
+//
+// Purpose:		Work queue: makes the most recently requested thumbnail and
+//				hands it back to the main thread.
+//
+//==============================================================================
+- (void) generateNextRequestedThumbnail
+{
+	NSAutoreleasePool	*pool				= [[NSAutoreleasePool alloc] init];
+	NSString			*partName			= nil;
+	NSUInteger			requestGeneration	= 0;
+	CGImageRef			image				= NULL;
+
+	@synchronized(self)
+	{
+		partName			= [[self->requestStack lastObject] retain];
+		requestGeneration	= self->generation;
+
+		if(partName != nil)
+			[self->requestStack removeLastObject];
+	}
+
+	// The stack is empty if it was cleared since this block was queued.
+	if(partName != nil)
+	{
+		image = [self copyThumbnailForPartName:partName];
+
+		dispatch_async(dispatch_get_main_queue(), ^{
+			[self deliverThumbnail:image forPartName:partName generation:requestGeneration];
+			CGImageRelease(image);
+			[partName release];
+		});
+	}
+
+	[pool drain];
+
+}//end generateNextRequestedThumbnail
+
+
+//========== deliverThumbnail:forPartName:generation: ==========================
+//
+// Purpose:		Main thread: files a finished thumbnail (NULL if it failed) and
+//				announces it, unless the cache was emptied in the meantime.
+//
+//==============================================================================
+- (void) deliverThumbnail:(CGImageRef)image
+			  forPartName:(NSString *)partName
+			   generation:(NSUInteger)requestGeneration
+{
+	NSDictionary	*userInfo	= nil;
+
+	if(requestGeneration == self->generation)
+	{
+		if(image != NULL)
+			[self->thumbnails setObject:(id)image forKey:partName];
+		else
+			[self->thumbnails setObject:[NSNull null] forKey:partName];
+
+		[self->requestedNames removeObject:partName];
+
+		userInfo = [NSDictionary dictionaryWithObject:partName forKey:PART_NUMBER_KEY];
+		[[NSNotificationCenter defaultCenter] postNotificationName:LDrawPartThumbnailDidLoadNotification
+															object:self
+														  userInfo:userInfo ];
+	}
+
+}//end deliverThumbnail:forPartName:generation:
+
+
+//========== partLibraryReloaded: ==============================================
+//
+// Purpose:		The part catalog was rebuilt from the LDraw folder. Any part,
+//				subpart or primitive may have changed, so start over.
+//
+//==============================================================================
+- (void) partLibraryReloaded:(NSNotification *)notification
+{
+	[self removeAllThumbnails];
+
+}//end partLibraryReloaded:
+
+
+//========== thumbnailPathForPartName: =========================================
+//
+// Purpose:		Returns where the thumbnail of the named part is kept, which
+//				depends on the contents of the part file. Returns nil if there
+//				is no such part file.
+//
+//==============================================================================
+- (NSString *) thumbnailPathForPartName:(NSString *)partName
+{
+	NSString	*partPath		= [[LDrawPaths sharedPaths] pathForPartName:[partName lowercaseString]];
+	NSData		*contents		= nil;
+	NSString	*fileName		= nil;
+	NSString	*thumbnailPath	= nil;
+
+	if(partPath != nil)
+		contents = [NSData dataWithContentsOfFile:partPath];
+
+	if(contents != nil)
+	{
+		fileName		= [NSString stringWithFormat:@"%016llx-%d.png",
+												(unsigned long long)HashBytes([contents bytes], [contents length]),
+												PART_THUMBNAIL_PIXEL_SIZE ];
+		thumbnailPath	= [self->cacheFolderPath stringByAppendingPathComponent:fileName];
+	}
+
+	return thumbnailPath;
+
+}//end thumbnailPathForPartName:
+
+
+#pragma mark -
+#pragma mark DESTRUCTOR
+#pragma mark -
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Out of the picture.
+//
+//==============================================================================
+- (void) dealloc
+{
+	[[NSNotificationCenter defaultCenter] removeObserver:self];
+
+	[cacheFolderPath	release];
+	[thumbnails			release];
+	[requestedNames		release];
+	[requestStack		release];
+	dispatch_release(workQueue);
+
+	[super dealloc];
+
+}//end dealloc
+
+
+@end
+
+
+#pragma mark -
+
+//---------- CreateThumbnailImage ------------------------------------[static]--
+//
+// Purpose:		Draws the model in the standard 3D view, filling a square image
+//				pixelSize across with a transparent background. Returns NULL if
+//				the model has no faces. The caller releases the image.
+//
+//------------------------------------------------------------------------------
+static CGImageRef CreateThumbnailImage(LDrawModel *model, NSUInteger pixelSize)
+{
+	NSUInteger			size		= pixelSize * THUMBNAIL_SUPERSAMPLING;
+	ThumbnailMesh		mesh;
+	LDrawPrimitiveSink	sink;
+	float				*depths		= NULL;
+	uint8_t				*samples	= NULL;
+	uint8_t				*pixels		= NULL;
+	float				extent		= 0;
+	float				scale		= 0;
+	Point2				offset		= ZeroPoint2;
+	NSUInteger			counter		= 0;
+	NSUInteger			row			= 0;
+	NSUInteger			column		= 0;
+	NSUInteger			channel		= 0;
+	unsigned			sum			= 0;
+	CFDataRef			data		= NULL;
+	CGDataProviderRef	provider	= NULL;
+	CGColorSpaceRef		colorSpace	= NULL;
+	CGImageRef			image		= NULL;
+
+	if(model == nil)
+		return NULL;
+
+	//---------- Collect ---------------------------------------------------
+
+	mesh.view				= Matrix4RotateModelview(IdentityMatrix4, [LDrawUtilities angleForViewOrientation:ViewOrientation3D]);
+	mesh.triangleCount		= 0;
+	mesh.triangleCapacity	= 256;
+	mesh.triangles			= malloc(sizeof(ThumbnailTriangle) * mesh.triangleCapacity);
+	mesh.bounds				= InvalidBox;
+
+	sink = LDrawPrimitiveSinkMake(CollectTriangles, &mesh);
+	[model flattenIntoSink:&sink
+			  currentColor:[[ColorLibrary sharedColorLibrary] colorForCode:LDrawCurrentColor]
+		  currentTransform:IdentityMatrix4];
+
+	//---------- Draw ------------------------------------------------------
+
+	if(mesh.triangleCount > 0)
+	{
+		depths	= malloc(sizeof(float) * size * size);
+		samples	= calloc(size * size, 4);
+		pixels	= calloc(pixelSize * pixelSize, 4);
+
+		for(counter = 0; counter < size * size; counter++)
+			depths[counter] = FLT_MAX;
+
+		// Fit the view-aligned bounds, centered, inside the margins.
+		extent		= MAX(mesh.bounds.max.x - mesh.bounds.min.x, mesh.bounds.max.y - mesh.bounds.min.y);
+		scale		= size * (1 - 2 * THUMBNAIL_MARGIN) / MAX(extent, 0.001);
+		offset.x	= size / 2.0 - (mesh.bounds.min.x + mesh.bounds.max.x) / 2 * scale;
+		offset.y	= size / 2.0 - (mesh.bounds.min.y + mesh.bounds.max.y) / 2 * scale;
+
+		for(counter = 0; counter < mesh.triangleCount; counter++)
+			DrawTriangle(&mesh.triangles[counter], scale, offset, size, depths, samples);
+
+		// Average each block of samples down to one pixel. Empty samples are
+		// transparent black, so the result is premultiplied.
+		for(row = 0; row < pixelSize; row++)
+		{
+			for(column = 0; column < pixelSize; column++)
+			{
+				for(channel = 0; channel < 4; channel++)
+				{
+					sum = 0;
+					for(counter = 0; counter < THUMBNAIL_SUPERSAMPLING * THUMBNAIL_SUPERSAMPLING; counter++)
+					{
+						sum += samples[(  (row    * THUMBNAIL_SUPERSAMPLING + counter / THUMBNAIL_SUPERSAMPLING) * size
+										+  column * THUMBNAIL_SUPERSAMPLING + counter % THUMBNAIL_SUPERSAMPLING) * 4 + channel];
+					}
+					pixels[(row * pixelSize + column) * 4 + channel] = sum / (THUMBNAIL_SUPERSAMPLING * THUMBNAIL_SUPERSAMPLING);
+				}
+			}
+		}
+
+		data		= CFDataCreate(NULL, pixels, pixelSize * pixelSize * 4);
+		provider	= CGDataProviderCreateWithCFData(data);
+		colorSpace	= CGColorSpaceCreateDeviceRGB();
+		image		= CGImageCreate(pixelSize, pixelSize, 8, 32, pixelSize * 4,
+									colorSpace, kCGImageAlphaPremultipliedLast,
+									provider, NULL, false, kCGRenderingIntentDefault);
+
+		CGColorSpaceRelease(colorSpace);
+		CGDataProviderRelease(provider);
+		CFRelease(data);
+		free(pixels);
+		free(samples);
+		free(depths);
+	}
+
+	free(mesh.triangles);
+
+	return image;
+
+}//end CreateThumbnailImage
+
+
+//---------- CollectTriangles ----------------------------------------[static]--
+//
+// Purpose:		Primitive sink function which adds the faces of a part to the
+//				thumbnail mesh. Lines are ignored.
+//
+//------------------------------------------------------------------------------
+static void CollectTriangles(const LDrawPrimitive *primitive, void *context)
+{
+	ThumbnailMesh	*mesh		= context;
+	const Point3	*vertexes	= primitive->vertexes;
+
+	switch(primitive->type)
+	{
+		case LDrawPrimitiveTriangle:
+			AddTriangle(mesh, vertexes[0], vertexes[1], vertexes[2], primitive->rgba);
+			break;
+
+		case LDrawPrimitiveQuadrilateral:
+			AddTriangle(mesh, vertexes[0], vertexes[1], vertexes[2], primitive->rgba);
+			AddTriangle(mesh, vertexes[2], vertexes[3], vertexes[0], primitive->rgba);
+			break;
+
+		default:
+			break;
+	}
+
+}//end CollectTriangles
+
+
+//---------- AddTriangle ---------------------------------------------[static]--
+//
+// Purpose:		Turns a triangle to the view and appends it to the mesh.
+//
+//------------------------------------------------------------------------------
+static void AddTriangle(ThumbnailMesh *mesh, Point3 vertex0, Point3 vertex1, Point3 vertex2, const GLfloat *rgba)
+{
+	ThumbnailTriangle	*triangle	= NULL;
+	int					counter		= 0;
+
+	if(mesh->triangleCount == mesh->triangleCapacity)
+	{
+		mesh->triangleCapacity	*= 2;
+		mesh->triangles			= realloc(mesh->triangles, sizeof(ThumbnailTriangle) * mesh->triangleCapacity);
+	}
+
+	triangle = mesh->triangles + mesh->triangleCount;
+	triangle->vertexes[0] = V3MulPointByProjMatrix(vertex0, mesh->view);
+	triangle->vertexes[1] = V3MulPointByProjMatrix(vertex1, mesh->view);
+	triangle->vertexes[2] = V3MulPointByProjMatrix(vertex2, mesh->view);
+	memcpy(triangle->rgba, rgba, sizeof(triangle->rgba));
+
+	for(counter = 0; counter < 3; counter++)
+		mesh->bounds = V3UnionBoxAndPoint(mesh->bounds, triangle->vertexes[counter]);
+
+	mesh->triangleCount += 1;
+
+}//end AddTriangle
+
+
+//---------- DrawTriangle --------------------------------------------[static]--
+//
+// Purpose:		Fills the samples covered by the triangle, where it is nearer
+//				than what is already there.
+//
+// Notes:		The light comes from the upper left, over the viewer's
+//				shoulder. Which side of a face is lit doesn't matter; library
+//				winding is too unreliable to light only the front.
+//
+//------------------------------------------------------------------------------
+static void DrawTriangle(const ThumbnailTriangle	*triangle,
+						 float						scale,
+						 Point2						offset,
+						 NSUInteger					size,
+						 float						*depths,
+						 uint8_t					*samples)
+{
+	const Point3	*vertexes	= triangle->vertexes;
+	Vector3			light		= V3Normalize(V3Make(-0.4, -0.7, -0.6));
+	Vector3			normal		= V3Cross(V3Sub(vertexes[1], vertexes[0]), V3Sub(vertexes[2], vertexes[0]));
+	float			length		= V3Length(normal);
+	float			shade		= 0;
+	uint8_t			color[4];
+	float			x[3];
+	float			y[3];
+	float			area		= 0;
+	float			sampleX		= 0;
+	float			sampleY		= 0;
+	float			weight0		= 0;
+	float			weight1		= 0;
+	float			weight2		= 0;
+	float			depth		= 0;
+	NSInteger		minX		= 0;
+	NSInteger		maxX		= 0;
+	NSInteger		minY		= 0;
+	NSInteger		maxY		= 0;
+	NSInteger		row			= 0;
+	NSInteger		column		= 0;
+	NSUInteger		index		= 0;
+	int				counter		= 0;
+
+	if(length == 0)
+		return;
+
+	shade = THUMBNAIL_AMBIENT_LIGHT + (1 - THUMBNAIL_AMBIENT_LIGHT) * fabsf(V3Dot(normal, light)) / length;
+	for(counter = 0; counter < 3; counter++)
+		color[counter] = MIN(triangle->rgba[counter] * shade, 1.0) * 255;
+	color[3] = 255;
+
+	for(counter = 0; counter < 3; counter++)
+	{
+		x[counter] = vertexes[counter].x * scale + offset.x;
+		y[counter] = vertexes[counter].y * scale + offset.y;
+	}
+
+	area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if(area == 0)
+		return;
+
+	minX = MAX(floorf(MIN(x[0], MIN(x[1], x[2]))), 0);
+	maxX = MIN(ceilf (MAX(x[0], MAX(x[1], x[2]))), (NSInteger)size - 1);
+	minY = MAX(floorf(MIN(y[0], MIN(y[1], y[2]))), 0);
+	maxY = MIN(ceilf (MAX(y[0], MAX(y[1], y[2]))), (NSInteger)size - 1);
+
+	// Sample at pixel centers. The weights are the barycentric coordinates;
+	// dividing by the signed area makes them positive inside the triangle
+	// whichever way it winds.
+	for(row = minY; row <= maxY; row++)
+	{
+		for(column = minX; column <= maxX; column++)
+		{
+			sampleX	= column + 0.5;
+			sampleY	= row + 0.5;
+
+			weight0 = ((x[1] - sampleX) * (y[2] - sampleY) - (x[2] - sampleX) * (y[1] - sampleY)) / area;
+			weight1 = ((x[2] - sampleX) * (y[0] - sampleY) - (x[0] - sampleX) * (y[2] - sampleY)) / area;
+			weight2 = 1 - weight0 - weight1;
+
+			if(weight0 < 0 || weight1 < 0 || weight2 < 0)
+				continue;
+
+			depth	= weight0 * vertexes[0].z + weight1 * vertexes[1].z + weight2 * vertexes[2].z;
+			index	= row * size + column;
+
+			if(depth < depths[index])
+			{
+				depths[index] = depth;
+				memcpy(samples + index * 4, color, 4);
+			}
+		}
+	}
+
+}//end DrawTriangle
+
+
+//---------- WriteThumbnailImage -------------------------------------[static]--
+//
+// Purpose:		Saves the image as a PNG. It is written beside its final name
+//				and then moved into place, so that nobody ever reads half a
+//				picture.
+//
+//------------------------------------------------------------------------------
+static BOOL WriteThumbnailImage(CGImageRef image, NSString *path)
+{
+	NSString				*temporaryPath	= [path stringByAppendingPathExtension:@"tmp"];
+	CGImageDestinationRef	destination		= NULL;
+	BOOL					success			= NO;
+
+	destination = CGImageDestinationCreateWithURL((CFURLRef)[NSURL fileURLWithPath:temporaryPath], CFSTR("public.png"), 1, NULL);
+	if(destination != NULL)
+	{
+		CGImageDestinationAddImage(destination, image, NULL);
+		success = CGImageDestinationFinalize(destination);
+		CFRelease(destination);
+	}
+
+	if(success)
+		success = (rename([temporaryPath fileSystemRepresentation], [path fileSystemRepresentation]) == 0);
+
+	return success;
+
+}//end WriteThumbnailImage
+
+
+//---------- HashBytes -----------------------------------------------[static]--
+//
+// Purpose:		64-bit FNV-1a hash. Only needs to tell apart versions of a part
+//				file, not resist anyone.
+//
+//------------------------------------------------------------------------------
+static uint64_t HashBytes(const uint8_t *bytes, NSUInteger length)
+{
+	uint64_t	hash	= 14695981039346656037ULL;
+	NSUInteger	counter	= 0;
+
+	for(counter = 0; counter < length; counter++)
+	{
+		hash ^= bytes[counter];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+
+}//end HashBytes
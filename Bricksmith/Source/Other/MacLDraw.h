@@ -36,6 +36,7 @@
 #define LDRAW_VIEWER_BACKGROUND_COLOR_KEY			@"LDraw Viewer Background Color"
 #define MOUSE_DRAGGING_BEHAVIOR_KEY					@"Mouse Dragging Behavior"
 #define RIGHT_BUTTON_BEHAVIOR_KEY					@"Right Button Behavior"
+#define SNAP_TO_CONNECTIONS_KEY						@"Snap to Connections"
 #define ROTATE_MODE_KEY								@"Rotate Mode"
 #define MOUSE_WHEEL_BEHAVIOR_KEY					@"Mouse Wheel Behavior"
 #define PART_BROWSER_DRAWER_STATE					@"Part Browser Drawer State"
@@ -181,7 +182,9 @@
 
 //A model was added to a document.  Note that the object
 // for this notification is the LDrawFile that was edited!
+// The new LDrawMPDModel is in the userInfo under LDrawMPDSubModelKey.
 #define LDrawMPDSubModelAdded							@"LDrawMPDSubModelAdded"
+#define LDrawMPDSubModelKey								@"LDrawMPDSubModel"
 
 //The library was reloaded.  Documents need to tell their parts
 // to re-resolve their references.
@@ -235,6 +238,7 @@ typedef enum MenuTags
 	gridFineMenuTag					= 305,
 	gridMediumMenuTag				= 306,
 	gridCoarseMenuTag				= 307,
+	recordTraceMenuTag				= 308,
 	
 	// Views Menu
 	viewsMenuTag					= 4,
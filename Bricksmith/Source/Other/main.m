@@ -9,7 +9,22 @@
 //==============================================================================
 #import <Cocoa/Cocoa.h>
 
+#import "BatchAnalyzer.h"
+
 int main(int argc, char *argv[])
 {
+	NSAutoreleasePool	*pool		= [[NSAutoreleasePool alloc] init];
+	NSArray				*arguments	= [[NSProcessInfo processInfo] arguments];
+	int					status		= 0;
+	
+	// Analyzing files from the command line needs no windows.
+	if([BatchAnalyzer wantsToRunWithArguments:arguments])
+	{
+		status = [BatchAnalyzer runWithArguments:arguments];
+		[pool drain];
+		return status;
+	}
+	[pool drain];
+	
     return NSApplicationMain(argc, (const char **) argv);
 }
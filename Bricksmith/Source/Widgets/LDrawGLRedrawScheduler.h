@@ -0,0 +1,81 @@
+//==============================================================================
+//
+// File:		LDrawGLRedrawScheduler.h
+//
+// Purpose:		Paces redraws of LDraw views to the display refresh rate.
+//
+//				Redraws are requested from all over: every changed directive, 
+//				the inspector, mouse-overs, drags, other views of the same 
+//				file. Instead of drawing each time, a view asks the scheduler, 
+//				which only marks it dirty. Once per frame interval, the 
+//				scheduler redraws every dirty view exactly once, so any burst 
+//				of requests costs at most one draw per view per frame.
+//
+//				Views the user is working in right now are drawn first. If a 
+//				frame runs long, the rest wait for the next one rather than 
+//				holding up the interactive view. Still, every frame draws at 
+//				least one waiting background view, taking turns, so no view 
+//				is starved by a slow one.
+//
+//				The clock is pluggable, so the pacing can be driven by hand: 
+//				request redraws, advance the clock, call -renderFrameIfDue, and 
+//				count the redraws.
+//
+//==============================================================================
+#import <Foundation/Foundation.h>
+
+
+// Returns the current time in seconds, on any steady timeline.
+typedef NSTimeInterval (*LDrawGLRedrawClockFunction)(void);
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// protocol LDrawGLRedrawClient
+//
+////////////////////////////////////////////////////////////////////////////////
+@protocol LDrawGLRedrawClient <NSObject>
+
+- (void) displayScheduledRedraw;
+- (BOOL) wantsPriorityRedraw;
+
+@end
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// class LDrawGLRedrawScheduler
+//
+////////////////////////////////////////////////////////////////////////////////
+@interface LDrawGLRedrawScheduler : NSObject
+{
+	NSHashTable					*dirtyClients;		// clients waiting for the next frame (not retained)
+	NSPointerArray				*deferredClients;	// background clients a late frame left over, oldest first (not retained)
+	NSTimeInterval				frameInterval;
+	NSTimeInterval				lastFrameTime;
+	LDrawGLRedrawClockFunction	clock;
+	NSTimer						*frameTimer;		// pending frame, or nil; owned by the run loop
+	
+	NSUInteger					framesRendered;		// statistics
+	NSUInteger					redrawsRendered;
+}
+
+// Initialization
++ (LDrawGLRedrawScheduler *) sharedScheduler;
+- (id) initWithFrameInterval:(NSTimeInterval)interval clock:(LDrawGLRedrawClockFunction)clockFunction;
+
+// Scheduling
+- (void) setNeedsRedraw:(id<LDrawGLRedrawClient>)client;
+- (void) cancelRedraw:(id<LDrawGLRedrawClient>)client;
+- (BOOL) needsRedraw:(id<LDrawGLRedrawClient>)client;
+
+// Rendering
+- (NSTimeInterval) nextFrameTime;
+- (void) renderFrameIfDue;
+- (void) renderFrame;
+
+// Statistics
+- (NSUInteger) framesRendered;
+- (NSUInteger) redrawsRendered;
+
+@end
@@ -0,0 +1,361 @@
+//==============================================================================
+//
+// File:		LDrawGLRedrawScheduler.m
+//
+// Purpose:		Paces redraws of LDraw views to the display refresh rate. See
+//				LDrawGLRedrawScheduler.h.
+//
+// Notes:		A real display link calls back on its own thread, but our views
+//				must be drawn on the main thread with their contexts locked. So
+//				frames are driven by a one-shot main-thread timer, armed only
+//				while something is dirty; an idle application has no timer at
+//				all.
+//
+//==============================================================================
+#import "LDrawGLRedrawScheduler.h"
+
+
+// Frame interval for the shared scheduler, in seconds.
+#define REDRAW_FRAME_INTERVAL	(1.0 / 60.0)
+
+static LDrawGLRedrawScheduler	*SharedScheduler	= nil;
+
+static NSTimeInterval SystemClock(void);
+
+
+@interface LDrawGLRedrawScheduler (Private)
+
+- (void) scheduleFrame;
+- (void) frameTimerFired:(NSTimer *)timer;
+
+@end
+
+
+@implementation LDrawGLRedrawScheduler
+
+#pragma mark -
+#pragma mark INITIALIZATION
+#pragma mark -
+
+//---------- sharedScheduler -----------------------------------------[static]--
+//
+// Purpose:		Returns the scheduler all views share, paced to the display.
+//
+//------------------------------------------------------------------------------
++ (LDrawGLRedrawScheduler *) sharedScheduler
+{
+	if(SharedScheduler == nil)
+	{
+		SharedScheduler = [[LDrawGLRedrawScheduler alloc] initWithFrameInterval:REDRAW_FRAME_INTERVAL
+																		  clock:SystemClock];
+	}
+
+	return SharedScheduler;
+
+}//end sharedScheduler
+
+
+//========== initWithFrameInterval:clock: ======================================
+//
+// Purpose:		Creates a scheduler which draws at most once per interval, as
+//				measured by clockFunction.
+//
+//==============================================================================
+- (id) initWithFrameInterval:(NSTimeInterval)interval clock:(LDrawGLRedrawClockFunction)clockFunction
+{
+	self = [super init];
+	if(self)
+	{
+		dirtyClients    = [[NSHashTable alloc] initWithOptions:(NSPointerFunctionsOpaqueMemory | NSPointerFunctionsObjectPointerPersonality)
+												  capacity:0];
+		deferredClients = [[NSPointerArray alloc] initWithOptions:(NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality)];
+		frameInterval   = interval;
+		clock           = clockFunction;
+
+		// So that the first request draws at once.
+		lastFrameTime   = clock() - frameInterval;
+	}
+	return self;
+
+}//end initWithFrameInterval:clock:
+
+
+#pragma mark -
+#pragma mark SCHEDULING
+#pragma mark -
+
+//========== setNeedsRedraw: ===================================================
+//
+// Purpose:		Marks client to be redrawn on the next frame.
+//
+// Notes:		Asking again before the frame comes costs nothing; that is the
+//				whole point.
+//
+//				Clients are not retained. A client must cancel its redraw
+//				before it is deallocated.
+//
+//==============================================================================
+- (void) setNeedsRedraw:(id<LDrawGLRedrawClient>)client
+{
+	if([NSThread isMainThread] == NO)
+	{
+		[self performSelectorOnMainThread:@selector(setNeedsRedraw:) withObject:client waitUntilDone:NO];
+		return;
+	}
+
+	NSHashInsertIfAbsent(self->dirtyClients, client);
+	[self scheduleFrame];
+
+}//end setNeedsRedraw:
+
+
+//========== cancelRedraw: =====================================================
+//
+// Purpose:		Forgets any redraw pending for client.
+//
+//==============================================================================
+- (void) cancelRedraw:(id<LDrawGLRedrawClient>)client
+{
+	NSUInteger  counter = 0;
+
+	NSHashRemove(self->dirtyClients, client);
+
+	// The client may be about to go away; don't keep its address in line.
+	for(counter = [self->deferredClients count]; counter > 0; counter--)
+	{
+		if([self->deferredClients pointerAtIndex:counter - 1] == client)
+			[self->deferredClients removePointerAtIndex:counter - 1];
+	}
+
+}//end cancelRedraw:
+
+
+//========== needsRedraw: ======================================================
+//
+// Purpose:		Returns YES if client will be redrawn on the next frame.
+//
+//==============================================================================
+- (BOOL) needsRedraw:(id<LDrawGLRedrawClient>)client
+{
+	return (NSHashGet(self->dirtyClients, client) != NULL);
+
+}//end needsRedraw:
+
+
+#pragma mark -
+#pragma mark RENDERING
+#pragma mark -
+
+//========== nextFrameTime =====================================================
+//
+// Purpose:		Returns the earliest time at which the next frame may be drawn.
+//
+//==============================================================================
+- (NSTimeInterval) nextFrameTime
+{
+	return self->lastFrameTime + self->frameInterval;
+
+}//end nextFrameTime
+
+
+//========== renderFrameIfDue ==================================================
+//
+// Purpose:		Draws a frame if one is both wanted and allowed by now.
+//
+//==============================================================================
+- (void) renderFrameIfDue
+{
+	if(		[self->dirtyClients count] > 0
+	   &&	clock() >= [self nextFrameTime] )
+	{
+		[self renderFrame];
+	}
+
+}//end renderFrameIfDue
+
+
+//========== renderFrame =======================================================
+//
+// Purpose:		Redraws every dirty client once, priority clients first.
+//
+// Notes:		Clients are taken off the dirty list before they draw, so one
+//				which asks to be redrawn while drawing gets the next frame.
+//
+//				Once a frame has taken longer than the interval, the remaining
+//				background clients stay dirty and wait for the next frame. But
+//				at least one background client is drawn every frame, however
+//				slow, and the ones left over go to the front of the line, so
+//				they all get their turn.
+//
+//==============================================================================
+- (void) renderFrame
+{
+	NSArray         *clients        = [self->dirtyClients allObjects];
+	NSMutableArray  *background     = [NSMutableArray array];
+	NSTimeInterval  frameStart      = clock();
+	NSUInteger      drawnCount      = 0;
+	NSUInteger      counter         = 0;
+	id              client          = nil;
+
+	self->lastFrameTime = frameStart;
+	self->framesRendered++;
+
+	// Whoever waited last frame goes first, in the order they were left.
+	for(counter = 0; counter < [self->deferredClients count]; counter++)
+	{
+		client = [self->deferredClients pointerAtIndex:counter];
+		if([self needsRedraw:client] && [client wantsPriorityRedraw] == NO)
+			[background addObject:client];
+	}
+	[self->deferredClients setCount:0];
+
+	for(client in clients)
+	{
+		if([client wantsPriorityRedraw])
+		{
+			NSHashRemove(self->dirtyClients, client);
+			[client displayScheduledRedraw];
+			self->redrawsRendered++;
+		}
+		else if([background indexOfObjectIdenticalTo:client] == NSNotFound)
+			[background addObject:client];
+	}
+
+	for(client in background)
+	{
+		// Skip anything cancelled by an earlier draw in this frame.
+		if([self needsRedraw:client] == NO)
+			continue;
+
+		if(drawnCount > 0 && clock() - frameStart > self->frameInterval)
+		{
+			[self->deferredClients addPointer:client];
+			continue;
+		}
+
+		NSHashRemove(self->dirtyClients, client);
+		[client displayScheduledRedraw];
+		self->redrawsRendered++;
+		drawnCount++;
+	}
+
+	[self scheduleFrame];
+
+}//end renderFrame
+
+
+#pragma mark -
+#pragma mark STATISTICS
+#pragma mark -
+
+//========== framesRendered ====================================================
+//
+// Purpose:		Returns the number of frames drawn so far.
+//
+//==============================================================================
+- (NSUInteger) framesRendered
+{
+	return self->framesRendered;
+
+}//end framesRendered
+
+
+//========== redrawsRendered ===================================================
+//
+// Purpose:		Returns the number of client redraws done so far. Without
+//				coalescing, this would equal the number of requests.
+//
+//==============================================================================
+- (NSUInteger) redrawsRendered
+{
+	return self->redrawsRendered;
+
+}//end redrawsRendered
+
+
+#pragma mark -
+#pragma mark UTILITIES
+#pragma mark -
+
+//========== scheduleFrame =====================================================
+//
+// Purpose:		Arms the frame timer if anything is waiting and it isn't armed
+//				already.
+//
+// Notes:		The timer runs in the common modes so that drawing keeps up
+//				during mouse tracking and live resize.
+//
+//==============================================================================
+- (void) scheduleFrame
+{
+	NSTimeInterval  delay   = 0;
+
+	if(self->frameTimer == nil && [self->dirtyClients count] > 0)
+	{
+		delay = MAX(0, [self nextFrameTime] - clock());
+
+		self->frameTimer = [NSTimer timerWithTimeInterval:delay
+												   target:self
+												 selector:@selector(frameTimerFired:)
+												 userInfo:nil
+												  repeats:NO];
+		[[NSRunLoop currentRunLoop] addTimer:self->frameTimer forMode:NSRunLoopCommonModes];
+	}
+
+}//end scheduleFrame
+
+
+//========== frameTimerFired: ==================================================
+//
+// Purpose:		Time for a frame.
+//
+//==============================================================================
+- (void) frameTimerFired:(NSTimer *)timer
+{
+	self->frameTimer = nil;
+
+	if([self->dirtyClients count] > 0)
+	{
+		// Timers can fire a hair early; don't draw ahead of the pace.
+		if(clock() >= [self nextFrameTime])
+			[self renderFrame];
+		else
+			[self scheduleFrame];
+	}
+
+}//end frameTimerFired:
+
+
+#pragma mark -
+#pragma mark DESTRUCTOR
+#pragma mark -
+
+//========== dealloc ===========================================================
+//
+// Purpose:		Stop the clock.
+//
+//==============================================================================
+- (void) dealloc
+{
+	[frameTimer			invalidate];
+	[dirtyClients		release];
+	[deferredClients	release];
+
+	[super dealloc];
+
+}//end dealloc
+
+
+@end
+
+
+//---------- SystemClock ---------------------------------------------[static]--
+//
+// Purpose:		The real clock.
+//
+//------------------------------------------------------------------------------
+static NSTimeInterval SystemClock(void)
+{
+	return [NSDate timeIntervalSinceReferenceDate];
+
+}//end SystemClock
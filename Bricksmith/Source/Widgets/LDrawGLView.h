@@ -15,6 +15,7 @@
 #import "ColorLibrary.h"
 #import "LDrawGLRenderer.h"
 #import "LDrawGLCamera.h"
+#import "LDrawGLRedrawScheduler.h"
 #import "LDrawUtilities.h"
 #import "MatrixMath.h"
 #import "ToolPalette.h"
@@ -31,7 +32,7 @@
 //		LDrawGLView
 //
 ////////////////////////////////////////////////////////////////////////////////
-@interface LDrawGLView : NSOpenGLView <LDrawColorable, LDrawGLRendererDelegate, LDrawGLCameraScroller>
+@interface LDrawGLView : NSOpenGLView <LDrawColorable, LDrawGLRendererDelegate, LDrawGLCameraScroller, LDrawGLRedrawClient>
 {
 @private
 	// The renderer is responsible for viewport math and OpenGL calls. Because 
@@ -140,6 +141,7 @@
 @interface NSObject (LDrawGLViewDelegate)
 
 - (void) LDrawGLViewBecameFirstResponder:(LDrawGLView *)glView;
+- (void) LDrawGLViewDidDraw:(LDrawGLView *)glView;
 
 - (BOOL) LDrawGLView:(LDrawGLView *)glView writeDirectivesToPasteboard:(NSPasteboard *)pasteboard asCopy:(BOOL)copyFlag;
 - (void) LDrawGLView:(LDrawGLView *)glView acceptDrop:(id < NSDraggingInfo >)info directives:(NSArray *)directives;
@@ -147,6 +149,7 @@
 - (void) LDrawGLViewPartDragEnded:(LDrawGLView*)glView;
 
 - (TransformComponents) LDrawGLViewPreferredPartTransform:(LDrawGLView *)glView;
+- (Vector3) LDrawGLView:(LDrawGLView *)glView snapDisplacement:(Vector3)displacement ofDirectives:(NSArray *)directives;
 
 // Delegate method is called when the user has changed the selection of parts 
 // by clicking in the view. This does not actually do any selecting; that is 
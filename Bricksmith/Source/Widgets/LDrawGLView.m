@@ -46,6 +46,7 @@
 #import "LDrawPart.h"
 #import "LDrawGLRenderer.h"
 #import "LDrawStep.h"
+#import "LDrawTrace.h"
 #import "LDrawUtilities.h"
 #import "MacLDraw.h"
 #import "OverlayViewCategory.h"
@@ -362,6 +363,8 @@ static NSSize Size2ToNSSize(Size2 size)
 //==============================================================================
 - (void) draw
 {
+	BOOL    didDraw = NO;
+	
 	//mark another outstanding draw request, then get in line by requesting the 
 	// mutex.
 	@synchronized(self)
@@ -378,13 +381,20 @@ static NSSize Size2ToNSSize(Size2 size)
 		// ourselves, and defer to the last guy.
 		if(numberDrawRequests == 1)
 		{
+			TRACE_BEGIN("frame");
 			[self->renderer draw];
-			
+			TRACE_END("frame");
+			didDraw = YES;
 		}
 		//else we just drop the draw.
 	}
 	CGLUnlockContext([[self openGLContext] CGLContextObj]);
 	
+	if(didDraw == YES && [self->delegate respondsToSelector:@selector(LDrawGLViewDidDraw:)])
+	{
+		[self->delegate LDrawGLViewDidDraw:self];
+	}
+	
 	//cleanup
 	@synchronized(self)
 	{
@@ -394,6 +404,36 @@ static NSSize Size2ToNSSize(Size2 size)
 }//end draw
 
 
+//========== displayScheduledRedraw ============================================
+//
+// Purpose:		The redraw scheduler says it is our turn to draw. 
+//
+// Notes:		If we can't draw right now (e.g. we are hidden), we stay marked 
+//				for display and Cocoa draws us when it can. 
+//
+//==============================================================================
+- (void) displayScheduledRedraw
+{
+	[super setNeedsDisplay:YES];
+	[self displayIfNeeded];
+	
+}//end displayScheduledRedraw
+
+
+//========== wantsPriorityRedraw ===============================================
+//
+// Purpose:		Returns YES if the user is working in this view right now, so 
+//				it should be drawn ahead of other views. 
+//
+//==============================================================================
+- (BOOL) wantsPriorityRedraw
+{
+	return (	[self->renderer isTrackingDrag] == YES
+			||	[[self window] firstResponder] == self );
+	
+}//end wantsPriorityRedraw
+
+
 //========== drawFocusRing =====================================================
 //
 // Purpose:		Draws a focus ring around the view, which indicates that this 
@@ -820,13 +860,19 @@ static NSSize Size2ToNSSize(Size2 size)
 
 //========== setNeedsDisplay: ==================================================
 //
-// Purpose:		Request redraw. This is here for debugging to track down extra 
-//				draws. 
+// Purpose:		Request redraw. 
+//
+// Notes:		Requests only mark us dirty with the redraw scheduler, which 
+//				draws us at most once per frame however many come in. It calls 
+//				back to -displayScheduledRedraw. 
 //
 //==============================================================================
 - (void) setNeedsDisplay:(BOOL)flag
 {
-	[super setNeedsDisplay:flag];
+	if(flag == YES)
+		[[LDrawGLRedrawScheduler sharedScheduler] setNeedsRedraw:self];
+	else
+		[super setNeedsDisplay:flag];
 }
 
 
@@ -2844,6 +2890,25 @@ static NSSize Size2ToNSSize(Size2 size)
 }
 
 
+//========== LDrawGLRenderer:snapDisplacement:ofDirectives: ====================
+//
+// Purpose:		Lets our delegate adjust the displacement of dragged directives, 
+//				which has already been snapped to the grid. 
+//
+//==============================================================================
+- (Vector3) LDrawGLRenderer:(LDrawGLRenderer*)renderer
+		   snapDisplacement:(Vector3)displacement
+			   ofDirectives:(NSArray *)directives
+{
+	if([self->delegate respondsToSelector:@selector(LDrawGLView:snapDisplacement:ofDirectives:)])
+	{
+		displacement = [self->delegate LDrawGLView:self snapDisplacement:displacement ofDirectives:directives];
+	}
+	
+	return displacement;
+}
+
+
 #pragma mark -
 #pragma mark NOTIFICATIONS
 #pragma mark -
@@ -3394,6 +3459,7 @@ static NSSize Size2ToNSSize(Size2 size)
 	[self saveConfiguration];
 	
 	[[NSNotificationCenter defaultCenter] removeObserver:self];
+	[[LDrawGLRedrawScheduler sharedScheduler] cancelRedraw:self];
 	
 	[renderer		release];
 	[canDrawLock	release];